@@ -16,7 +16,9 @@
 #include <sys/sem.h>
 #include <sys/msg.h>
 #include <sys/wait.h>
+#include <sys/resource.h>
 #include <limits.h>
+#include <stdint.h>
 #include <pthread.h>
 
 /// Główne limity systemu - wymagane w zadaniu
@@ -45,12 +47,83 @@
 #error "K musi byc < N2"
 #endif
 
+/// Progi wieku z regulaminu
+#define WIEK_Z_OPIEKUNEM 8  /// Młodsze dzieci tylko z opiekunem
+#define WIEK_SENIORA 75     /// Starsi tylko na trasy bez górnego limitu wieku
+
 /// Czasy w sekundach - jak długo co trwa
 #define T1 10  /// Zwiedzanie trasy 1
 #define T2 15  /// Zwiedzanie trasy 2
 #define Tp 0   /// Czas planowania (nieużywany bo 0)
 #define Tk 120  /// Jak długo kasa działa
 
+/// Układ jaskini - trasy i kładki opisane tabelami, z nich strażnik tworzy IPC
+/// i uruchamia po jednym przewodniku na trasę.
+///   TRASA(pojemność, czas zwiedzania [s], min wiek, max wiek, maska kładek, sygnał zamknięcia)
+///   KLADKA(pojemność)
+/// Bit i maski = kładka i+1. Przewodnik blokuje wszystkie kładki z maski (rosnąco) i dzieli
+/// grupę między nie. Dzieci < WIEK_Z_OPIEKUNEM idą z opiekunem na trasę z min wiekiem <= MIN_WIEK.
+/// Wybór układu: make UKLAD=n - domyślnie 2, czyli jaskinia z zadania.
+#ifndef UKLAD_JASKINI
+#define UKLAD_JASKINI 2
+#endif
+
+#if UKLAD_JASKINI == 2
+/// Dwie trasy przez wspólne dwie kładki
+#define TABELA_TRAS(TRASA) \
+    TRASA(N1, T1, WIEK_Z_OPIEKUNEM, WIEK_SENIORA, 0x3, SIGUSR1) \
+    TRASA(N2, T2, 0, INT_MAX, 0x3, SIGUSR2)
+#define TABELA_KLADEK(KLADKA) \
+    KLADKA(K) \
+    KLADKA(K)
+#elif UKLAD_JASKINI == 4
+/// Dwa niezależne wejścia - każde jak jaskinia z zadania, z własną parą kładek
+#define TABELA_TRAS(TRASA) \
+    TRASA(N1, T1, WIEK_Z_OPIEKUNEM, WIEK_SENIORA, 0x3, SIGUSR1) \
+    TRASA(N2, T2, 0, INT_MAX, 0x3, SIGUSR2) \
+    TRASA(N1, T1, WIEK_Z_OPIEKUNEM, WIEK_SENIORA, 0xC, SIGUSR1) \
+    TRASA(N2, T2, 0, INT_MAX, 0xC, SIGUSR2)
+#define TABELA_KLADEK(KLADKA) \
+    KLADKA(K) \
+    KLADKA(K) \
+    KLADKA(K) \
+    KLADKA(K)
+#else
+#error "Nieznany UKLAD_JASKINI (2 lub 4)"
+#endif
+
+#define MAX_TRAS 8     /// Górne limity tabel - role w logu, metryki, analizator
+#define MAX_KLADEK 8
+#define MAX_POJEMNOSC_TRASY 64  /// Rozmiar tablic grupy u przewodnika
+
+#define POLICZ_ELEMENT(...) + 1
+enum {
+    LICZBA_TRAS = 0 TABELA_TRAS(POLICZ_ELEMENT),
+    LICZBA_KLADEK = 0 TABELA_KLADEK(POLICZ_ELEMENT)
+};
+
+/// Opis trasy - jeden wiersz TABELA_TRAS
+typedef struct {
+    int pojemnosc;          /// Max osób jednocześnie na trasie (Ni)
+    int czas_s;             /// Czas zwiedzania (Ti)
+    int min_wiek;           /// Najmłodszy wpuszczany (dzieci tylko z opiekunem)
+    int max_wiek;           /// Najstarszy wpuszczany
+    unsigned maska_kladek;  /// Kładki, przez które przechodzi grupa
+    int sygnal;             /// Sygnał zamknięcia od strażnika
+} OpisTrasy;
+
+/// Opis kładki - jeden wiersz TABELA_KLADEK
+typedef struct {
+    int pojemnosc;  /// Max osób naraz na kładce (K)
+} OpisKladki;
+
+#define OPIS_TRASY(pojemnosc, czas_s, min_wiek, max_wiek, maska, sygnal) \
+    { pojemnosc, czas_s, min_wiek, max_wiek, maska, sygnal },
+static const OpisTrasy TRASY[LICZBA_TRAS] = { TABELA_TRAS(OPIS_TRASY) };
+
+#define OPIS_KLADKI(pojemnosc) { pojemnosc },
+static const OpisKladki KLADKI[LICZBA_KLADEK] = { TABELA_KLADEK(OPIS_KLADKI) };
+
 /// Ustawienia generatora zwiedzających
 #define OPOZNIENIE_GENERATORA_MIN 0  /// Min przerwa między ludźmi
 #define OPOZNIENIE_GENERATORA_MAX 5  /// Max przerwa między ludźmi
@@ -62,6 +135,21 @@
 #define MAX_WIEK_OPIEKUNA 60         /// Opiekun musi mieć max 60 lat
 #define MAX_ZWIEDZAJACYCH 1000       /// Limit żyjących procesów zwiedzających
 
+/// Tabele sprawdzane w kompilacji - jak #error dla N1/N2/K wyżej
+#define SPRAWDZ_TRASE(pojemnosc, czas_s, min_wiek, max_wiek, maska, sygnal) \
+    _Static_assert((pojemnosc) > 0 && (pojemnosc) <= MAX_POJEMNOSC_TRASY && (czas_s) >= 0 && (min_wiek) <= (max_wiek) && \
+        (maska) != 0 && ((maska) >> LICZBA_KLADEK) == 0, "Bledny wiersz TABELA_TRAS");
+#define SPRAWDZ_KLADKE(pojemnosc) _Static_assert((pojemnosc) > 0, "Bledny wiersz TABELA_KLADEK");
+TABELA_TRAS(SPRAWDZ_TRASE)
+TABELA_KLADEK(SPRAWDZ_KLADKE)
+
+#define TRASA_DLA_DZIECI(pojemnosc, czas_s, min_wiek, ...) + ((min_wiek) <= MIN_WIEK)
+#define TRASA_DLA_SENIOROW(pojemnosc, czas_s, min_wiek, max_wiek, ...) + ((max_wiek) >= MAX_WIEK)
+_Static_assert(LICZBA_TRAS >= 1 && LICZBA_TRAS <= MAX_TRAS, "LICZBA_TRAS poza 1..MAX_TRAS");
+_Static_assert(LICZBA_KLADEK >= 1 && LICZBA_KLADEK <= MAX_KLADEK, "LICZBA_KLADEK poza 1..MAX_KLADEK");
+_Static_assert(0 TABELA_TRAS(TRASA_DLA_DZIECI) > 0, "Brak trasy dla dzieci z opiekunem");
+_Static_assert(0 TABELA_TRAS(TRASA_DLA_SENIOROW) > 0, "Brak trasy dla najstarszych");
+
 /// Parametry techniczne
 #define CZAS_ZBIERANIA_GRUPY 5         /// Przewodnik czeka max 5s na pełną grupę
 #define CZAS_PRZECHODZENIA_KLADKA 200  /// Każdy idzie 200ms przez kładkę
@@ -71,42 +159,46 @@
 #define TIMEOUT_ODPOWIEDZ_BILET 30        /// Max czekanie na kasjer
 #define INTERWAL_POLLING 100              /// Co ile ms sprawdzać (polling)
 #define TIMEOUT_PUSTA_JASKINIA 300        /// Max czekanie aż wszyscy wyjdą
-#define WYPRZEDZENIE_SYGNAL_ZAMKNIECIA 10 /// Sygnał zamknięcia 10s przed końcem
+#define MIN_CZAS_OTWARCIA 11              /// Najkrótszy dzień (JASKINIA_TK, BENCH_TK)
 #define TIMEOUT_CZEKAJ_CLEANUP 10         /// Ile czekać przy sprzątaniu
-#define MAX_PROB_RETRY 10                 /// Ile razy próbować podłączyć IPC
+#define MAX_PROB_RETRY 10                 /// Ile razy próbować podłączyć IPC (co INTERWAL_POLLING)
+#define TIMEOUT_GOTOWOSC_MS 10000         /// Max czekanie strażnika na gotowość ról przed otwarciem
 #define INTERWAL_LOG 10                   /// Co ile sekund logować stan
 #define PROBY_SPRAWDZ_OPIEKUNA 3          /// Ile razy sprawdzić czy opiekun żyje
 
-/// Klucze IPC - losowe żeby nie kolidowały z innymi programami
-#define KLUCZ_SHM_JASKINIA 0x7A2F      /// Czy jaskinia otwarta/zamknięta
-#define KLUCZ_SHM_KLADKA1 0x4B91       /// Stan kładki 1
-#define KLUCZ_SHM_KLADKA2 0x8E3C       /// Stan kładki 2
-#define KLUCZ_SHM_TRASA1 0x2D74        /// Ile osób na trasie 1
-#define KLUCZ_SHM_TRASA2 0x6A1E        /// Ile osób na trasie 2
-#define KLUCZ_SHM_ZWIEDZAJACY 0x9F42   /// Lista PIDów zwiedzających
+/// Instancja symulacji (JASKINIA_INSTANCJA, domyślnie 0) - kilka symulacji obok siebie na jednym
+/// hoście. Numer instancji to górne 16 bitów każdego klucza IPC, a pliki logów, dziennika i śladu
+/// dostają go w nazwie (plik_instancji). Role dziedziczą go przez środowisko.
+#define MAX_INSTANCJA 0x7FFF  /// key_t zostaje dodatni
+#define KLUCZ_INSTANCJI(klucz) ((key_t)(((unsigned)instancja_jaskini() << 16) | (unsigned)(klucz)))
+
+/// Klucze IPC - losowe żeby nie kolidowały z innymi programami; dolne 16 bitów, górne to instancja
+#define KLUCZ_SHM_JASKINIA KLUCZ_INSTANCJI(0x7A2F)      /// Czy jaskinia otwarta/zamknięta
+#define KLUCZ_SHM_KLADKI KLUCZ_INSTANCJI(0x4B91)        /// Stany kładek - ShmKladka[LICZBA_KLADEK]
+#define KLUCZ_SHM_TRASY KLUCZ_INSTANCJI(0x2D74)         /// Ile osób na trasach - ShmTrasa[LICZBA_TRAS]
+#define KLUCZ_SHM_ZWIEDZAJACY KLUCZ_INSTANCJI(0x9F42)   /// Lista PIDów zwiedzających
+#define KLUCZ_SHM_HISTOGRAMY KLUCZ_INSTANCJI(0x3E17)    /// Histogramy czasów etapów (histogramy.h)
+#define KLUCZ_SHM_METRYKI KLUCZ_INSTANCJI(0x5C83)       /// Strona metryk na żywo (metryki.h)
+#define KLUCZ_SHM_PROFIL_BLOKAD KLUCZ_INSTANCJI(0x7B52) /// Profil rywalizacji o blokady (profil_blokad.h)
+#define KLUCZ_SHM_PARY KLUCZ_INSTANCJI(0x1D86)          /// Rejestr par opiekun-dziecko (pary.h)
+#define KLUCZ_SHM_PIERSCIENIE KLUCZ_INSTANCJI(0x6E38)   /// Kolejki do przewodników - pierścienie tras (pierscien.h)
 
 /// Klucze dla semaforów
-#define KLUCZ_SEM_KLADKA1_MIEJSCA 0x3C8B  /// Semafor limitujący kładkę 1 (max K)
-#define KLUCZ_SEM_KLADKA2_MIEJSCA 0x5D29  /// Semafor limitujący kładkę 2 (max K)
-#define KLUCZ_SEM_LOG 0x1A7E              /// Mutex do zapisu logów
-#define KLUCZ_SEM_TRASA1_MUTEX 0x4F63     /// Mutex do licznika trasy 1
-#define KLUCZ_SEM_TRASA2_MUTEX 0x8B94     /// Mutex do licznika trasy 2
+#define KLUCZ_SEM_KLADKI_MIEJSCA KLUCZ_INSTANCJI(0x3C8B)   /// Semafory limitujące kładki - numer i = kładka i+1
 
 /// Klucze dla kolejek komunikatów
-#define KLUCZ_MSG_KASJER 0x2E5A        /// Kolejka do kasjera (prośby o bilety)
-#define KLUCZ_MSG_PRZEWODNIK1 0x7C1F   /// Kolejka do przewodnika 1
-#define KLUCZ_MSG_PRZEWODNIK2 0x9A48   /// Kolejka do przewodnika 2
+#define KLUCZ_MSG_KASJER KLUCZ_INSTANCJI(0x2E5A)        /// Kolejka do kasjera (prośby o bilety)
 
 /// Typy wiadomości w kolejkach - żeby kasjer wiedział co to za request
 #define TYP_MSG_ZADANIE 1      /// Zwykłe zadanie (pierwsza wizyta)
 #define TYP_MSG_ODPOWIEDZ 2    /// Odpowiedź od kasjera
 #define TYP_MSG_ZWIEDZAJACY 3  /// Info o zwiedzającym do przewodnika
 #define TYP_MSG_POWTORNA 4     /// Powtórna wizyta (wyższy priorytet!)
+#define TYP_MSG_ZWIEDZAJACY_POWTORNY 5  /// Powracający do przewodnika - pas priorytetowy (przewodnik_helpers.h)
 
 /// Decyzje kasjera
 #define DECYZJA_ODRZUCONY 0  /// Nie wpuszczamy (np. dziecko bez opiekuna)
-#define DECYZJA_TRASA1 1     /// Idziesz na trasę 1
-#define DECYZJA_TRASA2 2     /// Idziesz na trasę 2
+#define DECYZJA_TRASA(n) (n) /// Idziesz na trasę n (1..LICZBA_TRAS)
 
 /// Kierunki na kładce - ważne bo kładka wąska (tylko jeden kierunek!)
 #define KIERUNEK_PUSTY 0    /// Nikt nie idzie, można zablokować
@@ -115,9 +207,10 @@
 
 /// Stan jaskini - czy otwarta czy już zamknięta
 typedef struct {
-    volatile int otwarta;           /// 1 = otwarta, 0 = zamknięta
-    pthread_mutex_t mutex;          /// Mutex do bezpiecznej zmiany stanu
-    pthread_cond_t cond_otwarta;    /// Condition variable - budzimy procesy gdy otwieramy
+    uint32_t stan_otwarcia;         /// Futex: numer zmiany << 1 | otwarta (jaskinia_otwarta w common_helpers.h)
+    uint32_t epoka;                 /// Epoka startu - strażnik ustawia przed fork (JASKINIA_EPOKA)
+    uint32_t gotowe;                /// Futex: ile ról zgłosiło gotowość w tej epoce
+    uint64_t koniec_dnia_ns;        /// Tk w czasie monotonicznym - strażnik ustawia przy otwarciu
 } ShmJaskinia;
 
 /// Stan kładki - kto i w którą stronę idzie
@@ -129,9 +222,10 @@ typedef struct {
     pthread_cond_t cond;            /// Condition variable do oczekiwania
 } ShmKladka;
 
-/// Licznik osób na trasie - prosta struktura
+/// Licznik osób na trasie - zmieniany tylko atomowo (trasa_rezerwuj/trasa_zwolnij w common_helpers.h)
 typedef struct {
-    volatile int osoby;  /// Ile osób aktualnie zwieda
+    int osoby;              /// Ile osób aktualnie zwieda
+    uint32_t oproznienia;   /// Futex: ile razy obsada spadła do zera - strażnik czeka na pustą trasę
 } ShmTrasa;
 
 /// Lista wszystkich aktywnych zwiedzających - do cleanup
@@ -149,20 +243,23 @@ typedef struct {
     int poprzednia_trasa;      /// Jeśli powtórna - na której byłem
     pid_t pid_opiekuna;        /// PID opiekuna jeśli jestem dzieckiem
     int czy_opiekun;           /// Czy sam jestem opiekunem dziecka
+    int id_pary;               /// Wpis w rejestrze par (pary.h), -1 = bez pary
 } WiadomoscKasjer;
 
 /// Odpowiedź od kasjera - czy dostałem bilet
 typedef struct {
     long mtype;              /// PID zwiedzającego (żeby każdy dostał swoją odpowiedź)
-    int decyzja;             /// ODRZUCONY/TRASA1/TRASA2
+    int decyzja;             /// DECYZJA_ODRZUCONY/DECYZJA_TRASA(n)
     int przydzielona_trasa;  /// Konkretny numer trasy
 } WiadomoscOdpowiedz;
 
 /// Wiadomość do przewodnika - dołączam do grupy
 typedef struct {
-    long mtype;              /// TYP_MSG_ZWIEDZAJACY
+    long mtype;              /// TYP_MSG_ZWIEDZAJACY lub TYP_MSG_ZWIEDZAJACY_POWTORNY
     pid_t pid_zwiedzajacego; /// Mój PID
     int wiek;                /// Mój wiek (dla statystyk)
+    int id_pary;             /// Wpis w rejestrze par - przewodnik trzyma parę razem
+    uint64_t czas_dolaczenia_ns;  /// Kiedy dołączyłem do kolejki (zegar monotoniczny)
 } WiadomoscPrzewodnik;
 
 /// Unia pomocnicza dla starszych wersji POSIX (semctl wymaga)
@@ -183,19 +280,52 @@ static inline int bezpieczny_strtol(const char* str, int* wynik, int min, int ma
     return 0;
 }
 
-/// Globalny semafor do logowania - żeby logi się nie mieszały
-extern int globalny_semid_log;
-
-/// Podłącz się do semafora logów z retry
-static inline int podlacz_sem_log() {
-    int retry = 0;
-    while (retry < MAX_PROB_RETRY) {
-        int semid = semget(KLUCZ_SEM_LOG, 0, 0);
-        if (semid != -1) return semid;
-        usleep(INTERWAL_POLLING * 1000);
-        retry++;
+/// Numer instancji z JASKINIA_INSTANCJA: 0 gdy brak, -1 gdy błędny (strażnik wtedy nie startuje)
+static inline int instancja_z_env(void) {
+    const char* env = getenv("JASKINIA_INSTANCJA");
+    int instancja;
+    if (!env || env[0] == '\0') return 0;
+    return bezpieczny_strtol(env, &instancja, 0, MAX_INSTANCJA) == 0 ? instancja : -1;
+}
+
+/// Instancja tego procesu - czytana raz, środowisko się nie zmienia
+static inline int instancja_jaskini(void) {
+    static int instancja = -1;
+    if (instancja < 0) {
+        int z_env = instancja_z_env();
+        instancja = z_env >= 0 ? z_env : 0;
     }
-    return -1;
+    return instancja;
+}
+
+/// Nazwa pliku w przestrzeni instancji: dla 0 bez zmian, dla n numer przed rozszerzeniem
+/// (jaskinia_common.log -> jaskinia_common.3.log)
+static inline const char* plik_instancji(const char* nazwa, char* bufor, size_t rozmiar) {
+    int instancja = instancja_jaskini();
+    if (instancja == 0) return nazwa;
+    const char* kropka = strrchr(nazwa, '.');
+    int przed = kropka ? (int)(kropka - nazwa) : (int)strlen(nazwa);
+    snprintf(bufor, rozmiar, "%.*s.%d%s", przed, nazwa, instancja, kropka ? kropka : "");
+    return bufor;
+}
+
+/// Zegar monotoniczny w nanosekundach - wspólny dla wszystkich procesów
+static inline uint64_t czas_monotoniczny_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/// Przed każdą synchronizacją z innym procesem - czekaniem (sen, msgrcv, sigsuspend, semop P,
+/// zmienna warunkowa) albo obudzeniem go (semop V, zwolnienie mutexu, sygnał, msgsnd).
+/// loguj_inicjalizuj podpina tu opróżnienie bufora logu: termin bufora sprawdzany przy logowaniu
+/// nie budzi śpiącego procesu, a linie sprzed obudzenia innego procesu muszą trafić do pliku
+/// przed jego liniami. Synchronizacja idzie przez opakowania z common_helpers.h,
+/// bezpieczny_sem_wait/signal i odblokuj_mutex/czekaj_cond
+static void (*hak_synchronizacji)(void) __attribute__((unused)) = NULL;
+
+static inline void przed_synchronizacja(void) {
+    if (hak_synchronizacji) hak_synchronizacji();
 }
 
 /// Zapisz cały bufor do pliku - retry przy EINTR
@@ -214,10 +344,15 @@ static inline ssize_t bezpieczny_zapis_wszystko(int fd, const void* buf, size_t
     return zapisane;
 }
 
+/// Opakowania blokad z profilerem - potrzebują czasu monotonicznego z góry pliku
+#include "profil_blokad.h"
+
 /// Bezpieczny semop - retry przy przerwaniu sygnałem
-static inline int bezpieczny_semop(int semid, struct sembuf* ops, size_t liczba) {
+/// Pojedyncze P/V idą przez profiler (gdy włączony) - miejsce wywołania podaje makro
+static inline int bezpieczny_semop_w(int semid, struct sembuf* ops, size_t liczba, MiejsceWywolania* miejsce) {
+    int profiluj = PROFIL_AKTYWNY() && liczba == 1 && ops->sem_op != 0 && !(ops->sem_flg & IPC_NOWAIT);
     while (1) {
-        if (semop(semid, ops, liczba) == 0) {
+        if ((profiluj ? profil_semop(semid, ops, miejsce) : semop(semid, ops, liczba)) == 0) {
             return 0;
         }
         if (errno != EINTR) {  /// Jeśli nie EINTR to prawdziwy błąd
@@ -226,43 +361,23 @@ static inline int bezpieczny_semop(int semid, struct sembuf* ops, size_t liczba)
         /// Przy EINTR próbuj ponownie
     }
 }
-
-/// Zapisz do logu z mutexem - żeby wiele procesów mogło logować równocześnie
-static inline void bezpieczny_zapis_logu(const char* buf, size_t dlugosc, const char* nazwa_pliku) {
-    int sem_zdobyty = 0;
-
-    /// Próba zdobycia mutexu
-    if (globalny_semid_log != -1) {
-        struct sembuf op = { 0, -1, 0 };
-        if (bezpieczny_semop(globalny_semid_log, &op, 1) == 0) {
-            sem_zdobyty = 1;
-        }
-    }
-
-    /// Zapis do pliku
-    int fd = open(nazwa_pliku, O_WRONLY | O_CREAT | O_APPEND, 0644);
-    if (fd != -1) {
-        bezpieczny_zapis_wszystko(fd, buf, dlugosc);
-        close(fd);
-    }
-
-    /// Zwolnienie mutexu
-    if (sem_zdobyty) {
-        struct sembuf op = { 0, 1, 0 };
-        bezpieczny_semop(globalny_semid_log, &op, 1);
-    }
-}
+#define bezpieczny_semop(semid, ops, liczba) \
+    bezpieczny_semop_w((semid), (ops), (liczba), PROFIL_MIEJSCE(#semid))
 
 /// P operation (wait) na semaforze
-static inline void bezpieczny_sem_wait(int semid, int numer) {
+static inline void bezpieczny_sem_wait_w(int semid, int numer, MiejsceWywolania* miejsce) {
     struct sembuf op = { numer, -1, 0 };
-    bezpieczny_semop(semid, &op, 1);
+    przed_synchronizacja();
+    bezpieczny_semop_w(semid, &op, 1, miejsce);
 }
+#define bezpieczny_sem_wait(semid, numer) bezpieczny_sem_wait_w((semid), (numer), PROFIL_MIEJSCE(#semid))
 
 /// V operation (signal) na semaforze
-static inline void bezpieczny_sem_signal(int semid, int numer) {
+static inline void bezpieczny_sem_signal_w(int semid, int numer, MiejsceWywolania* miejsce) {
     struct sembuf op = { numer, 1, 0 };
-    bezpieczny_semop(semid, &op, 1);
+    przed_synchronizacja();
+    bezpieczny_semop_w(semid, &op, 1, miejsce);
 }
+#define bezpieczny_sem_signal(semid, numer) bezpieczny_sem_signal_w((semid), (numer), PROFIL_MIEJSCE(#semid))
 
 #endif
\ No newline at end of file
@@ -2,6 +2,8 @@
 #define COMMON_HELPERS_H
 
 #include "common.h"
+#include <linux/futex.h>
+#include <sys/syscall.h>
 
 /// Podcz si do shared memory z retry - czasem IPC jeszcze nie istnieje
 static inline int podlacz_shm_helper(key_t klucz, void** ptr) {
@@ -11,11 +13,11 @@ static inline int podlacz_shm_helper(key_t klucz, void** ptr) {
         if (shmid != -1) {
             *ptr = shmat(shmid, NULL, 0);  /// Podcz si do niego
             if (*ptr != (void*)-1) return 0;  /// Sukces!
-            sleep(1);
+            usleep(INTERWAL_POLLING * 1000);
             retry++;
             continue;
         }
-        sleep(1);
+        usleep(INTERWAL_POLLING * 1000);
         retry++;
     }
     return -1;  /// Nie udao si po MAX_PROB_RETRY prbach
@@ -27,7 +29,7 @@ static inline int podlacz_sem_helper(key_t klucz) {
     while (retry < MAX_PROB_RETRY) {
         int semid = semget(klucz, 0, 0);
         if (semid != -1) return semid;
-        sleep(1);
+        usleep(INTERWAL_POLLING * 1000);
         retry++;
     }
     return -1;
@@ -39,12 +41,114 @@ static inline int podlacz_msg_helper(key_t klucz) {
     while (retry < MAX_PROB_RETRY) {
         int msgid = msgget(klucz, 0);
         if (msgid != -1) return msgid;
-        sleep(1);
+        usleep(INTERWAL_POLLING * 1000);
         retry++;
     }
     return -1;
 }
 
+/// Futex na sowie w pamici wspdzielonej (bez FUTEX_PRIVATE - rne procesy)
+static inline long futex_jaskini(uint32_t* adres, int operacja, uint32_t wartosc, const struct timespec* limit) {
+    przed_synchronizacja();  /// WAIT i WAKE - jak pozostae opakowania
+    return syscall(SYS_futex, adres, operacja, wartosc, limit, NULL, 0);
+}
+
+/// Stan otwarcia jaskini w jednym sowie ShmJaskinia.stan_otwarcia: bit 0 = otwarta, wyej
+/// numer zmiany. Ptle rl czytaj go zwykym load-acquire, otwarcie czeka futeksem na sowie.
+#define STAN_OTWARTA 1U
+
+static inline int jaskinia_otwarta(const ShmJaskinia* shm_j) {
+    return (int)(__atomic_load_n(&shm_j->stan_otwarcia, __ATOMIC_ACQUIRE) & STAN_OTWARTA);
+}
+
+/// Stranik: otwrz/zamknij - release publikuje wczeniejsze zapisy (koniec_dnia_ns), budzi wszystkich
+static inline void ustaw_otwarcie(ShmJaskinia* shm_j, int otwarta) {
+    uint32_t stary = __atomic_load_n(&shm_j->stan_otwarcia, __ATOMIC_RELAXED);
+    uint32_t nowy;
+    do {
+        nowy = ((stary & ~STAN_OTWARTA) + 2U) | (otwarta ? STAN_OTWARTA : 0U);
+    } while (!__atomic_compare_exchange_n(&shm_j->stan_otwarcia, &stary, nowy, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    futex_jaskini(&shm_j->stan_otwarcia, FUTEX_WAKE, INT_MAX, NULL);
+}
+
+/// Czekaj na otwarcie albo koniec pracy (*kontynuuj = 0). Limit co sekund tylko po to, by
+/// sygna midzy sprawdzeniem flagi a upieniem nie zostawi roli w futeksie. 1 = otwarta
+static inline int czekaj_na_otwarcie(ShmJaskinia* shm_j, volatile sig_atomic_t* kontynuuj) {
+    uint32_t stan;
+    while (!((stan = __atomic_load_n(&shm_j->stan_otwarcia, __ATOMIC_ACQUIRE)) & STAN_OTWARTA) && *kontynuuj) {
+        struct timespec limit = { .tv_sec = 1, .tv_nsec = 0 };
+        futex_jaskini(&shm_j->stan_otwarcia, FUTEX_WAIT, stan, &limit);
+    }
+    return (int)(stan & STAN_OTWARTA);
+}
+
+/// Zgo stranikowi gotowo - woane po podczeniu wszystkich zasobw, przed czekaniem na Tp.
+/// Liczy si tylko proces z epoki stranika (JASKINIA_EPOKA) - obcy z poprzedniego startu nie
+static inline void zglos_gotowosc(ShmJaskinia* shm_j) {
+    const char* env = getenv("JASKINIA_EPOKA");
+    if (!env || (uint32_t)strtoul(env, NULL, 10) != __atomic_load_n(&shm_j->epoka, __ATOMIC_ACQUIRE)) return;
+    __atomic_add_fetch(&shm_j->gotowe, 1, __ATOMIC_RELEASE);
+    futex_jaskini(&shm_j->gotowe, FUTEX_WAKE, INT_MAX, NULL);
+}
+
+/// Czekaj a `liczba` rl zgosi gotowo albo minie limit_ms / przyjdzie *przerwij.
+/// Zwraca liczb gotowych - mniej ni `liczba` oznacza limit lub przerwanie
+static inline uint32_t czekaj_na_gotowosc(ShmJaskinia* shm_j, uint32_t liczba, int limit_ms,
+    volatile sig_atomic_t* przerwij) {
+    uint64_t koniec_ns = czas_monotoniczny_ns() + (uint64_t)limit_ms * 1000000ULL;
+    uint32_t gotowe;
+    while ((gotowe = __atomic_load_n(&shm_j->gotowe, __ATOMIC_ACQUIRE)) < liczba && !*przerwij) {
+        uint64_t teraz = czas_monotoniczny_ns();
+        if (teraz >= koniec_ns) break;
+        uint64_t zostalo = koniec_ns - teraz;
+        struct timespec limit = { .tv_sec = (time_t)(zostalo / 1000000000ULL),
+            .tv_nsec = (long)(zostalo % 1000000000ULL) };
+        /// EAGAIN = licznik zmieni si przed upieniem, EINTR = SIGCHLD - w obu sprawdzamy od nowa
+        futex_jaskini(&shm_j->gotowe, FUTEX_WAIT, gotowe, &limit);
+    }
+    return gotowe;
+}
+
+/// Obsada trasy bez semafora - CAS na ShmTrasa.osoby, kilku przewodnikw moe dzieli tras.
+/// Rezerwuje do n miejsc (ile si zmieci przy pojemnoci), zwraca przyznane 0..n;
+/// *poprzednio = obsada tu przed rezerwacj
+static inline int trasa_rezerwuj(ShmTrasa* t, int n, int pojemnosc, int* poprzednio) {
+    int stare = __atomic_load_n(&t->osoby, __ATOMIC_RELAXED);
+    int przyznane;
+    do {
+        przyznane = pojemnosc - stare < n ? pojemnosc - stare : n;
+        if (przyznane <= 0) {
+            przyznane = 0;
+            break;
+        }
+    } while (!__atomic_compare_exchange_n(&t->osoby, &stare, stare + przyznane, 1, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+    if (poprzednio) *poprzednio = stare;
+    return przyznane;
+}
+
+/// Zwolnij n miejsc - zejcie do zera budzi czekajcych w trasa_czekaj_pusta. Zwraca now obsad
+static inline int trasa_zwolnij(ShmTrasa* t, int n) {
+    int zostalo = __atomic_sub_fetch(&t->osoby, n, __ATOMIC_ACQ_REL);
+    if (zostalo == 0) {
+        __atomic_add_fetch(&t->oproznienia, 1, __ATOMIC_RELEASE);
+        futex_jaskini(&t->oproznienia, FUTEX_WAKE, INT_MAX, NULL);
+    }
+    return zostalo;
+}
+
+static inline int trasa_osoby(const ShmTrasa* t) {
+    return __atomic_load_n(&t->osoby, __ATOMIC_ACQUIRE);
+}
+
+/// Czekaj maks. limit_ms a trasa si oprni (albo sygna) - 1 = pusta
+static inline int trasa_czekaj_pusta(ShmTrasa* t, int limit_ms) {
+    uint32_t oproznienia = __atomic_load_n(&t->oproznienia, __ATOMIC_ACQUIRE);  /// Przed odczytem obsady
+    if (trasa_osoby(t) == 0) return 1;
+    struct timespec limit = { .tv_sec = limit_ms / 1000, .tv_nsec = (long)(limit_ms % 1000) * 1000000L };
+    futex_jaskini(&t->oproznienia, FUTEX_WAIT, oproznienia, &limit);
+    return trasa_osoby(t) == 0;
+}
+
 /// Makro do bezpiecznego odczenia shared memory
 #define BEZPIECZNY_SHMDT(ptr) \
     do { \
@@ -54,26 +158,87 @@ static inline int podlacz_msg_helper(key_t klucz) {
         } \
     } while(0)
 
-/// Inicjalizuj globalny semafor logw - wywoaj na pocztku main()
-#define INIT_SEMAFOR_LOG() \
-    do { \
-        globalny_semid_log = podlacz_sem_log(); \
-        if (globalny_semid_log == -1) { \
-            fprintf(stderr, "OSTRZEZENIE: Nie mozna podlaczyc semafora logow\n"); \
-        } \
-    } while(0)
+/// Czekanie na inne procesy i budzenie ich - sen, blokujce msgrcv/sigsuspend, msgsnd i sygnay
+/// przez te opakowania, eby najpierw zadziaa przed_synchronizacja (common.h)
+static inline unsigned int sen_s(unsigned int sekundy) {
+    przed_synchronizacja();
+    return sleep(sekundy);
+}
+
+static inline int sen_us(useconds_t mikrosekundy) {
+    przed_synchronizacja();
+    return usleep(mikrosekundy);
+}
+
+/// Blokujcy msgrcv (bez IPC_NOWAIT)
+static inline ssize_t czekaj_msg(int msgid, void* wiadomosc, size_t rozmiar, long typ) {
+    przed_synchronizacja();
+    return msgrcv(msgid, wiadomosc, rozmiar, typ, 0);
+}
+
+static inline int czekaj_na_sygnal(const sigset_t* maska) {
+    przed_synchronizacja();
+    return sigsuspend(maska);
+}
+
+static inline int wyslij_msg(int msgid, const void* wiadomosc, size_t rozmiar, int flagi) {
+    przed_synchronizacja();
+    return msgsnd(msgid, wiadomosc, rozmiar, flagi);
+}
+
+static inline int wyslij_sygnal(pid_t pid, int sygnal) {
+    przed_synchronizacja();
+    return kill(pid, sygnal);
+}
+
+/// Parametr liczbowy ze zmiennej rodowiskowej - domylna gdy brak lub poza zakresem
+/// Pozwala benchmarkowi sterowa symulacj bez przekompilowania (stae z common.h to domylne)
+static inline int parametr_env(const char* nazwa, int domyslna, int min, int max) {
+    const char* env = getenv(nazwa);
+    int wartosc;
+    if (!env || env[0] == '\0' || bezpieczny_strtol(env, &wartosc, min, max) != 0) return domyslna;
+    return wartosc;
+}
+
+/// Jak parametr_env, ale uamkowy (np. JASKINIA_TEMPO=0.5)
+static inline double parametr_env_ulamek(const char* nazwa, double domyslna, double min, double max) {
+    const char* env = getenv(nazwa);
+    if (!env || env[0] == '\0') return domyslna;
+    char* koniec;
+    errno = 0;
+    double wartosc = strtod(env, &koniec);
+    if (errno != 0 || koniec == env || *koniec != '\0' || wartosc < min || wartosc > max) return domyslna;
+    return wartosc;
+}
+
+/// Ziarno rand() - stae gdy JASKINIA_SEED ustawione (powtarzalne pomiary), inaczej losowe
+/// rola rozrnia procesy, eby nie losoway tych samych liczb
+static inline unsigned int ziarno_losowania(int rola) {
+    int ziarno = parametr_env("JASKINIA_SEED", -1, 0, INT_MAX);
+    if (ziarno >= 0) return (unsigned int)ziarno + (unsigned int)rola;
+    return time(NULL) ^ getpid();
+}
 
 /// Sprawd czy proces o danym PID jeszcze yje
 static inline int czy_proces_zyje(pid_t pid) {
     return (pid > 0 && kill(pid, 0) == 0);  /// kill(pid,0) sprawdza istnienie
 }
 
+/// Nazwa sygnau zamknicia trasy do logw (TABELA_TRAS) - jak w kill -l
+static inline const char* nazwa_sygnalu(int sygnal) {
+    switch (sygnal) {
+    case SIGUSR1: return "SIGUSR1";
+    case SIGUSR2: return "SIGUSR2";
+    default: return "SIG?";
+    }
+}
+
 /// Makro - czekaj a jaskinia si zamknie
 #define CZEKAJ_NA_ZAMKNIECIE(shm_jaskinia, flaga_kontynuuj) \
     do { \
-        if (!(shm_jaskinia)->otwarta) { \
+        if (!jaskinia_otwarta(shm_jaskinia)) { \
             loguj_wiadomosc("Jaskinia zamknieta, czekam na SIGTERM"); \
-            while (flaga_kontynuuj) sleep(1); \
+            while (flaga_kontynuuj) sen_s(1); \
             break; \
         } \
     } while(0)
@@ -0,0 +1,300 @@
+#ifndef DZIENNIK_H
+#define DZIENNIK_H
+
+#include "common.h"
+#include <strings.h>
+
+/// Binarny dziennik zdarzeń (opcjonalny) - włączany zmienną JASKINIA_DZIENNIK=1
+/// Zamiast formatować linię (strftime/localtime/snprintf) i pisać ją do dwóch plików,
+/// każdy wpis to 64-bajtowy rekord dopisywany do jaskinia_dziennik.bin - jeden plik
+/// na przebieg, zakłada go strażnik. dziennik2txt odtwarza z niego jaskinia_common.log
+/// i logi poszczególnych ról.
+///
+/// Częste komunikaty mają identyfikator w katalogu poniżej - rekord niesie tylko
+/// identyfikator i argumenty, format jest stałą kompilacji. Pozostałe komunikaty idą
+/// jako tekst (dłuższe w kilku kolejnych rekordach). Wszystkie rekordy wpisu trafiają
+/// do pliku jednym write() z O_APPEND, więc nie przeplatają się z innymi procesami
+/// i semafor logów nie jest potrzebny.
+///
+/// Stan dziennika jest statyczny w nagłówku - tak jak w slad.h.
+
+#define DZIENNIK_MAGIC 0x4E425A44U  /// "DZBN"
+#define DZIENNIK_WERSJA 3
+#define DZIENNIK_PLIK "jaskinia_dziennik.bin"
+#define DZIENNIK_ARGUMENTY 8        /// Argumentów liczbowych w rekordzie
+#define DZIENNIK_TEKST 48           /// Bajtów tekstu w rekordzie
+#define DZIENNIK_MAX_REKORDOW 11    /// Rekordów na jedną 512-bajtową wiadomość tekstową
+
+/// Role piszące do dziennika - nazwy takie jak w nawiasach linii logu
+/// Przewodnicy na końcu, po jednym na trasę z TABELA_TRAS: ROLA_PRZEWODNIK(n)
+enum {
+    ROLA_STRAZNIK = 0,
+    ROLA_KASJER,
+    ROLA_GENERATOR,
+    ROLA_ZWIEDZAJACY,
+    ROLA_PRZEWODNIK1,
+    LICZBA_ROL = ROLA_PRZEWODNIK1 + LICZBA_TRAS
+};
+#define ROLA_PRZEWODNIK(trasa) (ROLA_PRZEWODNIK1 + (trasa) - 1)
+
+/// Tablice na MAX_TRAS przewodników - układ jaskini używa pierwszych LICZBA_TRAS
+static const char* const NAZWY_ROL[ROLA_PRZEWODNIK1 + MAX_TRAS] = {
+    "STRAZNIK", "KASJER", "GENERATOR", "ZWIEDZAJACY",
+    "PRZEWODNIK1", "PRZEWODNIK2", "PRZEWODNIK3", "PRZEWODNIK4",
+    "PRZEWODNIK5", "PRZEWODNIK6", "PRZEWODNIK7", "PRZEWODNIK8"
+};
+
+/// Pliki logów tekstowych - w instancji n z numerem w nazwie (plik_instancji w common.h)
+#define LOG_PLIK_WSPOLNY "jaskinia_common.log"
+
+/// Log roli obok wspólnego - strażnik pisze tylko do wspólnego
+static const char* const PLIKI_ROL[ROLA_PRZEWODNIK1 + MAX_TRAS] = {
+    NULL, "jaskinia_kasjer.log", "jaskinia_generator.log", "jaskinia_zwiedzajacy.log",
+    "jaskinia_przewodnik1.log", "jaskinia_przewodnik2.log", "jaskinia_przewodnik3.log", "jaskinia_przewodnik4.log",
+    "jaskinia_przewodnik5.log", "jaskinia_przewodnik6.log", "jaskinia_przewodnik7.log", "jaskinia_przewodnik8.log"
+};
+_Static_assert(MAX_TRAS == 8, "NAZWY_ROL/PLIKI_ROL maja wpisy dla 8 przewodnikow");
+
+/// Poziomy ważności - wyższy = więcej linii. Filtrowanie w loguj.h:
+/// poniżej LOG_POZIOM_KOMPILACJI wywołanie znika w kompilacji, powyżej decyduje maska ról
+enum {
+    LOG_BLAD = 0,       /// ERROR/BLAD/CRITICAL
+    LOG_OSTRZEZENIE,    /// WARN, timeouty, odrzucenia
+    LOG_INFO,           /// Start/stop ról, zdarzenia grup, raporty (zwykłe loguj_wiadomosc)
+    LOG_SZCZEGOLY,      /// Każdy krok zwiedzającego, sygnały do grupy, kładki
+    LICZBA_POZIOMOW
+};
+
+static const char* const NAZWY_POZIOMOW[LICZBA_POZIOMOW] = { "blad", "ostrzezenie", "info", "szczegoly" };
+
+/// Maska logu: LICZBA_POZIOMOW bitów na rolę (do 4 + MAX_TRAS = 12 ról * 4 = 48 bitów w jednym słowie)
+#define LOG_BIT(rola, poziom) (1ULL << ((rola) * LICZBA_POZIOMOW + (poziom)))
+#define LOG_MASKA_ROLI(rola) (((1ULL << LICZBA_POZIOMOW) - 1) << ((rola) * LICZBA_POZIOMOW))
+#define LOG_MASKA_WSZYSTKO ((1ULL << (LICZBA_ROL * LICZBA_POZIOMOW)) - 1)
+_Static_assert((ROLA_PRZEWODNIK1 + MAX_TRAS) * LICZBA_POZIOMOW < 64, "Maska logu nie miesci sie w 64 bitach");
+
+/// Najwyższy włączony poziom roli, -1 = rola wyciszona
+static inline int poziom_roli(uint64_t maska, int rola) {
+    for (int p = LICZBA_POZIOMOW - 1; p >= 0; p--) {
+        if (maska & LOG_BIT(rola, p)) return p;
+    }
+    return -1;
+}
+
+/// Zmień maskę wg opisu: "info" (wszystkie role) lub "zwiedzajacy=blad,przewodnik=szczegoly,..."
+/// Poziom włącza siebie i niższe; "przewodnik" = wszyscy przewodnicy. -1 gdy opis błędny.
+static inline int maska_logu_z_opisu(const char* opis, uint64_t* maska) {
+    uint64_t wynik = *maska;
+    char kopia[256];
+    if (strlen(opis) >= sizeof(kopia)) return -1;
+    strcpy(kopia, opis);
+
+    char* zapis;
+    for (char* el = strtok_r(kopia, ",", &zapis); el; el = strtok_r(NULL, ",", &zapis)) {
+        char* rownosc = strchr(el, '=');
+        const char* nazwa_poziomu = rownosc ? rownosc + 1 : el;
+        if (rownosc) *rownosc = '\0';
+
+        int poziom = -1;
+        for (int p = 0; p < LICZBA_POZIOMOW; p++) {
+            if (strcasecmp(nazwa_poziomu, NAZWY_POZIOMOW[p]) == 0) poziom = p;
+        }
+        if (poziom == -1) return -1;
+
+        uint64_t role = 0;
+        if (!rownosc) {
+            role = LOG_MASKA_WSZYSTKO;
+        }
+        else if (strcasecmp(el, "przewodnik") == 0) {
+            for (int t = 1; t <= LICZBA_TRAS; t++) role |= LOG_MASKA_ROLI(ROLA_PRZEWODNIK(t));
+        }
+        else {
+            for (int r = 0; r < LICZBA_ROL; r++) {
+                if (strcasecmp(el, NAZWY_ROL[r]) == 0) role = LOG_MASKA_ROLI(r);
+            }
+        }
+        if (role == 0) return -1;
+
+        uint64_t poziomy = 0;
+        for (int r = 0; r < LICZBA_ROL; r++) {
+            for (int p = 0; p <= poziom; p++) poziomy |= LOG_BIT(r, p);
+        }
+        wynik = (wynik & ~role) | (poziomy & role);
+    }
+    *maska = wynik;
+    return 0;
+}
+
+/// Katalog komunikatów: X(identyfikator, poziom, format) - formaty wyłącznie z %d,
+/// tekst musi być identyczny z dotychczasowym logiem (analizatory go parsują).
+/// Poziom decyduje o filtrowaniu (loguj.h) - domyślnie przechodzi wszystko.
+#define KATALOG_DZIENNIKA(X) \
+    X(DZ_TEKST,                     LOG_INFO,        NULL) \
+    X(DZ_ZW_START,                  LOG_SZCZEGOLY,   "START: wiek=%d powtorna=%d poprz=%d opiekun=%d czy_opiekun=%d") \
+    X(DZ_ZW_DO_KASJERA,             LOG_SZCZEGOLY,   "STATE: Ide do kasjera") \
+    X(DZ_ZW_CZEKAM_NA_BILET,        LOG_SZCZEGOLY,   "STATE: Czekam na bilet") \
+    X(DZ_ZW_TIMEOUT_BILETU,         LOG_OSTRZEZENIE, "TIMEOUT: Brak odpowiedzi od kasjera (%ds)") \
+    X(DZ_ZW_ODRZUCONY,              LOG_OSTRZEZENIE, "REJECT: Odrzucony przez kasjera") \
+    X(DZ_ZW_BILET,                  LOG_SZCZEGOLY,   "TICKET: Przydzielono trase %d") \
+    X(DZ_ZW_DO_KOLEJKI,             LOG_SZCZEGOLY,   "STATE: Dolaczam do kolejki przewodnika") \
+    X(DZ_ZW_W_KOLEJCE,              LOG_SZCZEGOLY,   "STATE: W kolejce czekam na grupe") \
+    X(DZ_ZW_TIMEOUT_KOLEJKI,        LOG_OSTRZEZENIE, "TIMEOUT: Za dlugo w kolejce (%ds), koncze") \
+    X(DZ_ZW_SHUTDOWN_PRZED,         LOG_INFO,        "SHUTDOWN: SIGTERM przed rozpoczeciem wycieczki") \
+    X(DZ_ZW_ANULOWANY_PRZED,        LOG_INFO,        "CANCEL: Przed rozpoczeciem wycieczki") \
+    X(DZ_ZW_ZEBRANO,                LOG_SZCZEGOLY,   "STATE: Zebrano do grupy") \
+    X(DZ_ZW_SHUTDOWN_W_GRUPIE,      LOG_INFO,        "SHUTDOWN: SIGTERM po zebraniu grupy") \
+    X(DZ_ZW_ANULOWANY_W_GRUPIE,     LOG_INFO,        "CANCEL: Po zebraniu grupy") \
+    X(DZ_ZW_KLADKA_WEJSCIE,         LOG_SZCZEGOLY,   "STATE: Przechodze kladke (wejscie)") \
+    X(DZ_ZW_SHUTDOWN_NA_KLADCE,     LOG_INFO,        "SHUTDOWN: SIGTERM podczas przechodzenia kladki") \
+    X(DZ_ZW_ANULOWANY_NA_KLADCE,    LOG_INFO,        "CANCEL: Podczas przechodzenia kladki") \
+    X(DZ_ZW_ZWIEDZAM,               LOG_SZCZEGOLY,   "STATE: Zwiedzam trase %d") \
+    X(DZ_ZW_SHUTDOWN_NA_TRASIE,     LOG_INFO,        "SHUTDOWN: SIGTERM podczas zwiedzania") \
+    X(DZ_ZW_ANULOWANY_NA_TRASIE,    LOG_INFO,        "CANCEL: Awaryjnie podczas zwiedzania") \
+    X(DZ_ZW_KLADKA_WYJSCIE,         LOG_SZCZEGOLY,   "STATE: Przechodze kladke (wyjscie)") \
+    X(DZ_ZW_KONIEC,                 LOG_SZCZEGOLY,   "COMPLETE: Opuscilem jaskinie") \
+    X(DZ_ZW_POWROT,                 LOG_SZCZEGOLY,   "STATE: Wracam do kasjera po trasie %d (powtorna wizyta)") \
+    X(DZ_KA_OPIEKUN,                LOG_SZCZEGOLY,   "ACCEPT: PID=%d opiekun (dziecko <8) -> trasa %d") \
+    X(DZ_KA_AKCEPTACJA,             LOG_SZCZEGOLY,   "ACCEPT: PID=%d trasa=%d") \
+    X(DZ_GE_LIMIT_ZYJACYCH,         LOG_OSTRZEZENIE, "Limit zyjacych zwiedzajacych osiagniety (%d/%d), czekam") \
+    X(DZ_GE_OPIEKUN,                LOG_SZCZEGOLY,   "Wygenerowano opiekuna PID=%d wiek=%d dla dziecka wiek=%d (TRASA %d)") \
+    X(DZ_GE_ZWIEDZAJACY,            LOG_SZCZEGOLY,   "Generuje zwiedzajacego #%d: wiek=%d powtorna=%d poprz=%d opiekun=%d") \
+    X(DZ_PR_ZBIERAM,                LOG_SZCZEGOLY,   "Zbieram grupe") \
+    X(DZ_PR_GRUPA_ZEBRANA,          LOG_INFO,        "Grupa zebrana: %d zwiedzajacych") \
+    X(DZ_PR_REZERWUJE,              LOG_SZCZEGOLY,   "Rezerwuje miejsca na trasie") \
+    X(DZ_PR_ZAREZERWOWANA,          LOG_SZCZEGOLY,   "Trasa zarezerwowana: bylo=%d teraz=%d/%d") \
+    X(DZ_PR_BLOKUJE_WEJSCIE,        LOG_SZCZEGOLY,   "Blokuje kladki (WEJSCIE)") \
+    X(DZ_PR_PRZEPROWADZAM_WEJSCIE,  LOG_SZCZEGOLY,   "Przeprowadzam grupe (WEJSCIE)") \
+    X(DZ_PR_ZWALNIAM_WEJSCIE,       LOG_SZCZEGOLY,   "Zwalniam kladki (inne grupy moga przechodzic)") \
+    X(DZ_PR_ZWIEDZANIE,             LOG_INFO,        "Zwiedzanie rozpoczete: trasa=%d czas=%ds") \
+    X(DZ_PR_POWROT,                 LOG_SZCZEGOLY,   "Zwiedzanie zakonczone - wracamy") \
+    X(DZ_PR_BLOKUJE_WYJSCIE,        LOG_SZCZEGOLY,   "Blokuje kladki (WYJSCIE)") \
+    X(DZ_PR_PRZEPROWADZAM_WYJSCIE,  LOG_SZCZEGOLY,   "Przeprowadzam grupe (WYJSCIE)") \
+    X(DZ_PR_ZWALNIAM_WYJSCIE,       LOG_SZCZEGOLY,   "Zwalniam kladki i grupe") \
+    X(DZ_PR_WYCIECZKA_ZAKONCZONA,   LOG_INFO,        "Wycieczka zakonczona: trasa=%d zwiedzajacych=%d") \
+    X(DZ_PR_ZWALNIAM_KLADKI,        LOG_SZCZEGOLY,   "Zwalniam kladki trasy") \
+    X(DZ_PR_KLADKI_ZWOLNIONE,       LOG_SZCZEGOLY,   "Kladki zwolnione - dostepne dla innych (maska=%d)")
+
+enum {
+#define X(id, poziom, format) id,
+    KATALOG_DZIENNIKA(X)
+#undef X
+    LICZBA_ZDARZEN_DZIENNIKA
+};
+
+/// Poziom komunikatu jako stała kompilacji: DZ_PR_ZBIERAM_POZIOM
+enum {
+#define X(id, poziom, format) id##_POZIOM = poziom,
+    KATALOG_DZIENNIKA(X)
+#undef X
+};
+
+static const char* const FORMATY_DZIENNIKA[LICZBA_ZDARZEN_DZIENNIKA] = {
+#define X(id, poziom, format) format,
+    KATALOG_DZIENNIKA(X)
+#undef X
+};
+
+#define DZ_FLAGA_CIAG 1  /// Rekord tekstowy kontynuujący poprzedni
+
+/// Nagłówek pliku - 64 bajty, kotwice pozwalają zamienić czas monotoniczny na ścienny
+typedef struct {
+    uint32_t magic;
+    uint32_t wersja;
+    uint32_t rozmiar_rekordu;
+    uint32_t liczba_zdarzen;           /// Rozmiar katalogu - inny katalog = inna wersja programu
+    uint64_t kotwica_realtime_ns;      /// CLOCK_REALTIME ...
+    uint64_t kotwica_monotoniczna_ns;  /// ... i CLOCK_MONOTONIC odczytane w tej samej chwili
+    int32_t strefa_s;                  /// Przesunięcie strefy czasowej (tm_gmtoff) przy zakładaniu
+    char zarezerwowane[28];
+} NaglowekDziennika;
+
+/// Jeden wpis - 64 bajty
+typedef struct {
+    uint64_t czas_ns;      /// Zegar monotoniczny
+    int32_t pid;
+    uint8_t rola;          /// ROLA_*
+    uint8_t flagi;         /// DZ_FLAGA_*
+    uint16_t zdarzenie;    /// DZ_* z katalogu
+    union {
+        int32_t argumenty[DZIENNIK_ARGUMENTY];
+        char tekst[DZIENNIK_TEKST];  /// DZ_TEKST - bez '\0' gdy pełny
+    };
+} RekordDziennika;
+
+static int dziennik_fd = -1;
+static uint8_t dziennik_rola = 0;
+
+/// Czy dziennik aktywny - jedyny koszt w loguj_zawsze gdy wyłączony
+#define DZIENNIK_AKTYWNY() __builtin_expect(dziennik_fd != -1, 0)
+
+static inline int dziennik_wlaczony_env(void) {
+    const char* env = getenv("JASKINIA_DZIENNIK");
+    return env && env[0] != '\0' && strcmp(env, "0") != 0;
+}
+
+static inline void dziennik_wypelnij(RekordDziennika* r, int zdarzenie, int flagi) {
+    r->czas_ns = czas_monotoniczny_ns();
+    r->pid = getpid();
+    r->rola = dziennik_rola;
+    r->flagi = (uint8_t)flagi;
+    r->zdarzenie = (uint16_t)zdarzenie;
+}
+
+/// Wiadomość spoza katalogu - tekst pocięty na rekordy, wszystkie jednym write()
+static inline void dziennik_tekst(const char* wiadomosc) {
+    RekordDziennika rekordy[DZIENNIK_MAX_REKORDOW];
+    size_t dlugosc = strlen(wiadomosc);
+    int liczba = 0;
+
+    do {
+        RekordDziennika* r = &rekordy[liczba];
+        size_t kawalek = dlugosc < DZIENNIK_TEKST ? dlugosc : DZIENNIK_TEKST;
+        dziennik_wypelnij(r, DZ_TEKST, liczba > 0 ? DZ_FLAGA_CIAG : 0);
+        memset(r->tekst, 0, sizeof(r->tekst));
+        memcpy(r->tekst, wiadomosc, kawalek);
+        wiadomosc += kawalek;
+        dlugosc -= kawalek;
+        liczba++;
+    } while (dlugosc > 0 && liczba < DZIENNIK_MAX_REKORDOW);
+
+    bezpieczny_zapis_wszystko(dziennik_fd, rekordy, sizeof(RekordDziennika) * (size_t)liczba);
+}
+
+/// Załóż pusty plik dziennika z nagłówkiem - strażnik, przed uruchomieniem ról
+static inline int dziennik_zaloz(void) {
+    if (!dziennik_wlaczony_env()) return 0;
+
+    char plik[128];
+    int fd = open(plik_instancji(DZIENNIK_PLIK, plik, sizeof(plik)), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+    if (fd == -1) return -1;
+
+    NaglowekDziennika n;
+    memset(&n, 0, sizeof(n));
+    n.magic = DZIENNIK_MAGIC;
+    n.wersja = DZIENNIK_WERSJA;
+    n.rozmiar_rekordu = sizeof(RekordDziennika);
+    n.liczba_zdarzen = LICZBA_ZDARZEN_DZIENNIKA;
+
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    n.kotwica_monotoniczna_ns = czas_monotoniczny_ns();
+    n.kotwica_realtime_ns = (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+    struct tm lokalny;
+    localtime_r(&ts.tv_sec, &lokalny);
+    n.strefa_s = (int32_t)lokalny.tm_gmtoff;
+
+    int wynik = bezpieczny_zapis_wszystko(fd, &n, sizeof(n)) == (ssize_t)sizeof(n) ? 0 : -1;
+    close(fd);
+    return wynik;
+}
+
+/// Włącz dziennik jeśli JASKINIA_DZIENNIK ustawione i plik założony - wywołaj na początku main()
+static inline void dziennik_inicjalizuj(int rola) {
+    if (!dziennik_wlaczony_env()) return;
+
+    dziennik_rola = (uint8_t)rola;
+    char plik[128];
+    dziennik_fd = open(plik_instancji(DZIENNIK_PLIK, plik, sizeof(plik)), O_WRONLY | O_APPEND | O_CLOEXEC);
+}
+
+#endif
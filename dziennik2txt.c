@@ -0,0 +1,148 @@
+#include "common.h"
+#include "dziennik.h"
+
+/// dziennik2txt - odtwarza tekstowe logi z binarnego dziennika (jaskinia_dziennik.bin):
+/// jaskinia_common.log oraz logi ról (kasjer, przewodnicy tras, generator, zwiedzajacy)
+/// w tym samym formacie co zwykłe loguj_wiadomosc - analizatory działają bez zmian.
+/// Użycie: ./dziennik2txt [jaskinia_dziennik.bin [katalog_wyjsciowy]]
+///
+/// Kolejność linii = kolejność rekordów w pliku (dopisywanych przez O_APPEND),
+/// czyli ta sama co w logu pisanym pod semaforem.
+
+#define BUFOR_WIERSZA 640
+
+/// Znacznik czasu rekordu w formacie logu - przeliczany tylko gdy zmieniła się sekunda
+static const char* znacznik_czasu(const NaglowekDziennika* n, uint64_t czas_ns) {
+    static int64_t ostatnia_sekunda = INT64_MIN;
+    static char ts[32];
+
+    int64_t sciana_ns = (int64_t)n->kotwica_realtime_ns + ((int64_t)czas_ns - (int64_t)n->kotwica_monotoniczna_ns);
+    int64_t sekunda = sciana_ns / 1000000000LL + n->strefa_s;
+    if (sekunda != ostatnia_sekunda) {
+        time_t t = (time_t)sekunda;
+        struct tm tm;
+        gmtime_r(&t, &tm);  /// Strefa już doliczona - wynik jak localtime() w chwili zapisu
+        strftime(ts, sizeof(ts), "%Y-%m-%d %H:%M:%S", &tm);
+        ostatnia_sekunda = sekunda;
+    }
+    return ts;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 3) {
+        fprintf(stderr, "Uzycie: %s [" DZIENNIK_PLIK " [katalog]]\n", argv[0]);
+        return 1;
+    }
+    char domyslny[64];
+    const char* sciezka = argc > 1 ? argv[1] : plik_instancji(DZIENNIK_PLIK, domyslny, sizeof(domyslny));
+    const char* katalog = argc > 2 ? argv[2] : ".";
+
+    FILE* we = fopen(sciezka, "rb");
+    if (!we) {
+        perror(sciezka);
+        return 1;
+    }
+
+    NaglowekDziennika n;
+    if (fread(&n, sizeof(n), 1, we) != 1 || n.magic != DZIENNIK_MAGIC || n.wersja != DZIENNIK_WERSJA ||
+        n.rozmiar_rekordu != sizeof(RekordDziennika)) {
+        fprintf(stderr, "%s: to nie jest dziennik w wersji %d\n", sciezka, DZIENNIK_WERSJA);
+        fclose(we);
+        return 1;
+    }
+    if (n.liczba_zdarzen != LICZBA_ZDARZEN_DZIENNIKA) {
+        fprintf(stderr, "%s: katalog ma %u komunikatow, ten program zna %d - uzyj dziennik2txt z tej samej wersji\n",
+            sciezka, n.liczba_zdarzen, LICZBA_ZDARZEN_DZIENNIKA);
+        fclose(we);
+        return 1;
+    }
+
+    /// Pliki wyjściowe - wspólny i po jednym na rolę
+    /// Nazwy jak u ról - w instancji n z jej numerem, żeby jaskinia-analiza znalazła log
+    char nazwa[512], plik[128];
+    snprintf(nazwa, sizeof(nazwa), "%s/%s", katalog, plik_instancji(LOG_PLIK_WSPOLNY, plik, sizeof(plik)));
+    FILE* wspolny = fopen(nazwa, "w");
+    if (!wspolny) {
+        perror(nazwa);
+        fclose(we);
+        return 1;
+    }
+    FILE* role[LICZBA_ROL] = { NULL };
+    for (int i = 0; i < LICZBA_ROL; i++) {
+        if (!PLIKI_ROL[i]) continue;
+        snprintf(nazwa, sizeof(nazwa), "%s/%s", katalog, plik_instancji(PLIKI_ROL[i], plik, sizeof(plik)));
+        role[i] = fopen(nazwa, "w");
+        if (!role[i]) perror(nazwa);
+    }
+
+    RekordDziennika r, poprzedni;
+    char wiadomosc[BUFOR_WIERSZA];
+    size_t dlugosc = 0;
+    int oczekujacy = 0;  /// Tekst złożony z rekordów czeka na ewentualne kontynuacje
+    size_t rekordow = 0, linii = 0, nieznanych = 0;
+
+    for (;;) {
+        int koniec = fread(&r, sizeof(r), 1, we) != 1;
+
+        /// Wypisz poprzednią linię tekstową gdy nie ma już jej kontynuacji
+        if (oczekujacy && (koniec || r.zdarzenie != DZ_TEKST || !(r.flagi & DZ_FLAGA_CIAG))) {
+            wiadomosc[dlugosc] = '\0';
+            char wiersz[BUFOR_WIERSZA + 96];
+            int w = snprintf(wiersz, sizeof(wiersz), "[%s] [PID:%d] [%s] %s\n",
+                znacznik_czasu(&n, poprzedni.czas_ns), poprzedni.pid, NAZWY_ROL[poprzedni.rola], wiadomosc);
+            if (w > (int)sizeof(wiersz) - 1) w = (int)sizeof(wiersz) - 1;
+            fwrite(wiersz, 1, (size_t)w, wspolny);
+            if (role[poprzedni.rola]) fwrite(wiersz, 1, (size_t)w, role[poprzedni.rola]);
+            oczekujacy = 0;
+            linii++;
+        }
+        if (koniec) break;
+        rekordow++;
+
+        if (r.rola >= LICZBA_ROL || r.zdarzenie >= LICZBA_ZDARZEN_DZIENNIKA) {
+            nieznanych++;
+            continue;
+        }
+
+        if (r.zdarzenie == DZ_TEKST) {
+            if (!(r.flagi & DZ_FLAGA_CIAG)) {
+                dlugosc = 0;
+                poprzedni = r;
+            }
+            else if (!oczekujacy) {
+                nieznanych++;  /// Kontynuacja bez początku - ucięty plik
+                continue;
+            }
+            size_t kawalek = strnlen(r.tekst, DZIENNIK_TEKST);
+            if (dlugosc + kawalek < sizeof(wiadomosc)) {
+                memcpy(wiadomosc + dlugosc, r.tekst, kawalek);
+                dlugosc += kawalek;
+            }
+            oczekujacy = 1;
+            continue;
+        }
+
+        /// Komunikat z katalogu - ten sam format i argumenty co przy zwykłym logowaniu
+        char wiersz[BUFOR_WIERSZA + 96];
+        int w = snprintf(wiersz, sizeof(wiersz), "[%s] [PID:%d] [%s] ",
+            znacznik_czasu(&n, r.czas_ns), r.pid, NAZWY_ROL[r.rola]);
+        w += snprintf(wiersz + w, sizeof(wiersz) - (size_t)w, FORMATY_DZIENNIKA[r.zdarzenie],
+            r.argumenty[0], r.argumenty[1], r.argumenty[2], r.argumenty[3],
+            r.argumenty[4], r.argumenty[5], r.argumenty[6], r.argumenty[7]);
+        if (w > (int)sizeof(wiersz) - 2) w = (int)sizeof(wiersz) - 2;
+        wiersz[w++] = '\n';
+        fwrite(wiersz, 1, (size_t)w, wspolny);
+        if (role[r.rola]) fwrite(wiersz, 1, (size_t)w, role[r.rola]);
+        linii++;
+    }
+
+    fclose(we);
+    fclose(wspolny);
+    for (int i = 0; i < LICZBA_ROL; i++) {
+        if (role[i]) fclose(role[i]);
+    }
+
+    fprintf(stderr, "dziennik2txt: %zu rekordow, %zu linii, %zu nieznanych -> %s/\n",
+        rekordow, linii, nieznanych, katalog);
+    return 0;
+}
@@ -1,75 +1,31 @@
 #include "common.h"
 #include "common_helpers.h"
+#include "metryki.h"
+#include "pary.h"
+#include "regulamin.h"
+#include "loguj.h"
+#include "role.h"
 
-int globalny_semid_log = -1;
-
-volatile sig_atomic_t kontynuuj = 1;
-void obsluga_sigterm(int sig) { (void)sig; kontynuuj = 0; }
-
-/// Funkcja logujca - zapisuje do common.log i generator.log
-void loguj_wiadomosc(const char* wiadomosc) {
-    int sem_zdobyty = 0;
-    char ts[64], buf[512];
-
-    /// Prbuj zdoby semafor logw
-    if (globalny_semid_log != -1) {
-        struct sembuf op = { 0, -1, 0 };
-        if (bezpieczny_semop(globalny_semid_log, &op, 1) == 0) {
-            sem_zdobyty = 1;
-        }
-    }
-
-    /// Timestamp + formatowanie
-    time_t teraz = time(NULL);
-    strftime(ts, sizeof(ts), "%Y-%m-%d %H:%M:%S", localtime(&teraz));
-    snprintf(buf, sizeof(buf), "[%s] [PID:%d] [GENERATOR] %s\n", ts, getpid(), wiadomosc);
-
-    /// Zapis do obu logw
-    int fd = open("jaskinia_common.log", O_WRONLY | O_CREAT | O_APPEND, 0644);
-    if (fd != -1) {
-        bezpieczny_zapis_wszystko(fd, buf, strlen(buf));
-        close(fd);
-    }
-
-    fd = open("jaskinia_generator.log", O_WRONLY | O_CREAT | O_APPEND, 0644);
-    if (fd != -1) {
-        bezpieczny_zapis_wszystko(fd, buf, strlen(buf));
-        close(fd);
-    }
-
-    /// Zwolnij semafor
-    if (sem_zdobyty) {
-        struct sembuf op = { 0, 1, 0 };
-        bezpieczny_semop(globalny_semid_log, &op, 1);
-    }
-}
-
-/// Wersja z formatowaniem jak printf
-void loguj_wiadomoscf(const char* format, ...) {
-    char wiadomosc[512];
-    va_list args;
-    va_start(args, format);
-    vsnprintf(wiadomosc, sizeof(wiadomosc), format, args);
-    va_end(args);
-    loguj_wiadomosc(wiadomosc);
-}
+static volatile sig_atomic_t kontynuuj = 1;
+static void obsluga_sigterm(int sig) { (void)sig; kontynuuj = 0; }
 
 /// Dodaj PID zwiedzajcego do globalnej listy - atomic operation!
-void zarejestruj_zwiedzajacego(ShmZwiedzajacy* shm_zwiedzajacy, pid_t pid) {
+static void zarejestruj_zwiedzajacego(ShmZwiedzajacy* shm_zwiedzajacy, pid_t pid) {
     /// __sync_fetch_and_add to atomic - bezpieczne nawet bez mutexu
     int idx = __sync_fetch_and_add(&shm_zwiedzajacy->licznik, 1);
     if (idx < MAX_ZWIEDZAJACYCH) {
         shm_zwiedzajacy->pidy[idx] = pid;
+        METRYKI_ZAPIS(generator, globalne_metryki->generator.wygenerowano++);
     }
     else {
-        loguj_wiadomoscf("WARN: MAX_ZWIEDZAJACYCH=%d przekroczony, nie rejestruje PID=%d",
+        loguj_ostrzezenie("WARN: MAX_ZWIEDZAJACYCH=%d przekroczony, nie rejestruje PID=%d",
             MAX_ZWIEDZAJACYCH, pid);
         __sync_fetch_and_sub(&shm_zwiedzajacy->licznik, 1);
     }
 }
 
 /// Zlicz ile zwiedzajcych faktycznie yje
-int policz_zyjacych_zwiedzajacych(ShmZwiedzajacy* shm_zwiedzajacy) {
+static int policz_zyjacych_zwiedzajacych(ShmZwiedzajacy* shm_zwiedzajacy) {
     int zywe = 0;
     int sprawdzonych = shm_zwiedzajacy->licznik;
     if (sprawdzonych > MAX_ZWIEDZAJACYCH) sprawdzonych = MAX_ZWIEDZAJACYCH;
@@ -82,7 +38,18 @@ int policz_zyjacych_zwiedzajacych(ShmZwiedzajacy* shm_zwiedzajacy) {
     return zywe;
 }
 
-int main() {
+/// Dziecko po fork(): zwiedzajcy dostaje chwil fork() w JASKINIA_SPAWN_NS (etap "spawn"
+/// w histogramach) i startuje bez exec. Wraca tylko gdy exec si nie uda (JASKINIA_SPAWN_EXEC=1)
+static void uruchom_zwiedzajacego(char* argv[], uint64_t fork_ns) {
+    char spawn[24];
+    snprintf(spawn, sizeof(spawn), "%llu", (unsigned long long)fork_ns);
+    setenv("JASKINIA_SPAWN_NS", spawn, 1);
+    uruchom_role(main_zwiedzajacy, argv);
+}
+
+int main_generator(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
     signal(SIGTERM, obsluga_sigterm);
     signal(SIGINT, SIG_IGN);
 
@@ -93,44 +60,59 @@ int main() {
     sigemptyset(&sa.sa_mask);
     sigaction(SIGCHLD, &sa, NULL);
 
-    srand(time(NULL) ^ getpid());  /// Seed dla rand() - kady proces inny
+    srand(ziarno_losowania(0));  /// Seed dla rand() - stay tylko z JASKINIA_SEED
 
-    INIT_SEMAFOR_LOG();
+    profil_blokad_inicjalizuj();
+    loguj_inicjalizuj(ROLA_GENERATOR);
     loguj_wiadomosc("START");
 
     ShmJaskinia* shm_j = NULL;
     ShmZwiedzajacy* shm_zwiedzajacy = NULL;
+    ShmPary* shm_pary = NULL;
 
     /// Podcz si do shared memory
     if (podlacz_shm_helper(KLUCZ_SHM_JASKINIA, (void**)&shm_j) == -1 ||
-        podlacz_shm_helper(KLUCZ_SHM_ZWIEDZAJACY, (void**)&shm_zwiedzajacy) == -1) {
+        podlacz_shm_helper(KLUCZ_SHM_ZWIEDZAJACY, (void**)&shm_zwiedzajacy) == -1 ||
+        podlacz_shm_helper(KLUCZ_SHM_PARY, (void**)&shm_pary) == -1) {
         perror("shmget SHM");
-        loguj_wiadomosc("ERROR: Nie mozna podlaczyc pamieci wspoldzielonej");
+        loguj_blad("ERROR: Nie mozna podlaczyc pamieci wspoldzielonej");
         BEZPIECZNY_SHMDT(shm_j);
         BEZPIECZNY_SHMDT(shm_zwiedzajacy);
+        BEZPIECZNY_SHMDT(shm_pary);
         return 1;
     }
 
+    globalne_metryki = podlacz_metryki();
+    if (!globalne_metryki) {
+        loguj_ostrzezenie("WARN: Brak strony metryk - jaskinia-top nie zobaczy generatora");
+    }
+
     loguj_wiadomoscf("Generator wystartowany PID=%d", getpid());
+    zglos_gotowosc(shm_j);
     loguj_wiadomosc("Czekam na otwarcie jaskini (Tp)");
 
     /// Czekaj a stranik otworzy jaskini
-    pthread_mutex_lock(&shm_j->mutex);
-    while (!shm_j->otwarta && kontynuuj) {
-        pthread_cond_wait(&shm_j->cond_otwarta, &shm_j->mutex);
-    }
-    pthread_mutex_unlock(&shm_j->mutex);
+    czekaj_na_otwarcie(shm_j, &kontynuuj);
 
     if (!kontynuuj) {
         loguj_wiadomosc("SHUTDOWN przed otwarciem jaskini");
         BEZPIECZNY_SHMDT(shm_j);
         BEZPIECZNY_SHMDT(shm_zwiedzajacy);
+        BEZPIECZNY_SHMDT(shm_pary);
+        BEZPIECZNY_SHMDT(globalne_metryki);
         return 0;
     }
 
     loguj_wiadomosc("Jaskinia otwarta, generuje zwiedzajacych");
-    loguj_wiadomoscf("Konfiguracja: opoznienie=%d-%ds, max_zyjacych=%d",
-        OPOZNIENIE_GENERATORA_MIN, OPOZNIENIE_GENERATORA_MAX, MAX_ZWIEDZAJACYCH);
+    /// JASKINIA_TEMPO (osb/s) zastpuje stae opnienie - przerwa losowa ze redni 1/tempo
+    double tempo = parametr_env_ulamek("JASKINIA_TEMPO", 0.0, 0.01, 1000.0);
+    if (tempo > 0.0) {
+        loguj_wiadomoscf("Konfiguracja: tempo=%.3f/s, max_zyjacych=%d", tempo, MAX_ZWIEDZAJACYCH);
+    }
+    else {
+        loguj_wiadomoscf("Konfiguracja: opoznienie=%d-%ds, max_zyjacych=%d",
+            OPOZNIENIE_GENERATORA_MIN, OPOZNIENIE_GENERATORA_MAX, MAX_ZWIEDZAJACYCH);
+    }
 
     int licznik = 0;
     int licznik_retry_fork = 0;
@@ -139,9 +121,7 @@ int main() {
     /// Gwna ptla - generujemy zwiedzajcych losowo
     while (kontynuuj) {
         /// Sprawd czy jaskinia dalej otwarta
-        pthread_mutex_lock(&shm_j->mutex);
-        int otwarta = shm_j->otwarta;
-        pthread_mutex_unlock(&shm_j->mutex);
+        int otwarta = jaskinia_otwarta(shm_j);  /// Load-acquire, bez mutexu
 
         if (!otwarta) {
             loguj_wiadomosc("Jaskinia zamknieta, zatrzymuje generowanie");
@@ -150,109 +130,139 @@ int main() {
 
         /// Sprawd limit yjcych zwiedzajcych
         int zywe = policz_zyjacych_zwiedzajacych(shm_zwiedzajacy);
+        METRYKI_ZAPIS(generator, globalne_metryki->generator.zyjacych = zywe);
         if (zywe >= MAX_ZWIEDZAJACYCH) {
-            loguj_wiadomoscf("Limit zyjacych zwiedzajacych osiagniety (%d/%d), czekam",
+            loguj_zdarzenie(DZ_GE_LIMIT_ZYJACYCH,
                 zywe, MAX_ZWIEDZAJACYCH);
-            sleep(2);
+            sen_s(2);
             continue;
         }
 
         /// Losuj parametry zwiedzajcego
         int wiek = MIN_WIEK + (rand() % (MAX_WIEK - MIN_WIEK + 1));
-        int powtorna = (rand() % 100) < SZANSA_POWTORNA ? 1 : 0;  /// 10% szansy
-        int poprz_trasa = (rand() % 2) + 1;  /// 1 lub 2
+        int powtorna = 0;     /// Powtrne wizyty robi sami zwiedzajcy po wycieczce (zwiedzajacy.c)
+        int poprz_trasa = 1;  /// Liczy si tylko przy powtrnej - dziecko z pary dostaje tras pary
         pid_t pid_opiekuna = 0;
+        int id_pary = BRAK_PARY;
 
         /// Jeli dziecko <8 lat - 70% szansy e przyjdzie z opiekunem
-        if (wiek < 8) {
+        if (wiek < WIEK_Z_OPIEKUNEM) {
             if (rand() % 100 < SZANSA_DZIECKO_OPIEKUN) {
                 /// Sprawd czy jest miejsce na par opiekun+dziecko (2 osoby)
                 if (zywe >= MAX_ZWIEDZAJACYCH - 1) {
                     loguj_wiadomosc("Brak miejsca na pare opiekun-dziecko, czekam");
-                    sleep(2);
+                    sen_s(2);
+                    continue;
+                }
+
+                /// Wpis pary zakadamy przed fork() - obaj dostan jego numer w argumentach
+                id_pary = para_zaloz(shm_pary);
+                if (id_pary == BRAK_PARY) {
+                    loguj_ostrzezenie("WARN: Rejestr par pelny (MAX_PAR=%d), czekam", MAX_PAR);
+                    sen_s(2);
                     continue;
                 }
 
+                int trasa_pary = regulamin_trasa_pary(id_pary);  /// Tak samo policzy kasjer
                 int wiek_opiekuna = MIN_WIEK_OPIEKUNA + (rand() % (MAX_WIEK_OPIEKUNA - MIN_WIEK_OPIEKUNA + 1));
 
                 /// Fork opiekuna NAJPIERW
+                uint64_t fork_ns = czas_monotoniczny_ns();
                 pid_t opiekun = fork();
                 if (opiekun == -1) {
                     perror("fork opiekun");
-                    loguj_wiadomosc("ERROR: Nie mozna fork procesu opiekuna");
-                    sleep(1);
+                    loguj_blad("ERROR: Nie mozna fork procesu opiekuna");
+                    para_opusc(shm_pary, id_pary, PARA_OPIEKUN | PARA_DZIECKO);  /// Para nie powstaa
+                    sen_s(1);
                     continue;
                 }
 
                 if (opiekun == 0) {  /// Proces dziecka (opiekun)
-                    /// Argumenty: wiek, powtorna=0, poprz_trasa=2, pid_opiekuna=0, czy_opiekun=1
-                    char w[16], p[16], t[16], o[16], c[16];
+                    /// Argumenty: wiek, powtorna=0, poprz_trasa=trasa pary, pid_opiekuna=0, czy_opiekun=1, id_pary
+                    char w[16], p[16], t[16], o[16], c[16], i[16];
                     snprintf(w, sizeof(w), "%d", wiek_opiekuna);
                     snprintf(p, sizeof(p), "0");
-                    snprintf(t, sizeof(t), "2");  /// Opiekunowie zawsze trasa 2!
+                    snprintf(t, sizeof(t), "%d", trasa_pary);  /// Opiekunowie zawsze na tras pary!
                     snprintf(o, sizeof(o), "0");
                     snprintf(c, sizeof(c), "1");  /// czy_opiekun=1
+                    snprintf(i, sizeof(i), "%d", id_pary);
 
-                    execl("./zwiedzajacy", "zwiedzajacy", w, p, t, o, c, NULL);
-                    perror("execl opiekun");
+                    char* argv_opiekuna[] = { "zwiedzajacy", w, p, t, o, c, i, NULL };
+                    uruchom_zwiedzajacego(argv_opiekuna, fork_ns);
+                    para_opusc(shm_pary, id_pary, PARA_OPIEKUN);
                     exit(1);
                 }
 
                 pid_opiekuna = opiekun;
+                para_opublikuj(shm_pary, id_pary, pid_opiekuna);  /// Przed fork() dziecka - kasjer ju je uzna
                 zarejestruj_zwiedzajacego(shm_zwiedzajacy, pid_opiekuna);
-                poprz_trasa = 2;  /// Dziecko te na tras 2
+                poprz_trasa = trasa_pary;  /// Dziecko te na tras pary
                 licznik++;
 
-                loguj_wiadomoscf("Wygenerowano opiekuna PID=%d wiek=%d dla dziecka wiek=%d (TRASA 2)",
-                    pid_opiekuna, wiek_opiekuna, wiek);
+                loguj_zdarzenie(DZ_GE_OPIEKUN,
+                    pid_opiekuna, wiek_opiekuna, wiek, trasa_pary);
             }
         }
 
-        loguj_wiadomoscf("Generuje zwiedzajacego #%d: wiek=%d powtorna=%d poprz=%d opiekun=%d",
+        loguj_zdarzenie(DZ_GE_ZWIEDZAJACY,
             licznik + 1, wiek, powtorna, poprz_trasa, pid_opiekuna);
 
         /// Fork zwiedzajcego
+        uint64_t fork_ns = czas_monotoniczny_ns();
         pid_t pid = fork();
         if (pid == -1) {
             perror("fork zwiedzajacy");
-            loguj_wiadomoscf("ERROR: Nie mozna fork zwiedzajacego (retry %d/%d)",
+            loguj_blad("ERROR: Nie mozna fork zwiedzajacego (retry %d/%d)",
                 licznik_retry_fork + 1, MAX_RETRY_FORK);
+            para_opusc(shm_pary, id_pary, PARA_DZIECKO);  /// Opiekun pjdzie sam
 
             licznik_retry_fork++;
             if (licznik_retry_fork >= MAX_RETRY_FORK) {
-                loguj_wiadomosc("CRITICAL: Zbyt wiele nieudanych fork, przerywam");
+                loguj_blad("CRITICAL: Zbyt wiele nieudanych fork, przerywam");
                 break;
             }
-            sleep(1);
+            sen_s(1);
             continue;
         }
 
         licznik_retry_fork = 0;
 
         if (pid == 0) {  /// Proces dziecka (zwiedzajcy)
-            char w[16], p[16], t[16], o[16], c[16];
+            char w[16], p[16], t[16], o[16], c[16], i[16];
             snprintf(w, sizeof(w), "%d", wiek);
             snprintf(p, sizeof(p), "%d", powtorna);
             snprintf(t, sizeof(t), "%d", poprz_trasa);
             snprintf(o, sizeof(o), "%d", pid_opiekuna);
             snprintf(c, sizeof(c), "0");  /// czy_opiekun=0
+            snprintf(i, sizeof(i), "%d", id_pary);
 
-            execl("./zwiedzajacy", "zwiedzajacy", w, p, t, o, c, NULL);
-            perror("execl zwiedzajacy");
+            char* argv_zwiedzajacego[] = { "zwiedzajacy", w, p, t, o, c, i, NULL };
+            uruchom_zwiedzajacego(argv_zwiedzajacego, fork_ns);
+            para_opusc(shm_pary, id_pary, PARA_DZIECKO);
             exit(1);
         }
 
+        if (id_pary != BRAK_PARY) shm_pary->pary[id_pary].pid_dziecka = pid;
+
         zarejestruj_zwiedzajacego(shm_zwiedzajacy, pid);
         licznik++;
 
         /// Losowe opnienie przed kolejnym zwiedzajcym
-        int opoznienie = OPOZNIENIE_GENERATORA_MIN + (rand() % (OPOZNIENIE_GENERATORA_MAX - OPOZNIENIE_GENERATORA_MIN + 1));
-        sleep(opoznienie);
+        if (tempo > 0.0) {
+            int max_ms = (int)(2000.0 / tempo);
+            sen_us((useconds_t)(rand() % (max_ms + 1)) * 1000);
+        }
+        else {
+            int opoznienie = OPOZNIENIE_GENERATORA_MIN + (rand() % (OPOZNIENIE_GENERATORA_MAX - OPOZNIENIE_GENERATORA_MIN + 1));
+            sen_s(opoznienie);
+        }
     }
 
     loguj_wiadomoscf("SHUTDOWN: wygenerowano=%d zarejestrowano=%d", licznik, shm_zwiedzajacy->licznik);
 
     BEZPIECZNY_SHMDT(shm_j);
     BEZPIECZNY_SHMDT(shm_zwiedzajacy);
+    BEZPIECZNY_SHMDT(shm_pary);
+    BEZPIECZNY_SHMDT(globalne_metryki);
     return 0;
 }
\ No newline at end of file
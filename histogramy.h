@@ -0,0 +1,114 @@
+#ifndef HISTOGRAMY_H
+#define HISTOGRAMY_H
+
+#include "common.h"
+
+/// Histogramy czasów etapów zwiedzania (styl HDR - kubełki log-liniowe)
+/// Każda potęga dwójki dzielona na 2^HIST_BITY_PODKUBELKA podkubełków,
+/// więc błąd względny odczytu percentyla to max ~6%.
+#define HIST_BITY_PODKUBELKA 4
+#define HIST_PODKUBELKI (1 << HIST_BITY_PODKUBELKA)
+#define HIST_LICZBA_KUBELKOW ((64 - HIST_BITY_PODKUBELKA + 1) * HIST_PODKUBELKI)
+
+/// Etapy cyklu życia zwiedzającego - kto mierzy podano w nawiasie
+enum {
+    ETAP_BILET = 0,   /// Prośba do kasjera -> odpowiedź (zwiedzający)
+    ETAP_KOLEJKA,     /// Dołączenie do kolejki -> odebranie przez przewodnika (przewodnik)
+    ETAP_ZBIERANIE,   /// Odebranie przez przewodnika -> grupa zebrana (przewodnik)
+    ETAP_KLADKA,      /// Grupa zebrana -> wejście na kładkę (zwiedzający)
+    ETAP_PRZEJSCIE,   /// Wejście na kładkę -> start zwiedzania (zwiedzający)
+    ETAP_ZWIEDZANIE,  /// Start zwiedzania -> przejście kładki przy wyjściu (zwiedzający)
+    ETAP_WYJSCIE,     /// Przejście kładki -> opuszczenie jaskini (zwiedzający)
+    ETAP_START_WYCIECZKI,  /// Dołączenie do kolejki -> start zwiedzania (zwiedzający)
+    ETAP_CALOSC,      /// Start procesu -> opuszczenie jaskini (zwiedzający)
+    ETAP_SPAWN,       /// fork() w generatorze -> start main zwiedzającego (koszt uruchomienia)
+    ETAP_KOLEJKA_ZWYKLY,       /// ETAP_KOLEJKA dla pierwszej wizyty (pas zwykły)
+    ETAP_KOLEJKA_POWRACAJACY,  /// ETAP_KOLEJKA dla powracających (pas priorytetowy)
+    LICZBA_ETAPOW
+};
+
+static const char* const NAZWY_ETAPOW[LICZBA_ETAPOW] = {
+    "bilet", "kolejka", "zbieranie", "czekanie_kladka",
+    "przejscie", "zwiedzanie", "wyjscie", "start_wycieczki", "calosc", "spawn",
+    "kolejka_zwykly", "kolejka_powracajacy"
+};
+
+/// Jeden histogram - wszystkie pola zmieniane atomowo (bez blokad)
+typedef struct {
+    uint64_t liczba;                         /// Ile pomiarów
+    uint64_t suma_ns;                        /// Suma do średniej
+    uint64_t max_ns;                         /// Największy pomiar
+    uint64_t kubelki[HIST_LICZBA_KUBELKOW];  /// Liczniki kubełków
+} Histogram;
+
+/// Segment shared memory z histogramami wszystkich etapów
+typedef struct {
+    Histogram etapy[LICZBA_ETAPOW];
+} ShmHistogramy;
+
+/// Wartość -> indeks kubełka (małe wartości liniowo, potem log-liniowo)
+static inline int histogram_kubelek(uint64_t wartosc) {
+    if (wartosc < HIST_PODKUBELKI) return (int)wartosc;
+    int wykladnik = 63 - __builtin_clzll(wartosc);
+    int podkubelek = (int)((wartosc >> (wykladnik - HIST_BITY_PODKUBELKA)) & (HIST_PODKUBELKI - 1));
+    return (wykladnik - HIST_BITY_PODKUBELKA + 1) * HIST_PODKUBELKI + podkubelek;
+}
+
+/// Indeks kubełka -> największa wartość jaka do niego trafia
+static inline uint64_t histogram_gorna_granica(int kubelek) {
+    if (kubelek < HIST_PODKUBELKI) return (uint64_t)kubelek;
+    int wykladnik = kubelek / HIST_PODKUBELKI + HIST_BITY_PODKUBELKA - 1;
+    uint64_t podkubelek = (uint64_t)(kubelek % HIST_PODKUBELKI);
+    int przesuniecie = wykladnik - HIST_BITY_PODKUBELKA;
+    uint64_t dolna = (HIST_PODKUBELKI + podkubelek) << przesuniecie;
+    return dolna + ((1ULL << przesuniecie) - 1);
+}
+
+/// Dodaj pomiar do histogramu - lock-free, bezpieczne z wielu procesów naraz
+static inline void histogram_dodaj(Histogram* hist, uint64_t czas_ns) {
+    __atomic_fetch_add(&hist->kubelki[histogram_kubelek(czas_ns)], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&hist->suma_ns, czas_ns, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&hist->liczba, 1, __ATOMIC_RELAXED);
+
+    /// Max przez CAS - ponawiamy tylko gdy ktoś równolegle podniósł max
+    uint64_t stary = __atomic_load_n(&hist->max_ns, __ATOMIC_RELAXED);
+    while (czas_ns > stary &&
+        !__atomic_compare_exchange_n(&hist->max_ns, &stary, czas_ns, 0,
+            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+/// Zapisz pomiar etapu zwiedzania
+static inline void histogram_zapisz(ShmHistogramy* h, int etap, uint64_t czas_ns) {
+    if (!h || etap < 0 || etap >= LICZBA_ETAPOW) return;
+    histogram_dodaj(&h->etapy[etap], czas_ns);
+}
+
+/// Zapisz etap od znacznika czasu do teraz, zwraca teraz (do łańcuchowania etapów)
+static inline uint64_t histogram_zapisz_od(ShmHistogramy* h, int etap, uint64_t od_ns) {
+    uint64_t teraz = czas_monotoniczny_ns();
+    if (od_ns > 0 && teraz >= od_ns) histogram_zapisz(h, etap, teraz - od_ns);
+    return teraz;
+}
+
+/// Percentyl (0-100) z histogramu - przybliżony do górnej granicy kubełka
+static inline uint64_t histogram_percentyl(const Histogram* hist, double percentyl) {
+    uint64_t liczba = __atomic_load_n(&hist->liczba, __ATOMIC_RELAXED);
+    if (liczba == 0) return 0;
+
+    uint64_t cel = (uint64_t)((percentyl / 100.0) * (double)liczba + 0.5);
+    if (cel < 1) cel = 1;
+
+    uint64_t narastajaco = 0;
+    for (int i = 0; i < HIST_LICZBA_KUBELKOW; i++) {
+        narastajaco += __atomic_load_n(&hist->kubelki[i], __ATOMIC_RELAXED);
+        if (narastajaco >= cel) {
+            uint64_t granica = histogram_gorna_granica(i);
+            uint64_t max = __atomic_load_n(&hist->max_ns, __ATOMIC_RELAXED);
+            return granica < max ? granica : max;
+        }
+    }
+    return __atomic_load_n(&hist->max_ns, __ATOMIC_RELAXED);
+}
+
+#endif
@@ -1,16 +1,37 @@
 #include "common.h"
+#include "slad.h"
+#include "dziennik.h"
+#include "metryki.h"
+#include <dirent.h>
 
 /// Punkt wejcia do systemu
 /// 1. Usuwa stare logi
 /// 2. Uruchamia stranika (ktry zajmuje si reszt)
+/// Pliki i IPC tylko tej instancji (JASKINIA_INSTANCJA) - inne symulacje dziaaj dalej
 int main() {
+    if (sprawdz_wolna_instancje() != 0) return 1;
+
     /// Czycimy logi z poprzednich uruchomie
-    unlink("jaskinia_common.log");
-    unlink("jaskinia_kasjer.log");
-    unlink("jaskinia_przewodnik1.log");
-    unlink("jaskinia_przewodnik2.log");
-    unlink("jaskinia_generator.log");
-    unlink("jaskinia_zwiedzajacy.log");
+    char plik[128];
+    unlink(plik_instancji(LOG_PLIK_WSPOLNY, plik, sizeof(plik)));
+    for (int r = 0; r < ROLA_PRZEWODNIK1 + MAX_TRAS; r++) {  /// Take przewodnicy wikszego ukadu
+        if (PLIKI_ROL[r]) unlink(plik_instancji(PLIKI_ROL[r], plik, sizeof(plik)));
+    }
+
+    /// Stare pliki ladu - inaczej slad2json pomieszaby rne uruchomienia.
+    /// Nazwa to prefiks, PID i kocwka instancji (".bin" albo ".n.bin")
+    const char* koncowka = plik_instancji(".bin", plik, sizeof(plik));
+    DIR* katalog = opendir(".");
+    if (katalog) {
+        struct dirent* wpis;
+        while ((wpis = readdir(katalog)) != NULL) {
+            if (strncmp(wpis->d_name, SLAD_PREFIKS_PLIKU, strlen(SLAD_PREFIKS_PLIKU)) != 0) continue;
+            const char* s = wpis->d_name + strlen(SLAD_PREFIKS_PLIKU);
+            while (*s >= '0' && *s <= '9') s++;
+            if (strcmp(s, koncowka) == 0) unlink(wpis->d_name);
+        }
+        closedir(katalog);
+    }
 
     /// Zamie si w stranika - exec() zastpuje ten proces
     execl("./straznik", "straznik", NULL);
@@ -0,0 +1,43 @@
+#include "common.h"
+#include "metryki.h"
+#include "role.h"
+
+/// jaskinia - jeden plik wykonywalny wszystkich ról symulacji (multi-call)
+/// Rola z nazwy programu (straznik, kasjer, przewodnik, generator, zwiedzajacy to dowiązania
+/// do ./jaskinia) albo z pierwszego argumentu:
+///   ./kasjer                  ./jaskinia kasjer
+///   ./przewodnik 2            ./jaskinia przewodnik 2
+/// Strażnik i generator startują role przez fork() bez exec (uruchom_role w role.h).
+
+/// Globalne wspólne dla ról - jedna definicja zamiast kopii w każdym pliku roli
+ShmMetryki* globalne_metryki = NULL;
+
+typedef struct {
+    const char* nazwa;
+    MainRoli main_roli;
+} RolaProgramu;
+
+#define WPIS_ROLI(nazwa) { #nazwa, main_##nazwa },
+static const RolaProgramu ROLE_PROGRAMU[] = { TABELA_ROL_PROGRAMU(WPIS_ROLI) };
+#undef WPIS_ROLI
+#define LICZBA_ROL_PROGRAMU (int)(sizeof(ROLE_PROGRAMU) / sizeof(ROLE_PROGRAMU[0]))
+
+int main(int argc, char* argv[]) {
+    const char* nazwa = strrchr(argv[0], '/');
+    nazwa = nazwa ? nazwa + 1 : argv[0];
+
+    if (strcmp(nazwa, "jaskinia") == 0 && argc > 1) {  /// ./jaskinia <rola> [argumenty roli]
+        argc--;
+        argv++;
+        nazwa = argv[0];
+    }
+
+    for (int i = 0; i < LICZBA_ROL_PROGRAMU; i++) {
+        if (strcmp(nazwa, ROLE_PROGRAMU[i].nazwa) == 0) return ROLE_PROGRAMU[i].main_roli(argc, argv);
+    }
+
+    fprintf(stderr, "Uzycie: jaskinia <rola> [argumenty] - role:");
+    for (int i = 0; i < LICZBA_ROL_PROGRAMU; i++) fprintf(stderr, " %s", ROLE_PROGRAMU[i].nazwa);
+    fprintf(stderr, "\n");
+    return 1;
+}
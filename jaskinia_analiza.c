@@ -0,0 +1,984 @@
+#include "common.h"
+#include "histogramy.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/// jaskinia-analiza - offline analiza jaskinia_common.log i weryfikacja niezmienników
+/// ze scenariuszy testowych README (K, N1/N2, pełny cykl, sygnał zamknięcia, regulamin).
+/// Limity tras i kładek bierze z linii "Gotowy" przewodników; regulamin sprawdza według
+/// TABELA_TRAS, więc log powinien pochodzić z symulacji zbudowanej z tym samym UKLAD_JASKINI.
+///
+/// Plik jest mapowany (mmap) i dzielony na kawałki wyrównane do końca linii; każdy wątek
+/// zamienia swój kawałek na zwarte zdarzenia. Potem jeden przebieg po zdarzeniach w kolejności
+/// pliku odtwarza cykl życia każdego PID-u - kolejność linii w logu jest globalna, bo każdy
+/// zapis to jeden writev na O_APPEND, a rola opróżnia bufor logu, zanim zacznie czekać
+/// na inną albo ją obudzi (loguj.h; znaczniki czasu mają tylko rozdzielczość 1s).
+///
+/// Log może zawierać wiele dni (dopisywanie bez make clean) - każdy "START STRAZNIKA"
+/// zaczyna nowy przebieg, stan PID-ów jest wtedy zerowany.
+///
+/// Użycie: ./jaskinia-analiza [plik.log] [watki 1-64] - domyślnie log instancji JASKINIA_INSTANCJA
+/// Kod wyjścia: 0 = wszystkie niezmienniki spełnione, 1 = naruszenia, 2 = błąd
+
+#define DOMYSLNY_LOG "jaskinia_common.log"
+#define MAX_WATKOW 64
+#define MAX_PRZYKLADOW 5         /// Ile numerów linii pokazać dla każdego naruszenia
+#define MIN_DLUGOSC_LINII 32     /// "[RRRR-MM-DD GG:MM:SS] [PID:1] [X] " - krótsze to śmieci
+
+/// Rodzaje zdarzeń - Z_ zwiedzający, P_ przewodnik, K_ kasjer, S_ strażnik
+enum {
+    Z_START = 0,          /// a=wiek b=poprzednia trasa c=flagi ZF_*
+    Z_BILET,              /// a=trasa
+    Z_ZEBRANO,
+    Z_KLADKA_WEJSCIE,
+    Z_ZWIEDZAM,           /// a=trasa
+    Z_KLADKA_WYJSCIE,
+    Z_KONIEC,             /// COMPLETE
+    Z_ODRZUCONY,
+    Z_ANULOWANY,          /// a=etap (0 przed wycieczką ... 3 podczas zwiedzania)
+    Z_TIMEOUT,            /// a=0 bilet, 1 kolejka
+    Z_SHUTDOWN,
+    Z_BLAD,
+    P_GOTOWY,             /// a=Ni b=czas c=K
+    P_GRUPA,              /// a=liczba
+    P_ODWOLANA,           /// a=liczba
+    P_LIMIT,              /// a=Ni b=bylo c=dozwolone
+    P_ZAREZERWOWANA,      /// a=bylo b=teraz c=Ni
+    P_ODRZUCONY_LIMIT,
+    P_KLADKI_ZABLOKOWANE, /// a=maska kładek
+    P_KLADKI_ZWOLNIONE,   /// a=maska kładek
+    P_ZWIEDZANIE,
+    P_WYCIECZKA_KONIEC,   /// a=liczba
+    P_KLADKA_PRZEKROCZONA,/// a=kładka b=osoby c=K
+    P_KLADKI_NIEPUSTE,
+    K_ODRZUCENIE,         /// a=powód ODRZ_*
+    S_START,
+    S_OTWARCIE,
+    S_SYGNAL,             /// trasa = przewodnik
+    S_ZAMKNIECIE,
+    S_KONIEC
+};
+
+/// Flagi zwiedzającego z linii START
+#define ZF_POWTORNA 1
+#define ZF_MA_OPIEKUNA 2
+#define ZF_JEST_OPIEKUNEM 4
+
+/// Maska kładek, gdy linia jej nie podaje (log sprzed tabeli tras - przewodnik brał obie)
+#define WSZYSTKIE_KLADKI ((1 << MAX_KLADEK) - 1)
+
+/// Powody odrzucenia przez kasjera
+enum { ODRZ_BEZ_OPIEKUNA = 0, ODRZ_OPIEKUN_NIE_ISTNIEJE, ODRZ_POPRZEDNIA_TRASA, LICZBA_ODRZUCEN };
+static const char* const NAZWY_ODRZUCEN[LICZBA_ODRZUCEN] = {
+    "dziecko bez opiekuna", "opiekun nie istnieje", "zla poprzednia trasa"
+};
+
+static const char* const NAZWY_ANULOWAN[4] = {
+    "przed wycieczka", "po zebraniu grupy", "na kladce", "podczas zwiedzania"
+};
+
+/// Jedno rozpoznane zdarzenie - 20 bajtów, żeby gigabajtowy log mieścił się w pamięci
+typedef struct {
+    uint32_t linia;   /// Numer linii w kawałku (od 1), przy scalaniu dodawany offset kawałka
+    uint32_t czas;    /// Sekundy od epoki (czas lokalny z logu)
+    int32_t pid;
+    uint8_t typ;
+    uint8_t trasa;    /// Numer przewodnika dla P_* i S_SYGNAL
+    int16_t a, b, c;
+} Zdarzenie;
+
+/// Kawałek pliku przetwarzany przez jeden wątek
+typedef struct {
+    const char* poczatek;
+    const char* koniec;
+    Zdarzenie* zdarzenia;
+    size_t liczba;
+    size_t pojemnosc;
+    uint32_t linie;
+    uint32_t nierozpoznane;  /// Linie bez nagłówka "[czas] [PID:n] [ROLA]"
+    int brak_pamieci;
+} Kawalek;
+
+/// --- Parsowanie (równoległe) --------------------------------------------------
+
+static inline int zaczyna(const char* p, const char* koniec, const char* prefiks, size_t dlugosc) {
+    return (size_t)(koniec - p) >= dlugosc && memcmp(p, prefiks, dlugosc) == 0;
+}
+#define ZACZYNA(p, koniec, lit) zaczyna((p), (koniec), (lit), sizeof(lit) - 1)
+
+/// Liczba całkowita za pierwszym wystąpieniem klucza, *p przesuwany za liczbę; -1 gdy brak
+static int liczba_po(const char** p, const char* koniec, const char* klucz, int* wynik) {
+    size_t dlugosc = strlen(klucz);
+    const char* s = *p;
+    while ((size_t)(koniec - s) >= dlugosc && memcmp(s, klucz, dlugosc) != 0) s++;
+    if ((size_t)(koniec - s) < dlugosc) return -1;
+    s += dlugosc;
+
+    int znak = 1, wartosc = 0, cyfr = 0;
+    if (s < koniec && *s == '-') {
+        znak = -1;
+        s++;
+    }
+    while (s < koniec && *s >= '0' && *s <= '9' && cyfr < 9) {
+        wartosc = wartosc * 10 + (*s++ - '0');
+        cyfr++;
+    }
+    if (cyfr == 0) return -1;
+    *wynik = znak * wartosc;
+    *p = s;
+    return 0;
+}
+
+static inline int16_t obetnij16(int v) {
+    return (int16_t)(v > INT16_MAX ? INT16_MAX : v < INT16_MIN ? INT16_MIN : v);
+}
+
+static inline int cyfry2(const char* p) { return (p[0] - '0') * 10 + (p[1] - '0'); }
+
+/// Dzień od 1970-01-01 dla daty kalendarzowej (algorytm "days from civil")
+static int32_t dni_od_epoki(int rok, int miesiac, int dzien) {
+    rok -= miesiac <= 2;
+    int era = (rok >= 0 ? rok : rok - 399) / 400;
+    int rok_ery = rok - era * 400;
+    int dzien_roku = (153 * (miesiac + (miesiac > 2 ? -3 : 9)) + 2) / 5 + dzien - 1;
+    int dzien_ery = rok_ery * 365 + rok_ery / 4 - rok_ery / 100 + dzien_roku;
+    return era * 146097 + dzien_ery - 719468;
+}
+
+/// Zwiedzający - kolejność sprawdzeń od najczęstszych linii
+static int rozpoznaj_zwiedzajacego(const char* m, const char* koniec, Zdarzenie* z) {
+    int v;
+    if (ZACZYNA(m, koniec, "STATE: ")) {
+        m += 7;
+        if (ZACZYNA(m, koniec, "Zwiedzam trase ")) {
+            if (liczba_po(&m, koniec, "trase ", &v) != 0) return -1;
+            z->typ = Z_ZWIEDZAM;
+            z->a = obetnij16(v);
+            return 0;
+        }
+        if (ZACZYNA(m, koniec, "Zebrano")) { z->typ = Z_ZEBRANO; return 0; }
+        if (ZACZYNA(m, koniec, "Przechodze kladke (wejscie)")) { z->typ = Z_KLADKA_WEJSCIE; return 0; }
+        if (ZACZYNA(m, koniec, "Przechodze kladke (wyjscie)")) { z->typ = Z_KLADKA_WYJSCIE; return 0; }
+        return -1;  /// Pozostałe STATE tylko opisują oczekiwanie
+    }
+    if (ZACZYNA(m, koniec, "START: ")) {
+        int wiek, powtorna, poprz, opiekun, czy_opiekun;
+        if (liczba_po(&m, koniec, "wiek=", &wiek) != 0 ||
+            liczba_po(&m, koniec, "powtorna=", &powtorna) != 0 ||
+            liczba_po(&m, koniec, "poprz=", &poprz) != 0 ||
+            liczba_po(&m, koniec, "opiekun=", &opiekun) != 0 ||
+            liczba_po(&m, koniec, "czy_opiekun=", &czy_opiekun) != 0) return -1;
+        z->typ = Z_START;
+        z->a = obetnij16(wiek);
+        z->b = obetnij16(poprz);
+        z->c = (int16_t)((powtorna ? ZF_POWTORNA : 0) | (opiekun > 0 ? ZF_MA_OPIEKUNA : 0) |
+            (czy_opiekun ? ZF_JEST_OPIEKUNEM : 0));
+        return 0;
+    }
+    if (ZACZYNA(m, koniec, "TICKET: ")) {
+        if (liczba_po(&m, koniec, "trase ", &v) != 0) return -1;
+        z->typ = Z_BILET;
+        z->a = obetnij16(v);
+        return 0;
+    }
+    if (ZACZYNA(m, koniec, "COMPLETE")) { z->typ = Z_KONIEC; return 0; }
+    if (ZACZYNA(m, koniec, "REJECT")) { z->typ = Z_ODRZUCONY; return 0; }
+    if (ZACZYNA(m, koniec, "CANCEL: ")) {
+        m += 8;
+        z->typ = Z_ANULOWANY;
+        z->a = ZACZYNA(m, koniec, "Przed") ? 0 : ZACZYNA(m, koniec, "Po zebraniu") ? 1 :
+            ZACZYNA(m, koniec, "Podczas przechodzenia") ? 2 : 3;
+        return 0;
+    }
+    if (ZACZYNA(m, koniec, "TIMEOUT: ")) {
+        z->typ = Z_TIMEOUT;
+        z->a = ZACZYNA(m + 9, koniec, "Brak odpowiedzi") ? 0 : 1;
+        return 0;
+    }
+    if (ZACZYNA(m, koniec, "SHUTDOWN")) { z->typ = Z_SHUTDOWN; return 0; }
+    if (ZACZYNA(m, koniec, "ERROR")) { z->typ = Z_BLAD; return 0; }
+    return -1;
+}
+
+static int rozpoznaj_przewodnika(const char* m, const char* koniec, Zdarzenie* z) {
+    int a, b, c;
+    /// Logi sprzed tabeli tras: "Obie kladki zablokowane" i zwolnienie bez maski - wszystkie kładki
+    if (ZACZYNA(m, koniec, "Kladki zablokowane") || ZACZYNA(m, koniec, "Obie kladki zablokowane")) {
+        if (liczba_po(&m, koniec, "maska=", &a) != 0) a = WSZYSTKIE_KLADKI;
+        z->typ = P_KLADKI_ZABLOKOWANE;
+        z->a = obetnij16(a);
+        return 0;
+    }
+    if (ZACZYNA(m, koniec, "Kladki zwolnione")) {
+        if (liczba_po(&m, koniec, "maska=", &a) != 0) a = WSZYSTKIE_KLADKI;
+        z->typ = P_KLADKI_ZWOLNIONE;
+        z->a = obetnij16(a);
+        return 0;
+    }
+    if (ZACZYNA(m, koniec, "Zwiedzanie rozpoczete")) { z->typ = P_ZWIEDZANIE; return 0; }
+    if (ZACZYNA(m, koniec, "Grupa zebrana: ")) {
+        if (liczba_po(&m, koniec, ": ", &a) != 0) return -1;
+        z->typ = P_GRUPA;
+        z->a = obetnij16(a);
+        return 0;
+    }
+    if (ZACZYNA(m, koniec, "Trasa zarezerwowana: ")) {
+        if (liczba_po(&m, koniec, "bylo=", &a) != 0 || liczba_po(&m, koniec, "teraz=", &b) != 0 ||
+            liczba_po(&m, koniec, "/", &c) != 0) return -1;
+        z->typ = P_ZAREZERWOWANA;
+        z->a = obetnij16(a);
+        z->b = obetnij16(b);
+        z->c = obetnij16(c);
+        return 0;
+    }
+    if (ZACZYNA(m, koniec, "Wycieczka zakonczona: ")) {
+        if (liczba_po(&m, koniec, "zwiedzajacych=", &a) != 0) return -1;
+        z->typ = P_WYCIECZKA_KONIEC;
+        z->a = obetnij16(a);
+        return 0;
+    }
+    if (ZACZYNA(m, koniec, "Sygnal zamkniecia przed trasa") || ZACZYNA(m, koniec, "Grupa nie zdazy przed Tk")) {
+        if (liczba_po(&m, koniec, "grupe ", &a) != 0) a = 0;
+        z->typ = P_ODWOLANA;
+        z->a = obetnij16(a);
+        return 0;
+    }
+    if (ZACZYNA(m, koniec, "Odrzucono PID=")) { z->typ = P_ODRZUCONY_LIMIT; return 0; }
+    if (ZACZYNA(m, koniec, "WARN: Limit trasy")) {
+        if (liczba_po(&m, koniec, "Ni=", &a) != 0 || liczba_po(&m, koniec, "bylo=", &b) != 0 ||
+            liczba_po(&m, koniec, "dozwolone=", &c) != 0) return -1;
+        z->typ = P_LIMIT;
+        z->a = obetnij16(a);
+        z->b = obetnij16(b);
+        z->c = obetnij16(c);
+        return 0;
+    }
+    if (ZACZYNA(m, koniec, "CRITICAL: Kladka ")) {
+        if (liczba_po(&m, koniec, "Kladka ", &a) != 0 || liczba_po(&m, koniec, "! ", &b) != 0 ||
+            liczba_po(&m, koniec, "> ", &c) != 0) return -1;
+        z->typ = P_KLADKA_PRZEKROCZONA;
+        z->a = obetnij16(a);
+        z->b = obetnij16(b);
+        z->c = obetnij16(c);
+        return 0;
+    }
+    if (ZACZYNA(m, koniec, "WARN: Po zakonczeniu")) {
+        const char* s = m;
+        if (liczba_po(&s, koniec, "kladka ", &a) != 0 && liczba_po(&m, koniec, "k1=", &a) != 0) return -1;
+        z->typ = P_KLADKI_NIEPUSTE;
+        return 0;
+    }
+    if (ZACZYNA(m, koniec, "Gotowy: ")) {
+        if (liczba_po(&m, koniec, "max=", &a) != 0 || liczba_po(&m, koniec, "czas=", &b) != 0 ||
+            liczba_po(&m, koniec, "K=", &c) != 0) return -1;
+        z->typ = P_GOTOWY;
+        z->a = obetnij16(a);
+        z->b = obetnij16(b);
+        z->c = obetnij16(c);
+        return 0;
+    }
+    return -1;
+}
+
+static int rozpoznaj_kasjera(const char* m, const char* koniec, Zdarzenie* z) {
+    if (!ZACZYNA(m, koniec, "REJECT: ")) return -1;
+    z->typ = K_ODRZUCENIE;
+    if (ZACZYNA(m + 8, koniec, "Nieprawidlowa")) {
+        z->a = ODRZ_POPRZEDNIA_TRASA;
+        return 0;
+    }
+    /// "REJECT: PID=%d dziecko<%d bez opiekuna" / "... opiekun nie istnieje"
+    const char* s = m;
+    int v;
+    if (liczba_po(&s, koniec, "dziecko<", &v) != 0) return -1;
+    z->a = ZACZYNA(s, koniec, " bez") ? ODRZ_BEZ_OPIEKUNA : ODRZ_OPIEKUN_NIE_ISTNIEJE;
+    return 0;
+}
+
+static int rozpoznaj_straznika(const char* m, const char* koniec, Zdarzenie* z) {
+    int numer;
+    if (ZACZYNA(m, koniec, "SIG")) {
+        const char* s = m;
+        if (liczba_po(&s, koniec, "-> przewodnik", &numer) != 0) return -1;
+        z->typ = S_SYGNAL;
+        z->trasa = (uint8_t)numer;
+        return 0;
+    }
+    if (ZACZYNA(m, koniec, "=== START STRAZNIKA")) { z->typ = S_START; return 0; }
+    if (ZACZYNA(m, koniec, "OTWIERAM JASKINIE")) { z->typ = S_OTWARCIE; return 0; }
+    if (ZACZYNA(m, koniec, "ZAMYKAM JASKINIE")) { z->typ = S_ZAMKNIECIE; return 0; }
+    if (ZACZYNA(m, koniec, "=== STRAZNIK ZAKONCZYL PRACE")) { z->typ = S_KONIEC; return 0; }
+    return -1;
+}
+
+/// Jedna linia bez '\n': 1 = zdarzenie, 0 = linia bez znaczenia dla analizy, -1 = nie linia logu
+static int rozpoznaj_linie(const char* p, const char* koniec, Zdarzenie* z,
+    char* ostatnia_data, int32_t* ostatnie_dni) {
+    if (koniec - p < MIN_DLUGOSC_LINII || p[0] != '[' || p[20] != ']' || !ZACZYNA(p + 21, koniec, " [PID:")) {
+        return -1;
+    }
+
+    /// Data zmienia się rzadko - przeliczamy tylko gdy inna niż w poprzedniej linii
+    if (memcmp(p + 1, ostatnia_data, 10) != 0) {
+        memcpy(ostatnia_data, p + 1, 10);
+        *ostatnie_dni = dni_od_epoki(cyfry2(p + 1) * 100 + cyfry2(p + 3), cyfry2(p + 6), cyfry2(p + 9));
+    }
+    z->czas = (uint32_t)((int64_t)*ostatnie_dni * 86400 + cyfry2(p + 12) * 3600 + cyfry2(p + 15) * 60 + cyfry2(p + 18));
+
+    const char* s = p + 27;
+    int32_t pid = 0;
+    while (s < koniec && *s >= '0' && *s <= '9') pid = pid * 10 + (*s++ - '0');
+    if (!ZACZYNA(s, koniec, "] [")) return -1;
+    z->pid = pid;
+
+    const char* rola = s + 3;
+    const char* koniec_roli = memchr(rola, ']', (size_t)(koniec - rola));
+    if (!koniec_roli || koniec_roli + 2 > koniec) return -1;
+    const char* m = koniec_roli + 2;
+    size_t dlugosc_roli = (size_t)(koniec_roli - rola);
+
+    z->trasa = 0;
+    z->a = z->b = z->c = 0;
+    int wynik = -1;
+    switch (rola[0]) {
+    case 'Z':
+        wynik = rozpoznaj_zwiedzajacego(m, koniec, z);
+        break;
+    case 'P':
+        if (dlugosc_roli > 10 && ZACZYNA(rola, koniec_roli, "PRZEWODNIK")) {  /// PRZEWODNIK1 ... PRZEWODNIKn
+            int numer = 0;
+            for (const char* c = rola + 10; c < koniec_roli && *c >= '0' && *c <= '9'; c++) {
+                numer = numer * 10 + (*c - '0');
+            }
+            if (numer >= 1 && numer <= MAX_TRAS) {
+                z->trasa = (uint8_t)numer;
+                wynik = rozpoznaj_przewodnika(m, koniec, z);
+            }
+        }
+        break;
+    case 'K':
+        wynik = rozpoznaj_kasjera(m, koniec, z);
+        break;
+    case 'S':
+        wynik = rozpoznaj_straznika(m, koniec, z);
+        break;
+    default:
+        break;
+    }
+    return wynik == 0 ? 1 : 0;
+}
+
+static void* parsuj_kawalek(void* arg) {
+    Kawalek* k = (Kawalek*)arg;
+    char ostatnia_data[10] = { 0 };
+    int32_t ostatnie_dni = 0;
+
+    /// Zgrubnie jedno zdarzenie na ~80 bajtów logu
+    k->pojemnosc = (size_t)(k->koniec - k->poczatek) / 80 + 64;
+    k->zdarzenia = malloc(k->pojemnosc * sizeof(Zdarzenie));
+    if (!k->zdarzenia) {
+        k->brak_pamieci = 1;
+        return NULL;
+    }
+
+    const char* p = k->poczatek;
+    while (p < k->koniec) {
+        const char* nl = memchr(p, '\n', (size_t)(k->koniec - p));
+        const char* koniec_linii = nl ? nl : k->koniec;
+        k->linie++;
+
+        if (k->liczba == k->pojemnosc) {
+            size_t nowa = k->pojemnosc * 2;
+            Zdarzenie* nowe = realloc(k->zdarzenia, nowa * sizeof(Zdarzenie));
+            if (!nowe) {
+                k->brak_pamieci = 1;
+                return NULL;
+            }
+            k->zdarzenia = nowe;
+            k->pojemnosc = nowa;
+        }
+
+        Zdarzenie* z = &k->zdarzenia[k->liczba];
+        int wynik = rozpoznaj_linie(p, koniec_linii, z, ostatnia_data, &ostatnie_dni);
+        if (wynik == 1) {
+            z->linia = k->linie;
+            k->liczba++;
+        }
+        else if (wynik == -1) {
+            k->nierozpoznane++;
+        }
+        p = koniec_linii + 1;
+    }
+    return NULL;
+}
+
+/// --- Analiza (sekwencyjna, w kolejności pliku) -----------------------------
+
+enum {
+    INV_KLADKA = 0,
+    INV_TRASA,
+    INV_BILET,
+    INV_KOLEJNOSC,
+    INV_PO_SYGNALE,
+    INV_DOKONCZENIE,
+    INV_DZIECI,
+    INV_SENIORZY,
+    INV_POWTORNI,
+    LICZBA_NIEZMIENNIKOW
+};
+
+static const char* const NAZWY_NIEZMIENNIKOW[LICZBA_NIEZMIENNIKOW] = {
+    "T1 kladka: max K osob, jeden przewodnik naraz",
+    "T1 trasa: max N1/N2 osob",
+    "T1 COMPLETE poprzedzony TICKET",
+    "T1 pelny cykl w kolejnosci",
+    "T2 brak nowej wycieczki po sygnale",
+    "T3 wycieczki w toku dokonczone",
+    "T4 dziecko <8: tylko trasa dla dzieci z opiekunem",
+    "T5 senior >75: tylko trasa dla seniorow",
+    "T6 powracajacy: druga trasa"
+};
+
+typedef struct {
+    uint64_t liczba;
+    uint64_t linie[MAX_PRZYKLADOW];
+} Naruszenie;
+
+/// Stany cyklu życia zwiedzającego (bity)
+#define ZS_START 1
+#define ZS_BILET 2
+#define ZS_ZEBRANY 4
+#define ZS_ZWIEDZA 8
+#define ZS_WYSZEDL 16
+#define ZS_KONIEC 32
+
+typedef struct {
+    int32_t pid;          /// 0 = wolny slot
+    uint32_t t_start;
+    uint32_t t_bilet;
+    uint32_t t_zwiedzam;
+    int16_t wiek;
+    int16_t poprz;
+    uint8_t flagi;        /// ZF_*
+    uint8_t stan;         /// ZS_*
+    uint8_t trasa;
+} Zwiedzajacy;
+
+/// Tablica PID -> zwiedzający (adresowanie otwarte), zerowana na początku każdego przebiegu
+typedef struct {
+    Zwiedzajacy* sloty;
+    size_t pojemnosc;     /// Potęga dwójki
+    size_t zajete;
+} MapaPidow;
+
+enum { CZ_BILET = 0, CZ_KOLEJKA, CZ_START_WYCIECZKI, CZ_ZWIEDZANIE, CZ_CALOSC, LICZBA_CZASOW };
+static const char* const NAZWY_CZASOW[LICZBA_CZASOW] = {
+    "bilet", "kolejka", "start_wycieczki", "zwiedzanie", "calosc"
+};
+
+typedef struct {
+    Naruszenie naruszenia[LICZBA_NIEZMIENNIKOW];
+    Histogram czasy[LICZBA_CZASOW];   /// W sekundach - rozdzielczość logu
+    MapaPidow mapa;
+
+    uint64_t przebiegi, wygenerowani, zakonczyli[MAX_TRAS + 1], bilety[MAX_TRAS + 1];
+    uint64_t odrzuceni_kasjer[LICZBA_ODRZUCEN], odrzuceni, odrzuceni_limit;
+    uint64_t anulowani[4], timeouty[2], shutdown, bledy;
+    uint64_t grupy[MAX_TRAS + 1], grupy_odwolane[MAX_TRAS + 1];
+    uint64_t wycieczki[MAX_TRAS + 1], wycieczki_zakonczone[MAX_TRAS + 1];
+    uint64_t czas_otwarcia_s;
+    int max_na_trasie[MAX_TRAS + 1], max_rezerwacja[MAX_TRAS + 1], max_grupa[MAX_TRAS + 1];
+    int limit_trasy[MAX_TRAS + 1], limit_kladki;
+    int liczba_tras;            /// Najwyższy numer przewodnika w logu (co najmniej LICZBA_TRAS)
+
+    /// Stan bieżącego przebiegu
+    int na_trasie[MAX_TRAS + 1];
+    int kladka_trzyma[MAX_KLADEK];  /// Numer przewodnika trzymającego kładkę, 0 = wolna
+    uint64_t sygnal[MAX_TRAS + 1];  /// Linia sygnału zamknięcia dla przewodnika, 0 = brak
+    int grupa_po_sygnale[MAX_TRAS + 1];
+    int ostrzezenie_limitu[MAX_TRAS + 1];
+    uint64_t wycieczka_trwa[MAX_TRAS + 1];  /// Linia startu trwającej wycieczki, 0 = brak
+    uint32_t t_otwarcia;
+    int otwarta, zakonczony;
+} Analiza;
+
+static void narusz(Analiza* a, int niezmiennik, uint64_t linia) {
+    Naruszenie* n = &a->naruszenia[niezmiennik];
+    if (n->liczba < MAX_PRZYKLADOW) n->linie[n->liczba] = linia;
+    n->liczba++;
+}
+
+static inline size_t skrot_pidu(int32_t pid, size_t maska) {
+    return ((uint32_t)pid * 2654435761U) & maska;
+}
+
+static int mapa_powieksz(MapaPidow* m) {
+    size_t nowa = m->pojemnosc ? m->pojemnosc * 2 : 4096;
+    Zwiedzajacy* sloty = calloc(nowa, sizeof(Zwiedzajacy));
+    if (!sloty) return -1;
+    for (size_t i = 0; i < m->pojemnosc; i++) {
+        if (m->sloty[i].pid == 0) continue;
+        size_t j = skrot_pidu(m->sloty[i].pid, nowa - 1);
+        while (sloty[j].pid != 0) j = (j + 1) & (nowa - 1);
+        sloty[j] = m->sloty[i];
+    }
+    free(m->sloty);
+    m->sloty = sloty;
+    m->pojemnosc = nowa;
+    return 0;
+}
+
+/// Znajdź zwiedzającego po PID, utwórz pusty wpis gdy go nie ma (NULL tylko przy braku pamięci)
+static Zwiedzajacy* mapa_wpis(MapaPidow* m, int32_t pid) {
+    if ((m->zajete + 1) * 2 > m->pojemnosc && mapa_powieksz(m) != 0) return NULL;
+    size_t i = skrot_pidu(pid, m->pojemnosc - 1);
+    while (m->sloty[i].pid != 0) {
+        if (m->sloty[i].pid == pid) return &m->sloty[i];
+        i = (i + 1) & (m->pojemnosc - 1);
+    }
+    memset(&m->sloty[i], 0, sizeof(Zwiedzajacy));
+    m->sloty[i].pid = pid;
+    m->zajete++;
+    return &m->sloty[i];
+}
+
+/// Koniec przebiegu - wycieczki bez zakończenia liczą się tylko gdy strażnik normalnie skończył
+static void zakoncz_przebieg(Analiza* a) {
+    if (a->zakonczony) {
+        for (int t = 1; t <= MAX_TRAS; t++) {
+            if (a->wycieczka_trwa[t]) narusz(a, INV_DOKONCZENIE, a->wycieczka_trwa[t]);
+        }
+    }
+    if (a->mapa.sloty) memset(a->mapa.sloty, 0, a->mapa.pojemnosc * sizeof(Zwiedzajacy));
+    a->mapa.zajete = 0;
+    memset(a->na_trasie, 0, sizeof(a->na_trasie));
+    memset(a->sygnal, 0, sizeof(a->sygnal));
+    memset(a->grupa_po_sygnale, 0, sizeof(a->grupa_po_sygnale));
+    memset(a->ostrzezenie_limitu, 0, sizeof(a->ostrzezenie_limitu));
+    memset(a->wycieczka_trwa, 0, sizeof(a->wycieczka_trwa));
+    memset(a->kladka_trzyma, 0, sizeof(a->kladka_trzyma));
+    a->otwarta = 0;
+    a->zakonczony = 0;
+}
+
+/// Zwiedzający opuszcza trasę (wyjście lub przerwanie w trakcie)
+static void zejdz_z_trasy(Analiza* a, Zwiedzajacy* w) {
+    if (!(w->stan & ZS_ZWIEDZA)) return;
+    if (w->trasa >= 1 && w->trasa <= MAX_TRAS) a->na_trasie[w->trasa]--;
+    w->stan &= (uint8_t)~ZS_ZWIEDZA;
+}
+
+/// Czy trasa z TABELA_TRAS dopuszcza wiek
+static int trasa_dopuszcza(int trasa, int wiek) {
+    return trasa >= 1 && trasa <= LICZBA_TRAS &&
+        wiek >= TRASY[trasa - 1].min_wiek && wiek <= TRASY[trasa - 1].max_wiek;
+}
+
+/// Regulamin kasjera (ta sama kolejność reguł co w regulamin.h) dla przydzielonej trasy.
+/// Para opiekun-dziecko idzie na trasę dla dzieci (tę dopuszczającą MIN_WIEK)
+static void sprawdz_regulamin(Analiza* a, const Zwiedzajacy* w, int trasa, uint64_t linia) {
+    if (!(w->stan & ZS_START)) return;
+    if (w->flagi & ZF_JEST_OPIEKUNEM) {
+        if (!trasa_dopuszcza(trasa, MIN_WIEK)) narusz(a, INV_DZIECI, linia);
+    }
+    else if (w->wiek < WIEK_Z_OPIEKUNEM) {
+        if (!trasa_dopuszcza(trasa, MIN_WIEK) || !(w->flagi & ZF_MA_OPIEKUNA)) narusz(a, INV_DZIECI, linia);
+    }
+    else if (w->wiek > WIEK_SENIORA) {
+        if (!trasa_dopuszcza(trasa, w->wiek)) narusz(a, INV_SENIORZY, linia);
+    }
+    else if ((w->flagi & ZF_POWTORNA) && w->poprz >= 1 && w->poprz <= LICZBA_TRAS && trasa == w->poprz) {
+        /// Ta sama trasa tylko gdy wiek nie dopuszcza żadnej innej
+        for (int t = 1; t <= LICZBA_TRAS; t++) {
+            if (t != w->poprz && trasa_dopuszcza(t, w->wiek)) {
+                narusz(a, INV_POWTORNI, linia);
+                break;
+            }
+        }
+    }
+}
+
+static int zdarzenie_zwiedzajacego(Analiza* a, const Zdarzenie* z, uint64_t linia) {
+    Zwiedzajacy* w = mapa_wpis(&a->mapa, z->pid);
+    if (!w) return -1;
+
+    switch (z->typ) {
+    case Z_START:
+        /// Ten sam PID drugi raz w przebiegu - powrót po wycieczce (powtorna=1) albo nowy proces
+        /// po zawinięciu numerów
+        zejdz_z_trasy(a, w);
+        memset(w, 0, sizeof(*w));
+        w->pid = z->pid;
+        w->stan = ZS_START;
+        w->t_start = z->czas;
+        w->wiek = z->a;
+        w->poprz = z->b;
+        w->flagi = (uint8_t)z->c;
+        a->wygenerowani++;
+        break;
+
+    case Z_BILET:
+        if (z->a >= 1 && z->a <= MAX_TRAS) a->bilety[z->a]++;
+        sprawdz_regulamin(a, w, z->a, linia);
+        if (w->stan & ZS_START) histogram_dodaj(&a->czasy[CZ_BILET], z->czas - w->t_start);
+        w->stan |= ZS_BILET;
+        w->trasa = (uint8_t)z->a;
+        w->t_bilet = z->czas;
+        break;
+
+    case Z_ZEBRANO:
+        if (!(w->stan & ZS_BILET)) narusz(a, INV_KOLEJNOSC, linia);
+        else histogram_dodaj(&a->czasy[CZ_KOLEJKA], z->czas - w->t_bilet);
+        w->stan |= ZS_ZEBRANY;
+        break;
+
+    case Z_KLADKA_WEJSCIE:
+        if (!(w->stan & ZS_ZEBRANY)) narusz(a, INV_KOLEJNOSC, linia);
+        break;
+
+    case Z_ZWIEDZAM:
+        if (!(w->stan & ZS_BILET) || w->trasa != z->a) narusz(a, INV_KOLEJNOSC, linia);
+        else histogram_dodaj(&a->czasy[CZ_START_WYCIECZKI], z->czas - w->t_bilet);
+        if (z->a >= 1 && z->a <= MAX_TRAS && !(w->stan & ZS_ZWIEDZA)) {
+            w->trasa = (uint8_t)z->a;
+            w->stan |= ZS_ZWIEDZA;
+            w->t_zwiedzam = z->czas;
+            int ile = ++a->na_trasie[z->a];
+            if (ile > a->max_na_trasie[z->a]) a->max_na_trasie[z->a] = ile;
+            if (ile > a->limit_trasy[z->a]) narusz(a, INV_TRASA, linia);
+        }
+        break;
+
+    case Z_KLADKA_WYJSCIE:
+        if (!(w->stan & ZS_ZWIEDZA)) narusz(a, INV_KOLEJNOSC, linia);
+        else histogram_dodaj(&a->czasy[CZ_ZWIEDZANIE], z->czas - w->t_zwiedzam);
+        zejdz_z_trasy(a, w);
+        w->stan |= ZS_WYSZEDL;
+        break;
+
+    case Z_KONIEC:
+        if (!(w->stan & ZS_BILET)) narusz(a, INV_BILET, linia);
+        else if (!(w->stan & ZS_WYSZEDL)) narusz(a, INV_KOLEJNOSC, linia);
+        if (w->stan & ZS_START) histogram_dodaj(&a->czasy[CZ_CALOSC], z->czas - w->t_start);
+        if (w->trasa >= 1 && w->trasa <= MAX_TRAS) a->zakonczyli[w->trasa]++;
+        zejdz_z_trasy(a, w);
+        w->stan |= ZS_KONIEC;
+        break;
+
+    case Z_ANULOWANY:
+        /// Grupa na trasie kończy normalnie - anulowanie podczas zwiedzania łamie T3
+        if (w->stan & ZS_ZWIEDZA) narusz(a, INV_DOKONCZENIE, linia);
+        if (z->a >= 0 && z->a < 4) a->anulowani[z->a]++;
+        zejdz_z_trasy(a, w);
+        w->stan |= ZS_KONIEC;
+        break;
+
+    default:  /// Z_ODRZUCONY, Z_TIMEOUT, Z_SHUTDOWN, Z_BLAD - zakończenie bez wycieczki
+        if (z->typ == Z_ODRZUCONY) a->odrzuceni++;
+        else if (z->typ == Z_TIMEOUT) a->timeouty[z->a ? 1 : 0]++;
+        else if (z->typ == Z_SHUTDOWN) a->shutdown++;
+        else a->bledy++;
+        zejdz_z_trasy(a, w);
+        w->stan |= ZS_KONIEC;
+        break;
+    }
+    return 0;
+}
+
+static void zdarzenie_przewodnika(Analiza* a, const Zdarzenie* z, uint64_t linia) {
+    int t = z->trasa;
+    if (t < 1 || t > MAX_TRAS) return;
+    if (t > a->liczba_tras) a->liczba_tras = t;
+
+    switch (z->typ) {
+    case P_GOTOWY:
+        a->limit_trasy[t] = z->a;
+        if (z->c > a->limit_kladki) a->limit_kladki = z->c;
+        break;
+    case P_GRUPA:
+        a->grupy[t]++;
+        if (z->a > a->max_grupa[t]) a->max_grupa[t] = z->a;
+        if (z->a > a->limit_trasy[t]) narusz(a, INV_TRASA, linia);
+        a->grupa_po_sygnale[t] = a->sygnal[t] != 0;
+        a->ostrzezenie_limitu[t] = 0;
+        break;
+    case P_ODWOLANA:
+        a->grupy_odwolane[t]++;
+        break;
+    case P_LIMIT:
+        a->ostrzezenie_limitu[t] = 1;
+        break;
+    case P_ZAREZERWOWANA: {
+        /// Po ostrzeżeniu o limicie przewodnik przycina licznik do Ni, a log pokazuje wartość sprzed przycięcia
+        int teraz = a->ostrzezenie_limitu[t] ? z->c : z->b;
+        if (teraz > a->max_rezerwacja[t]) a->max_rezerwacja[t] = teraz;
+        if (teraz > z->c || teraz > a->limit_trasy[t]) narusz(a, INV_TRASA, linia);
+        a->ostrzezenie_limitu[t] = 0;
+        break;
+    }
+    case P_ODRZUCONY_LIMIT:
+        a->odrzuceni_limit++;
+        break;
+    case P_KLADKI_ZABLOKOWANE:
+        for (int i = 0; i < MAX_KLADEK; i++) {
+            if (!(z->a & (1 << i))) continue;
+            if (a->kladka_trzyma[i] != 0 && a->kladka_trzyma[i] != t) narusz(a, INV_KLADKA, linia);
+            a->kladka_trzyma[i] = t;
+        }
+        break;
+    case P_KLADKI_ZWOLNIONE:
+        for (int i = 0; i < MAX_KLADEK; i++) {
+            if ((z->a & (1 << i)) && a->kladka_trzyma[i] == t) a->kladka_trzyma[i] = 0;
+        }
+        break;
+    case P_ZWIEDZANIE:
+        /// Sygnał logowany przed kill() - grupa zebrana po jego linii nie mogła go przegapić
+        a->wycieczki[t]++;
+        if (a->grupa_po_sygnale[t]) narusz(a, INV_PO_SYGNALE, linia);
+        a->wycieczka_trwa[t] = linia;
+        break;
+    case P_WYCIECZKA_KONIEC:
+        a->wycieczki_zakonczone[t]++;
+        a->wycieczka_trwa[t] = 0;
+        break;
+    case P_KLADKA_PRZEKROCZONA:
+    case P_KLADKI_NIEPUSTE:
+        narusz(a, INV_KLADKA, linia);
+        break;
+    default:
+        break;
+    }
+}
+
+static void zdarzenie_straznika(Analiza* a, const Zdarzenie* z, uint64_t linia) {
+    switch (z->typ) {
+    case S_START:
+        zakoncz_przebieg(a);
+        a->przebiegi++;
+        break;
+    case S_OTWARCIE:
+        a->t_otwarcia = z->czas;
+        a->otwarta = 1;
+        break;
+    case S_SYGNAL:
+        if (z->trasa >= 1 && z->trasa <= MAX_TRAS && a->sygnal[z->trasa] == 0) a->sygnal[z->trasa] = linia;
+        break;
+    case S_ZAMKNIECIE:
+        if (a->otwarta) a->czas_otwarcia_s += z->czas - a->t_otwarcia;
+        a->otwarta = 0;
+        break;
+    case S_KONIEC:
+        a->zakonczony = 1;
+        break;
+    default:
+        break;
+    }
+}
+
+/// --- Raport ------------------------------------------------------------------
+
+static void wyswietl_raport(const Analiza* a) {
+    uint64_t zakonczyli = 0;
+    for (int t = 1; t <= a->liczba_tras; t++) zakonczyli += a->zakonczyli[t];
+    uint64_t odrzuceni_kasjer = 0;
+    for (int i = 0; i < LICZBA_ODRZUCEN; i++) odrzuceni_kasjer += a->odrzuceni_kasjer[i];
+
+    printf("\n=== PRZEPUSTOWOSC ===\n");
+    printf("Przebiegi (dni):        %llu\n", (unsigned long long)a->przebiegi);
+    printf("Czas otwarcia:          %llu s\n", (unsigned long long)a->czas_otwarcia_s);
+    printf("Wygenerowani:           %llu\n", (unsigned long long)a->wygenerowani);
+    printf("Bilety:                ");
+    for (int t = 1; t <= a->liczba_tras; t++) printf(" trasa%d=%llu", t, (unsigned long long)a->bilety[t]);
+    printf("\n");
+    printf("Zakonczyli (COMPLETE): ");
+    for (int t = 1; t <= a->liczba_tras; t++) printf(" trasa%d=%llu", t, (unsigned long long)a->zakonczyli[t]);
+    printf(" razem=%llu\n", (unsigned long long)zakonczyli);
+    if (a->czas_otwarcia_s > 0) {
+        printf("Przepustowosc:          %.2f zwiedzajacych/min\n",
+            (double)zakonczyli * 60.0 / (double)a->czas_otwarcia_s);
+    }
+    for (int t = 1; t <= a->liczba_tras; t++) {
+        printf("Przewodnik %d:           grupy=%llu odwolane=%llu wycieczki=%llu zakonczone=%llu max_grupa=%d\n", t,
+            (unsigned long long)a->grupy[t], (unsigned long long)a->grupy_odwolane[t],
+            (unsigned long long)a->wycieczki[t], (unsigned long long)a->wycieczki_zakonczone[t], a->max_grupa[t]);
+    }
+
+    printf("\n=== ODRZUCENIA I PRZERWANIA ===\n");
+    printf("Kasjer:                 %llu", (unsigned long long)odrzuceni_kasjer);
+    for (int i = 0; i < LICZBA_ODRZUCEN; i++) {
+        printf("  %s=%llu", NAZWY_ODRZUCEN[i], (unsigned long long)a->odrzuceni_kasjer[i]);
+    }
+    printf("\n");
+    printf("REJECT (zwiedzajacy):   %llu\n", (unsigned long long)a->odrzuceni);
+    printf("Limit trasy:            %llu\n", (unsigned long long)a->odrzuceni_limit);
+    printf("Anulowani:             ");
+    for (int i = 0; i < 4; i++) printf("  %s=%llu", NAZWY_ANULOWAN[i], (unsigned long long)a->anulowani[i]);
+    printf("\n");
+    printf("Timeouty:               bilet=%llu kolejka=%llu\n",
+        (unsigned long long)a->timeouty[0], (unsigned long long)a->timeouty[1]);
+    printf("SHUTDOWN / ERROR:       %llu / %llu\n", (unsigned long long)a->shutdown, (unsigned long long)a->bledy);
+
+    printf("\n=== CZASY (s, rozdzielczosc logu 1s) ===\n");
+    printf("%-16s %8s %6s %6s %6s %6s %8s\n", "etap", "liczba", "p50", "p90", "p99", "max", "srednia");
+    for (int i = 0; i < LICZBA_CZASOW; i++) {
+        const Histogram* h = &a->czasy[i];
+        if (h->liczba == 0) continue;
+        printf("%-16s %8llu %6llu %6llu %6llu %6llu %8.1f\n", NAZWY_CZASOW[i],
+            (unsigned long long)h->liczba,
+            (unsigned long long)histogram_percentyl(h, 50.0),
+            (unsigned long long)histogram_percentyl(h, 90.0),
+            (unsigned long long)histogram_percentyl(h, 99.0),
+            (unsigned long long)h->max_ns,
+            (double)h->suma_ns / (double)h->liczba);
+    }
+
+    printf("\n=== OBLOZENIE ===\n");
+    for (int t = 1; t <= a->liczba_tras; t++) {
+        printf("Trasa %d: max na trasie=%d max rezerwacja=%d limit=%d\n", t,
+            a->max_na_trasie[t], a->max_rezerwacja[t], a->limit_trasy[t]);
+    }
+    printf("Kladka: K=%d\n", a->limit_kladki);
+
+    printf("\n=== NIEZMIENNIKI ===\n");
+    for (int i = 0; i < LICZBA_NIEZMIENNIKOW; i++) {
+        const Naruszenie* n = &a->naruszenia[i];
+        printf("[%s] %s", n->liczba ? "BLAD" : " OK ", NAZWY_NIEZMIENNIKOW[i]);
+        if (n->liczba) {
+            printf(" - naruszen=%llu, linie:", (unsigned long long)n->liczba);
+            for (uint64_t j = 0; j < n->liczba && j < MAX_PRZYKLADOW; j++) {
+                printf(" %llu", (unsigned long long)n->linie[j]);
+            }
+        }
+        printf("\n");
+    }
+}
+
+int main(int argc, char* argv[]) {
+    char domyslny[64];
+    const char* sciezka = argc > 1 ? argv[1] : plik_instancji(DOMYSLNY_LOG, domyslny, sizeof(domyslny));
+    long cpu = sysconf(_SC_NPROCESSORS_ONLN);
+    int watki = cpu > 0 ? (int)(cpu < MAX_WATKOW ? cpu : MAX_WATKOW) : 1;
+
+    if (argc > 3 || (argc > 2 && bezpieczny_strtol(argv[2], &watki, 1, MAX_WATKOW) != 0)) {
+        fprintf(stderr, "Uzycie: %s [plik.log] [watki 1-%d]\n", argv[0], MAX_WATKOW);
+        return 2;
+    }
+
+    int fd = open(sciezka, O_RDONLY);
+    if (fd == -1) {
+        perror(sciezka);
+        return 2;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == -1 || st.st_size == 0) {
+        fprintf(stderr, "%s: pusty lub nieczytelny plik\n", sciezka);
+        close(fd);
+        return 2;
+    }
+    size_t rozmiar = (size_t)st.st_size;
+    const char* dane = mmap(NULL, rozmiar, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (dane == MAP_FAILED) {
+        perror("mmap");
+        return 2;
+    }
+    madvise((void*)dane, rozmiar, MADV_SEQUENTIAL);
+
+    uint64_t start_ns = czas_monotoniczny_ns();
+
+    /// Mały plik nie potrzebuje wielu wątków - min 1 MB na wątek
+    if ((size_t)watki > rozmiar / (1 << 20) + 1) watki = (int)(rozmiar / (1 << 20) + 1);
+
+    Kawalek kawalki[MAX_WATKOW];
+    pthread_t watek[MAX_WATKOW];
+    memset(kawalki, 0, sizeof(kawalki));
+    const char* koniec_pliku = dane + rozmiar;
+    const char* poczatek = dane;
+    for (int i = 0; i < watki; i++) {
+        const char* koniec = i == watki - 1 ? koniec_pliku : dane + rozmiar / (size_t)watki * (size_t)(i + 1);
+        if (koniec < poczatek) koniec = poczatek;
+        if (koniec < koniec_pliku) {
+            const char* nl = memchr(koniec, '\n', (size_t)(koniec_pliku - koniec));
+            koniec = nl ? nl + 1 : koniec_pliku;
+        }
+        kawalki[i].poczatek = poczatek;
+        kawalki[i].koniec = koniec;
+        poczatek = koniec;
+    }
+
+    /// Kawałek 0 parsuje wątek główny, pozostałe osobne wątki
+    int uruchomiony[MAX_WATKOW] = { 0 };
+    for (int i = 1; i < watki; i++) {
+        uruchomiony[i] = pthread_create(&watek[i], NULL, parsuj_kawalek, &kawalki[i]) == 0;
+        if (!uruchomiony[i]) parsuj_kawalek(&kawalki[i]);  /// Nie ma wątku - zrób to sam
+    }
+    parsuj_kawalek(&kawalki[0]);
+    for (int i = 1; i < watki; i++) {
+        if (uruchomiony[i]) pthread_join(watek[i], NULL);
+    }
+    uint64_t parsowanie_ns = czas_monotoniczny_ns() - start_ns;
+
+    Analiza* a = calloc(1, sizeof(Analiza));
+    if (!a) {
+        perror("calloc");
+        return 2;
+    }
+    a->liczba_tras = LICZBA_TRAS;
+    for (int t = 1; t <= MAX_TRAS; t++) a->limit_trasy[t] = MAX_POJEMNOSC_TRASY;
+    for (int t = 1; t <= LICZBA_TRAS; t++) a->limit_trasy[t] = TRASY[t - 1].pojemnosc;
+    a->limit_kladki = K;
+
+    int wynik = 0;
+    uint64_t linie = 0, zdarzen = 0, nierozpoznane = 0;
+    for (int i = 0; i < watki && wynik == 0; i++) {
+        Kawalek* k = &kawalki[i];
+        if (k->brak_pamieci) {
+            fprintf(stderr, "Brak pamieci na zdarzenia\n");
+            wynik = -1;
+            break;
+        }
+        for (size_t j = 0; j < k->liczba; j++) {
+            const Zdarzenie* z = &k->zdarzenia[j];
+            uint64_t linia = linie + z->linia;
+            if (z->typ <= Z_BLAD) {
+                if (zdarzenie_zwiedzajacego(a, z, linia) != 0) {
+                    fprintf(stderr, "Brak pamieci na mape PID-ow\n");
+                    wynik = -1;
+                    break;
+                }
+            }
+            else if (z->typ <= P_KLADKI_NIEPUSTE) zdarzenie_przewodnika(a, z, linia);
+            else if (z->typ == K_ODRZUCENIE) a->odrzuceni_kasjer[z->a]++;
+            else zdarzenie_straznika(a, z, linia);
+        }
+        linie += k->linie;
+        zdarzen += k->liczba;
+        nierozpoznane += k->nierozpoznane;
+    }
+    if (wynik == 0) zakoncz_przebieg(a);
+    uint64_t razem_ns = czas_monotoniczny_ns() - start_ns;
+
+    if (wynik == 0) {
+        if (a->przebiegi == 0) a->przebiegi = 1;  /// Log bez startu strażnika (np. ucięty)
+        printf("jaskinia-analiza: %s\n", sciezka);
+        wyswietl_raport(a);
+    }
+
+    fprintf(stderr, "\n%.1f MB, %llu linii, %llu zdarzen, %llu obcych linii; %d watk%s: "
+        "parsowanie %.3f s, razem %.3f s (%.0f MB/s)\n",
+        (double)rozmiar / 1048576.0, (unsigned long long)linie, (unsigned long long)zdarzen,
+        (unsigned long long)nierozpoznane, watki, watki == 1 ? "iem" : "ami",
+        (double)parsowanie_ns / 1e9, (double)razem_ns / 1e9,
+        (double)rozmiar / 1048576.0 / ((double)razem_ns / 1e9));
+
+    int naruszenia = 0;
+    for (int i = 0; i < LICZBA_NIEZMIENNIKOW; i++) naruszenia |= a->naruszenia[i].liczba != 0;
+
+    for (int i = 0; i < watki; i++) free(kawalki[i].zdarzenia);
+    free(a->mapa.sloty);
+    free(a);
+    munmap((void*)dane, rozmiar);
+
+    if (wynik != 0) return 2;
+    return naruszenia ? 1 : 0;
+}
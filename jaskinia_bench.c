@@ -0,0 +1,278 @@
+#include "common.h"
+#include "common_helpers.h"
+
+/// jaskinia-bench - rampa obciążenia całej symulacji z porównaniem do zapisanej linii bazowej
+/// Każdy krok to pełny dzień (./init) z JASKINIA_TK/TEMPO/SEED/WYNIKI; tempo rośnie
+/// co krok aż odrzucenia+timeouty przekroczą próg albo start wycieczki przekroczy limit.
+/// Wynik: bench_wyniki.txt (klucz=wartosc), porównanie z bench_baseline.txt jeśli istnieje.
+///
+/// Parametry (zmienne środowiskowe):
+///   BENCH_TK=90          długość dnia w sekundach - dłuższa niż MAX_CZAS_W_KOLEJCE,
+///                        inaczej timeouty kolejki nie zdążą się pojawić
+///   BENCH_TEMPO=0.25     tempo pierwszego kroku (zwiedzających/s)
+///   BENCH_MNOZNIK=2      mnożnik tempa między krokami
+///   BENCH_KROKI=5        max liczba kroków
+///   BENCH_PROG=5         próg niepowodzeń w % wygenerowanych (timeouty + odrzuceni przez limit trasy)
+///   BENCH_LIMIT_STARTU=30  limit p99 dołączenie->start wycieczki w sekundach
+///   BENCH_SEED=12345     ziarno rand() wszystkich ról
+///   BENCH_TOLERANCJA=10  o ile % gorzej od bazowej to już regresja
+///   BENCH_BASELINE=bench_baseline.txt, BENCH_WYNIKI=bench_wyniki.txt
+///   JASKINIA_SPAWN_EXEC=1 role i zwiedzający przez fork+exec zamiast samego fork() - porównanie
+///                        kosztu uruchomienia (spawn_p50_ms/p99) i pamięci (rss_razem_kb)
+///   JASKINIA_INSTANCJA=n dziedziczą dni symulacji - kilka benchy obok siebie; plik kroku
+///                        i domyślne wyniki dostają wtedy numer instancji w nazwie
+/// Kod wyjścia: 0 = OK, 1 = błąd uruchomienia, 2 = regresja względem bazowej
+
+static const char* plik_kroku(void) {
+    static char bufor[64];
+    return plik_instancji("bench_krok.txt", bufor, sizeof(bufor));
+}
+#define PLIK_KROKU plik_kroku()
+#define MAX_KLUCZY 256
+#define MAX_KROKOW 16
+
+typedef struct {
+    char klucz[64];
+    double wartosc;
+} Wpis;
+
+typedef struct {
+    Wpis wpisy[MAX_KLUCZY];
+    int liczba;
+} Wyniki;
+
+/// Jedna pozycja porównania z bazową - luz to różnica bezwzględna poniżej której nie ma regresji
+typedef struct {
+    const char* klucz;
+    int wyzej_lepiej;
+    double luz;
+} Porownanie;
+
+static const Porownanie POROWNANIA[] = {
+    { "max_tempo", 1, 0.0 },
+    { "przepustowosc", 1, 0.01 },
+    { "bilet_p50_ms", 0, 1.0 },
+    { "bilet_p99_ms", 0, 1.0 },
+    { "start_wycieczki_p50_ms", 0, 100.0 },
+    { "start_wycieczki_p99_ms", 0, 100.0 },
+    { "cpu_razem_s", 0, 0.05 },
+    { "rss_max_kb", 0, 256.0 },
+    { "rss_razem_kb", 0, 1024.0 },
+    { "spawn_p50_ms", 0, 0.5 },
+    { "spawn_p99_ms", 0, 1.0 },
+    { "otwarcie_ms", 0, 50.0 },
+    { "kolejka_powracajacy_p50_ms", 0, 100.0 },
+    { "kolejka_zwykly_p99_ms", 0, 100.0 },
+};
+
+static double wartosc(const Wyniki* w, const char* klucz, double domyslna) {
+    for (int i = 0; i < w->liczba; i++) {
+        if (strcmp(w->wpisy[i].klucz, klucz) == 0) return w->wpisy[i].wartosc;
+    }
+    return domyslna;
+}
+
+static int ma_klucz(const Wyniki* w, const char* klucz) {
+    for (int i = 0; i < w->liczba; i++) {
+        if (strcmp(w->wpisy[i].klucz, klucz) == 0) return 1;
+    }
+    return 0;
+}
+
+/// Wczytaj plik klucz=wartosc (linie z # pomijane), -1 gdy brak pliku
+static int wczytaj_wyniki(const char* sciezka, Wyniki* w) {
+    FILE* f = fopen(sciezka, "r");
+    if (!f) return -1;
+
+    char linia[256];
+    w->liczba = 0;
+    while (fgets(linia, sizeof(linia), f) && w->liczba < MAX_KLUCZY) {
+        if (linia[0] == '#') continue;
+        char* rowna = strchr(linia, '=');
+        if (!rowna) continue;
+        *rowna = '\0';
+
+        char* koniec;
+        double v = strtod(rowna + 1, &koniec);
+        if (koniec == rowna + 1) continue;
+
+        Wpis* e = &w->wpisy[w->liczba++];
+        snprintf(e->klucz, sizeof(e->klucz), "%.63s", linia);
+        e->wartosc = v;
+    }
+    fclose(f);
+    return 0;
+}
+
+/// Jeden dzień symulacji - ./init z parametrami w środowisku, wyniki z PLIK_KROKU
+static int uruchom_krok(int tk, double tempo, int ziarno, Wyniki* w) {
+    char bufor[32];
+    unlink(PLIK_KROKU);
+
+    pid_t pid = fork();
+    if (pid == -1) {
+        perror("fork");
+        return -1;
+    }
+    if (pid == 0) {
+        snprintf(bufor, sizeof(bufor), "%d", tk);
+        setenv("JASKINIA_TK", bufor, 1);
+        snprintf(bufor, sizeof(bufor), "%.3f", tempo);
+        setenv("JASKINIA_TEMPO", bufor, 1);
+        snprintf(bufor, sizeof(bufor), "%d", ziarno);
+        setenv("JASKINIA_SEED", bufor, 1);
+        setenv("JASKINIA_WYNIKI", PLIK_KROKU, 1);
+
+        execl("./init", "init", NULL);
+        perror("execl init");
+        _exit(1);
+    }
+
+    int status;
+    while (waitpid(pid, &status, 0) == -1) {
+        if (errno != EINTR) {
+            perror("waitpid");
+            return -1;
+        }
+    }
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "jaskinia-bench: symulacja zakonczona bledem (status=%d)\n", status);
+        return -1;
+    }
+    if (wczytaj_wyniki(PLIK_KROKU, w) != 0) {
+        fprintf(stderr, "jaskinia-bench: brak pliku wynikow %s\n", PLIK_KROKU);
+        return -1;
+    }
+    return 0;
+}
+
+/// Porównaj z bazową - zwraca liczbę regresji
+static int porownaj(const Wyniki* teraz, const Wyniki* bazowa, double tolerancja) {
+    int regresje = 0;
+
+    printf("\nPorownanie z linia bazowa (tolerancja %.1f%%):\n", tolerancja);
+    printf("%-24s %12s %12s %9s  %s\n", "metryka", "bazowa", "teraz", "zmiana", "status");
+
+    if (wartosc(teraz, "max_tempo", 0) != wartosc(bazowa, "max_tempo", 0)) {
+        printf("UWAGA: inne tempo najlepszego kroku - koszty (cpu, rss) porownywalne tylko orientacyjnie\n");
+    }
+
+    for (size_t i = 0; i < sizeof(POROWNANIA) / sizeof(POROWNANIA[0]); i++) {
+        const Porownanie* p = &POROWNANIA[i];
+        if (!ma_klucz(bazowa, p->klucz) || !ma_klucz(teraz, p->klucz)) continue;
+
+        double b = wartosc(bazowa, p->klucz, 0);
+        double t = wartosc(teraz, p->klucz, 0);
+        double gorzej = p->wyzej_lepiej ? b - t : t - b;   /// > 0 = pogorszenie
+        double zmiana = b != 0.0 ? 100.0 * (t - b) / b : 0.0;
+
+        const char* status = "OK";
+        if (gorzej > p->luz && (b == 0.0 || 100.0 * gorzej / b > tolerancja)) {
+            status = "REGRESJA";
+            regresje++;
+        }
+        else if (-gorzej > p->luz && b != 0.0 && 100.0 * -gorzej / b > tolerancja) {
+            status = "poprawa";
+        }
+        printf("%-24s %12.3f %12.3f %8.1f%%  %s\n", p->klucz, b, t, zmiana, status);
+    }
+    return regresje;
+}
+
+int main(void) {
+    int tk = parametr_env("BENCH_TK", MAX_CZAS_W_KOLEJCE + 30, MIN_CZAS_OTWARCIA, 86400);
+    double tempo = parametr_env_ulamek("BENCH_TEMPO", 0.25, 0.01, 1000.0);
+    double mnoznik = parametr_env_ulamek("BENCH_MNOZNIK", 2.0, 1.01, 100.0);
+    int kroki = parametr_env("BENCH_KROKI", 5, 1, MAX_KROKOW);
+    double prog = parametr_env_ulamek("BENCH_PROG", 5.0, 0.0, 100.0);
+    double limit_startu_ms = parametr_env_ulamek("BENCH_LIMIT_STARTU", MAX_CZAS_W_KOLEJCE / 2, 1.0, 86400.0) * 1000.0;
+    int ziarno = parametr_env("BENCH_SEED", 12345, 0, INT_MAX);
+    double tolerancja = parametr_env_ulamek("BENCH_TOLERANCJA", 10.0, 0.0, 1000.0);
+    const char* plik_bazowy = getenv("BENCH_BASELINE") ? getenv("BENCH_BASELINE") : "bench_baseline.txt";
+    char domyslne_wyniki[64];
+    const char* plik_wynikow = getenv("BENCH_WYNIKI") ? getenv("BENCH_WYNIKI") :
+        plik_instancji("bench_wyniki.txt", domyslne_wyniki, sizeof(domyslne_wyniki));
+
+    printf("jaskinia-bench: tk=%ds tempo=%.3f/s x%.2f kroki=%d prog=%.1f%% limit_startu=%.0fs ziarno=%d\n",
+        tk, tempo, mnoznik, kroki, prog, limit_startu_ms / 1000.0, ziarno);
+    printf("%4s %8s %7s %7s %7s %8s %10s %11s %11s %10s\n", "krok", "tempo", "wygen", "zakoncz",
+        "niepow%", "przep/s", "bilet_p99", "start_p50", "start_p99", "otwarcie");
+
+    static Wyniki wyniki_krokow[MAX_KROKOW];
+    double tempa[MAX_KROKOW], niepowodzenia[MAX_KROKOW], przepustowosci[MAX_KROKOW];
+    int wykonane = 0;
+    int najlepszy = -1;
+
+    for (int k = 0; k < kroki; k++, tempo *= mnoznik) {
+        Wyniki* w = &wyniki_krokow[k];
+        if (uruchom_krok(tk, tempo, ziarno, w) != 0) break;
+        wykonane++;
+
+        double wygenerowano = wartosc(w, "wygenerowano", 0);
+        double zle = wartosc(w, "timeouty", 0) + wartosc(w, "odrzuceni_limit", 0);
+        tempa[k] = tempo;
+        niepowodzenia[k] = wygenerowano > 0 ? 100.0 * zle / wygenerowano : 0.0;
+        przepustowosci[k] = wartosc(w, "zakonczyli", 0) / tk;
+        double start_p99 = wartosc(w, "start_wycieczki_p99_ms", 0);
+
+        printf("%4d %8.3f %7.0f %7.0f %7.1f %8.3f %10.1f %11.1f %11.1f %10.1f\n", k + 1, tempo,
+            wygenerowano, wartosc(w, "zakonczyli", 0), niepowodzenia[k], przepustowosci[k],
+            wartosc(w, "bilet_p99_ms", 0), wartosc(w, "start_wycieczki_p50_ms", 0), start_p99,
+            wartosc(w, "otwarcie_ms", 0));
+        fflush(stdout);
+
+        if (niepowodzenia[k] > prog || start_p99 > limit_startu_ms) {
+            printf("Krok %d ponad prog - koniec rampy\n", k + 1);
+            break;
+        }
+        najlepszy = k;
+    }
+
+    if (wykonane == 0) {
+        fprintf(stderr, "jaskinia-bench: zaden krok sie nie udal\n");
+        return 1;
+    }
+    unlink(PLIK_KROKU);
+
+    /// Zapis - podsumowanie, krótko każdy krok, pełne wyniki najlepszego kroku
+    FILE* f = fopen(plik_wynikow, "w");
+    if (!f) {
+        perror(plik_wynikow);
+        return 1;
+    }
+    const Wyniki* wybrany = &wyniki_krokow[najlepszy >= 0 ? najlepszy : 0];
+    fprintf(f, "# bench jaskini: tk=%d ziarno=%d prog=%.1f%% limit_startu=%.0fs\n",
+        tk, ziarno, prog, limit_startu_ms / 1000.0);
+    fprintf(f, "max_tempo=%.3f\n", najlepszy >= 0 ? tempa[najlepszy] : 0.0);
+    fprintf(f, "przepustowosc=%.4f\n", najlepszy >= 0 ? przepustowosci[najlepszy] : 0.0);
+    fprintf(f, "kroki=%d\n", wykonane);
+    for (int k = 0; k < wykonane; k++) {
+        fprintf(f, "krok%d_tempo=%.3f\n", k + 1, tempa[k]);
+        fprintf(f, "krok%d_niepowodzenia_proc=%.2f\n", k + 1, niepowodzenia[k]);
+        fprintf(f, "krok%d_przepustowosc=%.4f\n", k + 1, przepustowosci[k]);
+    }
+    fprintf(f, "# pelne wyniki kroku %d\n", (najlepszy >= 0 ? najlepszy : 0) + 1);
+    for (int i = 0; i < wybrany->liczba; i++) {
+        if (strcmp(wybrany->wpisy[i].klucz, "tempo") == 0) continue;  /// Jest jako max_tempo
+        fprintf(f, "%s=%.4f\n", wybrany->wpisy[i].klucz, wybrany->wpisy[i].wartosc);
+    }
+    fclose(f);
+
+    printf("\nMax tempo bez przekroczenia progu: %.3f/s (przepustowosc %.3f/s)\n",
+        najlepszy >= 0 ? tempa[najlepszy] : 0.0, najlepszy >= 0 ? przepustowosci[najlepszy] : 0.0);
+    printf("Wyniki zapisane do %s\n", plik_wynikow);
+
+    Wyniki teraz, bazowa;
+    if (wczytaj_wyniki(plik_bazowy, &bazowa) != 0) {
+        printf("Brak linii bazowej %s - zapisz ja przez 'make bench-baseline'\n", plik_bazowy);
+        return 0;
+    }
+    wczytaj_wyniki(plik_wynikow, &teraz);
+    int regresje = porownaj(&teraz, &bazowa, tolerancja);
+    if (regresje > 0) {
+        printf("\n%d REGRESJ%s wzgledem %s\n", regresje, regresje == 1 ? "A" : "E", plik_bazowy);
+        return 2;
+    }
+    printf("\nBrak regresji wzgledem %s\n", plik_bazowy);
+    return 0;
+}
@@ -0,0 +1,56 @@
+#include "common.h"
+#include "metryki.h"
+#include "dziennik.h"
+
+/// jaskinia-logi - podgląd i zmiana poziomów logu ról działającej symulacji
+/// Maska leży na stronie metryk - procesy czytają ją przy każdym logu, więc zmiana
+/// działa od razu, bez restartu i bez sygnałów.
+///   ./jaskinia-logi                      pokaż poziomy ról
+///   ./jaskinia-logi info                 wszystkie role do poziomu info
+///   ./jaskinia-logi zwiedzajacy=blad,przewodnik=szczegoly
+/// Poziomy: blad, ostrzezenie, info, szczegoly. Wyższe niż LOG_POZIOM_KOMPILACJI
+/// i tak nie dotrą - zostały usunięte przy kompilacji ról.
+
+static void pokaz(uint64_t maska) {
+    for (int r = 0; r < LICZBA_ROL; r++) {
+        int p = poziom_roli(maska, r);
+        printf("%-12s %s\n", NAZWY_ROL[r], p >= 0 ? NAZWY_POZIOMOW[p] : "-");
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 2) {
+        fprintf(stderr, "Uzycie: %s [poziom | rola=poziom,...]\n", argv[0]);
+        return 1;
+    }
+
+    int shmid = shmget(KLUCZ_SHM_METRYKI, 0, 0);
+    if (shmid == -1) {
+        fprintf(stderr, "Symulacja nie dziala (brak strony metryk)\n");
+        return 1;
+    }
+    ShmMetryki* m = (ShmMetryki*)shmat(shmid, NULL, 0);
+    if (m == (void*)-1) {
+        perror("shmat KLUCZ_SHM_METRYKI");
+        return 1;
+    }
+    if (__atomic_load_n(&m->magic, __ATOMIC_ACQUIRE) != METRYKI_MAGIC || m->wersja != METRYKI_WERSJA) {
+        fprintf(stderr, "Niezgodna wersja metryk: strona=%u program=%u\n", m->wersja, METRYKI_WERSJA);
+        shmdt(m);
+        return 1;
+    }
+
+    uint64_t maska = __atomic_load_n(&m->maska_logu, __ATOMIC_RELAXED);
+    if (argc == 2) {
+        if (maska_logu_z_opisu(argv[1], &maska) != 0) {
+            fprintf(stderr, "Bledny opis: %s\n", argv[1]);
+            shmdt(m);
+            return 1;
+        }
+        __atomic_store_n(&m->maska_logu, maska, __ATOMIC_RELAXED);
+    }
+
+    pokaz(maska);
+    shmdt(m);
+    return 0;
+}
@@ -0,0 +1,500 @@
+#include "common.h"
+#include "common_helpers.h"
+#include "histogramy.h"
+#include "zegar.h"
+#include <sched.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
+#include <sys/utsname.h>
+#include <linux/futex.h>
+
+/// jaskinia-mikro - mikrobenchmark prymitywów IPC używanych w symulacji
+/// i kandydatów na ich zamienniki (futex, eventfd, pierścień w shm, atomiki, koło czasowe).
+/// Testy "rywalizacji" idą dla 1..max_procesow procesów, ping-pongi zawsze dla 2.
+/// Wszystkie obiekty IPC są IPC_PRIVATE - nie koliduje z działającą symulacją.
+///
+/// Użycie: ./jaskinia-mikro [max_procesow 1-64] [iteracje 1000-100000000] [plik.csv]
+/// Wyniki dopisywane do CSV (domyślnie mikro_ipc.csv) z nazwą hosta i wersją jądra.
+///
+/// ns_na_op = czas ścienny / liczba operacji wszystkich procesów (odwrotność przepustowości)
+/// p50/p99 tylko dla testów mierzących każdą operację osobno (round-trip)
+
+#define DOMYSLNE_PROCESY 4
+#define DOMYSLNE_ITERACJE 200000
+#define DOMYSLNY_PLIK "mikro_ipc.csv"
+#define POJEMNOSC_PIERSCIENIA 1024
+#define TERMINY_W_KOLE 4096  /// Ile terminów czeka w kole podczas testu zegar_kolo
+
+/// Pierścień SPSC w shm - kandydat na kolejkę do przewodnika
+typedef struct {
+    uint64_t glowa;   /// Pisze tylko producent
+    char odstep1[56];
+    uint64_t ogon;    /// Pisze tylko konsument
+    char odstep2[56];
+    uint64_t dane[POJEMNOSC_PIERSCIENIA];
+} Pierscien;
+
+/// Wspólny kontekst testu w shared memory
+typedef struct {
+    int start;                /// Bariera startu - 1 = ruszać
+    int gotowi;               /// Ile procesów czeka na starcie
+    pid_t pidy[2];            /// Dla ping-pongów - kto jest po drugiej stronie
+    int procesy;
+    long iteracje;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    int kolej;
+
+    uint32_t futex;           /// Mutex na futeksie: 0 wolny, 1 zajęty, 2 zajęty z czekającymi
+    uint32_t futex_kolej;
+    uint64_t licznik;
+
+    int semid;
+    int msgid;
+    int efd[2];
+
+    Pierscien pierscien;
+    Histogram opoznienia;     /// Czasy pojedynczych operacji (round-trip)
+} Kontekst;
+
+typedef struct {
+    const char* nazwa;
+    const char* rodzaj;       /// "obecny" - używany w symulacji, "kandydat" - zamiennik
+    int tryb;                 /// TRYB_*
+    int dzielnik;             /// Iteracje / dzielnik - wolne testy robią mniej powtórzeń
+    void (*pracuj)(Kontekst* k, int nr);
+} Test;
+
+enum {
+    TRYB_POJEDYNCZY = 0,      /// Jeden proces
+    TRYB_RYWALIZACJA,         /// 1..N procesów robi to samo
+    TRYB_PINGPONG,            /// Dokładnie 2 procesy, nr 0 mierzy round-trip
+    TRYB_SERWER               /// nr 0 = serwer (jak kasjer), 1..N klientów mierzy round-trip
+};
+
+static long futex(uint32_t* adres, int operacja, uint32_t wartosc) {
+    return syscall(SYS_futex, adres, operacja, wartosc, NULL, NULL, 0);
+}
+
+/// --- Obecne prymitywy -------------------------------------------------------
+
+/// Prośba o bilet jak zwiedzający -> kasjer: msgsnd typ 1, msgrcv mtype=pid
+static void test_msg_serwer(Kontekst* k, int nr) {
+    long razem = (long)k->procesy * k->iteracje;
+    if (nr == 0) {
+        WiadomoscKasjer zadanie;
+        WiadomoscOdpowiedz odpowiedz;
+        for (long i = 0; i < razem; i++) {
+            /// Dokładnie jak kasjer: dwie próby IPC_NOWAIT, potem blokujący odbiór
+            if (msgrcv(k->msgid, &zadanie, sizeof(zadanie) - sizeof(long), TYP_MSG_POWTORNA, IPC_NOWAIT) == -1 &&
+                msgrcv(k->msgid, &zadanie, sizeof(zadanie) - sizeof(long), TYP_MSG_ZADANIE, IPC_NOWAIT) == -1) {
+                while (msgrcv(k->msgid, &zadanie, sizeof(zadanie) - sizeof(long), -TYP_MSG_POWTORNA, 0) == -1 &&
+                    errno == EINTR) {
+                }
+            }
+            odpowiedz.mtype = zadanie.pid_zwiedzajacego;
+            odpowiedz.decyzja = DECYZJA_TRASA(1);
+            odpowiedz.przydzielona_trasa = 1;
+            while (msgsnd(k->msgid, &odpowiedz, sizeof(odpowiedz) - sizeof(long), 0) == -1 && errno == EINTR) {
+            }
+        }
+        return;
+    }
+
+    WiadomoscKasjer zadanie;
+    WiadomoscOdpowiedz odpowiedz;
+    memset(&zadanie, 0, sizeof(zadanie));
+    zadanie.mtype = TYP_MSG_ZADANIE;
+    zadanie.pid_zwiedzajacego = getpid();
+    for (long i = 0; i < k->iteracje; i++) {
+        uint64_t t0 = czas_monotoniczny_ns();
+        msgsnd(k->msgid, &zadanie, sizeof(zadanie) - sizeof(long), 0);
+        msgrcv(k->msgid, &odpowiedz, sizeof(odpowiedz) - sizeof(long), getpid(), 0);
+        histogram_dodaj(&k->opoznienia, czas_monotoniczny_ns() - t0);
+    }
+}
+
+/// Para prób IPC_NOWAIT na pustej kolejce - tak kasjer sprawdza priorytety
+static void test_msg_proba(Kontekst* k, int nr) {
+    (void)nr;
+    WiadomoscKasjer zadanie;
+    for (long i = 0; i < k->iteracje; i++) {
+        msgrcv(k->msgid, &zadanie, sizeof(zadanie) - sizeof(long), TYP_MSG_POWTORNA, IPC_NOWAIT);
+        msgrcv(k->msgid, &zadanie, sizeof(zadanie) - sizeof(long), TYP_MSG_ZADANIE, IPC_NOWAIT);
+    }
+}
+
+/// P+V na semaforze SysV - jak wejście na kładkę i zejście z niej
+static void test_semop(Kontekst* k, int nr) {
+    (void)nr;
+    struct sembuf p = { 0, -1, 0 }, v = { 0, 1, 0 };
+    for (long i = 0; i < k->iteracje; i++) {
+        semop(k->semid, &p, 1);
+        semop(k->semid, &v, 1);
+    }
+}
+
+/// lock+unlock mutexu PROCESS_SHARED w shm - jak ShmKladka.mutex
+static void test_pthread_mutex(Kontekst* k, int nr) {
+    (void)nr;
+    for (long i = 0; i < k->iteracje; i++) {
+        pthread_mutex_lock(&k->mutex);
+        k->licznik++;
+        pthread_mutex_unlock(&k->mutex);
+    }
+}
+
+/// Przekazanie pałeczki przez cond PROCESS_SHARED - jak czekanie na wolną kładkę
+static void test_pthread_cond(Kontekst* k, int nr) {
+    pthread_mutex_lock(&k->mutex);
+    for (long i = 0; i < k->iteracje; i++) {
+        if (nr == 0) {
+            uint64_t t0 = czas_monotoniczny_ns();
+            k->kolej = 1;
+            pthread_cond_signal(&k->cond);
+            while (k->kolej == 1) pthread_cond_wait(&k->cond, &k->mutex);
+            histogram_dodaj(&k->opoznienia, czas_monotoniczny_ns() - t0);
+        }
+        else {
+            while (k->kolej == 0) pthread_cond_wait(&k->cond, &k->mutex);
+            k->kolej = 0;
+            pthread_cond_signal(&k->cond);
+        }
+    }
+    pthread_mutex_unlock(&k->mutex);
+}
+
+/// kill(pid, 0) - sprawdzanie czy proces żyje (czy_proces_zyje)
+static void test_kill0(Kontekst* k, int nr) {
+    (void)nr;
+    pid_t rodzic = getppid();
+    for (long i = 0; i < k->iteracje; i++) kill(rodzic, 0);
+}
+
+/// Uzbrojenie i rozbrojenie terminu przez setitimer - jak alarm(), jeden termin na proces
+static void test_setitimer(Kontekst* k, int nr) {
+    (void)nr;
+    struct itimerval termin, zero;
+    memset(&termin, 0, sizeof(termin));
+    memset(&zero, 0, sizeof(zero));
+    termin.it_value.tv_sec = MAX_CZAS_W_KOLEJCE;
+    for (long i = 0; i < k->iteracje; i++) {
+        setitimer(ITIMER_REAL, &termin, NULL);
+        setitimer(ITIMER_REAL, &zero, NULL);
+    }
+}
+
+static volatile sig_atomic_t sygnal_odebrany = 0;
+static void obsluga_sygnalu_rt(int sig) { (void)sig; sygnal_odebrany = 1; }
+
+/// SIGRTMIN -> sigsuspend -> odpowiedź - jak maszyna stanów zwiedzającego
+static void test_sygnal_rt(Kontekst* k, int nr) {
+    sigset_t czekanie;
+    sigprocmask(SIG_BLOCK, NULL, &czekanie);
+    sigdelset(&czekanie, SIGRTMIN);
+    pid_t druga_strona = k->pidy[1 - nr];
+
+    for (long i = 0; i < k->iteracje; i++) {
+        uint64_t t0 = czas_monotoniczny_ns();
+        if (nr == 0) kill(druga_strona, SIGRTMIN);
+        while (!sygnal_odebrany) sigsuspend(&czekanie);
+        sygnal_odebrany = 0;
+        if (nr == 1) kill(druga_strona, SIGRTMIN);
+        else histogram_dodaj(&k->opoznienia, czas_monotoniczny_ns() - t0);
+    }
+}
+
+/// --- Kandydaci ---------------------------------------------------------------
+
+/// Mutex na futeksie (wariant z trzema stanami) - bez syscalla gdy brak rywalizacji
+static void test_futex_mutex(Kontekst* k, int nr) {
+    (void)nr;
+    for (long i = 0; i < k->iteracje; i++) {
+        uint32_t c = 0;
+        if (!__atomic_compare_exchange_n(&k->futex, &c, 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            if (c != 2) c = __atomic_exchange_n(&k->futex, 2, __ATOMIC_ACQUIRE);
+            while (c != 0) {
+                futex(&k->futex, FUTEX_WAIT, 2);
+                c = __atomic_exchange_n(&k->futex, 2, __ATOMIC_ACQUIRE);
+            }
+        }
+        k->licznik++;
+        if (__atomic_fetch_sub(&k->futex, 1, __ATOMIC_RELEASE) != 1) {
+            __atomic_store_n(&k->futex, 0, __ATOMIC_RELEASE);
+            futex(&k->futex, FUTEX_WAKE, 1);
+        }
+    }
+}
+
+/// Ping-pong na futeksie - zamiennik cond/sygnałów do budzenia
+static void test_futex_pingpong(Kontekst* k, int nr) {
+    for (long i = 0; i < k->iteracje; i++) {
+        if (nr == 0) {
+            uint64_t t0 = czas_monotoniczny_ns();
+            __atomic_store_n(&k->futex_kolej, 1, __ATOMIC_RELEASE);
+            futex(&k->futex_kolej, FUTEX_WAKE, 1);
+            while (__atomic_load_n(&k->futex_kolej, __ATOMIC_ACQUIRE) == 1) futex(&k->futex_kolej, FUTEX_WAIT, 1);
+            histogram_dodaj(&k->opoznienia, czas_monotoniczny_ns() - t0);
+        }
+        else {
+            while (__atomic_load_n(&k->futex_kolej, __ATOMIC_ACQUIRE) == 0) futex(&k->futex_kolej, FUTEX_WAIT, 0);
+            __atomic_store_n(&k->futex_kolej, 0, __ATOMIC_RELEASE);
+            futex(&k->futex_kolej, FUTEX_WAKE, 1);
+        }
+    }
+}
+
+/// Ping-pong przez dwa eventfd
+static void test_eventfd(Kontekst* k, int nr) {
+    uint64_t v = 1;
+    for (long i = 0; i < k->iteracje; i++) {
+        if (nr == 0) {
+            uint64_t t0 = czas_monotoniczny_ns();
+            if (write(k->efd[0], &v, sizeof(v)) != sizeof(v)) return;
+            if (read(k->efd[1], &v, sizeof(v)) != sizeof(v)) return;
+            histogram_dodaj(&k->opoznienia, czas_monotoniczny_ns() - t0);
+        }
+        else {
+            if (read(k->efd[0], &v, sizeof(v)) != sizeof(v)) return;
+            if (write(k->efd[1], &v, sizeof(v)) != sizeof(v)) return;
+        }
+    }
+}
+
+/// Pierścień SPSC w shm - przepustowość producent -> konsument (sched_yield gdy pełny/pusty)
+static void test_pierscien(Kontekst* k, int nr) {
+    Pierscien* p = &k->pierscien;
+    for (long i = 0; i < k->iteracje; i++) {
+        if (nr == 0) {
+            uint64_t glowa = p->glowa;
+            while (glowa - __atomic_load_n(&p->ogon, __ATOMIC_ACQUIRE) == POJEMNOSC_PIERSCIENIA) sched_yield();
+            p->dane[glowa % POJEMNOSC_PIERSCIENIA] = (uint64_t)i;
+            __atomic_store_n(&p->glowa, glowa + 1, __ATOMIC_RELEASE);
+        }
+        else {
+            uint64_t ogon = p->ogon;
+            while (__atomic_load_n(&p->glowa, __ATOMIC_ACQUIRE) == ogon) sched_yield();
+            volatile uint64_t wartosc = p->dane[ogon % POJEMNOSC_PIERSCIENIA];
+            (void)wartosc;
+            __atomic_store_n(&p->ogon, ogon + 1, __ATOMIC_RELEASE);
+        }
+    }
+}
+
+/// Koło czasowe (zegar.h): rozbrojenie i ponowne uzbrojenie terminu, gdy w kole czeka
+/// TERMINY_W_KOLE innych (0-60 s) - koszt nie zależy od liczby terminów
+static void akcja_pusta(void* arg) { (void)arg; }
+
+static void test_zegar(Kontekst* k, int nr) {
+    (void)nr;
+    static ZegarTimer terminy[TERMINY_W_KOLE];
+    if (zegar_uruchom() != 0) return;
+    for (int i = 0; i < TERMINY_W_KOLE; i++) {
+        zegar_uzbroj(&terminy[i], (uint64_t)(i % 600 + 1) * 100000000ULL, akcja_pusta, NULL);
+    }
+    for (long i = 0; i < k->iteracje; i++) {
+        ZegarTimer* t = &terminy[i % TERMINY_W_KOLE];
+        zegar_rozbroj(t);
+        zegar_uzbroj(t, (uint64_t)(i * 7919 % 60000 + 1) * 1000000ULL, akcja_pusta, NULL);
+    }
+    zegar_zatrzymaj();
+}
+
+/// Atomowy licznik - zamiennik liczników pod semaforem (np. osoby na trasie)
+static void test_atomik(Kontekst* k, int nr) {
+    (void)nr;
+    for (long i = 0; i < k->iteracje; i++) __atomic_fetch_add(&k->licznik, 1, __ATOMIC_SEQ_CST);
+}
+
+static const Test TESTY[] = {
+    { "msg_bilet_rtt",       "obecny",   TRYB_SERWER,      20, test_msg_serwer },
+    { "msg_proba_nowait_x2", "obecny",   TRYB_POJEDYNCZY,  1,  test_msg_proba },
+    { "semop_p_v",           "obecny",   TRYB_RYWALIZACJA, 1,  test_semop },
+    { "pthread_mutex_shm",   "obecny",   TRYB_RYWALIZACJA, 1,  test_pthread_mutex },
+    { "pthread_cond_rtt",    "obecny",   TRYB_PINGPONG,    20, test_pthread_cond },
+    { "kill_0",              "obecny",   TRYB_POJEDYNCZY,  1,  test_kill0 },
+    { "setitimer_x2",        "obecny",   TRYB_POJEDYNCZY,  1,  test_setitimer },
+    { "sygnal_rt_rtt",       "obecny",   TRYB_PINGPONG,    20, test_sygnal_rt },
+    { "futex_mutex",         "kandydat", TRYB_RYWALIZACJA, 1,  test_futex_mutex },
+    { "futex_rtt",           "kandydat", TRYB_PINGPONG,    20, test_futex_pingpong },
+    { "eventfd_rtt",         "kandydat", TRYB_PINGPONG,    20, test_eventfd },
+    { "pierscien_spsc",      "kandydat", TRYB_PINGPONG,    1,  test_pierscien },
+    { "atomik_fetch_add",    "kandydat", TRYB_RYWALIZACJA, 1,  test_atomik },
+    { "zegar_kolo_x2",       "kandydat", TRYB_POJEDYNCZY,  1,  test_zegar },
+};
+
+/// Świeży kontekst dla każdego przebiegu - żadnych resztek po poprzednim teście
+static int przygotuj(Kontekst* k) {
+    memset(k, 0, sizeof(*k));
+
+    pthread_mutexattr_t ma;
+    pthread_mutexattr_init(&ma);
+    pthread_mutexattr_setpshared(&ma, PTHREAD_PROCESS_SHARED);
+    pthread_mutex_init(&k->mutex, &ma);
+    pthread_mutexattr_destroy(&ma);
+
+    pthread_condattr_t ca;
+    pthread_condattr_init(&ca);
+    pthread_condattr_setpshared(&ca, PTHREAD_PROCESS_SHARED);
+    pthread_cond_init(&k->cond, &ca);
+    pthread_condattr_destroy(&ca);
+
+    k->semid = semget(IPC_PRIVATE, 1, IPC_CREAT | 0600);
+    k->msgid = msgget(IPC_PRIVATE, IPC_CREAT | 0600);
+    k->efd[0] = eventfd(0, 0);
+    k->efd[1] = eventfd(0, 0);
+    if (k->semid == -1 || k->msgid == -1 || k->efd[0] == -1 || k->efd[1] == -1) {
+        perror("przygotowanie IPC");
+        return -1;
+    }
+    semctl(k->semid, 0, SETVAL, 1);
+    return 0;
+}
+
+static void sprzatnij(Kontekst* k) {
+    pthread_mutex_destroy(&k->mutex);
+    pthread_cond_destroy(&k->cond);
+    if (k->semid != -1) semctl(k->semid, 0, IPC_RMID);
+    if (k->msgid != -1) msgctl(k->msgid, IPC_RMID, NULL);
+    if (k->efd[0] != -1) close(k->efd[0]);
+    if (k->efd[1] != -1) close(k->efd[1]);
+}
+
+/// Jeden przebieg: fork, bariera startu, pomiar czasu ściennego do zakończenia wszystkich
+/// uczestnicy = procesy robiące test (dla serwera: klienci), zwraca 0 gdy OK
+static int przebieg(const Test* t, Kontekst* k, int uczestnicy, long iteracje,
+    const struct utsname* host, long cpu, FILE* csv) {
+    if (przygotuj(k) != 0) return -1;
+    k->procesy = uczestnicy;
+    k->iteracje = iteracje;
+
+    int wszystkich = t->tryb == TRYB_SERWER ? uczestnicy + 1 : uczestnicy;
+    pid_t pidy[65];
+    for (int nr = 0; nr < wszystkich; nr++) {
+        pidy[nr] = fork();
+        if (pidy[nr] == -1) {
+            perror("fork");
+            for (int i = 0; i < nr; i++) kill(pidy[i], SIGKILL);
+            sprzatnij(k);
+            return -1;
+        }
+        if (pidy[nr] == 0) {
+            __atomic_fetch_add(&k->gotowi, 1, __ATOMIC_RELEASE);
+            while (!__atomic_load_n(&k->start, __ATOMIC_ACQUIRE)) sched_yield();
+            t->pracuj(k, nr);
+            _exit(0);
+        }
+        if (nr < 2) k->pidy[nr] = pidy[nr];
+    }
+
+    while (__atomic_load_n(&k->gotowi, __ATOMIC_ACQUIRE) < wszystkich) sched_yield();
+    uint64_t t0 = czas_monotoniczny_ns();
+    __atomic_store_n(&k->start, 1, __ATOMIC_RELEASE);
+    for (int nr = 0; nr < wszystkich; nr++) {
+        while (waitpid(pidy[nr], NULL, 0) == -1 && errno == EINTR) {
+        }
+    }
+    uint64_t czas_ns = czas_monotoniczny_ns() - t0;
+
+    long operacje = (t->tryb == TRYB_RYWALIZACJA || t->tryb == TRYB_SERWER) ? uczestnicy * iteracje : iteracje;
+    double ns_na_op = (double)czas_ns / (double)operacje;
+    int ma_opoznienia = k->opoznienia.liczba > 0;
+
+    printf("%-20s %-8s %3d %10ld %12.1f %14.0f", t->nazwa, t->rodzaj, uczestnicy, operacje,
+        ns_na_op, 1e9 / ns_na_op);
+    if (ma_opoznienia) {
+        printf(" %10llu %10llu", (unsigned long long)histogram_percentyl(&k->opoznienia, 50.0),
+            (unsigned long long)histogram_percentyl(&k->opoznienia, 99.0));
+    }
+    printf("\n");
+    fflush(stdout);
+
+    fprintf(csv, "%s,%s,%ld,%s,%s,%d,%ld,%.1f,%.0f,", host->nodename, host->release, cpu,
+        t->nazwa, t->rodzaj, uczestnicy, operacje, ns_na_op, 1e9 / ns_na_op);
+    if (ma_opoznienia) {
+        fprintf(csv, "%llu,%llu\n", (unsigned long long)histogram_percentyl(&k->opoznienia, 50.0),
+            (unsigned long long)histogram_percentyl(&k->opoznienia, 99.0));
+    }
+    else {
+        fprintf(csv, ",\n");
+    }
+
+    sprzatnij(k);
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    int max_procesow = DOMYSLNE_PROCESY;
+    int iteracje = DOMYSLNE_ITERACJE;
+    const char* plik = DOMYSLNY_PLIK;
+
+    if (argc > 4 ||
+        (argc > 1 && bezpieczny_strtol(argv[1], &max_procesow, 1, 64) != 0) ||
+        (argc > 2 && bezpieczny_strtol(argv[2], &iteracje, 1000, 100000000) != 0)) {
+        fprintf(stderr, "Uzycie: %s [max_procesow 1-64] [iteracje 1000-100000000] [plik.csv]\n", argv[0]);
+        return 1;
+    }
+    if (argc > 3) plik = argv[3];
+
+    /// Sygnały RT zablokowane przed fork - dzieci odbierają je tylko w sigsuspend
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = obsluga_sygnalu_rt;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGRTMIN, &sa, NULL);
+    sigset_t rt;
+    sigemptyset(&rt);
+    sigaddset(&rt, SIGRTMIN);
+    sigprocmask(SIG_BLOCK, &rt, NULL);
+
+    int shmid = shmget(IPC_PRIVATE, sizeof(Kontekst), IPC_CREAT | 0600);
+    if (shmid == -1) {
+        perror("shmget");
+        return 1;
+    }
+    Kontekst* k = (Kontekst*)shmat(shmid, NULL, 0);
+    shmctl(shmid, IPC_RMID, NULL);  /// Zniknie sam po odłączeniu ostatniego procesu
+    if (k == (void*)-1) {
+        perror("shmat");
+        return 1;
+    }
+
+    FILE* csv = fopen(plik, "a");
+    if (!csv) {
+        perror(plik);
+        return 1;
+    }
+    if (ftell(csv) == 0) {
+        fprintf(csv, "host,jadro,cpu,test,rodzaj,procesy,operacje,ns_na_op,ops_na_s,p50_ns,p99_ns\n");
+    }
+
+    struct utsname host;
+    uname(&host);
+    long cpu = sysconf(_SC_NPROCESSORS_ONLN);
+    printf("jaskinia-mikro: host=%s jadro=%s cpu=%ld max_procesow=%d iteracje=%d\n",
+        host.nodename, host.release, cpu, max_procesow, iteracje);
+    printf("%-20s %-8s %3s %10s %12s %14s %10s %10s\n", "test", "rodzaj", "n", "operacje",
+        "ns/op", "ops/s", "p50_ns", "p99_ns");
+
+    for (size_t i = 0; i < sizeof(TESTY) / sizeof(TESTY[0]); i++) {
+        const Test* t = &TESTY[i];
+        long n_iteracji = iteracje / t->dzielnik;
+        int od = t->tryb == TRYB_PINGPONG ? 2 : 1;
+        int do_ = (t->tryb == TRYB_RYWALIZACJA || t->tryb == TRYB_SERWER) ? max_procesow : od;
+
+        for (int n = od; n <= do_; n++) {
+            if (przebieg(t, k, n, n_iteracji, &host, cpu, csv) != 0) {
+                fclose(csv);
+                shmdt(k);
+                return 1;
+            }
+        }
+    }
+
+    fclose(csv);
+    shmdt(k);
+    printf("Wyniki dopisane do %s\n", plik);
+    return 0;
+}
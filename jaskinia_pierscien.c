@@ -0,0 +1,135 @@
+#include "common.h"
+#include "common_helpers.h"
+#include "pierscien.h"
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+/// jaskinia-pierscien - sprawdzenie pierścieni kolejek do przewodników (pierscien.h)
+/// Pierścienie w anonimowym mmap współdzielonym z dziećmi - bez kluczy IPC, nie koliduje
+/// z działającą symulacją. Najważniejszy przypadek: producent zabity SIGKILL między zajęciem
+/// slotu a publikacją nie może zatrzymać kolejki przewodnika.
+/// Raport na stdout; kod wyjścia 0 = OK, 1 = błąd uruchomienia, 2 = naruszenie
+
+static int ok = 1;
+
+#define SPRAWDZ(warunek, opis) \
+    do { \
+        int _w = (warunek); \
+        printf("[%s] %s\n", _w ? " OK " : "BLAD", opis); \
+        ok &= _w; \
+    } while (0)
+
+static WiadomoscPrzewodnik wiadomosc(pid_t pid) {
+    WiadomoscPrzewodnik w;
+    memset(&w, 0, sizeof(w));
+    w.mtype = TYP_MSG_ZWIEDZAJACY;
+    w.pid_zwiedzajacego = pid;
+    w.czas_dolaczenia_ns = czas_monotoniczny_ns();
+    return w;
+}
+
+/// Dziecko zajmuje slot i staje przed publikacją - zwraca jego PID (-1 = błąd)
+static pid_t producent_w_polowie(Pierscien* p) {
+    int rura[2];
+    if (pipe(rura) == -1) return -1;
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(rura[0]);
+        uint32_t poz;
+        char zajal = pierscien_zajmij(p, &poz) == 0;
+        if (write(rura[1], &zajal, 1) != 1) _exit(1);
+        for (;;) pause();  /// Wiadomość nigdy nie zostanie opublikowana
+    }
+    close(rura[1]);
+    char zajal = 0;
+    if (pid == -1 || read(rura[0], &zajal, 1) != 1 || !zajal) {
+        if (pid > 0) kill(pid, SIGKILL);
+        pid = -1;
+    }
+    close(rura[0]);
+    return pid;
+}
+
+static void zabij(pid_t pid) {
+    kill(pid, SIGKILL);
+    waitpid(pid, NULL, 0);  /// Zombie wciąż odpowiada na kill(pid, 0)
+}
+
+int main(void) {
+    ShmPierscienie* s = mmap(NULL, sizeof(ShmPierscienie), PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (s == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    pierscienie_inicjalizuj(s);
+    KolejkaTrasy* k = &s->trasy[0];
+    Pierscien* p = &k->pasy[PAS_ZWYKLY];
+    WiadomoscPrzewodnik bufor[PIERSCIEN_SLOTY];
+
+    /// Pełne okrążenie: pojemność, pełny pierścień, kolejność po przewinięciu
+    for (int okrazenie = 0; okrazenie < 2; okrazenie++) {
+        int wstawione = 0;
+        while (wstawione < PIERSCIEN_SLOTY + 1) {
+            WiadomoscPrzewodnik w = wiadomosc(1000 + wstawione);
+            if (pierscien_wstaw(p, &w) != 0) break;
+            wstawione++;
+        }
+        int pelny = wstawione == PIERSCIEN_SLOTY && errno == EAGAIN;
+        int zdjete = pierscien_zdejmij(p, bufor, PIERSCIEN_SLOTY);
+        int kolejnosc = zdjete == PIERSCIEN_SLOTY;
+        for (int i = 0; kolejnosc && i < zdjete; i++) kolejnosc = bufor[i].pid_zwiedzajacego == 1000 + i;
+        SPRAWDZ(pelny, okrazenie == 0 ? "pelny pierscien odrzuca wstawienie (EAGAIN)" :
+            "pelny pierscien po przewinieciu odrzuca wstawienie");
+        SPRAWDZ(kolejnosc, okrazenie == 0 ? "partia zdjeta w kolejnosci wstawienia" :
+            "kolejnosc zachowana po przewinieciu pozycji");
+    }
+
+    /// Producent zabity między zajęciem slotu a publikacją
+    pid_t martwy = producent_w_polowie(p);
+    if (martwy == -1) {
+        fprintf(stderr, "Nie mozna uruchomic producenta: %s\n", strerror(errno));
+        return 1;
+    }
+    WiadomoscPrzewodnik za_nim = wiadomosc(2001);
+    SPRAWDZ(kolejka_wstaw(k, &za_nim) == 0, "wstawienie za zajetym slotem");
+    SPRAWDZ(pierscien_gotowe(p, 2) == 0, "zywy producent wstrzymuje czolo");
+    zabij(martwy);
+    int gotowe = pierscien_gotowe(p, 2);
+    int zdjete = pierscien_zdejmij(p, bufor, gotowe);
+    SPRAWDZ(zdjete == 1 && bufor[0].pid_zwiedzajacego == 2001 && p->porzucone == 1,
+        "slot martwego producenta pominiety, nastepna wiadomosc zdjeta");
+
+    /// Śmierć przed przesunięciem ogona - ogon cofnięty na zajęty slot, jak gdyby nikt go nie przesunął
+    martwy = producent_w_polowie(p);
+    if (martwy == -1) {
+        fprintf(stderr, "Nie mozna uruchomic producenta: %s\n", strerror(errno));
+        return 1;
+    }
+    zabij(martwy);
+    __atomic_sub_fetch(&p->ogon, 1, __ATOMIC_SEQ_CST);
+    WiadomoscPrzewodnik po_nim = wiadomosc(2002);
+    int wstawiono = pierscien_wstaw(p, &po_nim) == 0;
+    gotowe = pierscien_gotowe(p, 2);
+    zdjete = pierscien_zdejmij(p, bufor, gotowe);
+    SPRAWDZ(wstawiono && zdjete == 1 && bufor[0].pid_zwiedzajacego == 2002 && p->porzucone == 2,
+        "producent przesuwa ogon za zajety slot martwego");
+
+    /// Martwy jako jedyny i ostatni - przewodnik sam przesuwa ogon, kolejni producenci nie stoją
+    martwy = producent_w_polowie(p);
+    if (martwy == -1) {
+        fprintf(stderr, "Nie mozna uruchomic producenta: %s\n", strerror(errno));
+        return 1;
+    }
+    zabij(martwy);
+    __atomic_sub_fetch(&p->ogon, 1, __ATOMIC_SEQ_CST);
+    gotowe = pierscien_gotowe(p, 1);
+    WiadomoscPrzewodnik ostatnia = wiadomosc(2003);
+    wstawiono = pierscien_wstaw(p, &ostatnia) == 0;
+    zdjete = pierscien_zdejmij(p, bufor, pierscien_gotowe(p, 1));
+    SPRAWDZ(gotowe == 0 && wstawiono && zdjete == 1 && bufor[0].pid_zwiedzajacego == 2003 && p->porzucone == 3,
+        "pominiecie na pustym pierscieniu nie blokuje kolejnych wstawien");
+
+    munmap(s, sizeof(ShmPierscienie));
+    return ok ? 0 : 2;
+}
@@ -0,0 +1,842 @@
+#include "common.h"
+#include "common_helpers.h"
+#include "przewodnik_helpers.h"
+#include "regulamin.h"
+#include "pary.h"
+#include "pula.h"
+
+/// jaskinia-pula - cała symulacja w jednym procesie, do testów obciążeniowych bez granicy procesów
+/// Strażnik, kasjer, przewodnicy tras, generator i zwiedzający to aktorzy na puli wątków
+/// z kradzieżą zadań (pula.h). Zamiast kolejek SysV - kanały w pamięci, zamiast sygnałów -
+/// bity w słowie aktora, zamiast semaforów tras i kładek - stan w aktorach przewodników.
+/// Regulamin kasy (regulamin.h), skład grup z parami (przewodnik_helpers.h), rejestr par (pary.h)
+/// i okno zbierania to ten sam kod co w procesach ról - wyniki są porównywalne.
+///
+/// Parametry (zmienne środowiskowe):
+///   JASKINIA_PULA_WATKI=n           wątki puli (domyślnie liczba rdzeni)
+///   JASKINIA_PULA_ZWIEDZAJACY=100000  ilu zwiedzających wygenerować
+///   JASKINIA_PULA_ZYWI=20000        limit jednocześnie obecnych (sloty w pamięci)
+///   JASKINIA_PULA_PRZYSPIESZENIE=0  sekund symulacji na sekundę rzeczywistą; 0 = bez czekania
+///                                   (wycieczki, kładki i okna zbierania trwają 0, bez timeoutów)
+///   JASKINIA_PULA_LIMIT_S=600       po tylu sekundach przebieg jest przerywany jako zawieszony
+///   JASKINIA_CEL_ZBIERANIA          jak w przewodniku (przy przyspieszeniu > 0)
+/// Raport na stdout; kod wyjścia 0 = niezmienniki OK, 1 = błąd uruchomienia, 2 = naruszenie
+
+ShmMetryki* globalne_metryki = NULL;
+
+/// Konfiguracja przebiegu
+static int cel_zwiedzajacych;
+static int limit_zywych;
+static double przyspieszenie;
+
+/// Sygnały zwiedzającego - odpowiedniki flag procesu zwiedzajacy
+#define Z_START (1U << 0)
+#define Z_ODPOWIEDZ (1U << 1)    /// Odpowiedź kasjera w decyzja/trasa
+#define Z_ODWOLANO (1U << 2)     /// SIGUSR1
+#define Z_W_GRUPIE (1U << 3)     /// SIGRTMIN+0
+#define Z_NA_KLADCE (1U << 4)    /// SIGRTMIN+1
+#define Z_ZWIEDZAM (1U << 5)     /// SIGRTMIN+2
+#define Z_MOZE_WYJSC (1U << 6)   /// SIGUSR2
+#define Z_TERMIN_BILET (1U << 7)    /// SIGALRM przy kasie
+#define Z_TERMIN_KOLEJKA (1U << 8)  /// SIGALRM w kolejce - osobny bit, bo spóźniony termin kasy
+                                    /// może przyjść już po przejściu do kolejki
+
+/// Kto trzyma zwiedzającego - przejścia CAS rozstrzygają wyścig termin <-> odbiór z kanału
+enum {
+    POBYT_KASA = 0,      /// W kanale kasjera
+    POBYT_KASJER,        /// Kasjer go obsłużył
+    POBYT_KOLEJKA,       /// W kanale przewodnika
+    POBYT_PRZEWODNIK,    /// Przewodnik go odebrał - bez timeoutu kolejki
+    POBYT_WYCOFANY       /// Termin minął w kanale - zwalnia go ten, kto go z kanału wyjmie
+};
+
+/// Stany maszyny zwiedzającego - jak kroki zwiedzajacy.c
+enum { ZS_START = 0, ZS_BILET, ZS_KOLEJKA, ZS_GRUPA, ZS_KLADKA, ZS_TRASA };
+
+typedef struct Zwiedzajacy {
+    Aktor aktor;
+    struct Zwiedzajacy* nastepny;   /// Łącze kanału - zwiedzający jest w jednym kanale naraz
+    int id;                         /// "PID" w protokole (pary, grupa[]) - indeks slotu + 1
+    int etap;                       /// POBYT_* (atomowo)
+    int stan;
+    uint32_t flagi;                 /// Zebrane sygnały - jak volatile sig_atomic_t w procesie
+    int wiek, powtorna, poprz_trasa, czy_opiekun, id_pary, pid_opiekuna;
+    int wroci;                      /// Losuje generator - po wycieczce raz wraca do kasy (powtorna)
+    int decyzja, trasa;             /// Pisze kasjer przed Z_ODPOWIEDZ
+    uint64_t czas_dolaczenia_ns;    /// Czas symulacji - dla okna zbierania
+    PulaTermin termin;
+} Zwiedzajacy;
+
+/// Kanał FIFO zwiedzających - zamiast kolejki komunikatów
+typedef struct {
+    pthread_mutex_t mutex;
+    Zwiedzajacy* glowa;
+    Zwiedzajacy* ogon;
+} Kanal;
+
+static inline void kanal_wloz(Kanal* k, Zwiedzajacy* z) {
+    z->nastepny = NULL;
+    pthread_mutex_lock(&k->mutex);
+    if (k->ogon) k->ogon->nastepny = z;
+    else k->glowa = z;
+    k->ogon = z;
+    pthread_mutex_unlock(&k->mutex);
+}
+
+static inline Zwiedzajacy* kanal_wez(Kanal* k) {
+    pthread_mutex_lock(&k->mutex);
+    Zwiedzajacy* z = k->glowa;
+    if (z) {
+        k->glowa = z->nastepny;
+        if (!k->glowa) k->ogon = NULL;
+    }
+    pthread_mutex_unlock(&k->mutex);
+    return z;
+}
+
+/// Sloty zwiedzających - stała tablica, wolne indeksy na stosie pod mutexem
+static Zwiedzajacy* sloty;
+static int* wolne_sloty;
+static int liczba_wolnych;
+static pthread_mutex_t mutex_slotow = PTHREAD_MUTEX_INITIALIZER;
+
+static ShmPary* pary;  /// Rejestr par w pamięci procesu
+
+/// Liczniki wyników (atomowo)
+static struct {
+    uint64_t wygenerowano;
+    uint64_t zakonczyli;
+    uint64_t powroty;     /// Wizyty powtórne w tym samym slocie - wizyt = wygenerowano + powroty
+    uint64_t odrzuceni;
+    uint64_t anulowani;
+    uint64_t timeouty;
+    int zywi;
+} wyniki;
+
+/// --- Aktorzy ---
+
+#define K_ZADANIE (1U << 0)
+#define KASJER_PACZKA 256  /// Tyle zadań na krok - potem ustępujemy innym aktorom
+
+typedef struct {
+    Aktor aktor;
+    Kanal powtorne;     /// TYP_MSG_POWTORNA - obsługiwane najpierw
+    Kanal zwykle;
+    unsigned ziarno;
+    uint64_t decyzje[1 + LICZBA_TRAS];
+    uint64_t reguly[REGULA_DOROSLY + 1];
+} Kasjer;
+
+#define P_PRZYBYL (1U << 0)     /// Coś w kanale
+#define P_TERMIN (1U << 1)      /// Koniec okna zbierania
+#define P_CZAS (1U << 2)        /// Koniec przejścia kładkami lub wycieczki
+#define P_KLADKI (1U << 3)      /// Kładki przydzielone
+#define P_ZAMKNIECIE (1U << 4)  /// SIGUSR1/SIGUSR2 od strażnika
+
+enum { PS_ZBIERANIE = 0, PS_KLADKI_WEJSCIE, PS_WEJSCIE, PS_TRASA, PS_KLADKI_WYJSCIE, PS_WYJSCIE, PS_ZAMKNIETY };
+
+typedef struct {
+    Aktor aktor;
+    int numer;
+    int max_osoby;
+    int czas_s;                 /// Ti z TABELA_TRAS
+    unsigned maska_kladek;      /// Kładki trasy
+    int liczba_kladek;
+    Kanal kanal;
+    int stan;
+    uint32_t flagi;
+
+    pid_t grupa[MAX_POJEMNOSC_TRASY];
+    WiadomoscPrzewodnik czlonkowie[MAX_POJEMNOSC_TRASY];
+    uint64_t odebrano_ns[MAX_POJEMNOSC_TRASY];
+    SkladGrupy sklad;
+    int liczba;                 /// Grupa na trasie
+    int zbiera;                 /// Zbieranie w toku
+    int czeka_na_kladki;
+    uint64_t pierwszy_ns;       /// Czas symulacji pierwszego członka (0 = nikt)
+    double okno_s;
+    OknoZbierania okno;
+    PulaTermin termin;
+
+    uint64_t grupy, zwiedzajacych, suma_okien_ms;
+    int max_grupa;
+    uint64_t rozdzielone_pary;  /// Członek pary w grupie bez obecnego partnera - nie powinno się zdarzać
+} Przewodnik;
+
+#define G_DALEJ (1U << 0)
+#define G_MIEJSCE (1U << 1)     /// Zwolnił się slot lub wpis pary
+#define GENERATOR_PACZKA 64
+
+typedef struct {
+    Aktor aktor;
+    unsigned ziarno;
+    int czeka;                  /// Czeka na G_MIEJSCE (atomowo)
+    int skonczyl;
+} Generator;
+
+#define S_START (1U << 0)
+#define S_SPRAWDZ (1U << 1)     /// Generator skończył lub wyszedł ostatni zwiedzający
+#define S_PRZEWODNIK (1U << 2)  /// Przewodnik zamknął trasę
+
+typedef struct {
+    Aktor aktor;
+    int otwarta;
+    int zamknieci;              /// Przewodnicy po zamknięciu (atomowo) - bity S_PRZEWODNIK kilku
+                                /// mogą się zlać w jeden krok, więc liczą sami przewodnicy
+} Straznik;
+
+/// Kładki z TABELA_KLADEK - jak mutexy kładek w shm, przewodnik bierze wszystkie kładki swojej trasy
+static struct {
+    pthread_mutex_t mutex;
+    int wlasciciel[LICZBA_KLADEK];  /// 0 wolna, inaczej numer przewodnika
+    unsigned czekajacy;             /// Bit (numer - 1) - przewodnik czeka na swoje kładki
+    uint64_t przejscia;
+} kladki = { .mutex = PTHREAD_MUTEX_INITIALIZER };
+
+static Kasjer kasjer;
+static Przewodnik przewodnicy[LICZBA_TRAS];
+static Generator generator;
+static Straznik straznik;
+static uint64_t czas_konca_ns;  /// Zamknięcie przez strażnika - main budzi się co 100 ms
+
+/// Czas w symulacji - przy przyspieszeniu 0 stoi, okna i terminy nie działają
+static inline uint64_t czas_symulacji_ns(void) {
+    return (uint64_t)((double)czas_monotoniczny_ns() * przyspieszenie);
+}
+
+/// Odczekaj czas symulacji ms - termin na kole albo od razu (przyspieszenie 0)
+static inline void odczekaj(Aktor* a, PulaTermin* t, uint32_t bit, uint64_t ms) {
+    if (przyspieszenie <= 0.0 || ms == 0) {
+        pula_wyslij(a, bit);
+        return;
+    }
+    pula_termin(t, a, bit, (uint64_t)((double)ms * 1e6 / przyspieszenie));
+}
+
+/// --- Zwiedzający ---
+
+static void zwolnij_slot(Zwiedzajacy* z) {
+    int indeks = z->id - 1;
+    pthread_mutex_lock(&mutex_slotow);
+    wolne_sloty[liczba_wolnych++] = indeks;
+    pthread_mutex_unlock(&mutex_slotow);
+
+    int zostalo = __atomic_sub_fetch(&wyniki.zywi, 1, __ATOMIC_ACQ_REL);
+    if (__atomic_exchange_n(&generator.czeka, 0, __ATOMIC_SEQ_CST)) pula_wyslij(&generator.aktor, G_MIEJSCE);
+    if (zostalo == 0) pula_wyslij(&straznik.aktor, S_SPRAWDZ);
+}
+
+/// Zwiedzający kończy (wyszedł, odrzucony, odwołany) - nikt go już nie trzyma
+static int zwiedzajacy_koniec(Zwiedzajacy* z, uint64_t* licznik) {
+    zegar_rozbroj(&z->termin.timer);
+    __atomic_add_fetch(licznik, 1, __ATOMIC_RELAXED);
+    para_opusc(pary, z->id_pary, z->czy_opiekun ? PARA_OPIEKUN : PARA_DZIECKO);
+    zwolnij_slot(z);
+    return PULA_KONIEC;
+}
+
+/// Termin minął w kanale - wycofanie; od udanego CAS zwiedzającego zwolni właściciel kanału
+static int zwiedzajacy_wycofaj(Zwiedzajacy* z, int etap, uint32_t bit_terminu) {
+    int id_pary = z->id_pary;
+    int bit = z->czy_opiekun ? PARA_OPIEKUN : PARA_DZIECKO;
+    if (!__atomic_compare_exchange_n(&z->etap, &etap, POBYT_WYCOFANY, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        z->flagi &= ~bit_terminu;  /// Już odebrany - termin nieaktualny
+        return PULA_DALEJ;
+    }
+    __atomic_add_fetch(&wyniki.timeouty, 1, __ATOMIC_RELAXED);
+    para_opusc(pary, id_pary, bit);
+    return PULA_KONIEC;
+}
+
+static int zwiedzajacy_krok(Aktor* a, uint32_t sygnaly) {
+    Zwiedzajacy* z = (Zwiedzajacy*)a;
+    z->flagi |= sygnaly;
+
+    for (;;) {
+        switch (z->stan) {
+        case ZS_START:  /// KROK 1: prośba o bilet
+            z->stan = ZS_BILET;
+            __atomic_store_n(&z->etap, POBYT_KASA, __ATOMIC_RELAXED);
+            if (przyspieszenie > 0.0) odczekaj(&z->aktor, &z->termin, Z_TERMIN_BILET, TIMEOUT_ODPOWIEDZ_BILET * 1000ULL);
+            kanal_wloz(z->powtorna ? &kasjer.powtorne : &kasjer.zwykle, z);
+            pula_wyslij(&kasjer.aktor, K_ZADANIE);
+            return PULA_DALEJ;
+
+        case ZS_BILET:  /// KROK 2: odpowiedź kasjera
+            if (z->flagi & Z_ODPOWIEDZ) {
+                zegar_rozbroj(&z->termin.timer);
+                if (z->decyzja == DECYZJA_ODRZUCONY) return zwiedzajacy_koniec(z, &wyniki.odrzuceni);
+
+                /// KROK 3: kolejka przewodnika
+                Przewodnik* p = &przewodnicy[z->trasa - 1];
+                z->stan = ZS_KOLEJKA;
+                z->czas_dolaczenia_ns = czas_symulacji_ns();
+                __atomic_store_n(&z->etap, POBYT_KOLEJKA, __ATOMIC_RELAXED);
+                if (przyspieszenie > 0.0) odczekaj(&z->aktor, &z->termin, Z_TERMIN_KOLEJKA, MAX_CZAS_W_KOLEJCE * 1000ULL);
+                kanal_wloz(&p->kanal, z);
+                pula_wyslij(&p->aktor, P_PRZYBYL);
+                return PULA_DALEJ;
+            }
+            if (z->flagi & Z_TERMIN_BILET) return zwiedzajacy_wycofaj(z, POBYT_KASA, Z_TERMIN_BILET);
+            return PULA_DALEJ;
+
+        case ZS_KOLEJKA:  /// STAN 1: czekam na zebranie grupy
+            if (z->flagi & Z_W_GRUPIE) {
+                zegar_rozbroj(&z->termin.timer);
+                z->stan = ZS_GRUPA;
+                continue;
+            }
+            if (z->flagi & Z_ODWOLANO) return zwiedzajacy_koniec(z, &wyniki.anulowani);
+            if (z->flagi & Z_TERMIN_KOLEJKA) return zwiedzajacy_wycofaj(z, POBYT_KOLEJKA, Z_TERMIN_KOLEJKA);
+            return PULA_DALEJ;
+
+        case ZS_GRUPA:  /// STAN 2: czekam na kładkę
+        case ZS_KLADKA:  /// STAN 3: czekam na start zwiedzania
+        case ZS_TRASA:  /// STAN 4: zwiedzam
+            if (z->flagi & Z_ODWOLANO) return zwiedzajacy_koniec(z, &wyniki.anulowani);
+            if ((z->flagi & Z_MOZE_WYJSC) && z->wroci) {
+                /// Powrót tego samego dnia na inną trasę - ten sam slot i aktor, kolejka powtórnych
+                zegar_rozbroj(&z->termin.timer);
+                __atomic_add_fetch(&wyniki.zakonczyli, 1, __ATOMIC_RELAXED);
+                __atomic_add_fetch(&wyniki.powroty, 1, __ATOMIC_RELAXED);
+                z->wroci = 0;
+                z->powtorna = 1;
+                z->poprz_trasa = z->trasa;
+                z->flagi = 0;
+                z->stan = ZS_START;
+                continue;
+            }
+            if (z->flagi & Z_MOZE_WYJSC) return zwiedzajacy_koniec(z, &wyniki.zakonczyli);
+            if (z->stan == ZS_GRUPA && (z->flagi & Z_NA_KLADCE)) {
+                z->stan = ZS_KLADKA;
+                continue;
+            }
+            if (z->stan == ZS_KLADKA && (z->flagi & Z_ZWIEDZAM)) {
+                z->stan = ZS_TRASA;
+                continue;
+            }
+            return PULA_DALEJ;
+        }
+        return PULA_DALEJ;
+    }
+}
+
+/// --- Kasjer ---
+
+static int kasjer_krok(Aktor* a, uint32_t sygnaly) {
+    (void)a;
+    (void)sygnaly;
+    for (int n = 0; n < KASJER_PACZKA; n++) {
+        Zwiedzajacy* z = kanal_wez(&kasjer.powtorne);  /// PRIORYTET 1: powtórne wizyty
+        if (!z) z = kanal_wez(&kasjer.zwykle);
+        if (!z) return PULA_DALEJ;
+
+        int etap = POBYT_KASA;
+        if (!__atomic_compare_exchange_n(&z->etap, &etap, POBYT_KASJER, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            zwolnij_slot(z);  /// Wycofał się czekając na bilet
+            continue;
+        }
+
+        WiadomoscKasjer zadanie = {
+            .mtype = z->powtorna ? TYP_MSG_POWTORNA : TYP_MSG_ZADANIE,
+            .pid_zwiedzajacego = z->id, .wiek = z->wiek, .powtorna_wizyta = z->powtorna,
+            .poprzednia_trasa = z->poprz_trasa, .pid_opiekuna = z->pid_opiekuna,
+            .czy_opiekun = z->czy_opiekun, .id_pary = z->id_pary
+        };
+        int trasa, regula;
+        z->decyzja = regulamin_decyzja(&zadanie, pary, (unsigned)rand_r(&kasjer.ziarno), &trasa, &regula);
+        z->trasa = trasa;
+        kasjer.decyzje[z->decyzja]++;
+        kasjer.reguly[regula]++;
+        pula_wyslij(&z->aktor, Z_ODPOWIEDZ);
+    }
+    pula_wyslij(&kasjer.aktor, K_ZADANIE);  /// Reszta w następnym kroku
+    return PULA_DALEJ;
+}
+
+/// --- Kładki ---
+
+/// Wszystkie kładki z maski naraz albo żadna - pod kladki.mutex, więc bez zakleszczeń
+static int kladki_wolne(unsigned maska) {
+    for (int i = 0; i < LICZBA_KLADEK; i++) {
+        if ((maska & (1U << i)) && kladki.wlasciciel[i] != 0) return 0;
+    }
+    return 1;
+}
+
+static void kladki_przypisz(unsigned maska, int numer) {
+    for (int i = 0; i < LICZBA_KLADEK; i++) {
+        if (maska & (1U << i)) kladki.wlasciciel[i] = numer;
+    }
+}
+
+static int kladki_zajmij(const Przewodnik* p) {
+    pthread_mutex_lock(&kladki.mutex);
+    int mam = kladki_wolne(p->maska_kladek);
+    if (mam) kladki_przypisz(p->maska_kladek, p->numer);
+    else kladki.czekajacy |= 1U << (p->numer - 1);
+    pthread_mutex_unlock(&kladki.mutex);
+    return mam;
+}
+
+/// Zwolnione kładki dostają czekający, którym teraz wystarczą - od następnego po zwalniającym
+static void kladki_zwolnij(const Przewodnik* p) {
+    unsigned obudzeni = 0;
+    pthread_mutex_lock(&kladki.mutex);
+    kladki.przejscia += (uint64_t)p->liczba;
+    kladki_przypisz(p->maska_kladek, 0);
+    for (int n = 0; n < LICZBA_TRAS; n++) {
+        int t = (p->numer + n) % LICZBA_TRAS;
+        const Przewodnik* c = &przewodnicy[t];
+        if ((kladki.czekajacy & (1U << t)) && kladki_wolne(c->maska_kladek)) {
+            kladki_przypisz(c->maska_kladek, c->numer);
+            kladki.czekajacy &= ~(1U << t);
+            obudzeni |= 1U << t;
+        }
+    }
+    pthread_mutex_unlock(&kladki.mutex);
+    for (int t = 0; t < LICZBA_TRAS; t++) {
+        if (obudzeni & (1U << t)) pula_wyslij(&przewodnicy[t].aktor, P_KLADKI);
+    }
+}
+
+/// Grupa dzielona między kładki jak w przewodniku - przejście trwa tyle, co najdłuższa kolejka
+static uint64_t czas_przejscia_ms(const Przewodnik* p) {
+    int na_kladke[MAX_KLADEK];
+    podziel_na_kladki(p->czlonkowie, p->liczba, p->liczba_kladek, na_kladke);
+    int najwiecej = 0;
+    for (int j = 0; j < p->liczba_kladek; j++) {
+        if (na_kladke[j] > najwiecej) najwiecej = na_kladke[j];
+    }
+    return (uint64_t)najwiecej * CZAS_PRZECHODZENIA_KLADKA;
+}
+
+/// --- Przewodnik ---
+
+static inline Zwiedzajacy* zwiedzajacy_o_id(pid_t id) {
+    return &sloty[id - 1];
+}
+
+static void wyslij_do_grupy(Przewodnik* p, uint32_t sygnal) {
+    for (int i = 0; i < p->liczba; i++) pula_wyslij(&zwiedzajacy_o_id(p->grupa[i])->aktor, sygnal);
+}
+
+static void odwolaj(const WiadomoscPrzewodnik* w, int liczba) {
+    for (int i = 0; i < liczba; i++) pula_wyslij(&zwiedzajacy_o_id(w[i].pid_zwiedzajacego)->aktor, Z_ODWOLANO);
+}
+
+/// Odbiór z kanału - jak msgrcv; wycofanych zwalniamy
+static int przewodnik_odbierz(Przewodnik* p, WiadomoscPrzewodnik* w) {
+    Zwiedzajacy* z;
+    while ((z = kanal_wez(&p->kanal)) != NULL) {
+        int etap = POBYT_KOLEJKA;
+        if (!__atomic_compare_exchange_n(&z->etap, &etap, POBYT_PRZEWODNIK, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            zwolnij_slot(z);
+            continue;
+        }
+        w->mtype = TYP_MSG_ZWIEDZAJACY;
+        w->pid_zwiedzajacego = z->id;
+        w->wiek = z->wiek;
+        w->id_pary = z->id_pary;
+        w->czas_dolaczenia_ns = z->czas_dolaczenia_ns;
+        return 1;
+    }
+    return 0;
+}
+
+static void przewodnik_zamknij(Przewodnik* p) {
+    WiadomoscPrzewodnik w;
+    while (przewodnik_odbierz(p, &w)) odwolaj(&w, 1);
+    odwolaj(p->czlonkowie, p->sklad.liczba);
+    odwolaj(p->sklad.odlozeni, p->sklad.liczba_odlozonych);
+    p->sklad.liczba = p->sklad.liczba_odlozonych = 0;
+    zegar_rozbroj(&p->termin.timer);
+    p->stan = PS_ZAMKNIETY;
+    __atomic_add_fetch(&straznik.zamknieci, 1, __ATOMIC_ACQ_REL);
+    pula_wyslij(&straznik.aktor, S_PRZEWODNIK);
+}
+
+/// Zbieranie grupy - 1 gdy grupa gotowa do wyjścia
+static int przewodnik_zbieraj(Przewodnik* p) {
+    SkladGrupy* g = &p->sklad;
+    int czekamy = przyspieszenie > 0.0;
+
+    if (!p->zbiera) {
+        grupa_zacznij(g, p->max_osoby);  /// Trasa pusta między grupami - cała pojemność
+        p->zbiera = 1;
+        p->flagi &= ~P_TERMIN;
+        p->pierwszy_ns = g->liczba > 0 ? czas_symulacji_ns() : 0;
+        p->okno_s = -1.0;
+        if (czekamy) {
+            p->okno_s = p->pierwszy_ns ? okno_wybierz(&p->okno, g->liczba + g->zarezerwowane, g->max) : p->okno.okno_max_s;
+            odczekaj(&p->aktor, &p->termin, P_TERMIN, (uint64_t)(p->okno_s * 1000.0));
+        }
+    }
+
+    int pelna = 0;
+    WiadomoscPrzewodnik w;
+    while (grupa_miejsca(g) > 0 && przewodnik_odbierz(p, &w)) {
+        okno_przybycie(&p->okno, w.czas_dolaczenia_ns);
+        if (grupa_przyjmij(g, &w)) {
+            pelna = 1;
+            break;
+        }
+        if (!czekamy) continue;
+        uint64_t teraz = czas_symulacji_ns();
+        if (p->pierwszy_ns == 0) p->pierwszy_ns = teraz;
+        p->okno_s = okno_wybierz(&p->okno, g->liczba + g->zarezerwowane, g->max);
+        double zostalo = p->okno_s - (double)(teraz - p->pierwszy_ns) / 1e9;
+        if (zostalo <= 0.0) {
+            pelna = 1;
+            break;
+        }
+        odczekaj(&p->aktor, &p->termin, P_TERMIN, (uint64_t)(zostalo * 1000.0) + 1);
+    }
+
+    int koniec = pelna || grupa_miejsca(g) <= 0 || (p->flagi & P_TERMIN) || (!czekamy && g->liczba > 0);
+    if (!koniec) return 0;
+
+    zegar_rozbroj(&p->termin.timer);
+    p->flagi &= ~P_TERMIN;
+    p->zbiera = 0;
+    grupa_zakoncz(g);
+    if (g->liczba == 0) {  /// Wszyscy odłożeni - czekają na partnerów dalej w kanale
+        if (czekamy) return przewodnik_zbieraj(p);  /// Nowe okno dla pustej grupy
+        if (__atomic_load_n(&p->kanal.glowa, __ATOMIC_ACQUIRE)) pula_wyslij(&p->aktor, P_PRZYBYL);
+        return 0;
+    }
+    p->suma_okien_ms += p->okno_s > 0.0 ? (uint64_t)(p->okno_s * 1000.0) : 0;
+    return 1;
+}
+
+static int przewodnik_krok(Aktor* a, uint32_t sygnaly) {
+    Przewodnik* p = (Przewodnik*)a;
+    p->flagi |= sygnaly;
+
+    for (;;) {
+        switch (p->stan) {
+        case PS_ZBIERANIE:
+            if (p->flagi & P_ZAMKNIECIE) {
+                przewodnik_zamknij(p);
+                return PULA_DALEJ;
+            }
+            if (!przewodnik_zbieraj(p)) return PULA_DALEJ;
+
+            p->liczba = p->sklad.liczba;
+            for (int i = 0; i < p->liczba; i++) {
+                const WiadomoscPrzewodnik* w = &p->czlonkowie[i];
+                if (w->id_pary == BRAK_PARY) continue;
+                if ((i > 0 && p->czlonkowie[i - 1].id_pary == w->id_pary) ||
+                    (i + 1 < p->liczba && p->czlonkowie[i + 1].id_pary == w->id_pary)) continue;
+                int bit_partnera = PARA_PARTNER(para_bit_czlonka(pary, w->id_pary, w->pid_zwiedzajacego));
+                if (!para_obecny(pary, w->id_pary, bit_partnera)) continue;
+                p->rozdzielone_pary++;
+            }
+            if (p->liczba > p->max_grupa) p->max_grupa = p->liczba;
+            wyslij_do_grupy(p, Z_W_GRUPIE);
+            p->stan = PS_KLADKI_WEJSCIE;
+            continue;
+
+        case PS_KLADKI_WEJSCIE:
+        case PS_KLADKI_WYJSCIE:
+            if (!p->czeka_na_kladki) {
+                if (!kladki_zajmij(p)) {
+                    p->czeka_na_kladki = 1;
+                    return PULA_DALEJ;
+                }
+            }
+            else {
+                if (!(p->flagi & P_KLADKI)) return PULA_DALEJ;
+                p->flagi &= ~P_KLADKI;
+                p->czeka_na_kladki = 0;
+            }
+            if (p->stan == PS_KLADKI_WEJSCIE) {
+                wyslij_do_grupy(p, Z_NA_KLADCE);
+                p->stan = PS_WEJSCIE;
+            }
+            else {
+                p->stan = PS_WYJSCIE;
+            }
+            /// Każdy idzie pojedynczo CZAS_PRZECHODZENIA_KLADKA - jak przeprowadz_przez_kladke
+            odczekaj(&p->aktor, &p->termin, P_CZAS, czas_przejscia_ms(p));
+            return PULA_DALEJ;
+
+        case PS_WEJSCIE:
+            if (!(p->flagi & P_CZAS)) return PULA_DALEJ;
+            p->flagi &= ~P_CZAS;
+            kladki_zwolnij(p);
+            wyslij_do_grupy(p, Z_ZWIEDZAM);
+            p->stan = PS_TRASA;
+            odczekaj(&p->aktor, &p->termin, P_CZAS, (uint64_t)p->czas_s * 1000ULL);
+            return PULA_DALEJ;
+
+        case PS_TRASA:
+            if (!(p->flagi & P_CZAS)) return PULA_DALEJ;
+            p->flagi &= ~P_CZAS;
+            p->stan = PS_KLADKI_WYJSCIE;
+            continue;
+
+        case PS_WYJSCIE:
+            if (!(p->flagi & P_CZAS)) return PULA_DALEJ;
+            p->flagi &= ~P_CZAS;
+            wyslij_do_grupy(p, Z_MOZE_WYJSC);
+            kladki_zwolnij(p);
+            p->grupy++;
+            p->zwiedzajacych += (uint64_t)p->liczba;
+            p->liczba = 0;
+            p->stan = PS_ZBIERANIE;
+            continue;
+
+        case PS_ZAMKNIETY:
+        default:
+            return PULA_DALEJ;
+        }
+    }
+}
+
+/// --- Generator ---
+
+static Zwiedzajacy* nowy_zwiedzajacy(int wiek, int powtorna, int poprz_trasa, int pid_opiekuna, int czy_opiekun, int id_pary) {
+    pthread_mutex_lock(&mutex_slotow);
+    int indeks = wolne_sloty[--liczba_wolnych];
+    pthread_mutex_unlock(&mutex_slotow);
+
+    Zwiedzajacy* z = &sloty[indeks];
+    memset(z, 0, sizeof(*z));
+    z->aktor.krok = zwiedzajacy_krok;
+    z->id = indeks + 1;
+    z->wiek = wiek;
+    z->powtorna = powtorna;
+    z->poprz_trasa = poprz_trasa;
+    z->pid_opiekuna = pid_opiekuna;
+    z->czy_opiekun = czy_opiekun;
+    z->id_pary = id_pary;
+    __atomic_add_fetch(&wyniki.zywi, 1, __ATOMIC_ACQ_REL);
+    __atomic_add_fetch(&wyniki.wygenerowano, 1, __ATOMIC_RELAXED);
+    return z;
+}
+
+static int wolne(void) {
+    pthread_mutex_lock(&mutex_slotow);
+    int n = liczba_wolnych;
+    pthread_mutex_unlock(&mutex_slotow);
+    return n;
+}
+
+/// Sloty dla zwiedzającego (i opiekuna) oraz wpis pary - zajmuje tylko generator, więc
+/// sprawdzone wolne sloty nie znikną przed nowy_zwiedzajacy
+static int zajmij_miejsce(int z_opiekunem, int* id_pary) {
+    if (wolne() < (z_opiekunem ? 2 : 1)) return 0;
+    if (z_opiekunem && (*id_pary = para_zaloz(pary)) == BRAK_PARY) return 0;
+    return 1;
+}
+
+static int generator_krok(Aktor* a, uint32_t sygnaly) {
+    (void)a;
+    (void)sygnaly;
+    if (generator.skonczyl) return PULA_DALEJ;
+
+    for (int n = 0; n < GENERATOR_PACZKA; n++) {
+        if (__atomic_load_n(&wyniki.wygenerowano, __ATOMIC_RELAXED) >= (uint64_t)cel_zwiedzajacych) {
+            generator.skonczyl = 1;
+            pula_wyslij(&straznik.aktor, S_SPRAWDZ);
+            return PULA_DALEJ;
+        }
+
+        /// Losowanie jak generator.c
+        int wiek = MIN_WIEK + (int)(rand_r(&generator.ziarno) % (MAX_WIEK - MIN_WIEK + 1));
+        int wroci = (int)(rand_r(&generator.ziarno) % 100) < SZANSA_POWTORNA ? 1 : 0;
+        int poprz_trasa = 1;  /// Liczy się tylko przy powtórnej - dziecko z pary dostaje trasę pary
+        int z_opiekunem = wiek < WIEK_Z_OPIEKUNEM && (int)(rand_r(&generator.ziarno) % 100) < SZANSA_DZIECKO_OPIEKUN;
+
+        int id_pary = BRAK_PARY;
+        if (!zajmij_miejsce(z_opiekunem, &id_pary)) {
+            /// Limit obecnych lub rejestr par pełny - czekamy na wyjście kogoś. Zgłoszenie przed
+            /// ponowną próbą: wyjście po niej na pewno zobaczy czeka i nas obudzi
+            __atomic_store_n(&generator.czeka, 1, __ATOMIC_SEQ_CST);
+            if (!zajmij_miejsce(z_opiekunem, &id_pary)) return PULA_DALEJ;
+            __atomic_store_n(&generator.czeka, 0, __ATOMIC_SEQ_CST);
+        }
+
+        int pid_opiekuna = 0;
+        if (id_pary != BRAK_PARY) {
+            int wiek_opiekuna = MIN_WIEK_OPIEKUNA + (int)(rand_r(&generator.ziarno) % (MAX_WIEK_OPIEKUNA - MIN_WIEK_OPIEKUNA + 1));
+            int trasa_pary = regulamin_trasa_pary(id_pary);
+            Zwiedzajacy* opiekun = nowy_zwiedzajacy(wiek_opiekuna, 0, trasa_pary, 0, 1, id_pary);
+            pid_opiekuna = opiekun->id;
+            para_opublikuj(pary, id_pary, pid_opiekuna);
+            poprz_trasa = trasa_pary;
+            pula_wyslij(&opiekun->aktor, Z_START);
+        }
+
+        Zwiedzajacy* z = nowy_zwiedzajacy(wiek, 0, poprz_trasa, pid_opiekuna, 0, id_pary);
+        z->wroci = wroci && id_pary == BRAK_PARY;  /// Pary wychodzą razem - nie wracają
+        if (id_pary != BRAK_PARY) pary->pary[id_pary].pid_dziecka = z->id;
+        pula_wyslij(&z->aktor, Z_START);
+    }
+    pula_wyslij(&generator.aktor, G_DALEJ);  /// Ustępujemy innym aktorom
+    return PULA_DALEJ;
+}
+
+/// --- Strażnik ---
+
+static int straznik_krok(Aktor* a, uint32_t sygnaly) {
+    (void)a;
+    if (sygnaly & S_START) {
+        straznik.otwarta = 1;
+        pula_wyslij(&generator.aktor, G_DALEJ);
+    }
+    if (sygnaly & S_PRZEWODNIK) {
+        if (__atomic_load_n(&straznik.zamknieci, __ATOMIC_ACQUIRE) == LICZBA_TRAS) {
+            __atomic_store_n(&czas_konca_ns, czas_monotoniczny_ns(), __ATOMIC_RELEASE);
+            pula_zakoncz();
+        }
+        return PULA_DALEJ;
+    }
+    /// Zamykamy, gdy wszyscy wygenerowani wyszli - przewodnicy odwołują resztę i kończą
+    if (straznik.otwarta && generator.skonczyl && __atomic_load_n(&wyniki.zywi, __ATOMIC_ACQUIRE) == 0) {
+        straznik.otwarta = 0;
+        for (int t = 0; t < LICZBA_TRAS; t++) pula_wyslij(&przewodnicy[t].aktor, P_ZAMKNIECIE);
+    }
+    return PULA_DALEJ;
+}
+
+/// --- Przebieg ---
+
+static void przygotuj_kanal(Kanal* k) {
+    pthread_mutex_init(&k->mutex, NULL);
+    k->glowa = k->ogon = NULL;
+}
+
+static void przygotuj_przewodnika(Przewodnik* p, int numer) {
+    memset(p, 0, sizeof(*p));
+    p->aktor.krok = przewodnik_krok;
+    p->numer = numer;
+    p->max_osoby = TRASY[numer - 1].pojemnosc;
+    p->czas_s = TRASY[numer - 1].czas_s;
+    p->maska_kladek = TRASY[numer - 1].maska_kladek;
+    p->liczba_kladek = __builtin_popcount(p->maska_kladek);
+    przygotuj_kanal(&p->kanal);
+    p->sklad = (SkladGrupy){ .pidy = p->grupa, .czlonkowie = p->czlonkowie, .odebrano_ns = p->odebrano_ns,
+        .max = p->max_osoby, .pary = pary };
+    p->okno = (OknoZbierania){ .odstep_ewma_s = OKNO_ODSTEP_POCZATKOWY, .waga_czekania = okno_waga_z_env(),
+        .okno_max_s = CZAS_ZBIERANIA_GRUPY, .czas_wycieczki_s = p->czas_s };
+}
+
+int main(void) {
+    long rdzenie = sysconf(_SC_NPROCESSORS_ONLN);
+    int watki = parametr_env("JASKINIA_PULA_WATKI", rdzenie > 0 ? (int)rdzenie : 1, 1, PULA_MAX_WATKOW);
+    cel_zwiedzajacych = parametr_env("JASKINIA_PULA_ZWIEDZAJACY", 100000, 1, INT_MAX);
+    limit_zywych = parametr_env("JASKINIA_PULA_ZYWI", 20000, 2, 10000000);
+    przyspieszenie = parametr_env_ulamek("JASKINIA_PULA_PRZYSPIESZENIE", 0.0, 0.0, 1e6);
+    int limit_s = parametr_env("JASKINIA_PULA_LIMIT_S", 600, 1, 86400);
+
+    sloty = (Zwiedzajacy*)calloc((size_t)limit_zywych, sizeof(Zwiedzajacy));
+    wolne_sloty = (int*)malloc((size_t)limit_zywych * sizeof(int));
+    pary = (ShmPary*)calloc(1, sizeof(ShmPary));
+    if (!sloty || !wolne_sloty || !pary) {
+        fprintf(stderr, "ERROR: Brak pamieci na %d slotow zwiedzajacych\n", limit_zywych);
+        return 1;
+    }
+    for (int i = 0; i < limit_zywych; i++) wolne_sloty[i] = limit_zywych - 1 - i;
+    liczba_wolnych = limit_zywych;
+
+    if (zegar_uruchom() != 0) {
+        perror("zegar_uruchom");
+        return 1;
+    }
+
+    unsigned ziarno = (unsigned)ziarno_losowania(0);
+    kasjer.aktor.krok = kasjer_krok;
+    kasjer.ziarno = ziarno ^ 0x9E3779B9U;
+    przygotuj_kanal(&kasjer.powtorne);
+    przygotuj_kanal(&kasjer.zwykle);
+    for (int t = 0; t < LICZBA_TRAS; t++) przygotuj_przewodnika(&przewodnicy[t], t + 1);
+    generator.aktor.krok = generator_krok;
+    generator.ziarno = ziarno;
+    straznik.aktor.krok = straznik_krok;
+
+    printf("jaskinia-pula: watki=%d zwiedzajacy=%d zywi<=%d przyspieszenie=%g\n",
+        watki, cel_zwiedzajacych, limit_zywych, przyspieszenie);
+    fflush(stdout);
+
+    uint64_t t0 = czas_monotoniczny_ns();
+    if (pula_uruchom(watki) != 0) {
+        perror("pula_uruchom");
+        return 1;
+    }
+    pula_wyslij(&straznik.aktor, S_START);
+
+    int zawieszony = 0;
+    while (!__atomic_load_n(&pula.koniec, __ATOMIC_ACQUIRE)) {
+        usleep(100000);
+        if (czas_monotoniczny_ns() - t0 > (uint64_t)limit_s * 1000000000ULL) {
+            zawieszony = 1;
+            pula_zakoncz();
+        }
+    }
+    pula_czekaj();
+    uint64_t koniec = __atomic_load_n(&czas_konca_ns, __ATOMIC_ACQUIRE);
+    double czas_s = (double)((koniec ? koniec : czas_monotoniczny_ns()) - t0) / 1e9;
+    zegar_zatrzymaj();
+
+    uint64_t wykonane = 0, skradzione = 0, uspienia = 0, min_wyk = UINT64_MAX, max_wyk = 0;
+    for (int i = 0; i < pula.watki; i++) {
+        PulaDeque* d = &pula.deki[i];
+        wykonane += d->wykonane;
+        skradzione += d->skradzione;
+        uspienia += d->uspienia;
+        if (d->wykonane < min_wyk) min_wyk = d->wykonane;
+        if (d->wykonane > max_wyk) max_wyk = d->wykonane;
+    }
+
+    printf("czas=%.3f s  zwiedzajacych/s=%.0f  krokow/s=%.0f\n", czas_s,
+        (double)wyniki.wygenerowano / czas_s, (double)wykonane / czas_s);
+    printf("zwiedzajacy: wygenerowano=%llu powroty=%llu zakonczyli=%llu odrzuceni=%llu anulowani=%llu timeouty=%llu\n",
+        (unsigned long long)wyniki.wygenerowano, (unsigned long long)wyniki.powroty,
+        (unsigned long long)wyniki.zakonczyli,
+        (unsigned long long)wyniki.odrzuceni, (unsigned long long)wyniki.anulowani,
+        (unsigned long long)wyniki.timeouty);
+    printf("kasjer:");
+    for (int t = 1; t <= LICZBA_TRAS; t++) {
+        printf(" trasa%d=%llu", t, (unsigned long long)kasjer.decyzje[DECYZJA_TRASA(t)]);
+    }
+    printf(" odrzucono=%llu (dzieci bez opiekuna=%llu)\n",
+        (unsigned long long)kasjer.decyzje[DECYZJA_ODRZUCONY],
+        (unsigned long long)kasjer.reguly[REGULA_DZIECKO_BEZ_OPIEKUNA]);
+    uint64_t zwiedzili = 0, rozdzielone = 0;
+    int grupy_w_limicie = 1;
+    for (int i = 0; i < LICZBA_TRAS; i++) {
+        Przewodnik* p = &przewodnicy[i];
+        printf("trasa%d: grupy=%llu zwiedzajacych=%llu srednia grupa=%.1f max grupa=%d/%d srednie okno=%llu ms\n",
+            p->numer, (unsigned long long)p->grupy, (unsigned long long)p->zwiedzajacych,
+            p->grupy ? (double)p->zwiedzajacych / (double)p->grupy : 0.0, p->max_grupa, p->max_osoby,
+            (unsigned long long)(p->grupy ? p->suma_okien_ms / p->grupy : 0));
+        zwiedzili += p->zwiedzajacych;
+        rozdzielone += p->rozdzielone_pary;
+        grupy_w_limicie &= p->max_grupa <= p->max_osoby;
+    }
+    printf("pary: rozdzielone=%llu\n", (unsigned long long)rozdzielone);
+    printf("pula: krokow=%llu skradzione=%llu uspienia=%llu na watek min=%llu max=%llu\n",
+        (unsigned long long)wykonane, (unsigned long long)skradzione, (unsigned long long)uspienia,
+        (unsigned long long)min_wyk, (unsigned long long)max_wyk);
+
+    /// Niezmienniki - jak w jaskinia-analiza, na licznikach zamiast logu
+    int ok = 1;
+#define SPRAWDZ(warunek, opis) \
+    do { \
+        int _w = (warunek); \
+        printf("[%s] %s\n", _w ? " OK " : "BLAD", opis); \
+        ok &= _w; \
+    } while (0)
+    SPRAWDZ(!zawieszony, "przebieg zakonczony przed JASKINIA_PULA_LIMIT_S");
+    SPRAWDZ(wyniki.zakonczyli + wyniki.odrzuceni + wyniki.anulowani + wyniki.timeouty ==
+        wyniki.wygenerowano + wyniki.powroty, "kazda wizyta zakonczyla sie dokladnie raz");
+    SPRAWDZ(grupy_w_limicie, "grupa nie przekracza Ni");
+    SPRAWDZ(zwiedzili == wyniki.zakonczyli, "zakonczyli = suma grup wszystkich tras");
+    SPRAWDZ(kladki.przejscia == 2 * wyniki.zakonczyli, "kazdy zwiedzajacy przeszedl kladke dwa razy");
+    SPRAWDZ(rozdzielone == 0, "pary opiekun-dziecko razem");
+#undef SPRAWDZ
+
+    return ok ? 0 : 2;
+}
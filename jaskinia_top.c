@@ -0,0 +1,200 @@
+#include "common.h"
+#include "metryki.h"
+
+/// jaskinia-top - podgląd symulacji na żywo
+/// Tylko czyta stronę metryk (SHM_RDONLY) - procesy symulacji nic o nim nie wiedzą.
+
+#define DOMYSLNY_INTERWAL_MS 250  /// 4 odświeżenia na sekundę
+#define STALA_CZASOWA_TEMPA 1.0   /// Wygładzanie temp (EWMA) w sekundach
+
+volatile sig_atomic_t kontynuuj = 1;
+void obsluga_sigint(int sig) { (void)sig; kontynuuj = 0; }
+
+/// Spójna migawka wszystkich sekcji
+typedef struct {
+    uint64_t czas_ns;
+    MetrykiKasjer kasjer;
+    MetrykiTrasa trasy[LICZBA_TRAS];
+    MetrykiKladka kladki[LICZBA_KLADEK];
+    MetrykiGenerator generator;
+    MetrykiZwiedzajacy zwiedzajacy;
+} Migawka;
+
+/// Wygładzone tempa zdarzeń na sekundę
+typedef struct {
+    double bilety;
+    double wygenerowani;
+    double zakonczyli;
+    double przejscia[LICZBA_KLADEK];
+} Tempa;
+
+static void zrob_migawke(const ShmMetryki* m, Migawka* s) {
+    s->czas_ns = czas_monotoniczny_ns();
+    seqlock_odczytaj(&m->kasjer, &s->kasjer, sizeof(s->kasjer));
+    for (int i = 0; i < LICZBA_TRAS; i++) {
+        seqlock_odczytaj(&m->trasy[i], &s->trasy[i], sizeof(s->trasy[i]));
+    }
+    for (int i = 0; i < LICZBA_KLADEK; i++) {
+        seqlock_odczytaj(&m->kladki[i], &s->kladki[i], sizeof(s->kladki[i]));
+    }
+    seqlock_odczytaj(&m->generator, &s->generator, sizeof(s->generator));
+
+    /// Liczniki atomowe czytamy pojedynczo - każdy osobno jest spójny
+    const MetrykiZwiedzajacy* z = &m->zwiedzajacy;
+    s->zwiedzajacy.kolejka_kasjer = __atomic_load_n(&z->kolejka_kasjer, __ATOMIC_RELAXED);
+    for (int i = 0; i < LICZBA_TRAS; i++) {
+        s->zwiedzajacy.kolejka_przewodnik[i] = __atomic_load_n(&z->kolejka_przewodnik[i], __ATOMIC_RELAXED);
+    }
+    s->zwiedzajacy.zakonczyli = __atomic_load_n(&z->zakonczyli, __ATOMIC_RELAXED);
+    s->zwiedzajacy.odrzuceni = __atomic_load_n(&z->odrzuceni, __ATOMIC_RELAXED);
+    s->zwiedzajacy.anulowani = __atomic_load_n(&z->anulowani, __ATOMIC_RELAXED);
+    s->zwiedzajacy.timeouty = __atomic_load_n(&z->timeouty, __ATOMIC_RELAXED);
+}
+
+/// EWMA tempa - stare * (1-a) + chwilowe * a
+static double wygladz(double stare, uint64_t teraz, uint64_t przed, double dt) {
+    if (dt <= 0.0) return stare;
+    double chwilowe = (double)(teraz - przed) / dt;
+    double a = dt / (dt + STALA_CZASOWA_TEMPA);
+    return stare * (1.0 - a) + chwilowe * a;
+}
+
+static const char* nazwa_kierunku(int kierunek) {
+    switch (kierunek) {
+    case KIERUNEK_WEJSCIE: return "WEJSCIE";
+    case KIERUNEK_WYJSCIE: return "WYJSCIE";
+    default: return "-";
+    }
+}
+
+/// Dopisz do bufora ekranu
+#define EKRAN(...) \
+    do { \
+        if (dl < sizeof(ekran)) dl += snprintf(ekran + dl, sizeof(ekran) - dl, __VA_ARGS__); \
+    } while(0)
+
+static void rysuj(const ShmMetryki* m, const Migawka* s, const Tempa* t) {
+    char ekran[8192];
+    size_t dl = 0;
+    double od_otwarcia = m->czas_otwarcia_ns > 0 ?
+        (double)(s->czas_ns - m->czas_otwarcia_ns) / 1e9 : 0.0;
+
+    EKRAN("\033[H\033[2J");
+    EKRAN("JASKINIA-TOP  wersja=%u  straznik PID=%d  stan: %s  czas: %.1fs\n",
+        m->wersja, m->pid_straznika, m->otwarta ? "OTWARTA" : "ZAMKNIETA", od_otwarcia);
+    EKRAN("--------------------------------------------------------------------------\n");
+    EKRAN("KASJER       obsluzonych %6llu  (%5.2f/s, srednio %5.2f/s)\n",
+        (unsigned long long)s->kasjer.obsluzonych, t->bilety,
+        od_otwarcia > 0 ? s->kasjer.obsluzonych / od_otwarcia : 0.0);
+    EKRAN("            ");
+    for (int i = 1; i <= LICZBA_TRAS; i++) {
+        EKRAN(" trasa%d %llu ", i, (unsigned long long)s->kasjer.decyzje[DECYZJA_TRASA(i)]);
+    }
+    EKRAN(" odrzuceni %llu  powtorni %llu\n",
+        (unsigned long long)s->kasjer.decyzje[DECYZJA_ODRZUCONY],
+        (unsigned long long)s->kasjer.powtornych);
+    EKRAN("KOLEJKI      kasjer %lld ", (long long)s->zwiedzajacy.kolejka_kasjer);
+    for (int i = 0; i < LICZBA_TRAS; i++) {
+        EKRAN(" przewodnik%d %lld ", i + 1, (long long)s->zwiedzajacy.kolejka_przewodnik[i]);
+    }
+    EKRAN("\n");
+
+    for (int i = 0; i < LICZBA_TRAS; i++) {
+        const MetrykiTrasa* tr = &s->trasy[i];
+        int faza = (tr->faza >= 0 && tr->faza < LICZBA_FAZ) ? tr->faza : FAZA_START;
+        EKRAN("TRASA %d      faza %-10s osoby %2d/%-2d  ostatnia grupa %d  okno %d ms  tempo %.2f/s\n",
+            i + 1, NAZWY_FAZ[faza], tr->osoby, TRASY[i].pojemnosc, tr->ostatnia_grupa, tr->okno_ms, tr->tempo_przybyc);
+        EKRAN("             grupy: rozpoczete %llu anulowane %llu zakonczone %llu  odrz.limit %llu  zwiedzilo %llu\n",
+            (unsigned long long)tr->grupy_rozpoczete, (unsigned long long)tr->grupy_anulowane,
+            (unsigned long long)tr->grupy_zakonczone, (unsigned long long)tr->odrzuceni_limit,
+            (unsigned long long)tr->zwiedzajacych);
+    }
+
+    for (int i = 0; i < LICZBA_KLADEK; i++) {
+        const MetrykiKladka* kl = &s->kladki[i];
+        EKRAN("KLADKA %d     osoby %d/%d  kierunek %-8s przewodnik %-7d przejscia %llu (%5.2f/s)\n",
+            i + 1, kl->osoby, KLADKI[i].pojemnosc, nazwa_kierunku(kl->kierunek), kl->przewodnik,
+            (unsigned long long)kl->przejscia, t->przejscia[i]);
+    }
+
+    EKRAN("GENERATOR    wygenerowano %llu (%5.2f/s)  zyjacych %d/%d\n",
+        (unsigned long long)s->generator.wygenerowano, t->wygenerowani,
+        s->generator.zyjacych, MAX_ZWIEDZAJACYCH);
+    EKRAN("ZWIEDZAJACY  zakonczyli %llu (%5.2f/s)  odrzuceni %llu  anulowani %llu  timeouty %llu\n",
+        (unsigned long long)s->zwiedzajacy.zakonczyli, t->zakonczyli,
+        (unsigned long long)s->zwiedzajacy.odrzuceni, (unsigned long long)s->zwiedzajacy.anulowani,
+        (unsigned long long)s->zwiedzajacy.timeouty);
+    EKRAN("--------------------------------------------------------------------------\n");
+    EKRAN("Ctrl+C - wyjscie\n");
+
+    if (dl > sizeof(ekran)) dl = sizeof(ekran);
+    bezpieczny_zapis_wszystko(STDOUT_FILENO, ekran, dl);
+}
+
+int main(int argc, char* argv[]) {
+    int interwal_ms = DOMYSLNY_INTERWAL_MS;
+    if (argc > 2 || (argc == 2 && bezpieczny_strtol(argv[1], &interwal_ms, 50, 5000) != 0)) {
+        fprintf(stderr, "Uzycie: %s [interwal_ms 50-5000]\n", argv[0]);
+        return 1;
+    }
+
+    signal(SIGINT, obsluga_sigint);
+    signal(SIGTERM, obsluga_sigint);
+
+    /// Czekaj aż strażnik utworzy stronę metryk
+    int shmid = -1;
+    while (kontynuuj && (shmid = shmget(KLUCZ_SHM_METRYKI, 0, 0)) == -1) {
+        fprintf(stderr, "\rCzekam na symulacje...");
+        usleep(500000);
+    }
+    if (shmid == -1) return 0;
+
+    const ShmMetryki* m = (const ShmMetryki*)shmat(shmid, NULL, SHM_RDONLY);
+    if (m == (void*)-1) {
+        perror("shmat KLUCZ_SHM_METRYKI");
+        return 1;
+    }
+
+    /// Strona mogła być jeszcze inicjalizowana - magic ustawiany na końcu
+    while (kontynuuj && __atomic_load_n(&m->magic, __ATOMIC_ACQUIRE) != METRYKI_MAGIC) {
+        usleep(100000);
+    }
+    if (m->wersja != METRYKI_WERSJA) {
+        fprintf(stderr, "Niezgodna wersja metryk: strona=%u program=%u\n", m->wersja, METRYKI_WERSJA);
+        shmdt(m);
+        return 1;
+    }
+
+    Migawka poprzednia, biezaca;
+    Tempa tempa = { 0 };
+    zrob_migawke(m, &poprzednia);
+
+    while (kontynuuj) {
+        usleep(interwal_ms * 1000);
+
+        zrob_migawke(m, &biezaca);
+        double dt = (double)(biezaca.czas_ns - poprzednia.czas_ns) / 1e9;
+
+        tempa.bilety = wygladz(tempa.bilety, biezaca.kasjer.obsluzonych, poprzednia.kasjer.obsluzonych, dt);
+        tempa.wygenerowani = wygladz(tempa.wygenerowani, biezaca.generator.wygenerowano,
+            poprzednia.generator.wygenerowano, dt);
+        tempa.zakonczyli = wygladz(tempa.zakonczyli, biezaca.zwiedzajacy.zakonczyli,
+            poprzednia.zwiedzajacy.zakonczyli, dt);
+        for (int i = 0; i < LICZBA_KLADEK; i++) {
+            tempa.przejscia[i] = wygladz(tempa.przejscia[i], biezaca.kladki[i].przejscia,
+                poprzednia.kladki[i].przejscia, dt);
+        }
+
+        rysuj(m, &biezaca, &tempa);
+        poprzednia = biezaca;
+
+        /// Strażnik usunął stronę lub już nie żyje - koniec symulacji
+        if (shmget(KLUCZ_SHM_METRYKI, 0, 0) != shmid || !czy_proces_zyje(m->pid_straznika)) {
+            printf("Symulacja zakonczona\n");
+            break;
+        }
+    }
+
+    shmdt(m);
+    return 0;
+}
@@ -0,0 +1,295 @@
+#ifndef LOGUJ_H
+#define LOGUJ_H
+
+#include "common.h"
+#include "common_helpers.h"
+#include "dziennik.h"
+#include "metryki.h"
+#include <sys/uio.h>
+
+/// Wspólny zapis logów tekstowych dla wszystkich ról (zamiast kopii loguj_wiadomosc w każdym .c)
+///
+/// - deskryptory jaskinia_common.log i logu roli otwierane raz w loguj_inicjalizuj (O_APPEND | O_CLOEXEC)
+/// - bez semafora logów: każda linia (albo paczka pełnych linii) to jeden write/writev na O_APPEND,
+///   więc linie różnych procesów nigdy nie mieszają się w połowie
+/// - buforowanie: linie czekają w procesie maks. JASKINIA_LOG_BUFOR_MS ms (domyślnie LOG_OKRES_MS,
+///   0 = zapis od razu) lub do LOG_BUFOR bajtów i idą jednym writev. Termin sprawdza następna
+///   linia, a śpiący proces nie loguje - dlatego bufor opróżnia też przed_synchronizacja (common.h)
+///   przed każdym czekaniem na inny proces i obudzeniem go. Linie sprzed obudzenia są więc w pliku
+///   przed liniami obudzonego i jaskinia-analiza dalej widzi przyczynę przed skutkiem
+/// - loguj_oproznij() jest bezpieczne w handlerze sygnału (tylko write/writev), atexit opróżnia ogon
+/// - poziomy (dziennik.h): loguj_blad/loguj_ostrzezenie/loguj_szczegol i loguj_zdarzenie z poziomem
+///   z katalogu; zwykłe loguj_wiadomosc to LOG_INFO. Poziom powyżej LOG_POZIOM_KOMPILACJI
+///   (make LOG_POZIOM=n) usuwa wywołanie razem z obliczaniem argumentów, pozostałe filtruje
+///   maska ról ze strony metryk (JASKINIA_LOG_POZIOM na start, jaskinia-logi na żywo)
+///
+/// Jak reszta nagłówka loguj_wiadomosc/loguj_wiadomoscf/loguj_zawsze są static inline - każda rola
+/// w ./jaskinia (role.h) ma własny stan logu, linkowanie kilku ról razem nie zdubluje symboli.
+
+#define LOG_BUFOR 16384         /// Próg rozmiaru bufora procesu
+#define LOG_OKRES_MS 100        /// Domyślny JASKINIA_LOG_BUFOR_MS
+#define LOG_MAX_LINIA 512       /// Jak dotychczasowy bufor linii
+
+#ifndef LOG_POZIOM_KOMPILACJI
+#define LOG_POZIOM_KOMPILACJI LOG_SZCZEGOLY
+#endif
+
+static int log_fd_wspolny = -1;
+static int log_fd_roli = -1;
+static int log_rola = ROLA_STRAZNIK;
+static pid_t log_pid = 0;               /// Właściciel bufora - po fork() dziecko nie zapisuje linii rodzica
+static uint64_t log_okres_ns = 0;       /// 0 = bez buforowania
+static uint64_t log_najstarszy_ns = 0;  /// Czas pierwszej linii w buforze
+
+static char log_bufor[LOG_BUFOR];
+static size_t log_zajete = 0;
+static volatile sig_atomic_t log_w_trakcie = 0;  /// Główny kod modyfikuje bufor - handler nie może go ruszać
+static volatile sig_atomic_t log_zalegle = 0;    /// Handler chciał opróżnić bufor w trakcie modyfikacji
+
+/// Maska procesu - używana zanim rola podłączy stronę metryk (i gdy jej brak)
+static uint64_t log_maska_lokalna = LOG_MASKA_WSZYSTKO;
+
+/// Bieżąca maska - jeden odczyt słowa ze strony metryk, bez syscalli
+static inline uint64_t log_maska(void) {
+    return globalne_metryki ? __atomic_load_n(&globalne_metryki->maska_logu, __ATOMIC_RELAXED) : log_maska_lokalna;
+}
+
+/// Stała część warunku składa się w kompilacji - przy fałszu cała instrukcja znika
+#define LOG_WLACZONY(poziom) \
+    ((int)(poziom) <= (int)LOG_POZIOM_KOMPILACJI && (log_maska() & LOG_BIT(log_rola, (poziom))))
+
+#define LOGUJ_NA_POZIOMIE(poziom, ...) \
+    do { \
+        if (LOG_WLACZONY(poziom)) loguj_zawszef(__VA_ARGS__); \
+    } while (0)
+
+#define loguj_blad(...) LOGUJ_NA_POZIOMIE(LOG_BLAD, __VA_ARGS__)
+#define loguj_ostrzezenie(...) LOGUJ_NA_POZIOMIE(LOG_OSTRZEZENIE, __VA_ARGS__)
+#define loguj_szczegol(...) LOGUJ_NA_POZIOMIE(LOG_SZCZEGOLY, __VA_ARGS__)
+
+/// Komunikat z katalogu: loguj_zdarzenie(DZ_PR_GRUPA_ZEBRANA, liczba) - poziom z katalogu
+#define loguj_zdarzenie(id, ...) \
+    do { \
+        if (LOG_WLACZONY(id##_POZIOM)) \
+            dziennik_zdarzenie((id), (const int32_t[DZIENNIK_ARGUMENTY]){ __VA_ARGS__ }); \
+    } while (0)
+
+static inline void loguj_zawszef(const char* format, ...);
+
+/// Znacznik czasu formatowany raz na sekundę
+static time_t log_sekunda = (time_t)-1;
+static char log_ts[32];
+
+/// Zapisz wektor w całości - writev to jeden zapis O_APPEND, resztę (krótki zapis) dopisz po kawałku
+static inline void log_zapisz_wektor(int fd, struct iovec* iov, int liczba) {
+    if (fd == -1) return;
+    size_t razem = 0;
+    for (int i = 0; i < liczba; i++) razem += iov[i].iov_len;
+
+    ssize_t n;
+    do {
+        n = writev(fd, iov, liczba);
+    } while (n == -1 && errno == EINTR);
+    if (n == -1 || (size_t)n == razem) return;
+
+    size_t pominiete = (size_t)n;
+    for (int i = 0; i < liczba; i++) {
+        if (pominiete >= iov[i].iov_len) {
+            pominiete -= iov[i].iov_len;
+            continue;
+        }
+        bezpieczny_zapis_wszystko(fd, (const char*)iov[i].iov_base + pominiete, iov[i].iov_len - pominiete);
+        pominiete = 0;
+    }
+}
+
+/// Zapisz bufor (i opcjonalnie bieżącą linię) do obu plików - wywoływać przy log_w_trakcie == 1
+static inline void log_wypisz(const char* linia, size_t dlugosc) {
+    struct iovec iov[2];
+    int liczba = 0;
+    if (log_zajete > 0) {
+        iov[liczba].iov_base = log_bufor;
+        iov[liczba++].iov_len = log_zajete;
+    }
+    if (dlugosc > 0) {
+        iov[liczba].iov_base = (void*)linia;
+        iov[liczba++].iov_len = dlugosc;
+    }
+    if (liczba == 0) return;
+
+    log_zapisz_wektor(log_fd_wspolny, iov, liczba);
+    log_zapisz_wektor(log_fd_roli, iov, liczba);
+    log_zajete = 0;
+}
+
+/// Opróżnij bufor - async-signal-safe (getpid, writev)
+/// Gdy sygnał przerwał loguj_zawsze, tylko zaznacza zaległość - opróżni ją przerwany kod
+static inline void loguj_oproznij(void) {
+    if (log_w_trakcie) {
+        log_zalegle = 1;
+        return;
+    }
+    if (log_zajete == 0) return;
+    log_w_trakcie = 1;
+    __atomic_signal_fence(__ATOMIC_SEQ_CST);
+    if (getpid() == log_pid) {
+        log_wypisz(NULL, 0);
+    }
+    log_zajete = 0;
+    __atomic_signal_fence(__ATOMIC_SEQ_CST);
+    log_w_trakcie = 0;
+}
+
+static void log_oproznij_przy_wyjsciu(void) {
+    loguj_oproznij();
+}
+
+/// Dziecko po fork() bez exec (uruchom_role, role.h) - porzuć stan logu rodzica: niewypisane
+/// linie i deskryptory jego plików. loguj_inicjalizuj roli otwiera własne
+static inline void loguj_porzuc_po_fork(void) {
+    log_zajete = 0;
+    log_zalegle = 0;
+    log_pid = getpid();
+    if (log_fd_wspolny != -1) close(log_fd_wspolny);
+    if (log_fd_roli != -1) close(log_fd_roli);
+    log_fd_wspolny = -1;
+    log_fd_roli = -1;
+    hak_synchronizacji = NULL;
+    if (dziennik_fd != -1) close(dziennik_fd);
+    dziennik_fd = -1;
+}
+
+/// Otwórz logi roli - wywołaj raz na początku main(), przed pierwszym loguj_wiadomosc
+/// Inicjalizuje też binarny dziennik (JASKINIA_DZIENNIK=1); strażnik zakłada go wcześniej
+static inline void loguj_inicjalizuj(int rola) {
+    log_rola = rola;
+    log_pid = getpid();
+
+    char plik[128];
+    const char* nazwa = plik_instancji(LOG_PLIK_WSPOLNY, plik, sizeof(plik));
+    log_fd_wspolny = open(nazwa, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (log_fd_wspolny == -1) perror(nazwa);
+    if (PLIKI_ROL[rola]) {
+        nazwa = plik_instancji(PLIKI_ROL[rola], plik, sizeof(plik));
+        log_fd_roli = open(nazwa, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (log_fd_roli == -1) perror(nazwa);
+    }
+
+    const char* opis = getenv("JASKINIA_LOG_POZIOM");
+    if (opis && opis[0] != '\0' && maska_logu_z_opisu(opis, &log_maska_lokalna) != 0) {
+        fprintf(stderr, "OSTRZEZENIE: Bledny JASKINIA_LOG_POZIOM=%s - loguje wszystko\n", opis);
+    }
+
+    log_okres_ns = (uint64_t)parametr_env("JASKINIA_LOG_BUFOR_MS", LOG_OKRES_MS, 0, 60000) * 1000000ULL;
+    static int atexit_zarejestrowany = 0;  /// Dziecko po fork() bez exec dziedziczy rejestrację rodzica
+    if (log_okres_ns > 0) {
+        if (!atexit_zarejestrowany) atexit(log_oproznij_przy_wyjsciu);
+        atexit_zarejestrowany = 1;
+        hak_synchronizacji = loguj_oproznij;
+    }
+
+    dziennik_inicjalizuj(rola);
+}
+
+/// Zapis linii bez sprawdzania poziomu - dla makr poziomów i dziennik_zdarzenie
+static inline void loguj_zawsze(const char* wiadomosc) {
+    if (DZIENNIK_AKTYWNY()) {
+        dziennik_tekst(wiadomosc);  /// Rekord binarny zamiast linii tekstu
+        return;
+    }
+
+    time_t teraz = time(NULL);
+    if (teraz != log_sekunda) {
+        struct tm tm;
+        localtime_r(&teraz, &tm);
+        strftime(log_ts, sizeof(log_ts), "%Y-%m-%d %H:%M:%S", &tm);
+        log_sekunda = teraz;
+    }
+
+    char linia[LOG_MAX_LINIA];
+    int n = snprintf(linia, sizeof(linia), "[%s] [PID:%d] [%s] %s\n", log_ts, getpid(), NAZWY_ROL[log_rola], wiadomosc);
+    if (n < 0) return;
+    size_t dlugosc = (size_t)n;
+    if (dlugosc >= sizeof(linia)) {
+        dlugosc = sizeof(linia) - 1;
+        linia[dlugosc - 1] = '\n';  /// Obcięta linia nadal kończy się znakiem nowej linii
+    }
+
+    log_w_trakcie = 1;
+    __atomic_signal_fence(__ATOMIC_SEQ_CST);
+
+    pid_t pid = getpid();
+    if (pid != log_pid) {  /// Dziecko po fork() - bufor należy do rodzica
+        log_zajete = 0;
+        log_pid = pid;
+    }
+
+    if (log_okres_ns == 0) {
+        log_wypisz(linia, dlugosc);
+    }
+    else {
+        uint64_t t = czas_monotoniczny_ns();
+        if (log_zajete + dlugosc > LOG_BUFOR) {
+            log_wypisz(linia, dlugosc);  /// Pełny bufor + bieżąca linia jednym writev
+        }
+        else {
+            if (log_zajete == 0) log_najstarszy_ns = t;
+            memcpy(log_bufor + log_zajete, linia, dlugosc);
+            log_zajete += dlugosc;
+            if (t - log_najstarszy_ns >= log_okres_ns) log_wypisz(NULL, 0);
+        }
+    }
+
+    /// Sygnał w trakcie prosił o opróżnienie - zrób to teraz, nadal jako właściciel bufora
+    while (log_zalegle) {
+        log_zalegle = 0;
+        log_wypisz(NULL, 0);
+    }
+    __atomic_signal_fence(__ATOMIC_SEQ_CST);
+    log_w_trakcie = 0;
+}
+
+/// Komunikat z katalogu (dziennik.h) - rekord gdy dziennik aktywny, inaczej zwykła linia tekstu
+static inline void dziennik_zdarzenie(int zdarzenie, const int32_t* argumenty) {
+    if (DZIENNIK_AKTYWNY()) {
+        RekordDziennika r;
+        dziennik_wypelnij(&r, zdarzenie, 0);
+        memset(r.tekst, 0, sizeof(r.tekst));
+        memcpy(r.argumenty, argumenty, sizeof(r.argumenty));
+        bezpieczny_zapis_wszystko(dziennik_fd, &r, sizeof(r));
+        return;
+    }
+
+    char wiadomosc[512];
+    snprintf(wiadomosc, sizeof(wiadomosc), FORMATY_DZIENNIKA[zdarzenie],
+        argumenty[0], argumenty[1], argumenty[2], argumenty[3],
+        argumenty[4], argumenty[5], argumenty[6], argumenty[7]);
+    loguj_zawsze(wiadomosc);  /// Poziom już sprawdzony przez loguj_zdarzenie
+}
+
+static inline void loguj_zawszef(const char* format, ...) {
+    char wiadomosc[LOG_MAX_LINIA];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(wiadomosc, sizeof(wiadomosc), format, args);
+    va_end(args);
+    loguj_zawsze(wiadomosc);
+}
+
+/// Zwykły komunikat - poziom LOG_INFO
+static inline void loguj_wiadomosc(const char* wiadomosc) {
+    if (LOG_WLACZONY(LOG_INFO)) loguj_zawsze(wiadomosc);
+}
+
+/// Wersja z formatowaniem jak printf
+static inline void loguj_wiadomoscf(const char* format, ...) {
+    if (!LOG_WLACZONY(LOG_INFO)) return;
+    char wiadomosc[LOG_MAX_LINIA];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(wiadomosc, sizeof(wiadomosc), format, args);
+    va_end(args);
+    loguj_zawsze(wiadomosc);
+}
+
+#endif
@@ -0,0 +1,194 @@
+#ifndef METRYKI_H
+#define METRYKI_H
+
+#include "common.h"
+#include "common_helpers.h"
+
+/// Strona metryk na żywo w shared memory - czyta ją jaskinia-top
+/// Każda sekcja ma jednego pisarza i własny seqlock, więc zapis to dwa
+/// zwykłe store'y licznika sekwencji (bez syscalli i bez blokad).
+/// Liczniki z wieloma pisarzami (zwiedzający) są zwykłymi atomikami.
+#define METRYKI_MAGIC 0x4A41534BU  /// "JASK"
+#define METRYKI_WERSJA 5           /// Zwiększać przy każdej zmianie układu struktur!
+#define METRYKI_PROBY_ODCZYTU 1000 /// Po tylu próbach uznajemy że pisarz zginął w trakcie
+
+/// Fazy pracy przewodnika - do podglądu co robi
+enum {
+    FAZA_START = 0,
+    FAZA_ZBIERANIE,
+    FAZA_KLADKA_WEJSCIE,
+    FAZA_TRASA,
+    FAZA_KLADKA_WYJSCIE,
+    FAZA_ZAMKNIETY,
+    LICZBA_FAZ
+};
+
+static const char* const NAZWY_FAZ[LICZBA_FAZ] = {
+    "start", "zbieranie", "kladka-wej", "trasa", "kladka-wyj", "zamkniety"
+};
+
+/// Sekcja kasjera (pisarz: kasjer)
+typedef struct {
+    uint32_t sekwencja;      /// Seqlock - nieparzysta = zapis w toku
+    uint64_t obsluzonych;    /// Wszystkie przetworzone prośby
+    uint64_t decyzje[1 + LICZBA_TRAS];  /// Indeks = DECYZJA_ODRZUCONY/DECYZJA_TRASA(n)
+    uint64_t powtornych;     /// Ile z nich to powtórne wizyty
+} MetrykiKasjer;
+
+/// Sekcja trasy (pisarz: przewodnik tej trasy)
+typedef struct {
+    uint32_t sekwencja;
+    int faza;                   /// FAZA_*
+    int osoby;                  /// Aktualnie na trasie
+    int ostatnia_grupa;         /// Rozmiar ostatniej zebranej grupy
+    int okno_ms;                /// Okno zbierania wybrane dla ostatniej grupy
+    double tempo_przybyc;       /// EWMA przybyć do kolejki trasy (osób/s)
+    uint64_t grupy_rozpoczete;
+    uint64_t grupy_anulowane;   /// Sygnał zamknięcia przed wejściem
+    uint64_t grupy_zakonczone;
+    uint64_t odrzuceni_limit;   /// Odrzuceni bo przekroczyliby Ni
+    uint64_t zwiedzajacych;     /// Suma osób w zakończonych wycieczkach
+} MetrykiTrasa;
+
+/// Sekcja kładki (pisarz: przewodnik trzymający mutex tej kładki)
+typedef struct {
+    uint32_t sekwencja;
+    int osoby;            /// Aktualnie na kładce
+    int kierunek;         /// KIERUNEK_*
+    pid_t przewodnik;     /// Kto trzyma kładkę (0 = wolna)
+    uint64_t przejscia;   /// Ile osób przeszło od otwarcia
+} MetrykiKladka;
+
+/// Sekcja generatora (pisarz: generator)
+typedef struct {
+    uint32_t sekwencja;
+    uint64_t wygenerowano;
+    int zyjacych;         /// Ostatnio policzone żywe procesy zwiedzających
+} MetrykiGenerator;
+
+/// Liczniki z wieloma pisarzami - tylko atomowe inkrementy, bez seqlocka
+typedef struct {
+    int64_t kolejka_kasjer;          /// Wysłane prośby jeszcze nie odebrane
+    int64_t kolejka_przewodnik[LICZBA_TRAS];  /// Czekający w kolejce do przewodnika trasy i+1
+    uint64_t zakonczyli;             /// COMPLETE
+    uint64_t odrzuceni;              /// REJECT od kasjera
+    uint64_t anulowani;              /// CANCEL (sygnał od przewodnika)
+    uint64_t timeouty;               /// TIMEOUT bilet lub kolejka
+    uint64_t cpu_us;                 /// Suma czasu CPU zakończonych procesów (user+sys)
+    uint64_t max_rss_kb;             /// Największe szczytowe RSS zwiedzającego
+} MetrykiZwiedzajacy;
+
+/// Cała strona metryk
+typedef struct {
+    uint32_t magic;            /// METRYKI_MAGIC
+    uint32_t wersja;           /// METRYKI_WERSJA
+    pid_t pid_straznika;
+    int otwarta;               /// Kopia stanu jaskini dla podglądu
+    uint64_t maska_logu;       /// Poziomy logu ról (LOG_BIT z dziennik.h) - zmienia jaskinia-logi na żywo
+    uint64_t czas_otwarcia_ns; /// Zegar monotoniczny, 0 = jeszcze zamknięta
+    MetrykiKasjer kasjer;
+    MetrykiTrasa trasy[LICZBA_TRAS];
+    MetrykiKladka kladki[LICZBA_KLADEK];
+    MetrykiGenerator generator;
+    MetrykiZwiedzajacy zwiedzajacy;
+} ShmMetryki;
+
+/// Globalny wskaźnik na stronę metryk - NULL gdy niedostępna (każdy proces definiuje)
+extern ShmMetryki* globalne_metryki;
+
+/// Seqlock - początek zapisu (tylko jeden pisarz na sekcję!)
+static inline void seqlock_zapis_start(uint32_t* sekwencja) {
+    __atomic_store_n(sekwencja, *sekwencja + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+/// Seqlock - koniec zapisu, czytelnicy zobaczą spójną kopię
+static inline void seqlock_zapis_koniec(uint32_t* sekwencja) {
+    __atomic_store_n(sekwencja, *sekwencja + 1, __ATOMIC_RELEASE);
+}
+
+/// Zmień sekcję pod seqlockiem - nic nie robi gdy metryk brak
+#define METRYKI_ZAPIS(sekcja, kod) \
+    do { \
+        if (globalne_metryki) { \
+            seqlock_zapis_start(&globalne_metryki->sekcja.sekwencja); \
+            { kod; } \
+            seqlock_zapis_koniec(&globalne_metryki->sekcja.sekwencja); \
+        } \
+    } while(0)
+
+/// Atomowy licznik z wieloma pisarzami
+#define METRYKI_DODAJ(pole, ile) \
+    do { \
+        if (globalne_metryki) { \
+            __atomic_fetch_add(&globalne_metryki->pole, (ile), __ATOMIC_RELAXED); \
+        } \
+    } while(0)
+
+/// Atomowe maksimum z wieloma pisarzami - CAS ponawiany tylko gdy ktoś podniósł wartość
+#define METRYKI_MAX(pole, wartosc) \
+    do { \
+        if (globalne_metryki) { \
+            uint64_t _nowa = (wartosc); \
+            uint64_t _stara = __atomic_load_n(&globalne_metryki->pole, __ATOMIC_RELAXED); \
+            while (_nowa > _stara && !__atomic_compare_exchange_n(&globalne_metryki->pole, \
+                &_stara, _nowa, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) { \
+            } \
+        } \
+    } while(0)
+
+/// Spójna kopia sekcji (pierwsze pole to sekwencja) - ponawia gdy trafi na zapis
+/// Zwraca -1 gdy sekcja ciągle w zapisie (np. pisarz zabity SIGKILL w połowie)
+static inline int seqlock_odczytaj(const void* sekcja, void* kopia, size_t rozmiar) {
+    const uint32_t* sekwencja = (const uint32_t*)sekcja;
+    for (int proba = 0; proba < METRYKI_PROBY_ODCZYTU; proba++) {
+        uint32_t przed = __atomic_load_n(sekwencja, __ATOMIC_ACQUIRE);
+        if (przed & 1) continue;  /// Pisarz w trakcie - spróbuj jeszcze raz
+        memcpy(kopia, sekcja, rozmiar);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(sekwencja, __ATOMIC_RELAXED) == przed) return 0;
+    }
+    memcpy(kopia, sekcja, rozmiar);  /// Lepsza niespójna kopia niż żadna
+    return -1;
+}
+
+/// Podłącz stronę metryk - NULL gdy brak lub inna wersja układu
+static inline ShmMetryki* podlacz_metryki(void) {
+    ShmMetryki* m = NULL;
+    if (podlacz_shm_helper(KLUCZ_SHM_METRYKI, (void**)&m) == -1) return NULL;
+    if (m->magic != METRYKI_MAGIC || m->wersja != METRYKI_WERSJA) {
+        shmdt(m);
+        return NULL;
+    }
+    return m;
+}
+
+/// PID żywego strażnika, który trzyma stronę metryk tej instancji - 0 gdy instancja wolna.
+/// Bez sprawdzania wersji: magic, wersja i pid_straznika leżą na początku w każdej wersji
+static inline pid_t straznik_instancji(void) {
+    int shmid = shmget(KLUCZ_SHM_METRYKI, 0, 0);
+    if (shmid == -1) return 0;
+    const ShmMetryki* m = (const ShmMetryki*)shmat(shmid, NULL, SHM_RDONLY);
+    if (m == (void*)-1) return 0;
+    pid_t pid = __atomic_load_n(&m->magic, __ATOMIC_ACQUIRE) == METRYKI_MAGIC ? m->pid_straznika : 0;
+    shmdt(m);
+    return pid > 0 && czy_proces_zyje(pid) ? pid : 0;
+}
+
+/// Przed startem dnia: poprawna JASKINIA_INSTANCJA, której nie trzyma inny strażnik -
+/// inaczej czyszczenie IPC i logów zniszczyłoby działającą symulację
+static inline int sprawdz_wolna_instancje(void) {
+    if (instancja_z_env() < 0) {
+        fprintf(stderr, "Bledna JASKINIA_INSTANCJA=%s (dozwolone 0-%d)\n", getenv("JASKINIA_INSTANCJA"), MAX_INSTANCJA);
+        return -1;
+    }
+    pid_t pid = straznik_instancji();
+    if (pid > 0 && pid != getpid()) {
+        fprintf(stderr, "Instancja %d zajeta - dziala straznik PID=%d (inna instancja: JASKINIA_INSTANCJA=n)\n",
+            instancja_jaskini(), (int)pid);
+        return -1;
+    }
+    return 0;
+}
+
+#endif
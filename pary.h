@@ -0,0 +1,99 @@
+#ifndef PARY_H
+#define PARY_H
+
+#include "common.h"
+
+/// Rejestr par opiekun-dziecko w shared memory (KLUCZ_SHM_PARY)
+/// - generator zakłada wpis przed fork() pary i publikuje go zanim powstanie dziecko
+/// - kasjer sprawdza dziecko po wpisie - odczyt pamięci zamiast kill(pid_opiekuna, 0)
+/// - przewodnik trzyma parę razem: w jednej grupie i na jednej kładce
+/// - każdy członek przy wyjściu kasuje swój bit obecności, ostatni zwalnia wpis
+/// Identyfikator pary (indeks wpisu) dostają oba procesy w argv i podają go w wiadomościach.
+
+#define MAX_PAR (MAX_ZWIEDZAJACYCH / 2)  /// Więcej par nie zmieści się w limicie żyjących
+#define BRAK_PARY (-1)
+
+/// Stany wpisu
+#define PARA_WOLNA 0     /// Do wzięcia przez generator
+#define PARA_TWORZONA 1  /// Generator forkuje opiekuna
+#define PARA_AKTYWNA 2   /// Opiekun istnieje - dziecko może kupić bilet
+
+/// Bity obecności członków
+#define PARA_OPIEKUN 1
+#define PARA_DZIECKO 2
+#define PARA_PARTNER(bit) ((PARA_OPIEKUN | PARA_DZIECKO) ^ (bit))
+
+typedef struct {
+    int stan;             /// PARA_WOLNA/TWORZONA/AKTYWNA (atomiki)
+    int obecni;           /// PARA_OPIEKUN | PARA_DZIECKO - kto jeszcze nie wyszedł
+    pid_t pid_opiekuna;   /// Ustawiony przed publikacją
+    pid_t pid_dziecka;    /// Informacyjnie - ustawiany po fork() dziecka
+} Para;
+
+typedef struct {
+    int nastepny;         /// Od którego wpisu generator szuka wolnego (tylko generator)
+    Para pary[MAX_PAR];
+} ShmPary;
+
+static inline Para* para_wpis(ShmPary* p, int id) {
+    if (!p || id < 0 || id >= MAX_PAR) return NULL;
+    return &p->pary[id];
+}
+
+/// Zajmij wolny wpis (generator) - BRAK_PARY gdy rejestr pełny
+static inline int para_zaloz(ShmPary* p) {
+    for (int n = 0; n < MAX_PAR; n++) {
+        int id = (p->nastepny + n) % MAX_PAR;
+        int wolny = PARA_WOLNA;
+        if (__atomic_compare_exchange_n(&p->pary[id].stan, &wolny, PARA_TWORZONA, 0,
+                __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            p->pary[id].pid_opiekuna = 0;
+            p->pary[id].pid_dziecka = 0;
+            __atomic_store_n(&p->pary[id].obecni, PARA_OPIEKUN | PARA_DZIECKO, __ATOMIC_RELAXED);
+            p->nastepny = (id + 1) % MAX_PAR;
+            return id;
+        }
+    }
+    return BRAK_PARY;
+}
+
+/// Opiekun istnieje - od teraz kasjer uzna dziecko tej pary
+static inline void para_opublikuj(ShmPary* p, int id, pid_t pid_opiekuna) {
+    Para* w = para_wpis(p, id);
+    if (!w) return;
+    w->pid_opiekuna = pid_opiekuna;
+    __atomic_store_n(&w->stan, PARA_AKTYWNA, __ATOMIC_RELEASE);
+}
+
+/// Członek pary wychodzi (lub nigdy nie powstał) - ostatni zwalnia wpis
+static inline void para_opusc(ShmPary* p, int id, int bit) {
+    Para* w = para_wpis(p, id);
+    if (!w) return;
+    if (__atomic_and_fetch(&w->obecni, ~bit, __ATOMIC_ACQ_REL) == 0) {
+        __atomic_store_n(&w->stan, PARA_WOLNA, __ATOMIC_RELEASE);
+    }
+}
+
+/// Czy członek (bit) pary nadal jest w systemie
+static inline int para_obecny(ShmPary* p, int id, int bit) {
+    Para* w = para_wpis(p, id);
+    return w && (__atomic_load_n(&w->obecni, __ATOMIC_ACQUIRE) & bit) != 0;
+}
+
+/// Bit członka pary o danym PID (opiekun rozpoznawany po PID z wpisu)
+static inline int para_bit_czlonka(ShmPary* p, int id, pid_t pid) {
+    Para* w = para_wpis(p, id);
+    if (!w) return 0;
+    return w->pid_opiekuna == pid ? PARA_OPIEKUN : PARA_DZIECKO;
+}
+
+/// Kasjer: dziecko ma opiekuna z aktywnej pary, który jeszcze nie wyszedł
+static inline int para_potwierdz_dziecko(ShmPary* p, int id, pid_t pid_opiekuna) {
+    Para* w = para_wpis(p, id);
+    return w && pid_opiekuna > 0 &&
+        __atomic_load_n(&w->stan, __ATOMIC_ACQUIRE) == PARA_AKTYWNA &&
+        w->pid_opiekuna == pid_opiekuna &&
+        (__atomic_load_n(&w->obecni, __ATOMIC_ACQUIRE) & PARA_OPIEKUN) != 0;
+}
+
+#endif
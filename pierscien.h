@@ -0,0 +1,220 @@
+#ifndef PIERSCIEN_H
+#define PIERSCIEN_H
+
+#include "common.h"
+#include "common_helpers.h"
+#include "histogramy.h"
+
+/// Kolejki zwiedzających do przewodników w shared memory (KLUCZ_SHM_PIERSCIENIE) zamiast kolejek
+/// komunikatów - na każdą trasę i pas priorytetu jeden pierścień MPSC:
+/// - zwiedzający (wielu producentów) zajmuje slot CAS-em na jego stanie (sekwencja + swój PID),
+///   przesuwa ogon, wpisuje wiadomość i publikuje ją następną sekwencją; potem licznik przybyć
+///   trasy, a FUTEX_WAKE tylko gdy przewodnik śpi - zwykle kilka atomików bez wywołania systemowego
+/// - przewodnik (jedyny konsument) zdejmuje partią; slot zajęty przez proces, który zginął
+///   przed publikacją (SIGKILL), pomija - PID w stanie slotu mówi, czy jest na kogo czekać
+/// - na pustych pasach przewodnik śpi futeksem na liczniku przybyć do końca okna zbierania
+/// Pozycje 32-bitowe przewijają się - porównania przez różnicę ze znakiem.
+#define PIERSCIEN_SLOTY 1024  /// Potęga 2, >= MAX_ZWIEDZAJACYCH - żyjący stoi najwyżej w jednej kolejce
+_Static_assert((PIERSCIEN_SLOTY & (PIERSCIEN_SLOTY - 1)) == 0, "PIERSCIEN_SLOTY musi byc potega 2");
+_Static_assert(PIERSCIEN_SLOTY >= MAX_ZWIEDZAJACYCH, "Pierscien mniejszy niz limit zwiedzajacych");
+
+/// Pasy priorytetu - pas wynika z mtype wiadomości; który pas przewodnik bierze następny,
+/// decyduje PasyKolejki (przewodnik_helpers.h)
+#define TABELA_PASOW(X) \
+    X(PAS_POWRACAJACY, TYP_MSG_ZWIEDZAJACY_POWTORNY, 3, ETAP_KOLEJKA_POWRACAJACY, "powracajacy") \
+    X(PAS_ZWYKLY,      TYP_MSG_ZWIEDZAJACY,          1, ETAP_KOLEJKA_ZWYKLY,      "zwykly")
+
+#define PAS_ENUM(pas, typ, waga, etap, nazwa) pas,
+enum { TABELA_PASOW(PAS_ENUM) LICZBA_PASOW };
+#undef PAS_ENUM
+
+typedef struct {
+    long typ;          /// mtype wiadomości w tym pasie
+    int waga;          /// Domyślna waga
+    int etap;          /// Histogram czekania w kolejce tego pasu
+    const char* nazwa;
+} OpisPasu;
+
+#define PAS_OPIS(pas, typ, waga, etap, nazwa) { typ, waga, etap, nazwa },
+static const OpisPasu PASY[LICZBA_PASOW] = { TABELA_PASOW(PAS_OPIS) };
+#undef PAS_OPIS
+
+static inline int pas_wiadomosci(const WiadomoscPrzewodnik* w) {
+    for (int i = 0; i < LICZBA_PASOW; i++) {
+        if (PASY[i].typ == w->mtype) return i;
+    }
+    return PAS_ZWYKLY;
+}
+
+/// Stan slotu: sekwencja w górnych 32 bitach, PID producenta w dolnych. { pozycja, 0 } - wolny,
+/// { pozycja, pid } - zajęty, pid jeszcze pisze; { pozycja + 1, 0 } - wiadomość gotowa
+#define STAN_SLOTU(sekwencja, pid) (((uint64_t)(uint32_t)(sekwencja) << 32) | (uint32_t)(pid))
+#define SEKWENCJA_SLOTU(stan) ((uint32_t)((stan) >> 32))
+#define PID_SLOTU(stan) ((pid_t)(uint32_t)(stan))
+
+typedef struct {
+    uint64_t stan;
+    WiadomoscPrzewodnik wiadomosc;
+} SlotPierscienia;
+
+typedef struct {
+    uint32_t ogon;                                 /// Następna pozycja do zajęcia - producenci (CAS)
+    uint32_t glowa __attribute__((aligned(64)));   /// Następna do zdjęcia - tylko przewodnik
+    uint32_t porzucone;                            /// Pominięte sloty martwych producentów - tylko przewodnik
+    SlotPierscienia sloty[PIERSCIEN_SLOTY] __attribute__((aligned(64)));
+} Pierscien;
+
+typedef struct {
+    Pierscien pasy[LICZBA_PASOW];
+    uint32_t przybycia;  /// Futex: licznik wstawień do wszystkich pasów trasy
+    uint32_t spi;        /// Przewodnik śpi na przybycia - producent musi go obudzić
+} KolejkaTrasy;
+
+typedef struct {
+    KolejkaTrasy trasy[LICZBA_TRAS];
+} ShmPierscienie;
+
+/// Strażnik przed startem ról
+static inline void pierscienie_inicjalizuj(ShmPierscienie* s) {
+    memset(s, 0, sizeof(*s));
+    for (int t = 0; t < LICZBA_TRAS; t++) {
+        for (int p = 0; p < LICZBA_PASOW; p++) {
+            for (uint32_t i = 0; i < PIERSCIEN_SLOTY; i++) s->trasy[t].pasy[p].sloty[i].stan = STAN_SLOTU(i, 0);
+        }
+    }
+}
+
+/// Zajmij slot na ogonie - 0 OK (pozycja w *poz), -1 pierścień pełny (errno = EAGAIN).
+/// Slot zajmuje CAS na jego stanie, nie na ogonie - zajęcie i PID zajmującego to jeden zapis,
+/// więc nie ma chwili, w której śmierć producenta zostawia slot bez właściciela
+static inline int pierscien_zajmij(Pierscien* p, uint32_t* poz) {
+    uint32_t ogon = __atomic_load_n(&p->ogon, __ATOMIC_ACQUIRE);
+    for (;;) {
+        SlotPierscienia* s = &p->sloty[ogon & (PIERSCIEN_SLOTY - 1)];
+        uint64_t stan = __atomic_load_n(&s->stan, __ATOMIC_ACQUIRE);
+        int32_t roznica = (int32_t)(SEKWENCJA_SLOTU(stan) - ogon);
+        if (roznica == 0 && PID_SLOTU(stan) == 0) {
+            if (__atomic_compare_exchange_n(&s->stan, &stan, STAN_SLOTU(ogon, getpid()), 0,
+                __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+                uint32_t oczekiwany = ogon;
+                __atomic_compare_exchange_n(&p->ogon, &oczekiwany, ogon + 1, 0, __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+                *poz = ogon;
+                return 0;
+            }
+            /// Inny producent był szybszy - stan slotu przeczytamy jeszcze raz
+        }
+        else if (roznica == 0) {
+            /// Slot zajęty, a ogon stoi - zajmujący jeszcze go nie przesunął albo zginął; pomagamy
+            __atomic_compare_exchange_n(&p->ogon, &ogon, ogon + 1, 0, __ATOMIC_RELEASE, __ATOMIC_ACQUIRE);
+            ogon = __atomic_load_n(&p->ogon, __ATOMIC_ACQUIRE);
+        }
+        else if (roznica < 0) {  /// Slot z poprzedniego okrążenia jeszcze niezdjęty
+            errno = EAGAIN;
+            return -1;
+        }
+        else {
+            ogon = __atomic_load_n(&p->ogon, __ATOMIC_ACQUIRE);
+        }
+    }
+}
+
+/// Wpisz wiadomość w zajęty slot i opublikuj ją przewodnikowi
+static inline void pierscien_opublikuj(Pierscien* p, uint32_t poz, const WiadomoscPrzewodnik* w) {
+    SlotPierscienia* s = &p->sloty[poz & (PIERSCIEN_SLOTY - 1)];
+    s->wiadomosc = *w;
+    __atomic_store_n(&s->stan, STAN_SLOTU(poz + 1, 0), __ATOMIC_RELEASE);
+}
+
+/// Zajmij i opublikuj - 0 OK, -1 pierścień pełny (errno = EAGAIN)
+static inline int pierscien_wstaw(Pierscien* p, const WiadomoscPrzewodnik* w) {
+    uint32_t poz;
+    if (pierscien_zajmij(p, &poz) != 0) return -1;
+    pierscien_opublikuj(p, poz, w);
+    return 0;
+}
+
+/// Pomiń na czole sloty zajęte przez producentów, którzy zginęli przed publikacją (tylko przewodnik).
+/// Bez tego jeden SIGKILL między zajęciem a publikacją zatrzymałby pierścień na zawsze
+static inline void pierscien_pomin_porzucone(Pierscien* p) {
+    for (;;) {
+        SlotPierscienia* s = &p->sloty[p->glowa & (PIERSCIEN_SLOTY - 1)];
+        uint64_t stan = __atomic_load_n(&s->stan, __ATOMIC_ACQUIRE);
+        if (SEKWENCJA_SLOTU(stan) != p->glowa || PID_SLOTU(stan) == 0) return;  /// Gotowy albo wolny
+        if (czy_proces_zyje(PID_SLOTU(stan))) return;  /// Jeszcze pisze
+
+        uint32_t oczekiwany = p->glowa;  /// Zginął przed przesunięciem ogona - przesuwamy za niego
+        __atomic_compare_exchange_n(&p->ogon, &oczekiwany, p->glowa + 1, 0, __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+        if (!__atomic_compare_exchange_n(&s->stan, &stan, STAN_SLOTU(p->glowa + PIERSCIEN_SLOTY, 0), 0,
+            __ATOMIC_RELEASE, __ATOMIC_RELAXED)) return;
+        p->glowa++;
+        p->porzucone++;
+    }
+}
+
+/// Ile wiadomości od czoła jest gotowych, najwyżej n (tylko przewodnik)
+static inline int pierscien_gotowe(Pierscien* p, int n) {
+    pierscien_pomin_porzucone(p);
+    int gotowe = 0;
+    while (gotowe < n) {
+        uint32_t poz = p->glowa + (uint32_t)gotowe;
+        const SlotPierscienia* s = &p->sloty[poz & (PIERSCIEN_SLOTY - 1)];
+        if (__atomic_load_n(&s->stan, __ATOMIC_ACQUIRE) != STAN_SLOTU(poz + 1, 0)) break;
+        gotowe++;
+    }
+    return gotowe;
+}
+
+/// Wiadomość i-ta od czoła - tylko dla i < pierscien_gotowe()
+static inline const WiadomoscPrzewodnik* pierscien_podglad(const Pierscien* p, int i) {
+    return &p->sloty[(p->glowa + (uint32_t)i) & (PIERSCIEN_SLOTY - 1)].wiadomosc;
+}
+
+/// Zdejmij do n gotowych wiadomości partią (tylko przewodnik) - zwraca ile zdjęto
+static inline int pierscien_zdejmij(Pierscien* p, WiadomoscPrzewodnik* bufor, int n) {
+    uint32_t poz = p->glowa;
+    int zdjete = 0;
+    while (zdjete < n) {
+        SlotPierscienia* s = &p->sloty[poz & (PIERSCIEN_SLOTY - 1)];
+        if (__atomic_load_n(&s->stan, __ATOMIC_ACQUIRE) != STAN_SLOTU(poz + 1, 0)) break;
+        bufor[zdjete++] = s->wiadomosc;
+        __atomic_store_n(&s->stan, STAN_SLOTU(poz + PIERSCIEN_SLOTY, 0), __ATOMIC_RELEASE);  /// Slot wolny na następne okrążenie
+        poz++;
+    }
+    p->glowa = poz;
+    return zdjete;
+}
+
+/// Zwiedzający: dołącz do kolejki trasy w pasie z mtype - 0 OK, -1 pełny pierścień
+static inline int kolejka_wstaw(KolejkaTrasy* k, const WiadomoscPrzewodnik* w) {
+    przed_synchronizacja();  /// Przekazanie przewodnikowi bez wywołania systemowego - jak wyslij_msg
+    if (pierscien_wstaw(&k->pasy[pas_wiadomosci(w)], w) != 0) return -1;
+    __atomic_add_fetch(&k->przybycia, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&k->spi, __ATOMIC_SEQ_CST)) futex_jaskini(&k->przybycia, FUTEX_WAKE, 1, NULL);
+    return 0;
+}
+
+/// Przewodnik: śpij do przybycia, termin_ns (czas monotoniczny, 0 = bez limitu) albo sygnału.
+/// spi ustawione przed odczytem licznika - wstawienie po odczycie zmienia licznik (FUTEX_WAIT
+/// wraca od razu) albo widzi spi i budzi
+static inline void kolejka_czekaj(KolejkaTrasy* k, uint64_t termin_ns) {
+    __atomic_store_n(&k->spi, 1, __ATOMIC_SEQ_CST);
+    uint32_t przybycia = __atomic_load_n(&k->przybycia, __ATOMIC_SEQ_CST);
+
+    int pusta = 1;
+    for (int i = 0; i < LICZBA_PASOW; i++) {
+        if (pierscien_gotowe(&k->pasy[i], 1) > 0) pusta = 0;
+    }
+    uint64_t teraz = czas_monotoniczny_ns();
+    if (pusta && termin_ns == 0) {
+        futex_jaskini(&k->przybycia, FUTEX_WAIT, przybycia, NULL);
+    }
+    else if (pusta && termin_ns > teraz) {
+        uint64_t zostalo = termin_ns - teraz;
+        struct timespec limit = { .tv_sec = (time_t)(zostalo / 1000000000ULL),
+            .tv_nsec = (long)(zostalo % 1000000000ULL) };
+        futex_jaskini(&k->przybycia, FUTEX_WAIT, przybycia, &limit);
+    }
+    __atomic_store_n(&k->spi, 0, __ATOMIC_RELAXED);
+}
+
+#endif
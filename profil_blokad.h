@@ -0,0 +1,239 @@
+#ifndef PROFIL_BLOKAD_H
+#define PROFIL_BLOKAD_H
+
+#include "common.h"
+#include "histogramy.h"
+
+/// Profiler rywalizacji o blokady (opcjonalny) - włączany JASKINIA_PROFIL_BLOKAD=1
+/// Opakowuje semafory SysV (bezpieczny_semop/sem_wait/sem_signal) oraz mutexy
+/// i zmienne warunkowe pthread. Statystyki per miejsce wywołania (plik:linia + nazwa
+/// blokady) trafiają do segmentu shm, strażnik drukuje raport przy zamknięciu.
+/// Gdy wyłączony - każde opakowanie to jeden przewidywalny if przed zwykłym wywołaniem.
+///
+/// Stan procesu (tablica trzymanych blokad) jest statyczny w nagłówku - tak jak w slad.h.
+
+#define PROFIL_MAX_MIEJSC 64        /// Miejsc wywołań w segmencie (jest ich ~40)
+#define PROFIL_MAX_TRZYMANYCH 8     /// Blokad trzymanych naraz przez jeden proces
+
+/// Rodzaj blokady w miejscu wywołania
+enum {
+    PROFIL_SEMAFOR = 0,   /// semop -1 (P), czas trzymania do semop +1 (V)
+    PROFIL_MUTEX,         /// pthread_mutex_lock
+    PROFIL_COND,          /// pthread_cond_wait - czekanie zawsze liczone jako rywalizacja
+    LICZBA_RODZAJOW_BLOKAD
+};
+
+static const char* const NAZWY_RODZAJOW_BLOKAD[LICZBA_RODZAJOW_BLOKAD] = {
+    "sem", "mutex", "cond"
+};
+
+/// Statystyki jednego miejsca wywołania - liczniki atomowe, wielu pisarzy
+typedef struct {
+    uint32_t klucz;          /// Skrót plik:linia:nazwa, 0 = wolne miejsce
+    int gotowe;              /// Nazwy już wpisane (ustawiane po nich)
+    int rodzaj;              /// PROFIL_*
+    char nazwa[40];          /// Wyrażenie blokady, np. "&k1->mutex", "sem_trasa_mutex"
+    char miejsce[40];        /// "przewodnik_helpers.h:33"
+    uint64_t przejecia;      /// Wszystkie zdobycia
+    uint64_t z_czekaniem;    /// Zdobycia gdy blokada była zajęta
+    Histogram czekanie;      /// Czas czekania - tylko zdobycia z rywalizacją
+    Histogram trzymanie;     /// Zdobycie -> zwolnienie
+} MiejsceBlokady;
+
+typedef struct {
+    MiejsceBlokady miejsca[PROFIL_MAX_MIEJSC];
+} ShmProfilBlokad;
+
+/// Opis miejsca wywołania - statyczny w każdym miejscu, pamięta numer slotu
+typedef struct {
+    const char* nazwa;
+    const char* plik;
+    int linia;
+    int slot;                /// -1 = jeszcze nie szukany, -2 = brak miejsca w segmencie
+} MiejsceWywolania;
+
+/// Blokada trzymana przez ten proces - do policzenia czasu trzymania
+typedef struct {
+    uintptr_t blokada;       /// Adres mutexu lub zakodowany semafor (nieparzysty)
+    int slot;
+    uint64_t od_ns;
+} TrzymanaBlokada;
+
+static ShmProfilBlokad* profil_blokad = NULL;
+static TrzymanaBlokada profil_trzymane[PROFIL_MAX_TRZYMANYCH];
+static int profil_liczba_trzymanych = 0;
+
+/// Czy profiler aktywny - jedyny koszt opakowania gdy wyłączony
+#define PROFIL_AKTYWNY() __builtin_expect(profil_blokad != NULL, 0)
+
+/// Statyczny opis bieżącego miejsca wywołania (rozszerzenie GCC - wyrażenie blokowe)
+#define PROFIL_MIEJSCE(nazwa) \
+    ({ static MiejsceWywolania _miejsce = { (nazwa), __FILE__, __LINE__, -1 }; &_miejsce; })
+
+/// Semafor jako klucz tablicy trzymanych - nieparzysty, więc nie zderzy się z adresem mutexu
+static inline uintptr_t profil_klucz_semafora(int semid, int numer) {
+    return ((((uintptr_t)(unsigned)semid) << 16 | (uintptr_t)(unsigned)numer) << 1) | 1;
+}
+
+/// FNV-1a - skrót tekstu miejsca
+static inline uint32_t profil_skrot(const char* tekst) {
+    uint32_t h = 2166136261U;
+    while (*tekst) {
+        h ^= (uint8_t)*tekst++;
+        h *= 16777619U;
+    }
+    return h ? h : 1;
+}
+
+/// Znajdź lub zajmij slot miejsca wywołania - wynik zapamiętany w opisie miejsca
+static inline int profil_slot(MiejsceWywolania* m, int rodzaj) {
+    if (m->slot != -1) return m->slot;
+
+    char tekst[128];
+    snprintf(tekst, sizeof(tekst), "%s:%d:%s", m->plik, m->linia, m->nazwa);
+    uint32_t h = profil_skrot(tekst);
+
+    for (int i = 0; i < PROFIL_MAX_MIEJSC; i++) {
+        int idx = (int)((h + (uint32_t)i) % PROFIL_MAX_MIEJSC);
+        MiejsceBlokady* e = &profil_blokad->miejsca[idx];
+        uint32_t oczekiwany = 0;
+        if (__atomic_compare_exchange_n(&e->klucz, &oczekiwany, h, 0,
+            __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            /// Nasz nowy slot - wpisz opis, potem gotowe
+            e->rodzaj = rodzaj;
+            snprintf(e->nazwa, sizeof(e->nazwa), "%s", m->nazwa);
+            snprintf(e->miejsce, sizeof(e->miejsce), "%s:%d", m->plik, m->linia);
+            __atomic_store_n(&e->gotowe, 1, __ATOMIC_RELEASE);
+            return m->slot = idx;
+        }
+        if (oczekiwany == h) return m->slot = idx;  /// Inny proces już zajął to miejsce
+    }
+    return m->slot = -2;
+}
+
+/// Zapamiętaj zdobytą blokadę
+static inline void profil_trzymaj(uintptr_t blokada, int slot, uint64_t od_ns) {
+    if (profil_liczba_trzymanych == PROFIL_MAX_TRZYMANYCH) return;
+    TrzymanaBlokada* t = &profil_trzymane[profil_liczba_trzymanych++];
+    t->blokada = blokada;
+    t->slot = slot;
+    t->od_ns = od_ns;
+}
+
+/// Zwolnienie blokady - dopisz czas trzymania do miejsca które ją zdobyło
+static inline void profil_zwolnij(uintptr_t blokada) {
+    for (int i = profil_liczba_trzymanych - 1; i >= 0; i--) {
+        if (profil_trzymane[i].blokada != blokada) continue;
+
+        uint64_t teraz = czas_monotoniczny_ns();
+        histogram_dodaj(&profil_blokad->miejsca[profil_trzymane[i].slot].trzymanie,
+            teraz - profil_trzymane[i].od_ns);
+        profil_trzymane[i] = profil_trzymane[--profil_liczba_trzymanych];
+        return;
+    }
+    /// Nie znaleziono - zdobyta przed włączeniem profilera albo semafor liczący zwalniany gdzie indziej
+}
+
+/// Policz zdobycie w slocie
+static inline void profil_zdobyto(int slot, int z_czekaniem, uint64_t czekanie_ns) {
+    MiejsceBlokady* e = &profil_blokad->miejsca[slot];
+    __atomic_fetch_add(&e->przejecia, 1, __ATOMIC_RELAXED);
+    if (z_czekaniem) {
+        __atomic_fetch_add(&e->z_czekaniem, 1, __ATOMIC_RELAXED);
+        histogram_dodaj(&e->czekanie, czekanie_ns);
+    }
+}
+
+/// semop z pomiarem: P najpierw z IPC_NOWAIT - EAGAIN oznacza rywalizację
+static inline int profil_semop(int semid, struct sembuf* ops, MiejsceWywolania* m) {
+    uintptr_t klucz = profil_klucz_semafora(semid, ops->sem_num);
+
+    if (ops->sem_op > 0) {
+        int wynik = semop(semid, ops, 1);
+        if (wynik == 0) profil_zwolnij(klucz);
+        return wynik;
+    }
+
+    int slot = profil_slot(m, PROFIL_SEMAFOR);
+    uint64_t start = czas_monotoniczny_ns();
+    struct sembuf proba = *ops;
+    proba.sem_flg |= IPC_NOWAIT;
+    if (semop(semid, &proba, 1) == 0) {
+        if (slot >= 0) {
+            profil_zdobyto(slot, 0, 0);
+            profil_trzymaj(klucz, slot, start);
+        }
+        return 0;
+    }
+    if (errno != EAGAIN) return -1;
+
+    int wynik = semop(semid, ops, 1);
+    if (wynik == 0 && slot >= 0) {
+        uint64_t teraz = czas_monotoniczny_ns();
+        profil_zdobyto(slot, 1, teraz - start);
+        profil_trzymaj(klucz, slot, teraz);
+    }
+    return wynik;
+}
+
+/// pthread_mutex_lock z pomiarem: trylock najpierw - EBUSY oznacza rywalizację
+static inline int profil_mutex_lock(pthread_mutex_t* mutex, MiejsceWywolania* m) {
+    if (!PROFIL_AKTYWNY()) return pthread_mutex_lock(mutex);
+
+    int slot = profil_slot(m, PROFIL_MUTEX);
+    uint64_t start = czas_monotoniczny_ns();
+    int wynik = pthread_mutex_trylock(mutex);
+    int z_czekaniem = 0;
+    if (wynik == EBUSY) {
+        wynik = pthread_mutex_lock(mutex);
+        z_czekaniem = 1;
+    }
+    if (wynik != 0 || slot < 0) return wynik;
+
+    uint64_t teraz = z_czekaniem ? czas_monotoniczny_ns() : start;
+    profil_zdobyto(slot, z_czekaniem, teraz - start);
+    profil_trzymaj((uintptr_t)mutex, slot, teraz);
+    return 0;
+}
+
+static inline int profil_mutex_unlock(pthread_mutex_t* mutex) {
+    przed_synchronizacja();
+    if (PROFIL_AKTYWNY()) profil_zwolnij((uintptr_t)mutex);
+    return pthread_mutex_unlock(mutex);
+}
+
+/// pthread_cond_wait z pomiarem - oddanie mutexu kończy trzymanie, obudzenie zaczyna nowe
+static inline int profil_cond_wait(pthread_cond_t* cond, pthread_mutex_t* mutex, MiejsceWywolania* m) {
+    przed_synchronizacja();
+    if (!PROFIL_AKTYWNY()) return pthread_cond_wait(cond, mutex);
+
+    int slot = profil_slot(m, PROFIL_COND);
+    profil_zwolnij((uintptr_t)mutex);
+    uint64_t start = czas_monotoniczny_ns();
+    int wynik = pthread_cond_wait(cond, mutex);
+    if (slot < 0) return wynik;
+
+    uint64_t teraz = czas_monotoniczny_ns();
+    profil_zdobyto(slot, 1, teraz - start);
+    profil_trzymaj((uintptr_t)mutex, slot, teraz);
+    return wynik;
+}
+
+/// Opakowania pthread z miejscem wywołania
+#define zablokuj_mutex(mutex) profil_mutex_lock((mutex), PROFIL_MIEJSCE(#mutex))
+#define odblokuj_mutex(mutex) profil_mutex_unlock((mutex))
+#define czekaj_cond(cond, mutex) profil_cond_wait((cond), (mutex), PROFIL_MIEJSCE(#cond))
+
+/// Włącz profiler jeśli JASKINIA_PROFIL_BLOKAD ustawione i segment istnieje - wywołaj na początku main()
+static inline void profil_blokad_inicjalizuj(void) {
+    const char* env = getenv("JASKINIA_PROFIL_BLOKAD");
+    if (!env || env[0] == '\0' || strcmp(env, "0") == 0) return;
+
+    int shmid = shmget(KLUCZ_SHM_PROFIL_BLOKAD, 0, 0);
+    if (shmid == -1) return;
+    void* adres = shmat(shmid, NULL, 0);
+    if (adres == (void*)-1) return;
+    profil_blokad = (ShmProfilBlokad*)adres;
+}
+
+#endif
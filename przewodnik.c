@@ -1,140 +1,140 @@
 #include "common.h"
 #include "common_helpers.h"
 #include "przewodnik_helpers.h"
-
-int globalny_semid_log = -1;
+#include "histogramy.h"
+#include "metryki.h"
+#include "slad.h"
+#include "loguj.h"
 
 /// Flagi volatile sig_atomic_t - bezpieczne w handlerach sygnaw
-volatile sig_atomic_t kontynuuj = 1;
-volatile sig_atomic_t zamkniecie_otrzymane = 0;  /// Czy dostalimy sygna zamknicia (SIGUSR1/2)
-volatile sig_atomic_t na_trasie = 0;             /// Czy aktualnie prowadzimy grup po trasie
-volatile sig_atomic_t alarm_otrzymany = 0;       /// Czy timeout zbierania grupy min
-
-void obsluga_sigterm(int sig) { (void)sig; kontynuuj = 0; }
-void obsluga_zamkniecie(int sig) { (void)sig; zamkniecie_otrzymane = 1; }  /// SIGUSR1 lub SIGUSR2
-void obsluga_alarm(int sig) { (void)sig; alarm_otrzymany = 1; }
-
-int NUMER;  /// Numer trasy: 1 lub 2
-
-void loguj_wiadomosc(const char* wiadomosc) {
-    /// Log do pliku przewodnik1.log lub przewodnik2.log
-    char nazwa_pliku[64];
-    snprintf(nazwa_pliku, sizeof(nazwa_pliku), "jaskinia_przewodnik%d.log", NUMER);
-
-    int sem_zdobyty = 0;
-    char ts[64], buf[512];
-
-    if (globalny_semid_log != -1) {
-        struct sembuf op = { 0, -1, 0 };
-        if (bezpieczny_semop(globalny_semid_log, &op, 1) == 0) {
-            sem_zdobyty = 1;
-        }
-    }
+static volatile sig_atomic_t kontynuuj = 1;
+static volatile sig_atomic_t zamkniecie_otrzymane = 0;  /// Czy dostalimy sygna zamknicia (z TABELA_TRAS)
+static volatile sig_atomic_t na_trasie = 0;             /// Czy aktualnie prowadzimy grup po trasie
 
-    time_t teraz = time(NULL);
-    strftime(ts, sizeof(ts), "%Y-%m-%d %H:%M:%S", localtime(&teraz));
-    snprintf(buf, sizeof(buf), "[%s] [PID:%d] [PRZEWODNIK%d] %s\n", ts, getpid(), NUMER, wiadomosc);
+static void obsluga_sigterm(int sig) { (void)sig; kontynuuj = 0; }
+static void obsluga_zamkniecie(int sig) { (void)sig; zamkniecie_otrzymane = 1; }  /// Sygna zamknicia trasy
 
-    int fd = open("jaskinia_common.log", O_WRONLY | O_CREAT | O_APPEND, 0644);
-    if (fd != -1) {
-        bezpieczny_zapis_wszystko(fd, buf, strlen(buf));
-        close(fd);
-    }
+static int NUMER;  /// Numer trasy: 1..LICZBA_TRAS
 
-    fd = open(nazwa_pliku, O_WRONLY | O_CREAT | O_APPEND, 0644);
-    if (fd != -1) {
-        bezpieczny_zapis_wszystko(fd, buf, strlen(buf));
-        close(fd);
-    }
+/// Zmiana sekcji naszej trasy na stronie metryk - w kodzie dostpna jako mt
+#define METRYKI_TRASY(kod) \
+    METRYKI_ZAPIS(trasy[NUMER - 1], MetrykiTrasa* mt = &globalne_metryki->trasy[NUMER - 1]; kod)
 
-    if (sem_zdobyty) {
-        struct sembuf op = { 0, 1, 0 };
-        bezpieczny_semop(globalny_semid_log, &op, 1);
-    }
-}
-
-void loguj_wiadomoscf(const char* format, ...) {
-    char wiadomosc[512];
-    va_list args;
-    va_start(args, format);
-    vsnprintf(wiadomosc, sizeof(wiadomosc), format, args);
-    va_end(args);
-    loguj_wiadomosc(wiadomosc);
-}
-
-int main(int argc, char* argv[]) {
+int main_przewodnik(int argc, char* argv[]) {
     if (argc != 2) {
-        fprintf(stderr, "Uzycie: %s <1|2>\n", argv[0]);
+        fprintf(stderr, "Uzycie: %s <1..%d>\n", argv[0], LICZBA_TRAS);
         return 1;
     }
 
-    /// Walidacja argumentu - musi by 1 lub 2
+    /// Walidacja argumentu - numer trasy z TABELA_TRAS
     int tmp;
-    if (bezpieczny_strtol(argv[1], &tmp, 1, 2) != 0) {
-        fprintf(stderr, "ERROR: Numer musi byc 1 lub 2\n");
+    if (bezpieczny_strtol(argv[1], &tmp, 1, LICZBA_TRAS) != 0) {
+        fprintf(stderr, "ERROR: Numer musi byc 1..%d\n", LICZBA_TRAS);
         return 1;
     }
     NUMER = tmp;
+    const OpisTrasy* opis_trasy = &TRASY[NUMER - 1];
 
     signal(SIGTERM, obsluga_sigterm);
-    signal(NUMER == 1 ? SIGUSR1 : SIGUSR2, obsluga_zamkniecie);  /// Kady przewodnik ma swj sygna!
-    signal(SIGALRM, obsluga_alarm);
+    signal(opis_trasy->sygnal, obsluga_zamkniecie);  /// Kady przewodnik ma swj sygna!
     signal(SIGINT, SIG_IGN);
 
-    INIT_SEMAFOR_LOG();
+    profil_blokad_inicjalizuj();
+    loguj_inicjalizuj(ROLA_PRZEWODNIK(NUMER));
+    slad_inicjalizuj(NAZWY_ROL[ROLA_PRZEWODNIK(NUMER)]);
 
     loguj_wiadomosc("START");
-    loguj_wiadomoscf("Obsluguje %s", NUMER == 1 ? "SIGUSR1" : "SIGUSR2");
+    loguj_wiadomoscf("Obsluguje %s", nazwa_sygnalu(opis_trasy->sygnal));
 
-    srand(time(NULL) ^ getpid());
+    srand(ziarno_losowania(1 + NUMER));
 
     /// Podcz si do wszystkich potrzebnych struktur
     ShmJaskinia* shm_j = NULL;
-    ShmKladka* shm_k1 = NULL;
-    ShmKladka* shm_k2 = NULL;
-    ShmTrasa* shm_t = NULL;
+    ShmKladka* shm_kladki = NULL;
+    ShmTrasa* shm_trasy = NULL;
+    ShmPary* shm_pary = NULL;
 
     if (podlacz_shm_helper(KLUCZ_SHM_JASKINIA, (void**)&shm_j) == -1 ||
-        podlacz_shm_helper(KLUCZ_SHM_KLADKA1, (void**)&shm_k1) == -1 ||
-        podlacz_shm_helper(KLUCZ_SHM_KLADKA2, (void**)&shm_k2) == -1 ||
-        podlacz_shm_helper(NUMER == 1 ? KLUCZ_SHM_TRASA1 : KLUCZ_SHM_TRASA2, (void**)&shm_t) == -1) {
-        loguj_wiadomosc("ERROR: Nie mozna podlaczyc pamieci wspoldzielonej");
+        podlacz_shm_helper(KLUCZ_SHM_KLADKI, (void**)&shm_kladki) == -1 ||
+        podlacz_shm_helper(KLUCZ_SHM_TRASY, (void**)&shm_trasy) == -1 ||
+        podlacz_shm_helper(KLUCZ_SHM_PARY, (void**)&shm_pary) == -1) {
+        loguj_blad("ERROR: Nie mozna podlaczyc pamieci wspoldzielonej");
         BEZPIECZNY_SHMDT(shm_j);
-        BEZPIECZNY_SHMDT(shm_k1);
-        BEZPIECZNY_SHMDT(shm_k2);
-        BEZPIECZNY_SHMDT(shm_t);
+        BEZPIECZNY_SHMDT(shm_kladki);
+        BEZPIECZNY_SHMDT(shm_trasy);
+        BEZPIECZNY_SHMDT(shm_pary);
         return 1;
     }
+    ShmTrasa* shm_t = &shm_trasy[NUMER - 1];  /// Licznik naszej trasy
 
-    loguj_wiadomoscf("Przewodnik %d wystartowany PID=%d", NUMER, getpid());
+    /// Histogramy etapw - opcjonalne, mierzymy kolejk i zbieranie grupy
+    ShmHistogramy* shm_hist = NULL;
+    if (podlacz_shm_helper(KLUCZ_SHM_HISTOGRAMY, (void**)&shm_hist) == -1) {
+        loguj_ostrzezenie("WARN: Brak histogramow etapow - pomiary wylaczone");
+        shm_hist = NULL;
+    }
+    globalne_metryki = podlacz_metryki();
+    if (!globalne_metryki) {
+        loguj_ostrzezenie("WARN: Brak strony metryk - jaskinia-top nie zobaczy trasy");
+    }
 
-    int sem1_miejsca = podlacz_sem_helper(KLUCZ_SEM_KLADKA1_MIEJSCA);
-    int sem2_miejsca = podlacz_sem_helper(KLUCZ_SEM_KLADKA2_MIEJSCA);
-    int sem_trasa_mutex = podlacz_sem_helper(NUMER == 1 ? KLUCZ_SEM_TRASA1_MUTEX : KLUCZ_SEM_TRASA2_MUTEX);
-    int msgid = podlacz_msg_helper(NUMER == 1 ? KLUCZ_MSG_PRZEWODNIK1 : KLUCZ_MSG_PRZEWODNIK2);
+    loguj_wiadomoscf("Przewodnik %d wystartowany PID=%d", NUMER, getpid());
 
-    if (sem1_miejsca == -1 || sem2_miejsca == -1 || sem_trasa_mutex == -1 || msgid == -1) {
-        loguj_wiadomosc("ERROR: Nie mozna podlaczyc semaforow lub kolejki");
+    int sem_kladki = podlacz_sem_helper(KLUCZ_SEM_KLADKI_MIEJSCA);
+    ShmPierscienie* shm_pierscienie = NULL;  /// Kolejki do przewodnikw (pierscien.h)
+    if (sem_kladki == -1 || podlacz_shm_helper(KLUCZ_SHM_PIERSCIENIE, (void**)&shm_pierscienie) == -1) {
+        loguj_blad("ERROR: Nie mozna podlaczyc semaforow lub kolejki");
+        BEZPIECZNY_SHMDT(shm_pierscienie);
         BEZPIECZNY_SHMDT(shm_j);
-        BEZPIECZNY_SHMDT(shm_k1);
-        BEZPIECZNY_SHMDT(shm_k2);
-        BEZPIECZNY_SHMDT(shm_t);
+        BEZPIECZNY_SHMDT(shm_kladki);
+        BEZPIECZNY_SHMDT(shm_trasy);
+        BEZPIECZNY_SHMDT(shm_pary);
+        BEZPIECZNY_SHMDT(shm_hist);
+        BEZPIECZNY_SHMDT(globalne_metryki);
         return 1;
     }
 
-    int max_osoby = (NUMER == 1) ? N1 : N2;
-    int czas = (NUMER == 1) ? T1 : T2;
+    int max_osoby = opis_trasy->pojemnosc;
+    int czas = opis_trasy->czas_s;
+
+    /// Kadki trasy w kolejnoci przechodzenia - grupa dzielona midzy nie
+    int kladki_trasy[MAX_KLADEK];
+    int liczba_kladek = 0;
+    int max_na_kladce = 0;
+    for (int i = 0; i < LICZBA_KLADEK; i++) {
+        if (!(opis_trasy->maska_kladek & (1U << i))) continue;
+        kladki_trasy[liczba_kladek++] = i + 1;
+        if (KLADKI[i].pojemnosc > max_na_kladce) max_na_kladce = KLADKI[i].pojemnosc;
+    }
+    int na_kladke[MAX_KLADEK];
 
-    loguj_wiadomoscf("Gotowy: max=%d czas=%ds K=%d", max_osoby, czas, K);
+    loguj_wiadomoscf("Gotowy: max=%d czas=%ds K=%d kladki=%#x", max_osoby, czas, max_na_kladce,
+        opis_trasy->maska_kladek);
 
+    /// Zbieranie koczy si przed CZAS_ZBIERANIA_GRUPY, gdy redni odstp przyby w oknie
+    /// (oczekiwane czekanie na nastpn osob) przekracza prg - 0 wycza
+    int prog_czekania_ms = parametr_env("JASKINIA_PROG_CZEKANIA_MS", 2000, 0, 60000);
+    uint64_t prog_czekania_ns = (uint64_t)prog_czekania_ms * 1000000ULL;
+
+    /// Okno zbierania dobierane do tempa przyby i celu (przewodnik_helpers.h)
+    OknoZbierania okno = { .odstep_ewma_s = OKNO_ODSTEP_POCZATKOWY, .waga_czekania = okno_waga_z_env(),
+        .okno_max_s = CZAS_ZBIERANIA_GRUPY, .czas_wycieczki_s = czas };
+    loguj_wiadomoscf("Zbieranie: okno<=%ds waga_czekania=%.2f prog_czekania=%dms",
+        CZAS_ZBIERANIA_GRUPY, okno.waga_czekania, prog_czekania_ms);
+    uint64_t okna_grup = 0, okna_suma_ms = 0, okna_osob = 0;  /// Podsumowanie przy zamkniciu
+
+    /// Powracajcy zbierani pierwsi, zwykli bez zagodzenia (pasy w przewodnik_helpers.h)
+    PasyKolejki pasy;
+    pasy_z_env(&pasy);
+    loguj_wiadomoscf("Pasy kolejki: waga powracajacych=%d zwyklych=%d", pasy.waga[PAS_POWRACAJACY], pasy.waga[PAS_ZWYKLY]);
+
+    KolejkaTrasy* kolejka = &shm_pierscienie->trasy[NUMER - 1];
+
+    zglos_gotowosc(shm_j);  /// Kolejka podczona - stranik moe otwiera
     loguj_wiadomosc("Czekam na otwarcie jaskini (Tp)");
 
     /// Czekaj a jaskinia si otworzy
-    pthread_mutex_lock(&shm_j->mutex);
-    while (!shm_j->otwarta && kontynuuj) {
-        pthread_cond_wait(&shm_j->cond_otwarta, &shm_j->mutex);
-    }
-    pthread_mutex_unlock(&shm_j->mutex);
+    czekaj_na_otwarcie(shm_j, &kontynuuj);
 
     if (!kontynuuj) {
         loguj_wiadomosc("SHUTDOWN przed otwarciem jaskini");
@@ -143,178 +143,289 @@ int main(int argc, char* argv[]) {
 
     loguj_wiadomosc("Jaskinia otwarta - rozpoczynam prace");
 
+    /// Ostatni bezpieczny start liczony z Ti, przejcia kadek i zmierzonego czekania na nie
+    TerminDnia termin = { .koniec_dnia_ns = shm_j->koniec_dnia_ns, .czas_wycieczki_s = czas };  /// Opublikowany przed otwarciem
+    int po_terminie = 0;  /// Zalogowano ju, e min ostatni bezpieczny start
+    if (termin.koniec_dnia_ns > 0) {
+        loguj_wiadomoscf("Ostatni bezpieczny start pelnej grupy za %.1f s (wycieczka z kladkami %.1f s)",
+            termin_zapas_s(&termin, max_osoby, czas_monotoniczny_ns()), termin_potrzebny_s(&termin, max_osoby));
+    }
+
     WiadomoscPrzewodnik wiadomosc;
 
+    /// Grupa w budowie - pary opiekun-dziecko trzymane razem (przewodnik_helpers.h)
+    pid_t grupa[MAX_POJEMNOSC_TRASY];
+    WiadomoscPrzewodnik czlonkowie[MAX_POJEMNOSC_TRASY];
+    uint64_t odebrano_ns[MAX_POJEMNOSC_TRASY];  /// Kiedy kady wszed do grupy
+    SkladGrupy sklad = { .pidy = grupa, .czlonkowie = czlonkowie, .odebrano_ns = odebrano_ns,
+        .max = max_osoby, .pary = shm_pary };
+
     /// GWNA PTLA - zbieramy grupy i prowadzimy wycieczki
     while (kontynuuj) {
         /// Sprawd czy jaskinia dalej otwarta
-        pthread_mutex_lock(&shm_j->mutex);
-        int otwarta = shm_j->otwarta;
-        pthread_mutex_unlock(&shm_j->mutex);
+        int otwarta = jaskinia_otwarta(shm_j);  /// Load-acquire, bez mutexu
 
         if (!otwarta) {
+            METRYKI_TRASY(mt->faza = FAZA_ZAMKNIETY);
             loguj_wiadomosc("Jaskinia zamknieta, czekam na SIGTERM");
-            while (kontynuuj) sleep(1);
+            while (kontynuuj) sen_s(1);
             break;
         }
 
-        pid_t grupa[max_osoby];
-        int liczba = 0;
-
-        loguj_wiadomosc("Zbieram grupe");
-
-        /// Zbieranie grupy - max CZAS_ZBIERANIA_GRUPY sekund
-        alarm_otrzymany = 0;
-        alarm(CZAS_ZBIERANIA_GRUPY);
-
-        while (liczba < max_osoby && !alarm_otrzymany) {
-            ssize_t wynik = msgrcv(msgid, &wiadomosc, sizeof(WiadomoscPrzewodnik) - sizeof(long),
-                TYP_MSG_ZWIEDZAJACY, 0);  /// Blocking - czekamy na zwiedzajcych
-
-            if (wynik != -1) {
-                grupa[liczba++] = wiadomosc.pid_zwiedzajacego;
+        /// Zbieramy tylko tyle, ile trasa pomieci - reszta zostaje w kolejce zamiast by odwoana
+        int wolne_na_trasie = max_osoby - trasa_osoby(shm_t);
+        grupa_zacznij(&sklad, wolne_na_trasie);  /// Najpierw odoeni przy poprzedniej grupie
+
+        METRYKI_TRASY(mt->faza = FAZA_ZBIERANIE);
+        loguj_zdarzenie(DZ_PR_ZBIERAM);
+
+        /// Zbieranie grupy - pusta grupa czeka na pierwsz osob maks. CZAS_ZBIERANIA_GRUPY,
+        /// potem termin (od pierwszego czonka) wyznacza okno_wybierz, przeliczane przy kadym przybyciu
+        uint64_t slad_zbierania = SLAD_START();
+        uint64_t poczatek_zbierania_ns = czas_monotoniczny_ns();
+        uint64_t pierwszy_ns = sklad.liczba > 0 ? poczatek_zbierania_ns : 0;
+        double okno_s = -1.0;  /// -1 = nikt nie przyszed, okna nie wybrano
+        int przybylo = 0;
+        int pelna = 0;         /// Para si nie zmiecia - nie dobieramy kolejnych
+        int koniec_okna = 0;
+        double okno_teraz_s;   /// Ile okna zostao od teraz
+
+        /// Okno nie siga za ostatni bezpieczny start penej grupy - po nim tylko ci, co ju czekaj
+        if (pierwszy_ns > 0) {
+            okno_s = termin_przytnij_okno(&termin, max_osoby,
+                okno_wybierz(&okno, sklad.liczba + sklad.zarezerwowane, sklad.max));
+            okno_teraz_s = okno_s;
+        }
+        else {
+            okno_teraz_s = termin_przytnij_okno(&termin, max_osoby, okno.okno_max_s);
+        }
+        koniec_okna = okno_teraz_s <= 0.0;
+        uint64_t termin_zbierania_ns = poczatek_zbierania_ns + (uint64_t)(okno_teraz_s * 1e9);
+
+        /// Przewodnik pi na kolejce trasy (futex) najwyej do koca okna
+        while (!koniec_okna && grupa_miejsca(&sklad) > 0) {
+            if (!pasy_odbierz(&pasy, kolejka, &wiadomosc, grupa_miejsca(&sklad), termin_zbierania_ns)) {
+                if (czas_monotoniczny_ns() >= termin_zbierania_ns) break;  /// Termin min - bierzemy co mamy
+                continue;  /// Sygna przerwa czekanie
             }
-            else if (errno == EINTR) {
-                if (alarm_otrzymany) {  /// Timeout - bierzemy co mamy
-                    break;
-                }
-                continue;
+
+            METRYKI_DODAJ(zwiedzajacy.kolejka_przewodnik[NUMER - 1], -1);
+            okno_przybycie(&okno, wiadomosc.czas_dolaczenia_ns);
+            if (grupa_przyjmij(&sklad, &wiadomosc)) {  /// Para ju si nie mieci - grupa pena
+                pelna = 1;
+                break;
             }
-            else if (errno == EIDRM) {
-                loguj_wiadomosc("Kolejka usunieta, zamykam");
-                alarm(0);
-                goto cleanup;
+            przybylo++;
+            uint64_t teraz = czas_monotoniczny_ns();
+            if (pierwszy_ns == 0) pierwszy_ns = teraz;
+            uint64_t sredni_odstep_ns = (teraz - poczatek_zbierania_ns) / (uint64_t)przybylo;
+            if (prog_czekania_ns > 0 && sredni_odstep_ns > prog_czekania_ns) {
+                okno_s = (double)(teraz - pierwszy_ns) / 1e9;  /// Nie warto czeka dalej - okno koczy si teraz
+                break;
             }
+
+            okno_s = okno_wybierz(&okno, sklad.liczba + sklad.zarezerwowane, sklad.max);
+            double zostalo = termin_przytnij_okno(&termin, max_osoby, okno_s - (double)(teraz - pierwszy_ns) / 1e9);
+            if (zostalo <= 0.0) break;
+            termin_zbierania_ns = teraz + (uint64_t)(zostalo * 1e9);
+        }
+
+        /// Kto ju czeka w kolejce, wchodzi bez czekania - okno dotyczy tylko nowych przyby
+        while (!pelna && grupa_miejsca(&sklad) > 0 &&
+            pasy_odbierz(&pasy, kolejka, &wiadomosc, grupa_miejsca(&sklad), 0)) {
+            METRYKI_DODAJ(zwiedzajacy.kolejka_przewodnik[NUMER - 1], -1);
+            okno_przybycie(&okno, wiadomosc.czas_dolaczenia_ns);
+            if (grupa_przyjmij(&sklad, &wiadomosc)) break;
         }
 
-        alarm(0);
+        grupa_zakoncz(&sklad);  /// Czonek pary bez partnera czeka na nastpn grup
+        int liczba = sklad.liczba;
 
         if (liczba == 0) {
-            usleep(500000);  /// P sekundy przerwy jeli nikt nie czeka
+            sen_us(500000);  /// P sekundy przerwy jeli nikt nie czeka
             continue;
         }
 
-        loguj_wiadomoscf("Grupa zebrana: %d zwiedzajacych", liczba);
+        SLAD_KONIEC(SLAD_ZBIERANIE_GRUPY, slad_zbierania, liczba);
+        uint64_t zebrano_ns = czas_monotoniczny_ns();
+
+        loguj_zdarzenie(DZ_PR_GRUPA_ZEBRANA, liczba);
 
         /// WANE: Sprawd czy nie dostalimy sygnau zamknicia PRZED wejciem na tras
         sigset_t maska, stara_maska;
         sigemptyset(&maska);
-        sigaddset(&maska, NUMER == 1 ? SIGUSR1 : SIGUSR2);
+        sigaddset(&maska, opis_trasy->sygnal);
         sigprocmask(SIG_BLOCK, &maska, &stara_maska);
 
         int czy_odwolac = (zamkniecie_otrzymane && !na_trasie);
         sigprocmask(SIG_SETMASK, &stara_maska, NULL);
 
-        if (czy_odwolac) {
-            /// Dostalimy sygna zamknicia PRZED tras - odwoujemy grup
-            loguj_wiadomoscf("Sygnal zamkniecia przed trasa - odwoluje grupe %d osob", liczba);
+        /// Grupa, ktra nie zejdzie z kadek przed Tk, nie startuje - stranik nie musi jej odwoywa
+        double zapas_s = termin_zapas_s(&termin, liczba, czas_monotoniczny_ns());
+        int za_pozno = !czy_odwolac && zapas_s < 0.0;
+
+        if (czy_odwolac || za_pozno) {
+            /// Dostalimy sygna zamknicia PRZED tras albo grupa nie zdy - odwoujemy grup
+            METRYKI_TRASY(mt->grupy_anulowane++);
+            if (za_pozno) {
+                if (!po_terminie) {
+                    loguj_wiadomoscf("Minal ostatni bezpieczny start (brakuje %.1f s, czekanie na kladki %.1f/%.1f s)",
+                        -zapas_s, termin.czekanie_wejscie_s, termin.czekanie_wyjscie_s);
+                    po_terminie = 1;
+                }
+                loguj_wiadomoscf("Grupa nie zdazy przed Tk - odwoluje grupe %d osob", liczba);
+            }
+            else {
+                loguj_wiadomoscf("Sygnal zamkniecia przed trasa - odwoluje grupe %d osob", liczba);
+            }
             for (int i = 0; i < liczba; i++) {
-                if (czy_proces_zyje(grupa[i])) kill(grupa[i], SIGUSR1);  /// SIGUSR1 = odwoanie
+                if (czy_proces_zyje(grupa[i])) wyslij_sygnal(grupa[i], SIGUSR1);  /// SIGUSR1 = odwoanie
             }
             continue;
         }
 
-        /// Sygna do grupy: "jestecie w grupie, czekajcie"
-        wyslij_sygnal_do_grupy(grupa, liczba, SIGRTMIN + 0, "grupa zebrana");
-
-        loguj_wiadomosc("Rezerwuje miejsca na trasie");
+        loguj_zdarzenie(DZ_PR_REZERWUJE);
+
+        /// Rezerwuj miejsca atomowo (CAS) - grupa zbierana na wolne miejsca, wic zwykle wchodzi caa
+        uint64_t slad_rezerwacji = SLAD_START();
+        int poprzednia_wartosc;
+        int miesci_sie = trasa_rezerwuj(shm_t, liczba, max_osoby, &poprzednia_wartosc);
+
+        if (liczba > miesci_sie) {
+            /// Trasa zajta od pocztku zbierania - nadwyka (pary w caoci) wraca na pocztek kolejki
+            int zostaje = granica_bez_rozdzielania(czlonkowie, liczba, miesci_sie, -1);
+            if (zostaje < miesci_sie) trasa_zwolnij(shm_t, miesci_sie - zostaje);  /// Para by si rozdzielia - oddaj miejsca
+            grupa_oddaj(&sklad, zostaje);
+            loguj_ostrzezenie("WARN: Trasa Ni=%d zajeta (bylo=%d) - %d osob czeka na nastepna grupe",
+                max_osoby, poprzednia_wartosc, liczba - zostaje);
+            liczba = zostaje;
+        }
 
-        /// Rezerwuj miejsca atomowo - sprawd czy nie przekroczymy Ni
-        bezpieczny_sem_wait(sem_trasa_mutex, 0);
-        int poprzednia_wartosc = shm_t->osoby;
         int nowa_wartosc = poprzednia_wartosc + liczba;
+        METRYKI_TRASY(mt->osoby = nowa_wartosc);
+        SLAD_KONIEC(SLAD_REZERWACJA_TRASY, slad_rezerwacji, liczba);
 
-        if (nowa_wartosc > max_osoby) {
-            /// Za duo! Cz grupy musimy odrzuci
-            int dozwolone = max_osoby - poprzednia_wartosc;
-            if (dozwolone < 0) dozwolone = 0;
-
-            loguj_wiadomoscf("WARN: Limit trasy Ni=%d! bylo=%d dozwolone=%d", max_osoby, poprzednia_wartosc, dozwolone);
-
-            shm_t->osoby = max_osoby;
-            bezpieczny_sem_signal(sem_trasa_mutex, 0);
-
-            /// Odrzu nadwyk
-            for (int i = dozwolone; i < liczba; i++) {
-                if (czy_proces_zyje(grupa[i])) {
-                    kill(grupa[i], SIGUSR1);
-                    loguj_wiadomoscf("Odrzucono PID=%d (przekroczenie limitu)", grupa[i]);
-                }
-            }
+        if (liczba == 0) {
+            loguj_ostrzezenie("Trasa pelna - cala grupa czeka na nastepna");
+            continue;
+        }
 
-            liczba = dozwolone;
-            if (liczba == 0) {
-                loguj_wiadomosc("Cala grupa odrzucona - limit trasy osiagniety");
-                continue;
+        for (int i = 0; i < liczba; i++) {
+            if (czlonkowie[i].czas_dolaczenia_ns > 0 && odebrano_ns[i] >= czlonkowie[i].czas_dolaczenia_ns) {
+                histogram_zapisz(shm_hist, ETAP_KOLEJKA, odebrano_ns[i] - czlonkowie[i].czas_dolaczenia_ns);
+                histogram_zapisz(shm_hist, PASY[pas_wiadomosci(&czlonkowie[i])].etap,
+                    odebrano_ns[i] - czlonkowie[i].czas_dolaczenia_ns);
             }
+            histogram_zapisz(shm_hist, ETAP_ZBIERANIE, zebrano_ns - odebrano_ns[i]);
         }
-        else {
-            shm_t->osoby = nowa_wartosc;
-            bezpieczny_sem_signal(sem_trasa_mutex, 0);
+
+        /// Sygna do grupy: "jestecie w grupie, czekajcie" - dopiero gdy miejsca s pewne
+        wyslij_sygnal_do_grupy(grupa, liczba, SIGRTMIN + 0, "grupa zebrana");
+
+        int okno_ms = okno_s < 0.0 ? -1 : (int)(okno_s * 1000.0 + 0.5);
+        loguj_wiadomoscf("Okno zbierania: %d ms (tempo %.2f/s) -> grupa %d/%d", okno_ms, okno_tempo(&okno), liczba, max_osoby);
+        if (okno_ms >= 0) {
+            okna_grup++;
+            okna_suma_ms += (uint64_t)okno_ms;
+            okna_osob += (uint64_t)liczba;
         }
+        METRYKI_TRASY(mt->grupy_rozpoczete++; mt->ostatnia_grupa = liczba; mt->faza = FAZA_KLADKA_WEJSCIE;
+            mt->okno_ms = okno_ms; mt->tempo_przybyc = okno_tempo(&okno));
 
-        loguj_wiadomoscf("Trasa zarezerwowana: bylo=%d teraz=%d/%d", poprzednia_wartosc, nowa_wartosc, max_osoby);
+        loguj_zdarzenie(DZ_PR_ZAREZERWOWANA, poprzednia_wartosc, nowa_wartosc, max_osoby);
 
         /// STRATEGIA: Lock->Cross->Unlock (maksymalna przepustowo!)
-        loguj_wiadomosc("Blokuje kladki (WEJSCIE)");
-        zablokuj_obie_kladki(shm_k1, shm_k2, KIERUNEK_WEJSCIE);
+        loguj_zdarzenie(DZ_PR_BLOKUJE_WEJSCIE);
+        uint64_t czekanie_od = czas_monotoniczny_ns();
+        zablokuj_kladki(shm_kladki, opis_trasy->maska_kladek, KIERUNEK_WEJSCIE);
+        termin_czekanie(&termin.czekanie_wejscie_s, czekanie_od);
+        uint64_t slad_trzymania = SLAD_START();
 
-        /// Podziel grup na dwie kadki (mniej wicej po poowie)
-        int na_k1 = liczba / 2;
-        int na_k2 = liczba - na_k1;
+        /// Podziel grup midzy kadki trasy (po rwno, para zawsze na jednej)
+        podziel_na_kladki(czlonkowie, liczba, liczba_kladek, na_kladke);
 
-        loguj_wiadomosc("Przeprowadzam grupe (WEJSCIE)");
+        loguj_zdarzenie(DZ_PR_PRZEPROWADZAM_WEJSCIE);
         wyslij_sygnal_do_grupy(grupa, liczba, SIGRTMIN + 1, "przechodzenie");
 
-        /// Przeprowad przez obie kadki rwnolegle
-        if (na_k1 > 0) przeprowadz_przez_kladke(na_k1, shm_k1, sem1_miejsca, 1, 0, NULL, "WEJSCIE");
-        if (na_k2 > 0) przeprowadz_przez_kladke(na_k2, shm_k2, sem2_miejsca, 2, 0, NULL, "WEJSCIE");
+        /// Przeprowad przez wszystkie kadki trasy
+        for (int j = 0; j < liczba_kladek; j++) {
+            przeprowadz_przez_kladke(na_kladke[j], shm_kladki, sem_kladki, kladki_trasy[j], 0, NULL, "WEJSCIE");
+        }
 
-        loguj_wiadomosc("Zwalniam kladki (inne grupy moga przechodzic)");
-        zwolnij_obie_kladki(shm_k1, shm_k2);  /// Unlock - teraz inna grupa moe wchodzi!
+        loguj_zdarzenie(DZ_PR_ZWALNIAM_WEJSCIE);
+        zwolnij_kladki(shm_kladki, opis_trasy->maska_kladek);  /// Unlock - teraz inna grupa moe wchodzi!
+        SLAD_KONIEC(SLAD_KLADKI_TRZYMANIE, slad_trzymania, KIERUNEK_WEJSCIE);
 
-        loguj_wiadomoscf("Zwiedzanie rozpoczete: trasa=%d czas=%ds", NUMER, czas);
+        loguj_zdarzenie(DZ_PR_ZWIEDZANIE, NUMER, czas);
 
         /// Ustawiamy flag e jestemy NA TRASIE - jeli teraz przyjdzie SIGUSR, koczymy normalnie
         sigprocmask(SIG_BLOCK, &maska, &stara_maska);
         na_trasie = 1;
         sigprocmask(SIG_SETMASK, &stara_maska, NULL);
 
+        METRYKI_TRASY(mt->faza = FAZA_TRASA);
+
         /// Sygna do grupy: "zaczynamy zwiedzanie!"
         wyslij_sygnal_do_grupy(grupa, liczba, SIGRTMIN + 2, "zwiedzanie");
-        sleep(czas);  /// Zwiedzamy T1 lub T2 sekund
+        uint64_t slad_wycieczki = SLAD_START();
+        sen_s(czas);  /// Zwiedzamy Ti sekund
+        SLAD_KONIEC(SLAD_WYCIECZKA, slad_wycieczki, liczba);
 
         sigprocmask(SIG_BLOCK, &maska, &stara_maska);
         na_trasie = 0;
         sigprocmask(SIG_SETMASK, &stara_maska, NULL);
 
-        loguj_wiadomosc("Zwiedzanie zakonczone - wracamy");
+        loguj_zdarzenie(DZ_PR_POWROT);
+
+        METRYKI_TRASY(mt->faza = FAZA_KLADKA_WYJSCIE);
 
         /// WYJCIE - znowu Lock->Cross->Unlock
-        loguj_wiadomosc("Blokuje kladki (WYJSCIE)");
-        zablokuj_obie_kladki(shm_k1, shm_k2, KIERUNEK_WYJSCIE);
+        loguj_zdarzenie(DZ_PR_BLOKUJE_WYJSCIE);
+        czekanie_od = czas_monotoniczny_ns();
+        zablokuj_kladki(shm_kladki, opis_trasy->maska_kladek, KIERUNEK_WYJSCIE);
+        termin_czekanie(&termin.czekanie_wyjscie_s, czekanie_od);
+        slad_trzymania = SLAD_START();
 
-        loguj_wiadomosc("Przeprowadzam grupe (WYJSCIE)");
+        loguj_zdarzenie(DZ_PR_PRZEPROWADZAM_WYJSCIE);
         /// UWAGA: Teraz wysyamy SIGUSR2 do kadego gdy przejdzie kadk (w helpers)
-        if (na_k1 > 0) przeprowadz_przez_kladke(na_k1, shm_k1, sem1_miejsca, 1, 0, grupa, "WYJSCIE");
-        if (na_k2 > 0) przeprowadz_przez_kladke(na_k2, shm_k2, sem2_miejsca, 2, na_k1, grupa, "WYJSCIE");
+        for (int j = 0, offset = 0; j < liczba_kladek; offset += na_kladke[j++]) {
+            przeprowadz_przez_kladke(na_kladke[j], shm_kladki, sem_kladki, kladki_trasy[j], offset, grupa, "WYJSCIE");
+        }
 
-        loguj_wiadomosc("Zwalniam kladki i grupe");
-        zwolnij_obie_kladki(shm_k1, shm_k2);
+        loguj_zdarzenie(DZ_PR_ZWALNIAM_WYJSCIE);
+        zwolnij_kladki(shm_kladki, opis_trasy->maska_kladek);
+        SLAD_KONIEC(SLAD_KLADKI_TRZYMANIE, slad_trzymania, KIERUNEK_WYJSCIE);
 
         /// Zwolnij zarezerwowane miejsca na trasie
-        bezpieczny_sem_wait(sem_trasa_mutex, 0);
-        shm_t->osoby -= liczba;
-        bezpieczny_sem_signal(sem_trasa_mutex, 0);
+        int pozostalo = trasa_zwolnij(shm_t, liczba);
 
-        loguj_wiadomoscf("Wycieczka zakonczona: trasa=%d zwiedzajacych=%d", NUMER, liczba);
+        METRYKI_TRASY(mt->osoby = pozostalo; mt->grupy_zakonczone++; mt->zwiedzajacych += liczba);
+
+        loguj_zdarzenie(DZ_PR_WYCIECZKA_ZAKONCZONA, NUMER, liczba);
     }
 
 cleanup:
+    if (okna_grup > 0) {
+        loguj_wiadomoscf("Okna zbierania: grup=%llu srednie okno=%llu ms srednia grupa=%.1f tempo=%.2f/s",
+            (unsigned long long)okna_grup, (unsigned long long)(okna_suma_ms / okna_grup),
+            (double)okna_osob / (double)okna_grup, okno_tempo(&okno));
+    }
+    loguj_wiadomoscf("Pasy kolejki: odebrano %s=%llu %s=%llu, partii=%llu srednio %.1f osob", PASY[PAS_POWRACAJACY].nazwa,
+        (unsigned long long)pasy.odebrano[PAS_POWRACAJACY], PASY[PAS_ZWYKLY].nazwa,
+        (unsigned long long)pasy.odebrano[PAS_ZWYKLY], (unsigned long long)pasy.partie,
+        pasy.partie > 0 ? (double)pasy.w_partiach / (double)pasy.partie : 0.0);
+    uint32_t porzucone = 0;
+    for (int i = 0; i < LICZBA_PASOW; i++) porzucone += shm_pierscienie->trasy[NUMER - 1].pasy[i].porzucone;
+    if (porzucone > 0) {
+        loguj_ostrzezenie("WARN: Pominieto %u slotow kolejki po zwiedzajacych zabitych w trakcie dolaczania", porzucone);
+    }
     loguj_wiadomosc("SHUTDOWN");
+    BEZPIECZNY_SHMDT(shm_pierscienie);
     BEZPIECZNY_SHMDT(shm_j);
-    BEZPIECZNY_SHMDT(shm_k1);
-    BEZPIECZNY_SHMDT(shm_k2);
-    BEZPIECZNY_SHMDT(shm_t);
+    BEZPIECZNY_SHMDT(shm_kladki);
+    BEZPIECZNY_SHMDT(shm_trasy);
+    BEZPIECZNY_SHMDT(shm_pary);
+    BEZPIECZNY_SHMDT(shm_hist);
+    BEZPIECZNY_SHMDT(globalne_metryki);
     return 0;
 }
\ No newline at end of file
@@ -2,146 +2,558 @@
 #define PRZEWODNIK_HELPERS_H
 
 #include "common.h"
-
-void loguj_wiadomosc(const char* wiadomosc);
-void loguj_wiadomoscf(const char* format, ...);
+#include "metryki.h"
+#include "slad.h"
+#include "loguj.h"
+#include "pary.h"
+#include "pierscien.h"
 
 /// Wyślij sygnał do całej grupy - sprawdź czy proces żyje przed wysłaniem
 static inline void wyslij_sygnal_do_grupy(pid_t* grupa, int liczba, int sygnal, const char* opis) {
     int wyslano = 0;
     for (int i = 0; i < liczba; i++) {
         if (grupa[i] > 0 && kill(grupa[i], 0) == 0) {  /// Sprawdź czy proces istnieje
-            kill(grupa[i], sygnal);
+            wyslij_sygnal(grupa[i], sygnal);
             wyslano++;
         }
     }
-    loguj_wiadomoscf("Wyslano sygnal (%s) do %d/%d zwiedzajacych", opis, wyslano, liczba);
+    loguj_szczegol("Wyslano sygnal (%s) do %d/%d zwiedzajacych", opis, wyslano, liczba);
 }
 
-/// KLUCZOWA FUNKCJA - zablokuj obie kładki atomowo
+/// KLUCZOWA FUNKCJA - zablokuj atomowo wszystkie kładki trasy (maska z TABELA_TRAS)
 /// Strategia: Lock->Cross->Unlock dla maksymalnej przepustowości
-static inline void zablokuj_obie_kladki(ShmKladka* k1, ShmKladka* k2, int kierunek) {
+static inline void zablokuj_kladki(ShmKladka* kladki, unsigned maska, int kierunek) {
     pid_t moj_pid = getpid();
     const char* nazwa_kierunku = (kierunek == KIERUNEK_WEJSCIE) ? "WEJSCIE" : "WYJSCIE";
 
-    loguj_wiadomoscf("Blokuje obie kladki (kierunek: %s)", nazwa_kierunku);
-
-    /// DEADLOCK PREVENTION: Zawsze blokujemy w kolejności k1 -> k2
-    pthread_mutex_lock(&k1->mutex);
-
-    /// Czekaj aż kładka 1 będzie pusta i wolna
-    while (k1->osoby > 0 || k1->przewodnik_pid != 0) {
-        pthread_cond_wait(&k1->cond, &k1->mutex);
-    }
-
-    /// Teraz blokuj k2
-    pthread_mutex_lock(&k2->mutex);
+    loguj_szczegol("Blokuje kladki %#x (kierunek: %s)", maska, nazwa_kierunku);
+    uint64_t slad_czekania = SLAD_START();
 
-    /// Czekaj aż kładka 2 będzie pusta i wolna
-    while (k2->osoby > 0 || k2->przewodnik_pid != 0) {
-        /// UWAGA: Musimy zwolnić k1 na chwilę!
-        pthread_mutex_unlock(&k1->mutex);
-        pthread_cond_wait(&k2->cond, &k2->mutex);
-        pthread_mutex_unlock(&k2->mutex);
+    /// DEADLOCK PREVENTION: Zawsze blokujemy rosnąco po numerze kładki
+    while (1) {
+        int zajeta = -1;
+        for (int i = 0; i < LICZBA_KLADEK; i++) {
+            if (!(maska & (1U << i))) continue;
+            zablokuj_mutex(&kladki[i].mutex);
+            if (kladki[i].osoby > 0 || kladki[i].przewodnik_pid != 0) {
+                zajeta = i;
+                break;
+            }
+        }
+        if (zajeta == -1) break;  /// Mamy wszystkie, wolne
 
-        /// I znowu zablokować k1 od początku
-        pthread_mutex_lock(&k1->mutex);
-        while (k1->osoby > 0 || k1->przewodnik_pid != 0) {
-            pthread_cond_wait(&k1->cond, &k1->mutex);
+        /// UWAGA: Zwalniamy wcześniejsze na czas czekania na zajętą i zaczynamy od początku
+        for (int i = 0; i < zajeta; i++) {
+            if (maska & (1U << i)) odblokuj_mutex(&kladki[i].mutex);
+        }
+        while (kladki[zajeta].osoby > 0 || kladki[zajeta].przewodnik_pid != 0) {
+            czekaj_cond(&kladki[zajeta].cond, &kladki[zajeta].mutex);
         }
-        pthread_mutex_lock(&k2->mutex);
+        odblokuj_mutex(&kladki[zajeta].mutex);
     }
 
-    /// Mamy obie! Ustawiamy się jako właściciel
-    k1->przewodnik_pid = moj_pid;
-    k1->kierunek = kierunek;
-
-    k2->przewodnik_pid = moj_pid;
-    k2->kierunek = kierunek;
+    /// Ustawiamy się jako właściciel - metryki kładek piszemy tylko trzymając ich mutexy
+    for (int i = 0; i < LICZBA_KLADEK; i++) {
+        if (!(maska & (1U << i))) continue;
+        kladki[i].przewodnik_pid = moj_pid;
+        kladki[i].kierunek = kierunek;
+        METRYKI_ZAPIS(kladki[i], globalne_metryki->kladki[i].przewodnik = moj_pid;
+            globalne_metryki->kladki[i].kierunek = kierunek);
+    }
+    SLAD_KONIEC(SLAD_KLADKI_CZEKANIE, slad_czekania, kierunek);
 
-    loguj_wiadomoscf("Obie kladki zablokowane (PID=%d, kierunek=%s)", moj_pid, nazwa_kierunku);
+    loguj_szczegol("Kladki zablokowane (PID=%d, kierunek=%s, maska=%u)", moj_pid, nazwa_kierunku, maska);
 
-    pthread_mutex_unlock(&k2->mutex);
-    pthread_mutex_unlock(&k1->mutex);
+    for (int i = LICZBA_KLADEK - 1; i >= 0; i--) {
+        if (maska & (1U << i)) odblokuj_mutex(&kladki[i].mutex);
+    }
 }
 
-/// Przeprowadź N osób przez kładkę - semafor limituje do K jednocześnie
+/// Przeprowadź N osób przez kładkę - semafor limituje do pojemności kładki (K) jednocześnie
 static inline void przeprowadz_przez_kladke(
     int liczba_osob,
-    ShmKladka* kladka,
-    int sem_miejsca,
+    ShmKladka* kladki,     /// Wszystkie kładki (KLUCZ_SHM_KLADKI)
+    int sem_kladki,        /// Zbiór semaforów miejsc - numer = kładka - 1
     int numer_kladki,
-    int offset,        /// Offset w tablicy grupa[] (dla kładki 2)
-    pid_t* grupa,      /// Tablica PIDów - tylko dla WYJŚCIA!
+    int offset,            /// Offset w tablicy grupa[] (dla dalszych kładek)
+    pid_t* grupa,          /// Tablica PIDów - tylko dla WYJŚCIA!
     const char* nazwa_kierunku
 ) {
     if (liczba_osob == 0) return;
+    ShmKladka* kladka = &kladki[numer_kladki - 1];
+    int pojemnosc = KLADKI[numer_kladki - 1].pojemnosc;
+    uint64_t slad_przeprowadzenia = SLAD_START();
 
     /// Każdy zwiedzający przechodzi pojedynczo
     for (int i = 0; i < liczba_osob; i++) {
-        bezpieczny_sem_wait(sem_miejsca, 0);  /// P - czekaj na wolne miejsce (max K)
+        bezpieczny_sem_wait(sem_kladki, numer_kladki - 1);  /// P - czekaj na wolne miejsce (max K)
 
         /// Zwiększ licznik osób na kładce
-        pthread_mutex_lock(&kladka->mutex);
+        zablokuj_mutex(&kladka->mutex);
         kladka->osoby++;
         int aktualne = kladka->osoby;
 
         /// WALIDACJA - nie powinno nigdy przekroczyć K!
-        if (aktualne > K) {
-            loguj_wiadomoscf("CRITICAL: Kladka %d przekroczona! %d > %d", numer_kladki, aktualne, K);
+        if (aktualne > pojemnosc) {
+            loguj_blad("CRITICAL: Kladka %d przekroczona! %d > %d", numer_kladki, aktualne, pojemnosc);
         }
-        pthread_mutex_unlock(&kladka->mutex);
+        METRYKI_ZAPIS(kladki[numer_kladki - 1], globalne_metryki->kladki[numer_kladki - 1].osoby = aktualne;
+            globalne_metryki->kladki[numer_kladki - 1].przejscia++);
+        odblokuj_mutex(&kladka->mutex);
 
         /// Symulacja przechodzenia kładką
-        usleep(CZAS_PRZECHODZENIA_KLADKA * 1000);
+        sen_us(CZAS_PRZECHODZENIA_KLADKA * 1000);
 
         /// Zmniejsz licznik
-        pthread_mutex_lock(&kladka->mutex);
+        zablokuj_mutex(&kladka->mutex);
         kladka->osoby--;
-        pthread_mutex_unlock(&kladka->mutex);
+        METRYKI_ZAPIS(kladki[numer_kladki - 1], globalne_metryki->kladki[numer_kladki - 1].osoby = kladka->osoby);
+        odblokuj_mutex(&kladka->mutex);
 
-        bezpieczny_sem_signal(sem_miejsca, 0);  /// V - zwolnij miejsce
+        bezpieczny_sem_signal(sem_kladki, numer_kladki - 1);  /// V - zwolnij miejsce
     }
+    SLAD_KONIEC(SLAD_PRZEPROWADZENIE, slad_przeprowadzenia, numer_kladki);
 
     /// Jeśli WYJŚCIE - wyślij SIGUSR2 do każdego (mogą wyjść z jaskini)
     if (strcmp(nazwa_kierunku, "WYJSCIE") == 0 && grupa != NULL) {
         for (int i = 0; i < liczba_osob; i++) {
             pid_t pid = grupa[offset + i];
             if (pid > 0 && kill(pid, 0) == 0) {
-                kill(pid, SIGUSR2);  /// SIGUSR2 = możesz wyjść
+                wyslij_sygnal(pid, SIGUSR2);  /// SIGUSR2 = możesz wyjść
             }
         }
     }
 }
 
-/// Zwolnij obie kładki - inne przewodnicy mogą teraz zablokować
-static inline void zwolnij_obie_kladki(ShmKladka* k1, ShmKladka* k2) {
-    loguj_wiadomosc("Zwalniam obie kladki");
+/// Zwolnij kładki trasy - inni przewodnicy mogą teraz zablokować
+static inline void zwolnij_kladki(ShmKladka* kladki, unsigned maska) {
+    loguj_zdarzenie(DZ_PR_ZWALNIAM_KLADKI);
 
-    pthread_mutex_lock(&k1->mutex);
-    pthread_mutex_lock(&k2->mutex);
+    int puste = 1;
+    for (int i = 0; i < LICZBA_KLADEK; i++) {
+        if (!(maska & (1U << i))) continue;
+        zablokuj_mutex(&kladki[i].mutex);
+        if (kladki[i].osoby != 0) puste = 0;
+    }
 
     /// Sprawdź czy faktycznie są puste
-    if (k1->osoby == 0 && k2->osoby == 0) {
-        k1->kierunek = KIERUNEK_PUSTY;
-        k1->przewodnik_pid = 0;
-
-        k2->kierunek = KIERUNEK_PUSTY;
-        k2->przewodnik_pid = 0;
+    if (puste) {
+        for (int i = 0; i < LICZBA_KLADEK; i++) {
+            if (!(maska & (1U << i))) continue;
+            kladki[i].kierunek = KIERUNEK_PUSTY;
+            kladki[i].przewodnik_pid = 0;
+            METRYKI_ZAPIS(kladki[i], globalne_metryki->kladki[i].przewodnik = 0;
+                globalne_metryki->kladki[i].kierunek = KIERUNEK_PUSTY);
+        }
 
-        loguj_wiadomosc("Kladki zwolnione - dostepne dla innych");
+        loguj_zdarzenie(DZ_PR_KLADKI_ZWOLNIONE, (int)maska);
 
         /// Obudź wszystkich czekających przewodników
-        pthread_cond_broadcast(&k1->cond);
-        pthread_cond_broadcast(&k2->cond);
+        for (int i = 0; i < LICZBA_KLADEK; i++) {
+            if (maska & (1U << i)) pthread_cond_broadcast(&kladki[i].cond);
+        }
     }
     else {
         /// To nie powinno się zdarzyć!
-        loguj_wiadomoscf("WARN: Po zakonczeniu k1=%d k2=%d zwiedzajacych!", k1->osoby, k2->osoby);
+        for (int i = 0; i < LICZBA_KLADEK; i++) {
+            if ((maska & (1U << i)) && kladki[i].osoby != 0) {
+                loguj_ostrzezenie("WARN: Po zakonczeniu kladka %d: %d zwiedzajacych!", i + 1, kladki[i].osoby);
+            }
+        }
+    }
+
+    for (int i = LICZBA_KLADEK - 1; i >= 0; i--) {
+        if (maska & (1U << i)) odblokuj_mutex(&kladki[i].mutex);
+    }
+}
+
+/// Skład zbieranej grupy - członkowie pary opiekun-dziecko (pary.h) stoją w grupa[] obok siebie,
+/// więc para nie trafia do dwóch grup, a granice podziału (kładki, limit trasy) omijają ją.
+/// Członek pary, dla którego partnera zabrakło miejsca, czeka w odlozeni na następną grupę;
+/// tam też wraca nadwyżka, której trasa nie pomieści - nikt nie jest odwoływany za limit.
+/// Grupa i poczekalnia razem nie przekraczają MAX_ODLOZONYCH, więc każdy członek grupy zawsze
+/// ma gdzie wrócić; kto się nie zmieści, nie jest odbierany z kolejki i czeka w niej na początku.
+#define MAX_ODLOZONYCH 64
+
+typedef struct {
+    pid_t* pidy;                      /// grupa[] - kolejność przejścia przez kładki
+    WiadomoscPrzewodnik* czlonkowie;  /// Wiadomości członków (id_pary, czas dołączenia)
+    uint64_t* odebrano_ns;            /// Kiedy członek wszedł do grupy
+    int liczba;
+    int zarezerwowane;                /// Miejsca trzymane dla partnerów członków już w grupie
+    int max;
+    WiadomoscPrzewodnik odlozeni[MAX_ODLOZONYCH];  /// Przechodzą do kolejnych grup
+    int liczba_odlozonych;
+    ShmPary* pary;
+} SkladGrupy;
+
+static inline int grupa_wolne(const SkladGrupy* g) {
+    return g->max - g->liczba - g->zarezerwowane;
+}
+
+/// Ilu zwiedzających można jeszcze odebrać z kolejki - wolne w grupie, ale tylko tylu,
+/// ilu poczekalnia przyjmie, gdyby cała grupa musiała do niej wrócić
+static inline int grupa_miejsca(const SkladGrupy* g) {
+    int poczekalnia = MAX_ODLOZONYCH - g->liczba_odlozonych - g->liczba;
+    int wolne = grupa_wolne(g);
+    return wolne < poczekalnia ? wolne : poczekalnia;
+}
+
+/// Indeks członka pary id_pary w tablicy (-1 gdy brak)
+static inline int znajdz_pare(const WiadomoscPrzewodnik* tab, int liczba, int id_pary) {
+    for (int i = 0; i < liczba; i++) {
+        if (tab[i].id_pary == id_pary) return i;
+    }
+    return -1;
+}
+
+static inline void grupa_wstaw(SkladGrupy* g, int poz, const WiadomoscPrzewodnik* w) {
+    for (int i = g->liczba; i > poz; i--) {
+        g->pidy[i] = g->pidy[i - 1];
+        g->czlonkowie[i] = g->czlonkowie[i - 1];
+        g->odebrano_ns[i] = g->odebrano_ns[i - 1];
+    }
+    g->pidy[poz] = w->pid_zwiedzajacego;
+    g->czlonkowie[poz] = *w;
+    g->odebrano_ns[poz] = czas_monotoniczny_ns();
+    g->liczba++;
+}
+
+static inline void grupa_usun(SkladGrupy* g, int poz) {
+    for (int i = poz; i < g->liczba - 1; i++) {
+        g->pidy[i] = g->pidy[i + 1];
+        g->czlonkowie[i] = g->czlonkowie[i + 1];
+        g->odebrano_ns[i] = g->odebrano_ns[i + 1];
+    }
+    g->liczba--;
+}
+
+static inline void grupa_usun_odlozonego(SkladGrupy* g, int poz) {
+    g->odlozeni[poz] = g->odlozeni[--g->liczba_odlozonych];
+}
+
+/// Przyjmij zwiedzającego (wymaga grupa_miejsca() > 0 - odłożony zawsze się mieści)
+/// Zwraca 1 gdy członek pary został odłożony, bo para już się nie mieści
+static inline int grupa_przyjmij(SkladGrupy* g, const WiadomoscPrzewodnik* w) {
+    if (w->id_pary == BRAK_PARY) {
+        grupa_wstaw(g, g->liczba, w);
+        return 0;
+    }
+
+    int j = znajdz_pare(g->czlonkowie, g->liczba, w->id_pary);
+    if (j >= 0) {  /// Partner w grupie trzyma dla nas miejsce - stajemy obok
+        grupa_wstaw(g, j + 1, w);
+        g->zarezerwowane--;
+        return 0;
+    }
+
+    int bit_partnera = PARA_PARTNER(para_bit_czlonka(g->pary, w->id_pary, w->pid_zwiedzajacego));
+    int partner_obecny = para_obecny(g->pary, w->id_pary, bit_partnera);
+    int k = znajdz_pare(g->odlozeni, g->liczba_odlozonych, w->id_pary);
+    if (k >= 0 && !partner_obecny) {  /// Odłożony partner zdążył wyjść (timeout w kolejce)
+        grupa_usun_odlozonego(g, k);
+        k = -1;
+    }
+    if (!partner_obecny) {  /// Partner odrzucony lub już wyszedł - idzie sam
+        grupa_wstaw(g, g->liczba, w);
+        return 0;
+    }
+
+    if (grupa_wolne(g) >= 2) {
+        grupa_wstaw(g, g->liczba, w);
+        if (k >= 0) {
+            grupa_wstaw(g, g->liczba, &g->odlozeni[k]);
+            grupa_usun_odlozonego(g, k);
+        }
+        else {
+            g->zarezerwowane++;
+        }
+        return 0;
+    }
+
+    g->odlozeni[g->liczba_odlozonych++] = *w;
+    return 1;
+}
+
+/// Nowa grupa na pojemnosc miejsc (wolne na trasie) - najpierw odłożeni przy poprzedniej.
+/// Odłożony bez partnera w grupie zajmuje miejsce i rezerwację - wracają tylko dopóki zostaje
+/// wolne miejsce, inaczej sami odłożeni zapełniliby grupę i kolejka z ich partnerami stałaby
+static inline void grupa_zacznij(SkladGrupy* g, int pojemnosc) {
+    WiadomoscPrzewodnik czekajacy[MAX_ODLOZONYCH];
+    int n = g->liczba_odlozonych;
+    memcpy(czekajacy, g->odlozeni, (size_t)n * sizeof(WiadomoscPrzewodnik));
+
+    g->max = pojemnosc < 0 ? 0 : (pojemnosc > MAX_POJEMNOSC_TRASY ? MAX_POJEMNOSC_TRASY : pojemnosc);
+    g->liczba = 0;
+    g->zarezerwowane = 0;
+    g->liczba_odlozonych = 0;
+    for (int i = 0; i < n; i++) {
+        const WiadomoscPrzewodnik* w = &czekajacy[i];
+        if (!para_obecny(g->pary, w->id_pary, para_bit_czlonka(g->pary, w->id_pary, w->pid_zwiedzajacego))) {
+            continue;  /// Wyszedł w międzyczasie - nie zajmuje miejsca
+        }
+        if (grupa_wolne(g) > 2 || (grupa_wolne(g) > 0 && znajdz_pare(g->czlonkowie, g->liczba, w->id_pary) >= 0)) {
+            grupa_przyjmij(g, w);
+        }
+        else {
+            g->odlozeni[g->liczba_odlozonych++] = *w;
+        }
+    }
+}
+
+/// Koniec zbierania - członek pary, którego partner nie zdążył, czeka na następną grupę
+/// (partner, który już wyszedł, nie zatrzymuje nikogo; w poczekalni jest miejsce - grupa_miejsca)
+static inline void grupa_zakoncz(SkladGrupy* g) {
+    for (int i = g->liczba - 1; i >= 0 && g->zarezerwowane > 0; i--) {
+        const WiadomoscPrzewodnik* w = &g->czlonkowie[i];
+        if (w->id_pary == BRAK_PARY) continue;
+        if ((i > 0 && g->czlonkowie[i - 1].id_pary == w->id_pary) ||
+            (i + 1 < g->liczba && g->czlonkowie[i + 1].id_pary == w->id_pary)) continue;
+
+        int bit_partnera = PARA_PARTNER(para_bit_czlonka(g->pary, w->id_pary, w->pid_zwiedzajacego));
+        if (!para_obecny(g->pary, w->id_pary, bit_partnera)) continue;
+
+        g->zarezerwowane--;
+        g->odlozeni[g->liczba_odlozonych++] = *w;
+        grupa_usun(g, i);
+    }
+    g->zarezerwowane = 0;
+}
+
+/// Członkowie od pozycji od wracają na początek poczekalni - pójdą pierwsi w następnej grupie
+/// (mieszczą się zawsze - grupa_miejsca)
+static inline void grupa_oddaj(SkladGrupy* g, int od) {
+    int n = g->liczba - od;
+    if (n <= 0) return;
+    memmove(g->odlozeni + n, g->odlozeni, (size_t)g->liczba_odlozonych * sizeof(WiadomoscPrzewodnik));
+    memcpy(g->odlozeni, g->czlonkowie + od, (size_t)n * sizeof(WiadomoscPrzewodnik));
+    g->liczba_odlozonych += n;
+    g->liczba = od;
+}
+
+/// Granica podziału grupy nie rozcina pary - przesuń ją o krok (+1 lub -1)
+static inline int granica_bez_rozdzielania(const WiadomoscPrzewodnik* czlonkowie, int liczba, int granica, int krok) {
+    if (granica > 0 && granica < liczba && czlonkowie[granica].id_pary != BRAK_PARY &&
+        czlonkowie[granica - 1].id_pary == czlonkowie[granica].id_pary) {
+        granica += krok;
+    }
+    return granica;
+}
+
+/// Podział grupy między kładki trasy - po równo, para zawsze na jednej kładce
+/// (przy dwóch kładkach jak dotąd: pierwsza bierze połowę, granica przesunięta za parę)
+static inline void podziel_na_kladki(const WiadomoscPrzewodnik* czlonkowie, int liczba, int liczba_kladek, int* na_kladke) {
+    int poczatek = 0;
+    for (int j = 0; j < liczba_kladek - 1; j++) {
+        int zostalo = liczba - poczatek;
+        na_kladke[j] = granica_bez_rozdzielania(czlonkowie + poczatek, zostalo, zostalo / (liczba_kladek - j), 1);
+        poczatek += na_kladke[j];
+    }
+    na_kladke[liczba_kladek - 1] = liczba - poczatek;
+}
+
+/// Adaptacyjne okno zbierania grupy
+/// Tempo przybyć do kolejki trasy to EWMA odstępów między czas_dolaczenia_ns kolejnych osób
+/// (czas dołączenia, nie odbioru - podczas wycieczki kolejka rośnie bez odbiorów).
+/// Dla każdego kandydata W z siatki [0, okno_max] model liczy oczekiwaną grupę
+/// n(W) = min(C, n + lambda*W) (pełna grupa kończy okno wcześniej) i ocenia:
+///   przepustowość  n(W) / (W + T), względem C / T
+///   czekanie       średnie czekanie członków w oknie (obecni całe W, przybywający W/2),
+///                  względem T + okno_max (czas do następnej szansy)
+/// wynik = (1 - waga_czekania) * przepustowość - waga_czekania * czekanie, remis -> krótsze okno.
+/// JASKINIA_CEL_ZBIERANIA: "przepustowosc" (waga 0, domyślnie), "czekanie" (1) lub waga 0..1.
+#define OKNO_ALFA 0.2               /// Waga nowego odstępu w EWMA
+#define OKNO_KROKI 50               /// Kandydaci W na siatce
+#define OKNO_ODSTEP_POCZATKOWY 1.0  /// Zanim przyjdą pomiary: 1 osoba/s (okno jak stałe)
+
+typedef struct {
+    double odstep_ewma_s;           /// EWMA odstępu przybyć
+    uint64_t ostatnie_przybycie_ns; /// Najpóźniejszy widziany czas_dolaczenia_ns
+    double waga_czekania;
+    double okno_max_s;              /// CZAS_ZBIERANIA_GRUPY
+    double czas_wycieczki_s;        /// Ti trasy - cykl, w którym grupa zajmuje przewodnika
+} OknoZbierania;
+
+static inline double okno_tempo(const OknoZbierania* o) {
+    return o->odstep_ewma_s > 0.0 ? 1.0 / o->odstep_ewma_s : 0.0;
+}
+
+/// Waga czekania z JASKINIA_CEL_ZBIERANIA
+static inline double okno_waga_z_env(void) {
+    const char* cel = getenv("JASKINIA_CEL_ZBIERANIA");
+    if (!cel || cel[0] == '\0' || strcmp(cel, "przepustowosc") == 0) return 0.0;
+    if (strcmp(cel, "czekanie") == 0) return 1.0;
+    return parametr_env_ulamek("JASKINIA_CEL_ZBIERANIA", 0.0, 0.0, 1.0);
+}
+
+static inline void okno_przybycie(OknoZbierania* o, uint64_t czas_dolaczenia_ns) {
+    if (czas_dolaczenia_ns <= o->ostatnie_przybycie_ns) return;  /// Poza kolejnością - bez pomiaru
+    if (o->ostatnie_przybycie_ns > 0) {
+        double odstep = (double)(czas_dolaczenia_ns - o->ostatnie_przybycie_ns) / 1e9;
+        o->odstep_ewma_s = OKNO_ALFA * odstep + (1.0 - OKNO_ALFA) * o->odstep_ewma_s;
+    }
+    o->ostatnie_przybycie_ns = czas_dolaczenia_ns;
+}
+
+/// Najlepsze okno (s, liczone od pierwszego członka) dla n osób w grupie i pojemności C
+static inline double okno_wybierz(const OknoZbierania* o, int n, int pojemnosc) {
+    if (n >= pojemnosc || pojemnosc <= 0) return 0.0;
+    double lambda = okno_tempo(o);
+    double T = o->czas_wycieczki_s;
+    double najlepsze = 0.0, najlepszy_wynik = 0.0;
+
+    for (int k = 0; k <= OKNO_KROKI; k++) {
+        double w = o->okno_max_s * k / OKNO_KROKI;
+        double w_efektywne = w;  /// Pełna grupa zamyka okno
+        if (lambda > 0.0 && n + lambda * w > pojemnosc) w_efektywne = (pojemnosc - n) / lambda;
+        double przybedzie = lambda * w_efektywne;
+        double grupa = n + przybedzie;
+
+        double przepustowosc = (grupa / (w_efektywne + T)) / (pojemnosc / T);
+        double czekanie = (n * w_efektywne + przybedzie * w_efektywne / 2.0) / grupa;
+        double wynik = (1.0 - o->waga_czekania) * przepustowosc -
+            o->waga_czekania * czekanie / (T + o->okno_max_s);
+
+        if (k == 0 || wynik > najlepszy_wynik) {
+            najlepszy_wynik = wynik;
+            najlepsze = w_efektywne;
+        }
+    }
+    return najlepsze;
+}
+
+/// Ostatni bezpieczny start grupy - wycieczka ma zwolnić kładki wyjścia przed Tk.
+/// Czas od decyzji o starcie grupy n osób:
+///   czekanie na kładki (wejście) + n * CZAS_PRZECHODZENIA_KLADKA + Ti
+///   + czekanie na kładki (wyjście) + n * CZAS_PRZECHODZENIA_KLADKA
+/// (przeprowadz_przez_kladke puszcza osoby po kolei, kładki trasy jedna po drugiej).
+/// Czekanie na kładki to EWMA zmierzonych zablokuj_kladki tego przewodnika.
+/// Przewodnik przyjmuje grupy do koniec_dnia - potrzebny czas; strażnik pilnuje tylko Tk.
+#define TERMIN_ALFA 0.3  /// Waga nowego pomiaru czekania na kładki
+
+typedef struct {
+    uint64_t koniec_dnia_ns;    /// Tk w czasie monotonicznym (ShmJaskinia), 0 = nieznany
+    double czas_wycieczki_s;    /// Ti trasy
+    double czekanie_wejscie_s;  /// EWMA czekania na kładki przed wejściem
+    double czekanie_wyjscie_s;  /// EWMA czekania na kładki przed wyjściem
+} TerminDnia;
+
+static inline void termin_czekanie(double* ewma_s, uint64_t od_ns) {
+    double czekanie = (double)(czas_monotoniczny_ns() - od_ns) / 1e9;
+    *ewma_s = TERMIN_ALFA * czekanie + (1.0 - TERMIN_ALFA) * *ewma_s;
+}
+
+/// Ile sekund zajmie wycieczka n osób od startu do zejścia z kładek
+static inline double termin_potrzebny_s(const TerminDnia* t, int n) {
+    double przejscie_s = n * CZAS_PRZECHODZENIA_KLADKA / 1000.0;
+    return t->czekanie_wejscie_s + przejscie_s + t->czas_wycieczki_s + t->czekanie_wyjscie_s + przejscie_s;
+}
+
+/// Zapas (s) do ostatniego bezpiecznego startu grupy n osób - ujemny = ta grupa już nie zdąży
+static inline double termin_zapas_s(const TerminDnia* t, int n, uint64_t teraz_ns) {
+    if (t->koniec_dnia_ns == 0) return 1e9;
+    return ((double)t->koniec_dnia_ns - (double)teraz_ns) / 1e9 - termin_potrzebny_s(t, n);
+}
+
+/// Okno zbierania przycięte do ostatniego bezpiecznego startu pełnej grupy (0 = startujemy już)
+static inline double termin_przytnij_okno(const TerminDnia* t, int pojemnosc, double okno_s) {
+    double zapas = termin_zapas_s(t, pojemnosc, czas_monotoniczny_ns());
+    if (zapas < okno_s) okno_s = zapas;
+    return okno_s > 0.0 ? okno_s : 0.0;
+}
+
+/// Który pas przewodnik bierze następny (pasy i pierścienie w pierscien.h) - powracający
+/// (TYP_MSG_ZWIEDZAJACY_POWTORNY) zbierani przed zwykłymi w proporcji wag, ważony round-robin:
+/// przy każdym miejscu pas dostaje kredyt równy wadze, miejsce bierze niepusty pas z największym
+/// kredytem i oddaje sumę wag. Pusty pas traci kredyt (nie odkłada pierwszeństwa), więc przy
+/// obu kolejkach pełnych zwykli dostają co (waga_powracajacych + 1)-te miejsce - bez zagłodzenia.
+/// JASKINIA_WAGA_POWRACAJACYCH: waga pasu powracających (domyślnie 3, 0 = FIFO po czasie dołączenia).
+/// Zdjęci partią, a jeszcze nieprzyjęci do grupy czekają w partia[] - są przed resztą kolejki.
+typedef struct {
+    int waga[LICZBA_PASOW];
+    int kredyt[LICZBA_PASOW];
+    uint64_t odebrano[LICZBA_PASOW];  /// Podsumowanie przy zamknięciu
+    uint64_t partie, w_partiach;      /// Ile zdjęć partią i ile w nich osób
+    WiadomoscPrzewodnik partia[MAX_POJEMNOSC_TRASY];
+    int partia_od, partia_do;
+} PasyKolejki;
+
+static inline void pasy_z_env(PasyKolejki* p) {
+    memset(p, 0, sizeof(*p));
+    for (int i = 0; i < LICZBA_PASOW; i++) p->waga[i] = PASY[i].waga;
+    p->waga[PAS_POWRACAJACY] = parametr_env("JASKINIA_WAGA_POWRACAJACYCH", PASY[PAS_POWRACAJACY].waga, 0, 100);
+    if (p->waga[PAS_POWRACAJACY] == 0) p->waga[PAS_ZWYKLY] = 0;  /// Bez priorytetu - FIFO po obu pasach
+}
+
+/// Udział każdego pasu w partii do `ile` osób - round-robin liczony raz na liczbach gotowych
+/// wiadomości, pierścienie dotyka tylko podgląd czasu dołączenia w trybie FIFO. Zwraca sumę udziałów
+static inline int pasy_udzialy(PasyKolejki* p, KolejkaTrasy* k, int ile, int udzial[LICZBA_PASOW]) {
+    int gotowe[LICZBA_PASOW];
+    int suma = 0;
+    for (int i = 0; i < LICZBA_PASOW; i++) {
+        gotowe[i] = pierscien_gotowe(&k->pasy[i], ile);
+        udzial[i] = 0;
+        suma += p->waga[i];
+    }
+
+    int razem = 0;
+    while (razem < ile) {
+        int pas = -1;
+        for (int i = 0; i < LICZBA_PASOW; i++) {
+            if (udzial[i] == gotowe[i]) {
+                p->kredyt[i] = 0;
+                continue;
+            }
+            p->kredyt[i] += p->waga[i];
+            if (pas < 0 || (suma > 0 ? p->kredyt[i] > p->kredyt[pas] :
+                pierscien_podglad(&k->pasy[i], udzial[i])->czas_dolaczenia_ns <
+                pierscien_podglad(&k->pasy[pas], udzial[pas])->czas_dolaczenia_ns)) pas = i;
+        }
+        if (pas < 0) break;
+        if (suma > 0) {
+            p->kredyt[pas] -= suma;
+            if (p->kredyt[pas] < -suma) p->kredyt[pas] = -suma;  /// Długa seria jednego pasu nie zadłuża go bez końca
+        }
+        udzial[pas]++;
+        razem++;
+    }
+    return razem;
+}
+
+/// Następny zwiedzający: z partii, a gdy pusta - nowa partia do `ile` osób z pierścieni trasy,
+/// jedno zdjęcie na pas. Na pustych pasach śpi do termin_ns (0 = nie czeka). Zwraca 1 gdy jest,
+/// 0 gdy termin minął albo sygnał przerwał czekanie
+static inline int pasy_odbierz(PasyKolejki* p, KolejkaTrasy* k, WiadomoscPrzewodnik* w, int ile, uint64_t termin_ns) {
+    if (ile > MAX_POJEMNOSC_TRASY) ile = MAX_POJEMNOSC_TRASY;
+    for (int proba = 0; p->partia_od == p->partia_do && proba < 2; proba++) {
+        if (proba > 0) {
+            if (termin_ns == 0 || czas_monotoniczny_ns() >= termin_ns) return 0;
+            kolejka_czekaj(k, termin_ns);
+        }
+        p->partia_od = p->partia_do = 0;
+        int udzial[LICZBA_PASOW];
+        if (pasy_udzialy(p, k, ile, udzial) == 0) continue;
+
+        for (int i = 0; i < LICZBA_PASOW; i++) {
+            if (udzial[i] > 0) p->partia_do += pierscien_zdejmij(&k->pasy[i], &p->partia[p->partia_do], udzial[i]);
+        }
+        if (p->waga[PAS_POWRACAJACY] == 0) {
+            /// Bez priorytetu - partia w kolejności dołączenia (każdy pas już jest posortowany)
+            for (int i = 1; i < p->partia_do; i++) {
+                WiadomoscPrzewodnik x = p->partia[i];
+                int j = i;
+                for (; j > 0 && p->partia[j - 1].czas_dolaczenia_ns > x.czas_dolaczenia_ns; j--) p->partia[j] = p->partia[j - 1];
+                p->partia[j] = x;
+            }
+        }
+        p->partie++;
+        p->w_partiach += (uint64_t)p->partia_do;
     }
+    if (p->partia_od == p->partia_do) return 0;
 
-    pthread_mutex_unlock(&k2->mutex);
-    pthread_mutex_unlock(&k1->mutex);
+    *w = p->partia[p->partia_od++];
+    p->odebrano[pas_wiadomosci(w)]++;
+    return 1;
 }
 
-#endif
\ No newline at end of file
+#endif
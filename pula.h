@@ -0,0 +1,272 @@
+#ifndef PULA_H
+#define PULA_H
+
+#include "common.h"
+#include "zegar.h"
+#include <sched.h>
+
+/// Pula wątków z kradzieżą zadań - środowisko symulacji w jednym procesie (jaskinia-pula)
+///
+/// - zadaniem jest aktor: funkcja krok + słowo stanu. Aktor nigdy nie wykonuje się na dwóch
+///   wątkach naraz, więc jego pola nie potrzebują blokad
+/// - słowo stanu łączy flagę "zaplanowany" z bitami sygnałów aktora (jak flagi sig_atomic_t
+///   zwiedzającego procesu): pula_wyslij ustawia bity i planuje jednym fetch_or, więc po nim
+///   nadawca już aktora nie dotyka - aktor może się zakończyć i zwolnić pamięć
+/// - krok dostaje zebrane bity; sygnał, który przyszedł w trakcie kroku, planuje go ponownie
+/// - każdy wątek ma deque Chase-Lev: właściciel wkłada i zdejmuje z dołu (LIFO - ciepłe cache),
+///   bezczynni kradną z góry losowej ofiary; przepełnienie i planowanie spoza puli (wątek
+///   zegara, main) idzie do kolejki wstrzyknięć pod mutexem
+/// - bezczynny wątek śpi na futeksie, planowanie budzi jednego, gdy ktoś śpi
+/// - terminy (PulaTermin) na kole czasowym zegar.h - akcja wysyła bit do aktora
+///
+/// Stan puli jest statyczny w tym nagłówku - stan procesu.
+
+#define PULA_MAX_WATKOW 256
+#define PULA_DEQUE (1 << 12)
+#define PULA_MASKA (PULA_DEQUE - 1)
+
+#define PULA_ZAPLANOWANY (1U << 31)
+#define PULA_SYGNALY (~PULA_ZAPLANOWANY)  /// Bity do użytku aktora
+
+/// Wynik kroku
+#define PULA_DALEJ 0
+#define PULA_KONIEC 1  /// Aktor zakończony (pamięć może być już zwolniona) - pula go nie dotyka
+
+typedef struct Aktor {
+    int (*krok)(struct Aktor* a, uint32_t sygnaly);
+    uint32_t slowo;   /// PULA_ZAPLANOWANY | sygnały czekające na krok
+} Aktor;
+
+typedef struct {
+    int64_t gora;                 /// Złodzieje
+    char odstep1[56];
+    int64_t dol;                  /// Właściciel
+    char odstep2[56];
+    Aktor* zadania[PULA_DEQUE];
+    uint64_t wykonane;            /// Statystyki - pisze tylko właściciel
+    uint64_t skradzione;
+    uint64_t uspienia;
+    char odstep3[40];
+} PulaDeque;
+
+typedef struct {
+    PulaDeque* deki;
+    int watki;
+    pthread_t id[PULA_MAX_WATKOW];
+
+    pthread_mutex_t mutex_wstrzykniec;
+    Aktor** wstrzykniete;         /// Pierścień rosnący pod mutexem
+    size_t pojemnosc, glowa, liczba;
+    size_t liczba_widoczna;       /// Kopia liczba do sprawdzania bez mutexu
+
+    uint32_t sygnal;              /// Futex bezczynnych wątków
+    int spiacy;
+    int koniec;
+} Pula;
+
+static Pula pula;
+static __thread int pula_nr = -1;  /// Numer wątku puli (-1 poza pulą)
+
+/// --- Deque Chase-Lev (stała pojemność) ---
+
+static inline int pula_deque_wloz(PulaDeque* d, Aktor* a) {
+    int64_t b = __atomic_load_n(&d->dol, __ATOMIC_RELAXED);
+    int64_t t = __atomic_load_n(&d->gora, __ATOMIC_ACQUIRE);
+    if (b - t >= PULA_DEQUE) return -1;
+    __atomic_store_n(&d->zadania[b & PULA_MASKA], a, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&d->dol, b + 1, __ATOMIC_RELAXED);
+    return 0;
+}
+
+static inline Aktor* pula_deque_zdejmij(PulaDeque* d) {
+    int64_t b = __atomic_load_n(&d->dol, __ATOMIC_RELAXED) - 1;
+    __atomic_store_n(&d->dol, b, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int64_t t = __atomic_load_n(&d->gora, __ATOMIC_RELAXED);
+    if (t > b) {
+        __atomic_store_n(&d->dol, b + 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+    Aktor* a = __atomic_load_n(&d->zadania[b & PULA_MASKA], __ATOMIC_RELAXED);
+    if (t == b) {  /// Ostatni element - ścigamy się ze złodziejami
+        if (!__atomic_compare_exchange_n(&d->gora, &t, t + 1, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) a = NULL;
+        __atomic_store_n(&d->dol, b + 1, __ATOMIC_RELAXED);
+    }
+    return a;
+}
+
+static inline Aktor* pula_deque_ukradnij(PulaDeque* d) {
+    int64_t t = __atomic_load_n(&d->gora, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int64_t b = __atomic_load_n(&d->dol, __ATOMIC_ACQUIRE);
+    if (t >= b) return NULL;
+    Aktor* a = __atomic_load_n(&d->zadania[t & PULA_MASKA], __ATOMIC_RELAXED);
+    if (!__atomic_compare_exchange_n(&d->gora, &t, t + 1, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) return NULL;
+    return a;
+}
+
+/// --- Kolejka wstrzyknięć ---
+
+static inline void pula_wstrzyknij(Aktor* a) {
+    pthread_mutex_lock(&pula.mutex_wstrzykniec);
+    if (pula.liczba == pula.pojemnosc) {
+        size_t nowa = pula.pojemnosc ? pula.pojemnosc * 2 : 1024;
+        Aktor** tab = (Aktor**)malloc(nowa * sizeof(Aktor*));
+        if (!tab) {
+            pthread_mutex_unlock(&pula.mutex_wstrzykniec);
+            fprintf(stderr, "CRITICAL: Brak pamieci na kolejke wstrzykniec puli\n");
+            abort();  /// Zgubienie aktora zawiesiłoby symulację
+        }
+        for (size_t i = 0; i < pula.liczba; i++) tab[i] = pula.wstrzykniete[(pula.glowa + i) % pula.pojemnosc];
+        free(pula.wstrzykniete);
+        pula.wstrzykniete = tab;
+        pula.pojemnosc = nowa;
+        pula.glowa = 0;
+    }
+    pula.wstrzykniete[(pula.glowa + pula.liczba) % pula.pojemnosc] = a;
+    pula.liczba++;
+    __atomic_store_n(&pula.liczba_widoczna, pula.liczba, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&pula.mutex_wstrzykniec);
+}
+
+static inline Aktor* pula_wez_wstrzykniety(void) {
+    if (__atomic_load_n(&pula.liczba_widoczna, __ATOMIC_ACQUIRE) == 0) return NULL;
+    Aktor* a = NULL;
+    pthread_mutex_lock(&pula.mutex_wstrzykniec);
+    if (pula.liczba > 0) {
+        a = pula.wstrzykniete[pula.glowa];
+        pula.glowa = (pula.glowa + 1) % pula.pojemnosc;
+        pula.liczba--;
+        __atomic_store_n(&pula.liczba_widoczna, pula.liczba, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&pula.mutex_wstrzykniec);
+    return a;
+}
+
+/// --- Planowanie ---
+
+static inline void pula_obudz(void) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&pula.spiacy, __ATOMIC_RELAXED) > 0) {
+        __atomic_fetch_add(&pula.sygnal, 1, __ATOMIC_SEQ_CST);
+        zegar_futex(&pula.sygnal, FUTEX_WAKE_PRIVATE, 1, NULL);
+    }
+}
+
+static inline void pula_wloz(Aktor* a) {
+    if (pula_nr < 0 || pula_deque_wloz(&pula.deki[pula_nr], a) != 0) pula_wstrzyknij(a);
+    pula_obudz();
+}
+
+/// Ustaw sygnały aktora i zaplanuj go - po powrocie nadawca nie może już go dotykać
+static inline void pula_wyslij(Aktor* a, uint32_t sygnaly) {
+    uint32_t stare = __atomic_fetch_or(&a->slowo, (sygnaly & PULA_SYGNALY) | PULA_ZAPLANOWANY, __ATOMIC_ACQ_REL);
+    if (!(stare & PULA_ZAPLANOWANY)) pula_wloz(a);
+}
+
+static inline void pula_wykonaj(Aktor* a) {
+    uint32_t sygnaly = __atomic_fetch_and(&a->slowo, PULA_ZAPLANOWANY, __ATOMIC_ACQ_REL) & PULA_SYGNALY;
+    if (a->krok(a, sygnaly) == PULA_KONIEC) return;
+
+    /// Zdejmij flagę - chyba że w trakcie kroku przyszły nowe sygnały
+    uint32_t s = PULA_ZAPLANOWANY;
+    if (!__atomic_compare_exchange_n(&a->slowo, &s, 0, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) pula_wloz(a);
+}
+
+/// --- Wątki ---
+
+static inline int pula_jest_praca(void) {
+    if (__atomic_load_n(&pula.liczba_widoczna, __ATOMIC_SEQ_CST) > 0) return 1;
+    for (int i = 0; i < pula.watki; i++) {
+        PulaDeque* d = &pula.deki[i];
+        if (__atomic_load_n(&d->dol, __ATOMIC_SEQ_CST) > __atomic_load_n(&d->gora, __ATOMIC_SEQ_CST)) return 1;
+    }
+    return 0;
+}
+
+static void* pula_watek(void* arg) {
+    pula_nr = (int)(intptr_t)arg;
+    PulaDeque* moj = &pula.deki[pula_nr];
+    unsigned ziarno = (unsigned)pula_nr * 2654435761U + 1;
+
+    while (!__atomic_load_n(&pula.koniec, __ATOMIC_ACQUIRE)) {
+        Aktor* a = pula_deque_zdejmij(moj);
+        if (!a) a = pula_wez_wstrzykniety();
+        if (!a && pula.watki > 1) {
+            int start = rand_r(&ziarno) % pula.watki;
+            for (int i = 0; i < pula.watki && !a; i++) {
+                int ofiara = (start + i) % pula.watki;
+                if (ofiara != pula_nr) a = pula_deque_ukradnij(&pula.deki[ofiara]);
+            }
+            if (a) moj->skradzione++;
+        }
+        if (a) {
+            pula_wykonaj(a);
+            moj->wykonane++;
+            continue;
+        }
+
+        /// Nic do roboty - zasypiamy, chyba że praca pojawiła się po zgłoszeniu się jako śpiący
+        __atomic_fetch_add(&pula.spiacy, 1, __ATOMIC_SEQ_CST);
+        uint32_t s = __atomic_load_n(&pula.sygnal, __ATOMIC_SEQ_CST);
+        if (!pula_jest_praca() && !__atomic_load_n(&pula.koniec, __ATOMIC_ACQUIRE)) {
+            moj->uspienia++;
+            zegar_futex(&pula.sygnal, FUTEX_WAIT_PRIVATE, s, NULL);
+        }
+        __atomic_fetch_sub(&pula.spiacy, 1, __ATOMIC_SEQ_CST);
+    }
+    return NULL;
+}
+
+/// Start watki wątków - 0 OK, -1 błąd
+static inline int pula_uruchom(int watki) {
+    if (watki < 1) watki = 1;
+    if (watki > PULA_MAX_WATKOW) watki = PULA_MAX_WATKOW;
+    pula.watki = watki;
+    pula.deki = (PulaDeque*)aligned_alloc(64, sizeof(PulaDeque) * (size_t)watki);
+    if (!pula.deki) return -1;
+    memset(pula.deki, 0, sizeof(PulaDeque) * (size_t)watki);
+    pthread_mutex_init(&pula.mutex_wstrzykniec, NULL);
+
+    for (int i = 0; i < watki; i++) {
+        if (pthread_create(&pula.id[i], NULL, pula_watek, (void*)(intptr_t)i) != 0) {
+            pula.watki = i;  /// Pracujemy na tylu, ile powstało
+            return i > 0 ? 0 : -1;
+        }
+    }
+    return 0;
+}
+
+/// Zatrzymaj pulę (z dowolnego wątku) - wątki kończą po bieżącym kroku
+static inline void pula_zakoncz(void) {
+    __atomic_store_n(&pula.koniec, 1, __ATOMIC_RELEASE);
+    __atomic_fetch_add(&pula.sygnal, 1, __ATOMIC_SEQ_CST);
+    zegar_futex(&pula.sygnal, FUTEX_WAKE_PRIVATE, INT_MAX, NULL);
+}
+
+static inline void pula_czekaj(void) {
+    for (int i = 0; i < pula.watki; i++) pthread_join(pula.id[i], NULL);
+}
+
+/// --- Terminy ---
+
+/// Termin aktora na kole czasowym - po upływie wysyła mu bit
+typedef struct {
+    ZegarTimer timer;
+    Aktor* aktor;
+    uint32_t bit;
+} PulaTermin;
+
+static inline void pula_akcja_terminu(void* arg) {
+    PulaTermin* t = (PulaTermin*)arg;
+    pula_wyslij(t->aktor, t->bit);  /// Z wątku zegara - trafia do kolejki wstrzyknięć
+}
+
+static inline void pula_termin(PulaTermin* t, Aktor* a, uint32_t bit, uint64_t za_ns) {
+    t->aktor = a;
+    t->bit = bit;
+    zegar_uzbroj(&t->timer, za_ns, pula_akcja_terminu, t);
+}
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef REGULAMIN_H
+#define REGULAMIN_H
+
+#include "common.h"
+#include "pary.h"
+
+/// Regulamin kasy - wspólny dla kasjera i symulacji w jednym procesie (jaskinia-pula),
+/// żeby obie przydzielały trasy identycznie. Bez logów - statystyki i komunikaty
+/// zostają u wywołującego, który rozróżnia przypadki po regule.
+/// Trasy i ich limity wieku pochodzą z TABELA_TRAS (common.h).
+
+enum {
+    REGULA_OPIEKUN = 0,           /// 1: opiekun dziecka <8 -> trasa pary
+    REGULA_DZIECKO,               /// 2: dziecko <8 z opiekunem z rejestru par -> trasa pary
+    REGULA_DZIECKO_BEZ_OPIEKUNA,  /// 2: dziecko <8 bez opiekuna -> odrzucone
+    REGULA_SENIOR,                /// 3: senior >75 -> tylko trasy dopuszczające jego wiek
+    REGULA_POWTORNA,              /// 4: powtórna wizyta -> inna trasa niż poprzednio
+    REGULA_ZLA_POPRZEDNIA,        /// 4: powtórna z nieprawidłową poprzednią trasą -> odrzucona
+    REGULA_DOROSLY                /// 5: pozostali -> trasa losowa spośród dopuszczalnych
+};
+
+/// Trasa pary opiekun-dziecko: jedna z tras dla dzieci, wybrana po id_pary -
+/// opiekun i dziecko liczą ją niezależnie i zawsze trafiają na tę samą
+static inline int regulamin_trasa_pary(int id_pary) {
+    int trasy[LICZBA_TRAS];
+    int liczba = 0;
+    for (int t = 0; t < LICZBA_TRAS; t++) {
+        if (TRASY[t].min_wiek <= MIN_WIEK) trasy[liczba++] = t + 1;
+    }
+    return trasy[(id_pary >= 0 ? id_pary : 0) % liczba];  /// liczba > 0 - sprawdzone w common.h
+}
+
+/// Decyzja (DECYZJA_*) dla prośby o bilet; los (dowolna liczba losowa) wybiera trasę,
+/// gdy regulamin dopuszcza kilka
+static inline int regulamin_decyzja(const WiadomoscKasjer* z, ShmPary* pary, unsigned los,
+    int* trasa, int* regula) {
+    *trasa = 0;
+    if (z->czy_opiekun) {
+        *regula = REGULA_OPIEKUN;
+        *trasa = regulamin_trasa_pary(z->id_pary);
+    }
+    else if (z->wiek < WIEK_Z_OPIEKUNEM) {
+        if (para_potwierdz_dziecko(pary, z->id_pary, z->pid_opiekuna)) {
+            *regula = REGULA_DZIECKO;
+            *trasa = regulamin_trasa_pary(z->id_pary);
+        }
+        else {
+            *regula = REGULA_DZIECKO_BEZ_OPIEKUNA;
+        }
+    }
+    else if (z->wiek <= WIEK_SENIORA && z->powtorna_wizyta &&
+        (z->poprzednia_trasa < 1 || z->poprzednia_trasa > LICZBA_TRAS)) {
+        *regula = REGULA_ZLA_POPRZEDNIA;
+    }
+    else {
+        *regula = z->wiek > WIEK_SENIORA ? REGULA_SENIOR :
+            z->powtorna_wizyta ? REGULA_POWTORNA : REGULA_DOROSLY;
+
+        /// Trasy dopuszczające wiek; powracający bez poprzedniej, chyba że innej nie ma
+        int pomin = z->powtorna_wizyta ? z->poprzednia_trasa : 0;
+        int trasy[LICZBA_TRAS];
+        int liczba = 0;
+        for (int proba = 0; proba < 2 && liczba == 0; proba++) {
+            for (int t = 0; t < LICZBA_TRAS; t++) {
+                if (z->wiek < TRASY[t].min_wiek || z->wiek > TRASY[t].max_wiek) continue;
+                if (proba == 0 && t + 1 == pomin) continue;
+                trasy[liczba++] = t + 1;
+            }
+        }
+        if (liczba > 0) *trasa = trasy[los % (unsigned)liczba];
+    }
+
+    return *trasa > 0 ? DECYZJA_TRASA(*trasa) : DECYZJA_ODRZUCONY;
+}
+
+#endif
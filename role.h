@@ -0,0 +1,80 @@
+#ifndef ROLE_H
+#define ROLE_H
+
+#include "common.h"
+#include "common_helpers.h"
+#include "metryki.h"
+#include "slad.h"
+#include "loguj.h"
+#include <stdio_ext.h>
+#include <sys/prctl.h>
+
+/// Role symulacji w jednym pliku wykonywalnym ./jaskinia (jaskinia.c). Nazwy ról to dowiązania
+/// do niego - ./kasjer i ./jaskinia kasjer uruchamiają to samo main_kasjer.
+#define TABELA_ROL_PROGRAMU(X) \
+    X(straznik) \
+    X(kasjer) \
+    X(przewodnik) \
+    X(generator) \
+    X(zwiedzajacy)
+
+#define DEKLARUJ_MAIN_ROLI(nazwa) int main_##nazwa(int argc, char* argv[]);
+TABELA_ROL_PROGRAMU(DEKLARUJ_MAIN_ROLI)
+#undef DEKLARUJ_MAIN_ROLI
+
+typedef int (*MainRoli)(int argc, char* argv[]);
+
+/// Odłącz segmenty SysV odziedziczone po rodzicu (w /proc/self/maps jako "/SYSV<klucz>") -
+/// jak exec. Rola podłącza swoje od nowa, więc żaden segment nie jest zmapowany dwa razy
+static inline void odlacz_odziedziczone_shm(void) {
+    FILE* f = fopen("/proc/self/maps", "r");
+    if (!f) return;
+    void* adresy[64];
+    int liczba = 0;
+    char linia[512];
+    while (liczba < 64 && fgets(linia, sizeof(linia), f)) {
+        unsigned long poczatek;
+        if (strstr(linia, "/SYSV") && sscanf(linia, "%lx-", &poczatek) == 1) adresy[liczba++] = (void*)poczatek;
+    }
+    fclose(f);
+    for (int i = 0; i < liczba; i++) shmdt(adresy[i]);  /// Najpierw całe maps - shmdt je zmienia
+}
+
+/// Start roli w dziecku po fork(). Domyślnie bez exec - kod jest już zmapowany, wołamy
+/// main_<rola> i kończymy proces jego wynikiem. Jak po exec: przechwycone sygnały wracają do
+/// SIG_DFL (ignorowane i maska zostają), bufory stdio rodzica przepadają, comm = nazwa roli,
+/// a segmenty shm, deskryptory logów i bufory logu/śladu rodzica są odłączane i porzucane,
+/// zanim rola podłączy i otworzy własne.
+/// JASKINIA_SPAWN_EXEC=1 - klasyczne execv("./<rola>") do porównań w benchu.
+/// Wraca tylko gdy exec się nie udał (błąd już wypisany) - wołający sprząta jak dotąd.
+static inline void uruchom_role(MainRoli main_roli, char* argv[]) {
+    if (parametr_env("JASKINIA_SPAWN_EXEC", 0, 0, 1)) {
+        char sciezka[64];
+        snprintf(sciezka, sizeof(sciezka), "./%s", argv[0]);
+        execv(sciezka, argv);
+        fprintf(stderr, "execv %s: %s\n", sciezka, strerror(errno));
+        return;
+    }
+
+    for (int s = 1; s < NSIG; s++) {
+        struct sigaction sa;
+        if (sigaction(s, NULL, &sa) != 0) continue;  /// Numery zajęte przez glibc (NPTL)
+        if (sa.sa_handler == SIG_DFL || sa.sa_handler == SIG_IGN) continue;
+        signal(s, SIG_DFL);
+    }
+    __fpurge(stdout);  /// Nie wypisujemy drugi raz tego, co rodzic miał w buforze
+    __fpurge(stderr);
+    prctl(PR_SET_NAME, argv[0], 0, 0, 0);
+
+    odlacz_odziedziczone_shm();
+    globalne_metryki = NULL;
+    profil_blokad = NULL;
+    loguj_porzuc_po_fork();
+    slad_porzuc_po_fork();
+
+    int argc = 0;
+    while (argv[argc]) argc++;
+    exit(main_roli(argc, argv));
+}
+
+#endif
@@ -0,0 +1,144 @@
+#ifndef SLAD_H
+#define SLAD_H
+
+#include "common.h"
+
+/// Śledzenie osi czasu (opcjonalne) - włączane zmienną środowiskową JASKINIA_SLAD=1
+/// Każdy proces zbiera binarne rekordy odcinków (span) w swoim buforze i zrzuca je
+/// do jaskinia_slad_<pid>.bin. slad2json zamienia je na JSON Chrome/Perfetto.
+/// Gdy wyłączone - każde miejsce pomiaru to jeden przewidywalny if.
+///
+/// Stan śladu jest statyczny w tym nagłówku - każdy program to jedna jednostka
+/// kompilacji, więc to po prostu stan procesu.
+
+#define SLAD_MAGIC 0x534C4144U    /// "SLAD"
+#define SLAD_WERSJA 1
+#define SLAD_ROZMIAR_BUFORA 1024  /// Rekordów w buforze zanim zrzucimy do pliku
+#define SLAD_PREFIKS_PLIKU "jaskinia_slad_"
+
+/// Rodzaje odcinków - nazwy i kategorie w tabeli poniżej
+enum {
+    SLAD_BILET = 0,          /// Zwiedzający: prośba -> odpowiedź kasjera
+    SLAD_KOLEJKA,            /// Zwiedzający: dołączenie do kolejki -> grupa zebrana
+    SLAD_CZEKANIE_KLADKA,    /// Zwiedzający: grupa zebrana -> wejście na kładkę
+    SLAD_PRZEJSCIE,          /// Zwiedzający: przejście kładki przy wejściu
+    SLAD_ZWIEDZANIE,         /// Zwiedzający: zwiedzanie aż do przejścia kładki przy wyjściu
+    SLAD_WYJSCIE,            /// Zwiedzający: wyjście z jaskini
+    SLAD_ZBIERANIE_GRUPY,    /// Przewodnik: okno zbierania grupy
+    SLAD_REZERWACJA_TRASY,   /// Przewodnik: rezerwacja miejsc na trasie
+    SLAD_KLADKI_CZEKANIE,    /// Przewodnik: czekanie na kładki trasy w zablokuj_kladki
+    SLAD_KLADKI_TRZYMANIE,   /// Przewodnik: kładki zablokowane -> zwolnione
+    SLAD_PRZEPROWADZENIE,    /// Przewodnik: przeprowadzenie części grupy przez kładkę (arg = kładka)
+    SLAD_WYCIECZKA,          /// Przewodnik: zwiedzanie trasy
+    SLAD_OBSLUGA_BILETU,     /// Kasjer: odebranie prośby -> wysłanie odpowiedzi (arg = decyzja)
+    LICZBA_RODZAJOW_SLADU
+};
+
+static const char* const NAZWY_SLADU[LICZBA_RODZAJOW_SLADU] = {
+    "bilet", "kolejka", "czekanie_kladka", "przejscie", "zwiedzanie", "wyjscie",
+    "zbieranie_grupy", "rezerwacja_trasy", "kladki_czekanie", "kladki_trzymanie",
+    "przeprowadzenie", "wycieczka", "obsluga_biletu"
+};
+
+static const char* const KATEGORIE_SLADU[LICZBA_RODZAJOW_SLADU] = {
+    "zwiedzajacy", "zwiedzajacy", "zwiedzajacy", "zwiedzajacy", "zwiedzajacy", "zwiedzajacy",
+    "przewodnik", "przewodnik", "kladka", "kladka", "kladka", "przewodnik", "kasjer"
+};
+
+/// Nagłówek pliku - raz na początku
+typedef struct {
+    uint32_t magic;
+    uint32_t wersja;
+    int32_t pid;
+    char rola[20];  /// Np. "KASJER", "PRZEWODNIK1"
+} NaglowekSladu;
+
+/// Jeden odcinek - 32 bajty
+typedef struct {
+    uint64_t poczatek_ns;  /// Zegar monotoniczny
+    uint64_t koniec_ns;
+    int32_t pid;
+    uint16_t rodzaj;       /// SLAD_*
+    uint16_t zarezerwowane;
+    int32_t arg;           /// Dodatkowa liczba (np. numer kładki)
+    int32_t wyrownanie;
+} RekordSladu;
+
+static int slad_wlaczony = 0;
+static pid_t slad_pid = 0;
+static char slad_rola[20];
+static int slad_naglowek_zapisany = 0;
+static int slad_liczba = 0;
+static RekordSladu slad_bufor[SLAD_ROZMIAR_BUFORA];
+
+/// Czy ślad aktywny - jedyny koszt miejsca pomiaru gdy wyłączony
+#define SLAD_AKTYWNY() __builtin_expect(slad_wlaczony, 0)
+
+/// Znacznik początku odcinka - 0 gdy ślad wyłączony
+#define SLAD_START() (SLAD_AKTYWNY() ? czas_monotoniczny_ns() : 0)
+
+/// Zamknij odcinek rozpoczęty znacznikiem SLAD_START()
+#define SLAD_KONIEC(rodzaj, poczatek, arg) \
+    do { \
+        if (SLAD_AKTYWNY()) slad_zapisz((rodzaj), (poczatek), czas_monotoniczny_ns(), (arg)); \
+    } while(0)
+
+/// Zrzuć bufor do pliku jaskinia_slad_<pid>.bin (w instancji n: jaskinia_slad_<pid>.n.bin)
+static inline void slad_zrzuc(void) {
+    if (!slad_wlaczony || slad_liczba == 0) return;
+    if (getpid() != slad_pid) return;  /// Dziecko po fork() bez exec - bufor nie jego
+
+    char nazwa[64], plik[80];
+    snprintf(nazwa, sizeof(nazwa), SLAD_PREFIKS_PLIKU "%d.bin", (int)slad_pid);
+    int fd = open(plik_instancji(nazwa, plik, sizeof(plik)), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (fd == -1) return;
+
+    if (!slad_naglowek_zapisany) {
+        NaglowekSladu n;
+        memset(&n, 0, sizeof(n));
+        n.magic = SLAD_MAGIC;
+        n.wersja = SLAD_WERSJA;
+        n.pid = slad_pid;
+        memcpy(n.rola, slad_rola, sizeof(n.rola));
+        bezpieczny_zapis_wszystko(fd, &n, sizeof(n));
+        slad_naglowek_zapisany = 1;
+    }
+
+    bezpieczny_zapis_wszystko(fd, slad_bufor, sizeof(RekordSladu) * slad_liczba);
+    close(fd);
+    slad_liczba = 0;
+}
+
+/// Dopisz odcinek do bufora (wołać tylko przez SLAD_KONIEC)
+static inline void slad_zapisz(int rodzaj, uint64_t poczatek_ns, uint64_t koniec_ns, int arg) {
+    if (poczatek_ns == 0) return;  /// Początek sprzed włączenia śladu
+    RekordSladu* r = &slad_bufor[slad_liczba++];
+    r->poczatek_ns = poczatek_ns;
+    r->koniec_ns = koniec_ns;
+    r->pid = slad_pid;
+    r->rodzaj = (uint16_t)rodzaj;
+    r->zarezerwowane = 0;
+    r->arg = arg;
+    r->wyrownanie = 0;
+    if (slad_liczba == SLAD_ROZMIAR_BUFORA) slad_zrzuc();
+}
+
+/// Dziecko po fork() bez exec (role.h) - rekordy w buforze należą do rodzica
+static inline void slad_porzuc_po_fork(void) {
+    slad_wlaczony = 0;
+    slad_liczba = 0;
+    slad_naglowek_zapisany = 0;
+}
+
+/// Włącz ślad jeśli JASKINIA_SLAD ustawione - wywołaj na początku main()
+static inline void slad_inicjalizuj(const char* rola) {
+    const char* env = getenv("JASKINIA_SLAD");
+    if (!env || env[0] == '\0' || strcmp(env, "0") == 0) return;
+
+    slad_pid = getpid();
+    snprintf(slad_rola, sizeof(slad_rola), "%s", rola);
+    slad_wlaczony = 1;
+    atexit(slad_zrzuc);  /// Powrót z main() i exit() zrzucą resztę bufora
+}
+
+#endif
@@ -0,0 +1,123 @@
+#include "common.h"
+#include "slad.h"
+
+/// slad2json - zamienia binarne pliki śladu (jaskinia_slad_<pid>.bin) na JSON
+/// w formacie Chrome trace-event (chrome://tracing, ui.perfetto.dev).
+/// Użycie: ./slad2json jaskinia_slad_*.bin > jaskinia_slad.json
+///
+/// Wszyscy zwiedzający lądują w jednym "procesie" ZWIEDZAJACY jako osobne wątki,
+/// inaczej przeglądarka pokazałaby setki osobnych procesów.
+
+#define PID_ZWIEDZAJACYCH 0  /// Sztuczny pid grupujący zwiedzających
+
+/// Wczytany plik - nagłówek + wszystkie rekordy
+typedef struct {
+    NaglowekSladu naglowek;
+    RekordSladu* rekordy;
+    size_t liczba;
+} PlikSladu;
+
+/// Wczytaj cały plik do pamięci, -1 gdy to nie jest plik śladu
+static int wczytaj_plik(const char* nazwa, PlikSladu* plik) {
+    FILE* f = fopen(nazwa, "rb");
+    if (!f) {
+        perror(nazwa);
+        return -1;
+    }
+
+    if (fread(&plik->naglowek, sizeof(NaglowekSladu), 1, f) != 1 ||
+        plik->naglowek.magic != SLAD_MAGIC || plik->naglowek.wersja != SLAD_WERSJA) {
+        fprintf(stderr, "%s: to nie jest plik sladu w wersji %d\n", nazwa, SLAD_WERSJA);
+        fclose(f);
+        return -1;
+    }
+    plik->naglowek.rola[sizeof(plik->naglowek.rola) - 1] = '\0';
+
+    size_t pojemnosc = 64;
+    plik->rekordy = malloc(pojemnosc * sizeof(RekordSladu));
+    plik->liczba = 0;
+    while (plik->rekordy) {
+        if (plik->liczba == pojemnosc) {
+            pojemnosc *= 2;
+            RekordSladu* nowe = realloc(plik->rekordy, pojemnosc * sizeof(RekordSladu));
+            if (!nowe) break;
+            plik->rekordy = nowe;
+        }
+        if (fread(&plik->rekordy[plik->liczba], sizeof(RekordSladu), 1, f) != 1) break;
+        plik->liczba++;
+    }
+
+    fclose(f);
+    return plik->rekordy ? 0 : -1;
+}
+
+static int czy_zwiedzajacy(const PlikSladu* plik) {
+    return strcmp(plik->naglowek.rola, "ZWIEDZAJACY") == 0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Uzycie: %s " SLAD_PREFIKS_PLIKU "<pid>.bin... > slad.json\n", argv[0]);
+        return 1;
+    }
+
+    int liczba_plikow = argc - 1;
+    PlikSladu* pliki = calloc(liczba_plikow, sizeof(PlikSladu));
+    if (!pliki) {
+        perror("calloc");
+        return 1;
+    }
+
+    /// Najwcześniejszy znacznik - od niego liczymy czas (czytelniejsze liczby w JSON)
+    uint64_t poczatek = UINT64_MAX;
+    size_t wszystkich = 0;
+    for (int i = 0; i < liczba_plikow; i++) {
+        if (wczytaj_plik(argv[i + 1], &pliki[i]) != 0) continue;
+        for (size_t j = 0; j < pliki[i].liczba; j++) {
+            if (pliki[i].rekordy[j].poczatek_ns < poczatek) poczatek = pliki[i].rekordy[j].poczatek_ns;
+        }
+        wszystkich += pliki[i].liczba;
+    }
+    if (poczatek == UINT64_MAX) poczatek = 0;
+
+    printf("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    printf("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"ZWIEDZAJACY\"}}",
+        PID_ZWIEDZAJACYCH);
+
+    for (int i = 0; i < liczba_plikow; i++) {
+        PlikSladu* plik = &pliki[i];
+        if (!plik->rekordy) continue;
+
+        int pid = plik->naglowek.pid;
+        int pid_json = czy_zwiedzajacy(plik) ? PID_ZWIEDZAJACYCH : pid;
+
+        /// Metadane - nazwy procesów i wątków w przeglądarce
+        if (czy_zwiedzajacy(plik)) {
+            printf(",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,"
+                "\"args\":{\"name\":\"zwiedzajacy %d\"}}", pid_json, pid, pid);
+        }
+        else {
+            printf(",\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,"
+                "\"args\":{\"name\":\"%s %d\"}}", pid_json, plik->naglowek.rola, pid);
+        }
+
+        for (size_t j = 0; j < plik->liczba; j++) {
+            const RekordSladu* r = &plik->rekordy[j];
+            if (r->rodzaj >= LICZBA_RODZAJOW_SLADU || r->koniec_ns < r->poczatek_ns) continue;
+
+            printf(",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+                "\"pid\":%d,\"tid\":%d,\"args\":{\"arg\":%d}}",
+                NAZWY_SLADU[r->rodzaj], KATEGORIE_SLADU[r->rodzaj],
+                (double)(r->poczatek_ns - poczatek) / 1000.0,
+                (double)(r->koniec_ns - r->poczatek_ns) / 1000.0,
+                pid_json, pid, r->arg);
+        }
+    }
+    printf("\n]}\n");
+
+    fprintf(stderr, "slad2json: %d plikow, %zu odcinkow\n", liczba_plikow, wszystkich);
+
+    for (int i = 0; i < liczba_plikow; i++) free(pliki[i].rekordy);
+    free(pliki);
+    return 0;
+}
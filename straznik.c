@@ -1,140 +1,111 @@
 #include "common.h"
 #include "common_helpers.h"
 #include "straznik_helpers.h"
+#include "pary.h"
+#include "pierscien.h"
+#include "loguj.h"
+#include "role.h"
 
-int globalny_semid_log = -1;
+static volatile sig_atomic_t zakonczenie_zadane = 0;
+static volatile sig_atomic_t sigchld_otrzymany = 0;
+static volatile sig_atomic_t zrzut_histogramow = 0;
 
-volatile sig_atomic_t zakonczenie_zadane = 0;
-volatile sig_atomic_t sigchld_otrzymany = 0;
-
-void obsluga_sygnalu(int sig) {
+static void obsluga_sygnalu(int sig) {
     (void)sig;
     zakonczenie_zadane = 1;  /// SIGINT lub SIGTERM - zaczynamy zamykanie
 }
 
-void obsluga_sigchld(int sig) {
+static void obsluga_zrzutu(int sig) {
     (void)sig;
-    sigchld_otrzymany = 1;
-    while (waitpid(-1, NULL, WNOHANG) > 0);  /// Zbierz wszystkie zombie
+    zrzut_histogramow = 1;  /// SIGUSR1 - zrzut histogramw na danie
 }
 
-void loguj_wiadomosc(const char* wiadomosc) {
-    int sem_zdobyty = 0;
-    char ts[64], buf[512];
-
-    if (globalny_semid_log != -1) {
-        struct sembuf op = { 0, -1, 0 };
-        if (bezpieczny_semop(globalny_semid_log, &op, 1) == 0) {
-            sem_zdobyty = 1;
-        }
-    }
-
-    time_t teraz = time(NULL);
-    strftime(ts, sizeof(ts), "%Y-%m-%d %H:%M:%S", localtime(&teraz));
-    snprintf(buf, sizeof(buf), "[%s] [PID:%d] [STRAZNIK] %s\n", ts, getpid(), wiadomosc);
-
-    int fd = open("jaskinia_common.log", O_WRONLY | O_CREAT | O_APPEND, 0644);
-    if (fd != -1) {
-        bezpieczny_zapis_wszystko(fd, buf, strlen(buf));
-        close(fd);
-    }
-
-    if (sem_zdobyty) {
-        struct sembuf op = { 0, 1, 0 };
-        bezpieczny_semop(globalny_semid_log, &op, 1);
-    }
-}
-
-void loguj_wiadomoscf(const char* format, ...) {
-    char wiadomosc[512];
-    va_list args;
-    va_start(args, format);
-    vsnprintf(wiadomosc, sizeof(wiadomosc), format, args);
-    va_end(args);
-    loguj_wiadomosc(wiadomosc);
+static void obsluga_sigchld(int sig) {
+    (void)sig;
+    sigchld_otrzymany = 1;
+    while (waitpid(-1, NULL, WNOHANG) > 0);  /// Zbierz wszystkie zombie
 }
 
 /// Funkcja czyszczca - usuwa wszystkie zasoby IPC
-void wyczysc_ipc() {
+static void wyczysc_ipc(void) {
     loguj_wiadomosc("Rozpoczynam czyszczenie IPC");
     int shmid, semid, msgid;
 
     /// Shared memory - niszcz pthread obiekty PRZED shmctl
     if ((shmid = shmget(KLUCZ_SHM_JASKINIA, 0, 0)) != -1) {
-        ShmJaskinia* shm = (ShmJaskinia*)shmat(shmid, NULL, 0);
-        if (shm != (void*)-1) {
-            pthread_mutex_destroy(&shm->mutex);
-            pthread_cond_destroy(&shm->cond_otwarta);
-            shmdt(shm);
-        }
         shmctl(shmid, IPC_RMID, NULL);
     }
 
-    if ((shmid = shmget(KLUCZ_SHM_KLADKA1, 0, 0)) != -1) {
-        ShmKladka* k1 = (ShmKladka*)shmat(shmid, NULL, 0);
-        if (k1 != (void*)-1) {
-            pthread_mutex_destroy(&k1->mutex);
-            pthread_cond_destroy(&k1->cond);
-            shmdt(k1);
-        }
-        shmctl(shmid, IPC_RMID, NULL);
-    }
-
-    if ((shmid = shmget(KLUCZ_SHM_KLADKA2, 0, 0)) != -1) {
-        ShmKladka* k2 = (ShmKladka*)shmat(shmid, NULL, 0);
-        if (k2 != (void*)-1) {
-            pthread_mutex_destroy(&k2->mutex);
-            pthread_cond_destroy(&k2->cond);
-            shmdt(k2);
+    if ((shmid = shmget(KLUCZ_SHM_KLADKI, 0, 0)) != -1) {
+        ShmKladka* kladki = (ShmKladka*)shmat(shmid, NULL, 0);
+        struct shmid_ds stan;
+        if (kladki != (void*)-1 && shmctl(shmid, IPC_STAT, &stan) == 0) {
+            /// Segment po poprzednim przebiegu mg mie inny ukad - tylko tyle kadek, ile mieci
+            size_t liczba = stan.shm_segsz / sizeof(ShmKladka);
+            for (size_t i = 0; i < liczba && i < LICZBA_KLADEK; i++) {
+                pthread_mutex_destroy(&kladki[i].mutex);
+                pthread_cond_destroy(&kladki[i].cond);
+            }
         }
+        if (kladki != (void*)-1) shmdt(kladki);
         shmctl(shmid, IPC_RMID, NULL);
     }
 
     /// Pozostae segmenty pamici
-    if ((shmid = shmget(KLUCZ_SHM_TRASA1, 0, 0)) != -1) {
+    if ((shmid = shmget(KLUCZ_SHM_TRASY, 0, 0)) != -1) {
         shmctl(shmid, IPC_RMID, NULL);
     }
-    if ((shmid = shmget(KLUCZ_SHM_TRASA2, 0, 0)) != -1) {
+    if ((shmid = shmget(KLUCZ_SHM_ZWIEDZAJACY, 0, 0)) != -1) {
         shmctl(shmid, IPC_RMID, NULL);
     }
-    if ((shmid = shmget(KLUCZ_SHM_ZWIEDZAJACY, 0, 0)) != -1) {
+    if ((shmid = shmget(KLUCZ_SHM_HISTOGRAMY, 0, 0)) != -1) {
         shmctl(shmid, IPC_RMID, NULL);
     }
-
-    /// Semafory
-    if ((semid = semget(KLUCZ_SEM_KLADKA1_MIEJSCA, 0, 0)) != -1) {
-        semctl(semid, 0, IPC_RMID);
+    if ((shmid = shmget(KLUCZ_SHM_METRYKI, 0, 0)) != -1) {
+        shmctl(shmid, IPC_RMID, NULL);
     }
-    if ((semid = semget(KLUCZ_SEM_KLADKA2_MIEJSCA, 0, 0)) != -1) {
-        semctl(semid, 0, IPC_RMID);
+    if ((shmid = shmget(KLUCZ_SHM_PROFIL_BLOKAD, 0, 0)) != -1) {
+        shmctl(shmid, IPC_RMID, NULL);
     }
-    if ((semid = semget(KLUCZ_SEM_LOG, 0, 0)) != -1) {
-        semctl(semid, 0, IPC_RMID);
+    if ((shmid = shmget(KLUCZ_SHM_PARY, 0, 0)) != -1) {
+        shmctl(shmid, IPC_RMID, NULL);
     }
-    if ((semid = semget(KLUCZ_SEM_TRASA1_MUTEX, 0, 0)) != -1) {
-        semctl(semid, 0, IPC_RMID);
+    if ((shmid = shmget(KLUCZ_SHM_PIERSCIENIE, 0, 0)) != -1) {
+        shmctl(shmid, IPC_RMID, NULL);
     }
-    if ((semid = semget(KLUCZ_SEM_TRASA2_MUTEX, 0, 0)) != -1) {
+
+    /// Semafory
+    if ((semid = semget(KLUCZ_SEM_KLADKI_MIEJSCA, 0, 0)) != -1) {
         semctl(semid, 0, IPC_RMID);
     }
 
-    /// Kolejki komunikatw
+    /// Kolejka komunikatw kasjera (do przewodnikw - piercienie w shared memory)
     if ((msgid = msgget(KLUCZ_MSG_KASJER, 0)) != -1) {
         msgctl(msgid, IPC_RMID, NULL);
     }
-    if ((msgid = msgget(KLUCZ_MSG_PRZEWODNIK1, 0)) != -1) {
-        msgctl(msgid, IPC_RMID, NULL);
-    }
-    if ((msgid = msgget(KLUCZ_MSG_PRZEWODNIK2, 0)) != -1) {
-        msgctl(msgid, IPC_RMID, NULL);
-    }
 
     loguj_wiadomosc("Czyszczenie IPC zakonczone");
 }
 
-int main() {
+/// Sygnay zamknicia do przewodnikw - kady dostaje sygna swojej trasy z TABELA_TRAS
+static void wyslij_sygnaly_zamkniecia(const pid_t* przewodnicy) {
+    for (int t = 0; t < LICZBA_TRAS; t++) {
+        loguj_wiadomoscf("%s -> przewodnik%d (PID=%d)", nazwa_sygnalu(TRASY[t].sygnal), t + 1, przewodnicy[t]);
+        wyslij_sygnal(przewodnicy[t], TRASY[t].sygnal);
+    }
+}
+
+int main_straznik(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+    uint64_t start_ns = czas_monotoniczny_ns();  /// Od tej chwili liczymy czas do otwarcia
+
+    /// Instancja zajta przez innego stranika - nie ruszamy jego IPC ani plikw
+    if (sprawdz_wolna_instancje() != 0) return 1;
+
     signal(SIGINT, obsluga_sygnalu);   /// Ctrl+C
     signal(SIGTERM, obsluga_sygnalu);
+    signal(SIGUSR1, obsluga_zrzutu);   /// kill -USR1 <straznik> = zrzut histogramw
 
     struct sigaction sa_chld;
     sa_chld.sa_handler = obsluga_sigchld;
@@ -142,8 +113,19 @@ int main() {
     sigemptyset(&sa_chld.sa_mask);
     sigaction(SIGCHLD, &sa_chld, NULL);
 
+    /// Dziennik binarny zakadamy przed pierwszym wpisem - role dopisuj do tego samego pliku
+    if (dziennik_zaloz() != 0) perror(DZIENNIK_PLIK);
+    loguj_inicjalizuj(ROLA_STRAZNIK);
+
     loguj_wiadomosc("=== START STRAZNIKA ===");
+    loguj_wiadomoscf("Instancja %d (klucze IPC 0x%04x____, np. metryki %#010x)", instancja_jaskini(),
+        instancja_jaskini(), (unsigned)KLUCZ_SHM_METRYKI);
     loguj_wiadomosc("Strategia kladek: Lock->Cross->Unlock (maksymalna przepustowosc)");
+    loguj_wiadomoscf("Uklad jaskini: %d tras, %d kladek", LICZBA_TRAS, LICZBA_KLADEK);
+    for (int t = 0; t < LICZBA_TRAS; t++) {
+        loguj_wiadomoscf("Trasa %d: max=%d czas=%ds kladki=%#x sygnal=%s", t + 1, TRASY[t].pojemnosc,
+            TRASY[t].czas_s, TRASY[t].maska_kladek, nazwa_sygnalu(TRASY[t].sygnal));
+    }
 
     /// KROK 1: Wyczy stare zasoby (gdyby poprzednie uruchomienie si crashno)
     loguj_wiadomosc("Czyszczenie starych zasobow IPC");
@@ -151,69 +133,63 @@ int main() {
 
     loguj_wiadomosc("Tworzenie nowych zasobow IPC");
 
-    /// KROK 2: Stwrz semafor logw (pierwszy - eby inne procesy mogy go uy)
-    int sem_log = utworz_sem(KLUCZ_SEM_LOG, 1, 1);
-    if (sem_log == -2) {  /// -2 = EEXIST (konflikt)
-        loguj_wiadomosc("=== BLAD KRYTYCZNY: KONFLIKT ZASOBOW ===");
-        loguj_wiadomosc("ROZWIAZANIE: Uruchom 'make clean'");
-        return 1;
-    }
-    if (sem_log == -1) {
-        perror("semget KLUCZ_SEM_LOG");
-        loguj_wiadomosc("BLAD: Nie udalo sie utworzyc semafora logow");
-        return 1;
-    }
-    globalny_semid_log = sem_log;
-
     /// KROK 3: Stwrz wszystkie shared memory segmenty
     int shmid_jaskinia = utworz_shm(KLUCZ_SHM_JASKINIA, sizeof(ShmJaskinia));
-    int shmid_kladka1 = utworz_shm(KLUCZ_SHM_KLADKA1, sizeof(ShmKladka));
-    int shmid_kladka2 = utworz_shm(KLUCZ_SHM_KLADKA2, sizeof(ShmKladka));
-    int shmid_trasa1 = utworz_shm(KLUCZ_SHM_TRASA1, sizeof(ShmTrasa));
-    int shmid_trasa2 = utworz_shm(KLUCZ_SHM_TRASA2, sizeof(ShmTrasa));
+    int shmid_kladki = utworz_shm(KLUCZ_SHM_KLADKI, sizeof(ShmKladka) * LICZBA_KLADEK);
+    int shmid_trasy = utworz_shm(KLUCZ_SHM_TRASY, sizeof(ShmTrasa) * LICZBA_TRAS);
     int shmid_zwiedzajacy = utworz_shm(KLUCZ_SHM_ZWIEDZAJACY, sizeof(ShmZwiedzajacy));
+    int shmid_histogramy = utworz_shm(KLUCZ_SHM_HISTOGRAMY, sizeof(ShmHistogramy));
+    int shmid_metryki = utworz_shm(KLUCZ_SHM_METRYKI, sizeof(ShmMetryki));
+    int shmid_profil = utworz_shm(KLUCZ_SHM_PROFIL_BLOKAD, sizeof(ShmProfilBlokad));
+    int shmid_pary = utworz_shm(KLUCZ_SHM_PARY, sizeof(ShmPary));
+    int shmid_pierscienie = utworz_shm(KLUCZ_SHM_PIERSCIENIE, sizeof(ShmPierscienie));
 
     /// Sprawd konflikty
-    SPRAWDZ_EEXIST_I_ZAKONCZ(shmid_jaskinia == -2 || shmid_kladka1 == -2 ||
-        shmid_kladka2 == -2 || shmid_trasa1 == -2 ||
-        shmid_trasa2 == -2 || shmid_zwiedzajacy == -2, "SHM");
+    SPRAWDZ_EEXIST_I_ZAKONCZ(shmid_jaskinia == -2 || shmid_kladki == -2 ||
+        shmid_trasy == -2 || shmid_zwiedzajacy == -2 || shmid_histogramy == -2 ||
+        shmid_metryki == -2 || shmid_profil == -2 || shmid_pary == -2 || shmid_pierscienie == -2, "SHM");
 
-    if (shmid_jaskinia == -1 || shmid_kladka1 == -1 || shmid_kladka2 == -1 ||
-        shmid_trasa1 == -1 || shmid_trasa2 == -1 || shmid_zwiedzajacy == -1) {
+    if (shmid_jaskinia == -1 || shmid_kladki == -1 || shmid_trasy == -1 || shmid_zwiedzajacy == -1 ||
+        shmid_histogramy == -1 || shmid_metryki == -1 || shmid_profil == -1 || shmid_pary == -1 ||
+        shmid_pierscienie == -1) {
         perror("shmget SHM");
-        loguj_wiadomosc("BLAD: Nie udalo sie utworzyc SHM");
+        loguj_blad("BLAD: Nie udalo sie utworzyc SHM");
         wyczysc_ipc();
         return 1;
     }
 
     /// KROK 4: Stwrz semafory
-    int sem1_miejsca = utworz_sem(KLUCZ_SEM_KLADKA1_MIEJSCA, 1, K);  /// Inicjalizuj na K
-    int sem2_miejsca = utworz_sem(KLUCZ_SEM_KLADKA2_MIEJSCA, 1, K);
-    int sem_trasa1_mutex = utworz_sem(KLUCZ_SEM_TRASA1_MUTEX, 1, 1);  /// Mutex = 1
-    int sem_trasa2_mutex = utworz_sem(KLUCZ_SEM_TRASA2_MUTEX, 1, 1);
+    int sem_kladki = utworz_sem(KLUCZ_SEM_KLADKI_MIEJSCA, LICZBA_KLADEK, 0);  /// Pojemnoci niej
 
-    SPRAWDZ_EEXIST_I_ZAKONCZ(sem1_miejsca == -2 || sem2_miejsca == -2 ||
-        sem_trasa1_mutex == -2 || sem_trasa2_mutex == -2, "SEM");
+    SPRAWDZ_EEXIST_I_ZAKONCZ(sem_kladki == -2, "SEM");
 
-    if (sem1_miejsca == -1 || sem2_miejsca == -1 ||
-        sem_trasa1_mutex == -1 || sem_trasa2_mutex == -1) {
+    if (sem_kladki == -1) {
         perror("semget SEM");
-        loguj_wiadomosc("BLAD: Nie udalo sie utworzyc semaforow");
+        loguj_blad("BLAD: Nie udalo sie utworzyc semaforow");
         wyczysc_ipc();
         return 1;
     }
 
-    /// KROK 5: Stwrz kolejki komunikatw
+    /// Semafor kadki inicjalizowany na jej pojemno (K) z TABELA_KLADEK
+    for (int i = 0; i < LICZBA_KLADEK; i++) {
+        union semun arg;
+        arg.val = KLADKI[i].pojemnosc;
+        if (semctl(sem_kladki, i, SETVAL, arg) == -1) {
+            perror("semctl SETVAL kladka");
+            loguj_blad("BLAD: Nie udalo sie ustawic pojemnosci kladki %d", i + 1);
+            wyczysc_ipc();
+            return 1;
+        }
+    }
+
+    /// KROK 5: Stwrz kolejk komunikatw kasjera (przewodnicy - piercienie, KLUCZ_SHM_PIERSCIENIE)
     int msg_kasjer = utworz_msg(KLUCZ_MSG_KASJER);
-    int msg_przewodnik1 = utworz_msg(KLUCZ_MSG_PRZEWODNIK1);
-    int msg_przewodnik2 = utworz_msg(KLUCZ_MSG_PRZEWODNIK2);
 
-    SPRAWDZ_EEXIST_I_ZAKONCZ(msg_kasjer == -2 || msg_przewodnik1 == -2 ||
-        msg_przewodnik2 == -2, "MSG");
+    SPRAWDZ_EEXIST_I_ZAKONCZ(msg_kasjer == -2, "MSG");
 
-    if (msg_kasjer == -1 || msg_przewodnik1 == -1 || msg_przewodnik2 == -1) {
+    if (msg_kasjer == -1) {
         perror("msgget MSG");
-        loguj_wiadomosc("BLAD: Nie udalo sie utworzyc kolejek komunikatow");
+        loguj_blad("BLAD: Nie udalo sie utworzyc kolejek komunikatow");
         wyczysc_ipc();
         return 1;
     }
@@ -222,33 +198,51 @@ int main() {
     loguj_wiadomosc("Inicjalizuje struktury globalne");
 
     ShmJaskinia* shm_j = (ShmJaskinia*)shmat(shmid_jaskinia, NULL, 0);
-    ShmKladka* shm_k1 = (ShmKladka*)shmat(shmid_kladka1, NULL, 0);
-    ShmKladka* shm_k2 = (ShmKladka*)shmat(shmid_kladka2, NULL, 0);
-    ShmTrasa* shm_t1 = (ShmTrasa*)shmat(shmid_trasa1, NULL, 0);
-    ShmTrasa* shm_t2 = (ShmTrasa*)shmat(shmid_trasa2, NULL, 0);
+    ShmKladka* shm_kladki = (ShmKladka*)shmat(shmid_kladki, NULL, 0);
+    ShmTrasa* shm_trasy = (ShmTrasa*)shmat(shmid_trasy, NULL, 0);
     ShmZwiedzajacy* shm_zwiedzajacy = (ShmZwiedzajacy*)shmat(shmid_zwiedzajacy, NULL, 0);
-
-    if (shm_j == (void*)-1 || shm_k1 == (void*)-1 || shm_k2 == (void*)-1 ||
-        shm_t1 == (void*)-1 || shm_t2 == (void*)-1 || shm_zwiedzajacy == (void*)-1) {
+    ShmHistogramy* shm_hist = (ShmHistogramy*)shmat(shmid_histogramy, NULL, 0);
+    ShmMetryki* shm_metryki = (ShmMetryki*)shmat(shmid_metryki, NULL, 0);
+    ShmProfilBlokad* shm_profil = (ShmProfilBlokad*)shmat(shmid_profil, NULL, 0);
+    ShmPary* shm_pary = (ShmPary*)shmat(shmid_pary, NULL, 0);
+    ShmPierscienie* shm_pierscienie = (ShmPierscienie*)shmat(shmid_pierscienie, NULL, 0);
+
+    if (shm_j == (void*)-1 || shm_kladki == (void*)-1 || shm_trasy == (void*)-1 || shm_zwiedzajacy == (void*)-1 ||
+        shm_hist == (void*)-1 || shm_metryki == (void*)-1 || shm_profil == (void*)-1 ||
+        shm_pary == (void*)-1 || shm_pierscienie == (void*)-1) {
         perror("shmat SHM");
-        loguj_wiadomosc("BLAD: shmat failed");
+        loguj_blad("BLAD: shmat failed");
         wyczysc_ipc();
         return 1;
     }
 
     /// Ustaw wartoci pocztkowe
-    shm_j->otwarta = 0;  /// Jaskinia ZAMKNITA na start
-    shm_k1->kierunek = KIERUNEK_PUSTY;
-    shm_k1->osoby = 0;
-    shm_k1->przewodnik_pid = 0;
-    shm_k2->kierunek = KIERUNEK_PUSTY;
-    shm_k2->osoby = 0;
-    shm_k2->przewodnik_pid = 0;
-    shm_t1->osoby = 0;
-    shm_t2->osoby = 0;
+    shm_j->stan_otwarcia = 0;  /// Jaskinia ZAMKNITA na start
+    shm_j->gotowe = 0;
+    shm_j->epoka = (uint32_t)(start_ns ^ ((uint64_t)getpid() << 16)) | 1U;  /// Nigdy 0
+    for (int i = 0; i < LICZBA_KLADEK; i++) {
+        shm_kladki[i].kierunek = KIERUNEK_PUSTY;
+        shm_kladki[i].osoby = 0;
+        shm_kladki[i].przewodnik_pid = 0;
+    }
+    for (int t = 0; t < LICZBA_TRAS; t++) {
+        shm_trasy[t].osoby = 0;
+        shm_trasy[t].oproznienia = 0;
+    }
     memset(shm_zwiedzajacy, 0, sizeof(ShmZwiedzajacy));
-
-    time_t czas_startu;
+    memset(shm_hist, 0, sizeof(ShmHistogramy));
+    memset(shm_metryki, 0, sizeof(ShmMetryki));
+    shm_metryki->pid_straznika = getpid();
+    shm_metryki->wersja = METRYKI_WERSJA;
+    shm_metryki->maska_logu = log_maska_lokalna;  /// JASKINIA_LOG_POZIOM - dalej zmienia jaskinia-logi
+    __atomic_store_n(&shm_metryki->magic, METRYKI_MAGIC, __ATOMIC_RELEASE);  /// Ostatnie - strona gotowa
+    globalne_metryki = shm_metryki;
+    memset(shm_profil, 0, sizeof(ShmProfilBlokad));
+    memset(shm_pary, 0, sizeof(ShmPary));  /// Wszystkie wpisy PARA_WOLNA
+    BEZPIECZNY_SHMDT(shm_pary);            /// Stranik tylko zakada rejestr
+    pierscienie_inicjalizuj(shm_pierscienie);
+    BEZPIECZNY_SHMDT(shm_pierscienie);     /// ... i kolejki do przewodnikw
+    profil_blokad_inicjalizuj();
 
     /// KROK 7: Inicjalizuj pthread mutexy i condition variables (PROCESS_SHARED!)
     loguj_wiadomosc("Inicjalizuje pthread mutex i condition variables");
@@ -262,44 +256,20 @@ int main() {
     pthread_condattr_setpshared(&cond_attr, PTHREAD_PROCESS_SHARED);
 
     int ret;
-    /// Dla jaskini
-    if ((ret = pthread_mutex_init(&shm_j->mutex, &mutex_attr)) != 0) {
-        fprintf(stderr, "pthread_mutex_init shm_j: %s\n", strerror(ret));
-        loguj_wiadomosc("BLAD: pthread_mutex_init shm_j failed");
-        wyczysc_ipc();
-        return 1;
-    }
-    if ((ret = pthread_cond_init(&shm_j->cond_otwarta, &cond_attr)) != 0) {
-        fprintf(stderr, "pthread_cond_init shm_j: %s\n", strerror(ret));
-        loguj_wiadomosc("BLAD: pthread_cond_init shm_j failed");
-        wyczysc_ipc();
-        return 1;
-    }
-    /// Dla kadki 1
-    if ((ret = pthread_mutex_init(&shm_k1->mutex, &mutex_attr)) != 0) {
-        fprintf(stderr, "pthread_mutex_init shm_k1: %s\n", strerror(ret));
-        loguj_wiadomosc("BLAD: pthread_mutex_init shm_k1 failed");
-        wyczysc_ipc();
-        return 1;
-    }
-    if ((ret = pthread_cond_init(&shm_k1->cond, &cond_attr)) != 0) {
-        fprintf(stderr, "pthread_cond_init shm_k1: %s\n", strerror(ret));
-        loguj_wiadomosc("BLAD: pthread_cond_init shm_k1 failed");
-        wyczysc_ipc();
-        return 1;
-    }
-    /// Dla kadki 2
-    if ((ret = pthread_mutex_init(&shm_k2->mutex, &mutex_attr)) != 0) {
-        fprintf(stderr, "pthread_mutex_init shm_k2: %s\n", strerror(ret));
-        loguj_wiadomosc("BLAD: pthread_mutex_init shm_k2 failed");
-        wyczysc_ipc();
-        return 1;
-    }
-    if ((ret = pthread_cond_init(&shm_k2->cond, &cond_attr)) != 0) {
-        fprintf(stderr, "pthread_cond_init shm_k2: %s\n", strerror(ret));
-        loguj_wiadomosc("BLAD: pthread_cond_init shm_k2 failed");
-        wyczysc_ipc();
-        return 1;
+    /// Dla kadej kadki (stan jaskini to futex - ustaw_otwarcie w common_helpers.h)
+    for (int i = 0; i < LICZBA_KLADEK; i++) {
+        if ((ret = pthread_mutex_init(&shm_kladki[i].mutex, &mutex_attr)) != 0) {
+            fprintf(stderr, "pthread_mutex_init kladka %d: %s\n", i + 1, strerror(ret));
+            loguj_blad("BLAD: pthread_mutex_init kladka %d failed", i + 1);
+            wyczysc_ipc();
+            return 1;
+        }
+        if ((ret = pthread_cond_init(&shm_kladki[i].cond, &cond_attr)) != 0) {
+            fprintf(stderr, "pthread_cond_init kladka %d: %s\n", i + 1, strerror(ret));
+            loguj_blad("BLAD: pthread_cond_init kladka %d failed", i + 1);
+            wyczysc_ipc();
+            return 1;
+        }
     }
 
     pthread_mutexattr_destroy(&mutex_attr);
@@ -307,73 +277,79 @@ int main() {
 
     loguj_wiadomosc("Obiekty pthread zainicjalizowane (PROCESS_SHARED)");
 
-    /// KROK 8: Uruchom workery (fork + exec)
+    /// KROK 8: Uruchom workery (fork, bez exec - role.h) - wszystkie zasoby ju istniej, role dziedzicz
+    /// epok przez rodowisko i zgaszaj gotowo na futeksie shm_j->gotowe
+    char epoka[16];
+    snprintf(epoka, sizeof(epoka), "%u", shm_j->epoka);
+    setenv("JASKINIA_EPOKA", epoka, 1);
     loguj_wiadomosc("Uruchamiam workery");
 
     /// Kasjer
     pid_t pid_kasjer = fork();
     if (pid_kasjer == -1) {
         perror("fork kasjer");
-        loguj_wiadomosc("BLAD: fork kasjer failed");
+        loguj_blad("BLAD: fork kasjer failed");
         wyczysc_ipc();
         return 1;
     }
     if (pid_kasjer == 0) {
-        execl("./kasjer", "kasjer", NULL);
-        perror("execl kasjer");
+        char* argv_kasjera[] = { "kasjer", NULL };
+        uruchom_role(main_kasjer, argv_kasjera);
         exit(1);
     }
     loguj_wiadomoscf("Uruchomiono kasjer: PID=%d", pid_kasjer);
 
-    /// Przewodnik 1
-    pid_t pid_przewodnik1 = fork();
-    if (pid_przewodnik1 == -1) {
-        perror("fork przewodnik1");
-        loguj_wiadomosc("BLAD: fork przewodnik1 failed");
-        wyczysc_ipc();
-        return 1;
-    }
-    if (pid_przewodnik1 == 0) {
-        execl("./przewodnik", "przewodnik", "1", NULL);
-        perror("execl przewodnik1");
-        exit(1);
-    }
-    loguj_wiadomoscf("Uruchomiono przewodnik1: PID=%d", pid_przewodnik1);
-
-    /// Przewodnik 2
-    pid_t pid_przewodnik2 = fork();
-    if (pid_przewodnik2 == -1) {
-        perror("fork przewodnik2");
-        loguj_wiadomosc("BLAD: fork przewodnik2 failed");
-        wyczysc_ipc();
-        return 1;
-    }
-    if (pid_przewodnik2 == 0) {
-        execl("./przewodnik", "przewodnik", "2", NULL);
-        perror("execl przewodnik2");
-        exit(1);
+    /// Przewodnicy - po jednym na tras z TABELA_TRAS
+    pid_t pid_przewodnicy[LICZBA_TRAS];
+    for (int t = 1; t <= LICZBA_TRAS; t++) {
+        char numer[16];
+        snprintf(numer, sizeof(numer), "%d", t);
+
+        pid_t pid = fork();
+        if (pid == -1) {
+            perror("fork przewodnik");
+            loguj_blad("BLAD: fork przewodnik%d failed", t);
+            wyczysc_ipc();
+            return 1;
+        }
+        if (pid == 0) {
+            char* argv_przewodnika[] = { "przewodnik", numer, NULL };
+            uruchom_role(main_przewodnik, argv_przewodnika);
+            exit(1);
+        }
+        pid_przewodnicy[t - 1] = pid;
+        loguj_wiadomoscf("Uruchomiono przewodnik%d: PID=%d", t, pid);
     }
-    loguj_wiadomoscf("Uruchomiono przewodnik2: PID=%d", pid_przewodnik2);
 
-    loguj_wiadomoscf("Workery uruchomione: kasjer=%d p1=%d p2=%d", pid_kasjer, pid_przewodnik1, pid_przewodnik2);
-
-    sleep(1);  /// Daj workerom chwil na start
+    loguj_wiadomoscf("Workery uruchomione: kasjer=%d przewodnikow=%d", pid_kasjer, LICZBA_TRAS);
 
     /// Generator - uruchom PRZED otwarciem jaskini
     pid_t pid_generator = fork();
     if (pid_generator == -1) {
         perror("fork generator");
-        loguj_wiadomosc("BLAD: fork generator failed");
+        loguj_blad("BLAD: fork generator failed");
         wyczysc_ipc();
         return 1;
     }
     if (pid_generator == 0) {
-        execl("./generator", "generator", NULL);
-        perror("execl generator");
+        char* argv_generatora[] = { "generator", NULL };
+        uruchom_role(main_generator, argv_generatora);
         exit(1);
     }
     loguj_wiadomoscf("Uruchomiono generator: PID=%d", pid_generator);
 
+    /// Otwieramy, gdy kasjer, generator i wszyscy przewodnicy zgosz gotowo
+    uint32_t rol = 2 + LICZBA_TRAS;
+    uint32_t gotowe = czekaj_na_gotowosc(shm_j, rol, TIMEOUT_GOTOWOSC_MS, &zakonczenie_zadane);
+    double otwarcie_ms = (czas_monotoniczny_ns() - start_ns) / 1e6;  /// Bez czekania na Tp
+    if (gotowe < rol && !zakonczenie_zadane) {
+        loguj_ostrzezenie("UWAGA: Gotowych rol %u/%u po %d ms - otwieram mimo to", gotowe, rol,
+            TIMEOUT_GOTOWOSC_MS);
+    }
+    else {
+        loguj_wiadomoscf("Wszystkie role gotowe (%u) - %.1f ms od startu straznika", gotowe, otwarcie_ms);
+    }
+
     /// KROK 9: Czekaj na czas otwarcia Tp (jeli > 0)
     if (Tp > 0) {
         time_t teraz = time(NULL);
@@ -383,46 +359,41 @@ int main() {
         if (aktualne_sekundy < Tp) {
             int czas_czekania = Tp - aktualne_sekundy;
             loguj_wiadomoscf("Czekam do godziny otwarcia Tp (%d sekund)", czas_czekania);
-            sleep(czas_czekania);
+            sen_s(czas_czekania);
         }
     }
 
     /// KROK 10: OTWRZ JASKINI!
     loguj_wiadomosc("OTWIERAM JASKINIE (Tp osiagniete)");
 
-    pthread_mutex_lock(&shm_j->mutex);
-    shm_j->otwarta = 1;
-    pthread_cond_broadcast(&shm_j->cond_otwarta);  /// Obud wszystkich czekajcych
-    pthread_mutex_unlock(&shm_j->mutex);
+    /// JASKINIA_TK pozwala benchmarkowi skrci/wyduy dzie bez przekompilowania
+    int czas_otwarcia = parametr_env("JASKINIA_TK", Tk, MIN_CZAS_OTWARCIA, 86400);
 
-    czas_startu = time(NULL);
-    loguj_wiadomoscf("Jaskinia otwarta na %d sekund (lub Ctrl+C)", Tk);
+    shm_j->koniec_dnia_ns = czas_monotoniczny_ns() + (uint64_t)czas_otwarcia * 1000000000ULL;  /// Przed otwarciem
+    ustaw_otwarcie(shm_j, 1);  /// Release + obud wszystkich czekajcych
 
-    int sygnaly_wyslane = 0;
+    shm_metryki->czas_otwarcia_ns = czas_monotoniczny_ns();
+    shm_metryki->otwarta = 1;
+
+    loguj_wiadomoscf("Jaskinia otwarta na %d sekund (lub Ctrl+C)", czas_otwarcia);
 
     /// KROK 11: Czekaj Tk sekund lub Ctrl+C
+    /// Ten sam monotoniczny termin, wg ktrego przewodnicy licz ostatni bezpieczny start
     while (!zakonczenie_zadane) {
-        int uplynelo = difftime(time(NULL), czas_startu);
-
-        /// Wylij sygnay zamknicia WYPRZEDZENIE_SYGNAL_ZAMKNIECIA sekund przed kocem
-        if (!sygnaly_wyslane && uplynelo >= (Tk - WYPRZEDZENIE_SYGNAL_ZAMKNIECIA)) {
-            loguj_wiadomosc("Wysylam sygnaly zamkniecia do przewodnikow (przed Tk)");
-
-            loguj_wiadomoscf("SIGUSR1 -> przewodnik1 (PID=%d)", pid_przewodnik1);
-            kill(pid_przewodnik1, SIGUSR1);
-
-            loguj_wiadomoscf("SIGUSR2 -> przewodnik2 (PID=%d)", pid_przewodnik2);
-            kill(pid_przewodnik2, SIGUSR2);
-
-            sygnaly_wyslane = 1;
-        }
-
-        if (uplynelo >= Tk) {
+        uint64_t teraz = czas_monotoniczny_ns();
+        if (teraz >= shm_j->koniec_dnia_ns) {
             loguj_wiadomosc("Uplynal czas Tk, rozpoczynam zamykanie");
             break;
         }
 
-        usleep(100000);
+        uint64_t zostalo_us = (shm_j->koniec_dnia_ns - teraz) / 1000ULL;
+        sen_us(zostalo_us < 100000ULL ? (useconds_t)zostalo_us : 100000);  /// Nie przesypiaj Tk
+
+        if (zrzut_histogramow) {
+            zrzut_histogramow = 0;
+            wyswietl_histogramy(shm_hist, "na zadanie");
+            wyswietl_profil_blokad(shm_profil, "na zadanie");
+        }
 
         if (sigchld_otrzymany) {
             sigchld_otrzymany = 0;
@@ -430,73 +401,89 @@ int main() {
         }
     }
 
-    /// Jeli Ctrl+C - wylij sygnay do przewodnikw (jak przy Tk-10)
-    if (zakonczenie_zadane) {
-        loguj_wiadomosc("=== OTRZYMANO CTRL+C - SYSTEMATYCZNE ZAMYKANIE ===");
-
-        if (!sygnaly_wyslane) {
-            loguj_wiadomosc("Wysylam sygnaly zamkniecia do przewodnikow (Ctrl+C)");
-
-            loguj_wiadomoscf("SIGUSR1 -> przewodnik1 (PID=%d)", pid_przewodnik1);
-            kill(pid_przewodnik1, SIGUSR1);
-
-            loguj_wiadomoscf("SIGUSR2 -> przewodnik2 (PID=%d)", pid_przewodnik2);
-            kill(pid_przewodnik2, SIGUSR2);
-
-            sygnaly_wyslane = 1;
-        }
-    }
+    /// Twardy koniec (Tk lub Ctrl+C) - grupy, ktre nie zdyyby przed Tk, przewodnicy odwouj
+    /// sami (ostatni bezpieczny start, przewodnik_helpers.h); sygna odwouje reszt przed tras
+    if (zakonczenie_zadane) loguj_wiadomosc("=== OTRZYMANO CTRL+C - SYSTEMATYCZNE ZAMYKANIE ===");
+    loguj_wiadomoscf("Wysylam sygnaly zamkniecia do przewodnikow (%s)", zakonczenie_zadane ? "Ctrl+C" : "Tk");
+    wyslij_sygnaly_zamkniecia(pid_przewodnicy);
 
     /// KROK 12: ZAMKNIJ JASKINI (brak nowych zwiedzajcych)
     loguj_wiadomosc("ZAMYKAM JASKINIE (brak nowych zwiedzajacych)");
 
-    pthread_mutex_lock(&shm_j->mutex);
-    shm_j->otwarta = 0;
-    pthread_cond_broadcast(&shm_j->cond_otwarta);
-    pthread_mutex_unlock(&shm_j->mutex);
+    ustaw_otwarcie(shm_j, 0);
+    shm_metryki->otwarta = 0;
 
     /// KROK 13: Czekaj a wszyscy zwiedzajcy wyjd
     loguj_wiadomosc("Czekam az wszyscy zwiedzajacy opuszcza jaskinie");
-    int licznik_czekania = 0;
-    while (licznik_czekania < TIMEOUT_PUSTA_JASKINIA) {
-        int t1 = shm_t1->osoby;
-        int t2 = shm_t2->osoby;
+    uint64_t poczatek_czekania_ns = czas_monotoniczny_ns();
+    int ostatni_log = -INTERWAL_LOG;
+    int licznik_czekania;
+    while ((licznik_czekania = (int)((czas_monotoniczny_ns() - poczatek_czekania_ns) / 1000000000ULL)) <
+        TIMEOUT_PUSTA_JASKINIA) {
+        /// Liczniki tras i czy ich przewodnicy jeszcze yj
+        int na_trasach = 0;
+        int zywi_przewodnicy = 0;
+        int zajeta = -1;  /// Pierwsza niepusta trasa - na jej futeksie czekamy
+        char stan[32 * LICZBA_TRAS];
+        int dlugosc = 0;
+        for (int t = 0; t < LICZBA_TRAS; t++) {
+            int osoby = trasa_osoby(&shm_trasy[t]);
+            if (osoby != 0 && zajeta < 0) zajeta = t;
+            na_trasach += osoby;
+            zywi_przewodnicy += czy_proces_zyje(pid_przewodnicy[t]);
+            dlugosc += snprintf(stan + dlugosc, sizeof(stan) - (size_t)dlugosc, " trasa%d=%d", t + 1, osoby);
+        }
 
-        if (t1 == 0 && t2 == 0) {
+        if (na_trasach == 0) {
             loguj_wiadomosc("Jaskinia pusta - wszyscy wyszli");
             break;
         }
 
-        /// Sprawd czy przewodnicy jeszcze yj
-        int p1_zyje = czy_proces_zyje(pid_przewodnik1);
-        int p2_zyje = czy_proces_zyje(pid_przewodnik2);
-
-        if (!p1_zyje && !p2_zyje) {
+        if (zywi_przewodnicy == 0) {
             loguj_wiadomosc("Przewodnicy juz nie zyja - przerywam czekanie na liczniki");
-            loguj_wiadomoscf("UWAGA: Pozostalo na trasach: t1=%d t2=%d (procesy martwe)", t1, t2);
+            loguj_wiadomoscf("UWAGA: Pozostalo na trasach:%s (procesy martwe)", stan);
             break;
         }
 
-        if (licznik_czekania % INTERWAL_LOG == 0) {
-            loguj_wiadomoscf("Oczekiwanie: trasa1=%d trasa2=%d (czas=%ds)", t1, t2, licznik_czekania);
+        if (licznik_czekania - ostatni_log >= INTERWAL_LOG) {
+            loguj_wiadomoscf("Oczekiwanie:%s (czas=%ds)", stan, licznik_czekania);
+            ostatni_log = licznik_czekania;
         }
 
-        sleep(1);
-        licznik_czekania++;
+        /// Zamiast sleep(1) - przewodnik budzi futex trasy, gdy jej obsada spada do zera;
+        /// limit 1 s zostaje na log, zrzut histogramw i sprawdzenie martwych przewodnikw
+        if (zajeta >= 0) trasa_czekaj_pusta(&shm_trasy[zajeta], 1000);
+
+        if (zrzut_histogramow) {
+            zrzut_histogramow = 0;
+            wyswietl_histogramy(shm_hist, "na zadanie");
+            wyswietl_profil_blokad(shm_profil, "na zadanie");
+        }
 
         while (waitpid(-1, NULL, WNOHANG) > 0);
     }
+    double czas_dnia_s = (double)(czas_monotoniczny_ns() - shm_metryki->czas_otwarcia_ns) / 1e9;
 
     /// KROK 14: SYSTEMATYCZNY CLEANUP
     loguj_wiadomosc("=== ROZPOCZYNAM SYSTEMATYCZNY CLEANUP ===");
 
-    loguj_wiadomoscf("PID-y workerow: generator=%d kasjer=%d p1=%d p2=%d",
-        pid_generator, pid_kasjer, pid_przewodnik1, pid_przewodnik2);
+    loguj_wiadomoscf("PID-y workerow: generator=%d kasjer=%d przewodnikow=%d",
+        pid_generator, pid_kasjer, LICZBA_TRAS);
 
     /// Kolejno zamykania: generator -> zwiedzajcy -> kasjer -> przewodnicy
     /// Generator MUSI by zabity PRZED czytaniem listy! Inaczej zdy utworzy nowych
     loguj_wiadomosc("KROK 1/4: Zamykanie generatora");
-    zakoncz_proces(pid_generator, "generator", TIMEOUT_CZEKAJ_CLEANUP);
+    /// Zuycie zasobw rl - do wynikw pomiaru (JASKINIA_WYNIKI)
+    /// Role: straznik, kasjer, generator, potem przewodnicy tras
+    char nazwy_przewodnikow[LICZBA_TRAS][16];
+    const char* nazwy_rol[3 + LICZBA_TRAS] = { "straznik", "kasjer", "generator" };
+    for (int t = 0; t < LICZBA_TRAS; t++) {
+        snprintf(nazwy_przewodnikow[t], sizeof(nazwy_przewodnikow[t]), "przewodnik%d", t + 1);
+        nazwy_rol[3 + t] = nazwy_przewodnikow[t];
+    }
+    ZuzycieRoli role[3 + LICZBA_TRAS];
+    memset(role, 0, sizeof(role));
+    zakoncz_proces(pid_generator, "generator", TIMEOUT_CZEKAJ_CLEANUP, &role[2]);
 
     /// Zapisz list zwiedzajcych (teraz ju finalna - generator nie tworzy nowych)
     int liczba_zwiedzajacych = shm_zwiedzajacy->licznik;
@@ -510,10 +497,8 @@ int main() {
 
     /// Odcz shared memory (ju nie potrzeba)
     BEZPIECZNY_SHMDT(shm_j);
-    BEZPIECZNY_SHMDT(shm_k1);
-    BEZPIECZNY_SHMDT(shm_k2);
-    BEZPIECZNY_SHMDT(shm_t1);
-    BEZPIECZNY_SHMDT(shm_t2);
+    BEZPIECZNY_SHMDT(shm_kladki);
+    BEZPIECZNY_SHMDT(shm_trasy);
     BEZPIECZNY_SHMDT(shm_zwiedzajacy);
 
     if (prawidlowi_zwiedzajacy > 0) {
@@ -521,7 +506,7 @@ int main() {
         for (int i = 0; i < prawidlowi_zwiedzajacy; i++) {
             pid_t pid = zwiedzajacy[i];
             if (czy_proces_zyje(pid)) {
-                kill(pid, SIGTERM);
+                wyslij_sygnal(pid, SIGTERM);
             }
         }
 
@@ -534,10 +519,10 @@ int main() {
                 for (int j = 0; j < 3; j++) {
                     if (waitpid(pid, &status, WNOHANG) == pid) break;
                     if (!czy_proces_zyje(pid)) break;
-                    sleep(1);
+                    sen_s(1);
                 }
                 if (czy_proces_zyje(pid)) {
-                    kill(pid, SIGKILL);  /// Force kill
+                    wyslij_sygnal(pid, SIGKILL);  /// Force kill
                     waitpid(pid, NULL, 0);
                 }
             }
@@ -549,11 +534,12 @@ int main() {
     }
 
     loguj_wiadomosc("KROK 3/4: Zamykanie kasjera");
-    zakoncz_proces(pid_kasjer, "kasjer", TIMEOUT_CZEKAJ_CLEANUP);
+    zakoncz_proces(pid_kasjer, "kasjer", TIMEOUT_CZEKAJ_CLEANUP, &role[1]);
 
     loguj_wiadomosc("KROK 4/4: Zamykanie przewodnikow");
-    zakoncz_proces(pid_przewodnik1, "przewodnik1", TIMEOUT_CZEKAJ_CLEANUP);
-    zakoncz_proces(pid_przewodnik2, "przewodnik2", TIMEOUT_CZEKAJ_CLEANUP);
+    for (int t = 0; t < LICZBA_TRAS; t++) {
+        zakoncz_proces(pid_przewodnicy[t], nazwy_rol[3 + t], TIMEOUT_CZEKAJ_CLEANUP, &role[3 + t]);
+    }
 
     loguj_wiadomosc("Wszystkie procesy robocze zakonczone");
 
@@ -562,6 +548,24 @@ int main() {
     while (waitpid(-1, NULL, WNOHANG) > 0) zombie_count++;
     loguj_wiadomoscf("Zebrano %d zombie procesow", zombie_count);
 
+    /// Histogramy na koniec - wszyscy zwiedzajcy ju zakoczeni, liczby s finalne
+    wyswietl_histogramy(shm_hist, "koniec dnia");
+    wyswietl_profil_blokad(shm_profil, "koniec dnia");
+
+    const char* plik_wynikow = getenv("JASKINIA_WYNIKI");
+    if (plik_wynikow && plik_wynikow[0] != '\0') {
+        struct rusage wlasne;
+        getrusage(RUSAGE_SELF, &wlasne);
+        role[0].cpu_s = czas_cpu_s(&wlasne);
+        role[0].rss_kb = wlasne.ru_maxrss;
+        zapisz_wyniki_pomiaru(plik_wynikow, shm_hist, shm_metryki, czas_otwarcia, czas_dnia_s, otwarcie_ms,
+            nazwy_rol, role, 3 + LICZBA_TRAS);
+    }
+    BEZPIECZNY_SHMDT(shm_hist);
+    globalne_metryki = NULL;  /// Dalsze logi wg maski lokalnej
+    BEZPIECZNY_SHMDT(shm_metryki);
+    BEZPIECZNY_SHMDT(shm_profil);
+
     /// KROK 15: Usu wszystkie zasoby IPC
     loguj_wiadomosc("KROK 5/5: Usuwanie zasobow IPC");
     wyczysc_ipc();
@@ -2,21 +2,21 @@
 #define STRAZNIK_HELPERS_H
 
 #include "common.h"
+#include "histogramy.h"
+#include "metryki.h"
+#include "loguj.h"
 
-void wyczysc_ipc(void);
-
-void loguj_wiadomosc(const char* wiadomosc);
-void loguj_wiadomoscf(const char* format, ...);
+static void wyczysc_ipc(void);  /// W straznik.c
 
 /// Stwórz segment shared memory - zwraca -2 jeśli już istnieje (EEXIST)
 static inline int utworz_shm(key_t klucz, size_t rozmiar) {
     int shmid = shmget(klucz, rozmiar, IPC_CREAT | IPC_EXCL | 0600);
     if (shmid == -1) {
         if (errno == EEXIST) {
-            loguj_wiadomoscf("BLAD KRYTYCZNY: SHM klucz=%#x juz istnieje!", klucz);
+            loguj_blad("BLAD KRYTYCZNY: SHM klucz=%#x juz istnieje!", klucz);
             return -2;  /// Specjalny kod - konflikt zasobów
         }
-        loguj_wiadomoscf("BLAD: shmget(%#x, %zu): %s (errno=%d)", klucz, rozmiar, strerror(errno), errno);
+        loguj_blad("BLAD: shmget(%#x, %zu): %s (errno=%d)", klucz, rozmiar, strerror(errno), errno);
         return -1;
     }
 
@@ -29,10 +29,10 @@ static inline int utworz_sem(key_t klucz, int liczba, int wartosc_init) {
     int semid = semget(klucz, liczba, IPC_CREAT | IPC_EXCL | 0600);
     if (semid == -1) {
         if (errno == EEXIST) {
-            loguj_wiadomoscf("BLAD KRYTYCZNY: SEM klucz=%#x juz istnieje!", klucz);
+            loguj_blad("BLAD KRYTYCZNY: SEM klucz=%#x juz istnieje!", klucz);
             return -2;
         }
-        loguj_wiadomoscf("BLAD: semget(%#x, %d): %s (errno=%d)", klucz, liczba, strerror(errno), errno);
+        loguj_blad("BLAD: semget(%#x, %d): %s (errno=%d)", klucz, liczba, strerror(errno), errno);
         return -1;
     }
 
@@ -41,7 +41,7 @@ static inline int utworz_sem(key_t klucz, int liczba, int wartosc_init) {
     arg.val = wartosc_init;
     for (int i = 0; i < liczba; i++) {
         if (semctl(semid, i, SETVAL, arg) == -1) {
-            loguj_wiadomoscf("BLAD: semctl(%#x, %d, SETVAL, %d): %s", klucz, i, wartosc_init, strerror(errno));
+            loguj_blad("BLAD: semctl(%#x, %d, SETVAL, %d): %s", klucz, i, wartosc_init, strerror(errno));
         }
     }
 
@@ -54,10 +54,10 @@ static inline int utworz_msg(key_t klucz) {
     int msgid = msgget(klucz, IPC_CREAT | IPC_EXCL | 0600);
     if (msgid == -1) {
         if (errno == EEXIST) {
-            loguj_wiadomoscf("BLAD KRYTYCZNY: MSG klucz=%#x juz istnieje!", klucz);
+            loguj_blad("BLAD KRYTYCZNY: MSG klucz=%#x juz istnieje!", klucz);
             return -2;
         }
-        loguj_wiadomoscf("BLAD: msgget(%#x): %s (errno=%d)", klucz, strerror(errno), errno);
+        loguj_blad("BLAD: msgget(%#x): %s (errno=%d)", klucz, strerror(errno), errno);
         return -1;
     }
 
@@ -69,16 +69,120 @@ static inline int utworz_msg(key_t klucz) {
 #define SPRAWDZ_EEXIST_I_ZAKONCZ(warunek, typ_zasobu) \
     do { \
         if (warunek) { \
-            loguj_wiadomosc("=== BLAD KRYTYCZNY: KONFLIKT ZASOBOW " typ_zasobu " ==="); \
+            loguj_blad("=== BLAD KRYTYCZNY: KONFLIKT ZASOBOW " typ_zasobu " ==="); \
             loguj_wiadomosc("Poprzednie uruchomienie nie zostalo poprawnie zakonczone."); \
-            loguj_wiadomosc("ROZWIAZANIE: Uruchom 'make clean' aby wyczyscic zasoby IPC."); \
+            loguj_wiadomoscf("ROZWIAZANIE: Uruchom 'make sprzataj INSTANCJA=%d' aby wyczyscic zasoby IPC.", \
+                instancja_jaskini()); \
             wyczysc_ipc(); \
             return 1; \
         } \
     } while(0)
 
+/// Zrzut histogramów etapów do logu - percentyle w milisekundach
+static inline void wyswietl_histogramy(ShmHistogramy* h, const char* powod) {
+    if (!h) return;
+
+    loguj_wiadomoscf("=== HISTOGRAMY ETAPOW (%s) [ms] ===", powod);
+    loguj_wiadomosc("etap                  liczba        p50        p90        p99      p99.9        max    srednia");
+
+    for (int e = 0; e < LICZBA_ETAPOW; e++) {
+        const Histogram* hist = &h->etapy[e];
+        uint64_t liczba = __atomic_load_n(&hist->liczba, __ATOMIC_RELAXED);
+        uint64_t suma = __atomic_load_n(&hist->suma_ns, __ATOMIC_RELAXED);
+        double srednia = liczba > 0 ? (double)suma / (double)liczba : 0.0;
+
+        loguj_wiadomoscf("%-19s %8llu %10.3f %10.3f %10.3f %10.3f %10.3f %10.3f",
+            NAZWY_ETAPOW[e], (unsigned long long)liczba,
+            histogram_percentyl(hist, 50.0) / 1e6,
+            histogram_percentyl(hist, 90.0) / 1e6,
+            histogram_percentyl(hist, 99.0) / 1e6,
+            histogram_percentyl(hist, 99.9) / 1e6,
+            __atomic_load_n(&hist->max_ns, __ATOMIC_RELAXED) / 1e6,
+            srednia / 1e6);
+    }
+}
+
+/// Raport profilera blokad - miejsca posortowane po łącznym czasie czekania
+static inline void wyswietl_profil_blokad(ShmProfilBlokad* p, const char* powod) {
+    if (!p) return;
+
+    int kolejnosc[PROFIL_MAX_MIEJSC];
+    int liczba = 0;
+    for (int i = 0; i < PROFIL_MAX_MIEJSC; i++) {
+        if (__atomic_load_n(&p->miejsca[i].gotowe, __ATOMIC_ACQUIRE)) kolejnosc[liczba++] = i;
+    }
+    if (liczba == 0) return;  /// Profiler wyłączony - nic nie zebrano
+
+    /// Sortowanie przez wstawianie - miejsc jest kilkadziesiąt
+    for (int i = 1; i < liczba; i++) {
+        int biezacy = kolejnosc[i];
+        uint64_t suma = p->miejsca[biezacy].czekanie.suma_ns;
+        int j = i - 1;
+        while (j >= 0 && p->miejsca[kolejnosc[j]].czekanie.suma_ns < suma) {
+            kolejnosc[j + 1] = kolejnosc[j];
+            j--;
+        }
+        kolejnosc[j + 1] = biezacy;
+    }
+
+    loguj_wiadomoscf("=== PROFIL BLOKAD (%s) [czekanie/trzymanie w us, suma w ms] ===", powod);
+    loguj_wiadomosc("rodzaj blokada                 miejsce                    zdobyc  rywal%  czek.p50  czek.p99  czek.max  czek.suma  trzym.p50  trzym.p99  trzym.max");
+
+    for (int i = 0; i < liczba; i++) {
+        const MiejsceBlokady* e = &p->miejsca[kolejnosc[i]];
+        uint64_t przejecia = __atomic_load_n(&e->przejecia, __ATOMIC_RELAXED);
+        uint64_t z_czekaniem = __atomic_load_n(&e->z_czekaniem, __ATOMIC_RELAXED);
+        int rodzaj = (e->rodzaj >= 0 && e->rodzaj < LICZBA_RODZAJOW_BLOKAD) ? e->rodzaj : PROFIL_SEMAFOR;
+
+        loguj_wiadomoscf("%-6s %-22s %-24s %8llu %6.1f %9.1f %9.1f %9.1f %10.1f %10.1f %10.1f %10.1f",
+            NAZWY_RODZAJOW_BLOKAD[rodzaj], e->nazwa, e->miejsce,
+            (unsigned long long)przejecia,
+            przejecia > 0 ? 100.0 * (double)z_czekaniem / (double)przejecia : 0.0,
+            histogram_percentyl(&e->czekanie, 50.0) / 1e3,
+            histogram_percentyl(&e->czekanie, 99.0) / 1e3,
+            __atomic_load_n(&e->czekanie.max_ns, __ATOMIC_RELAXED) / 1e3,
+            __atomic_load_n(&e->czekanie.suma_ns, __ATOMIC_RELAXED) / 1e6,
+            histogram_percentyl(&e->trzymanie, 50.0) / 1e3,
+            histogram_percentyl(&e->trzymanie, 99.0) / 1e3,
+            __atomic_load_n(&e->trzymanie.max_ns, __ATOMIC_RELAXED) / 1e3);
+    }
+}
+
+/// Zużycie zasobów jednej roli - zbierane przy zamykaniu procesu
+typedef struct {
+    double cpu_s;   /// user + sys
+    long rss_kb;    /// Szczytowe RSS (VmHWM)
+} ZuzycieRoli;
+
+static inline double czas_cpu_s(const struct rusage* r) {
+    return (double)(r->ru_utime.tv_sec + r->ru_stime.tv_sec) +
+        (double)(r->ru_utime.tv_usec + r->ru_stime.tv_usec) / 1e6;
+}
+
+/// Szczytowe RSS żywego procesu z /proc/<pid>/status - 0 gdy nie da się odczytać
+static inline long szczytowe_rss_kb(pid_t pid) {
+    char sciezka[64], linia[128];
+    long kb = 0;
+    snprintf(sciezka, sizeof(sciezka), "/proc/%d/status", (int)pid);
+    FILE* f = fopen(sciezka, "r");
+    if (!f) return 0;
+    while (fgets(linia, sizeof(linia), f)) {
+        if (sscanf(linia, "VmHWM: %ld", &kb) == 1) break;
+    }
+    fclose(f);
+    return kb;
+}
+
+/// CPU zebranego dziecka = przyrost RUSAGE_CHILDREN (działa też gdy zebrał je handler SIGCHLD)
+static inline void policz_cpu_dziecka(ZuzycieRoli* zuzycie, const struct rusage* przed) {
+    struct rusage po;
+    if (!zuzycie || getrusage(RUSAGE_CHILDREN, &po) != 0) return;
+    zuzycie->cpu_s = czas_cpu_s(&po) - czas_cpu_s(przed);
+}
+
 /// Zakończ proces gracefully - SIGTERM -> czekaj -> SIGKILL
-static inline void zakoncz_proces(pid_t pid, const char* nazwa, int timeout) {
+/// zuzycie (może być NULL) - CPU i szczytowe RSS zakończonego procesu
+static inline void zakoncz_proces(pid_t pid, const char* nazwa, int timeout, ZuzycieRoli* zuzycie) {
     if (pid <= 0) return;
 
     /// Sprawdź czy proces w ogóle istnieje
@@ -87,9 +191,14 @@ static inline void zakoncz_proces(pid_t pid, const char* nazwa, int timeout) {
         return;
     }
 
+    /// RSS czytamy póki proces żyje - zombie nie ma już VmHWM
+    struct rusage przed;
+    getrusage(RUSAGE_CHILDREN, &przed);
+    if (zuzycie) zuzycie->rss_kb = szczytowe_rss_kb(pid);
+
     /// Wyślij SIGTERM
     loguj_wiadomoscf("Wysylam SIGTERM -> %s (PID=%d)", nazwa, pid);
-    kill(pid, SIGTERM);
+    wyslij_sygnal(pid, SIGTERM);
 
     /// Czekaj max timeout sekund
     for (int i = 0; i < timeout; i++) {
@@ -97,20 +206,107 @@ static inline void zakoncz_proces(pid_t pid, const char* nazwa, int timeout) {
         pid_t wynik = waitpid(pid, &status, WNOHANG);
         if (wynik == pid) {
             loguj_wiadomoscf("%s zakonczyl sie (czekano %ds)", nazwa, i);
+            policz_cpu_dziecka(zuzycie, &przed);
             return;
         }
         if (wynik == -1) {
-            loguj_wiadomoscf("%s: waitpid blad: %s", nazwa, strerror(errno));
+            if (errno == ECHILD) {  /// Zebrał go już handler SIGCHLD
+                loguj_wiadomoscf("%s zakonczyl sie (czekano %ds)", nazwa, i);
+            }
+            else {
+                loguj_wiadomoscf("%s: waitpid blad: %s", nazwa, strerror(errno));
+            }
+            policz_cpu_dziecka(zuzycie, &przed);
             return;
         }
-        sleep(1);
+        sen_s(1);
     }
 
     /// Timeout - force kill
-    loguj_wiadomoscf("TIMEOUT dla %s - wysylam SIGKILL", nazwa);
-    kill(pid, SIGKILL);
+    loguj_ostrzezenie("TIMEOUT dla %s - wysylam SIGKILL", nazwa);
+    wyslij_sygnal(pid, SIGKILL);
     waitpid(pid, NULL, 0);
     loguj_wiadomoscf("%s zakonczony (SIGKILL)", nazwa);
+    policz_cpu_dziecka(zuzycie, &przed);
+}
+
+/// Zapisz wyniki dnia jako klucz=wartosc (czyta je bench) - gdy ustawione JASKINIA_WYNIKI
+/// Wykorzystanie kładki = zajęte miejsco-sekundy / (pojemność * czas od otwarcia do opróżnienia)
+static inline void zapisz_wyniki_pomiaru(const char* sciezka, ShmHistogramy* h, ShmMetryki* m,
+    int czas_otwarcia, double czas_dnia_s, double otwarcie_ms, const char* const* nazwy_rol, const ZuzycieRoli* role, int liczba_rol) {
+    FILE* f = fopen(sciezka, "w");
+    if (!f) {
+        loguj_blad("BLAD: Nie mozna zapisac wynikow %s: %s", sciezka, strerror(errno));
+        return;
+    }
+
+    MetrykiKasjer kasjer;
+    MetrykiTrasa trasy[LICZBA_TRAS];
+    MetrykiKladka kladki[LICZBA_KLADEK];
+    MetrykiGenerator generator;
+    seqlock_odczytaj(&m->kasjer, &kasjer, sizeof(kasjer));
+    seqlock_odczytaj(&m->generator, &generator, sizeof(generator));
+    uint64_t odrzuceni_limit = 0;
+    for (int i = 0; i < LICZBA_TRAS; i++) {
+        seqlock_odczytaj(&m->trasy[i], &trasy[i], sizeof(trasy[i]));
+        odrzuceni_limit += trasy[i].odrzuceni_limit;
+    }
+    for (int i = 0; i < LICZBA_KLADEK; i++) {
+        seqlock_odczytaj(&m->kladki[i], &kladki[i], sizeof(kladki[i]));
+    }
+    const MetrykiZwiedzajacy* z = &m->zwiedzajacy;
+
+    fprintf(f, "tk=%d\n", czas_otwarcia);
+    fprintf(f, "tempo=%.3f\n", parametr_env_ulamek("JASKINIA_TEMPO", 0.0, 0.01, 1000.0));
+    fprintf(f, "ziarno=%d\n", parametr_env("JASKINIA_SEED", -1, 0, INT_MAX));
+    fprintf(f, "czas_dnia_s=%.3f\n", czas_dnia_s);
+    fprintf(f, "otwarcie_ms=%.3f\n", otwarcie_ms);
+    fprintf(f, "wygenerowano=%llu\n", (unsigned long long)generator.wygenerowano);
+    fprintf(f, "obsluzonych=%llu\n", (unsigned long long)kasjer.obsluzonych);
+    fprintf(f, "odrzuceni=%llu\n", (unsigned long long)z->odrzuceni);
+    fprintf(f, "zakonczyli=%llu\n", (unsigned long long)z->zakonczyli);
+    fprintf(f, "anulowani=%llu\n", (unsigned long long)z->anulowani);
+    fprintf(f, "timeouty=%llu\n", (unsigned long long)z->timeouty);
+    fprintf(f, "odrzuceni_limit=%llu\n", (unsigned long long)odrzuceni_limit);
+
+    for (int e = 0; e < LICZBA_ETAPOW; e++) {
+        const Histogram* hist = &h->etapy[e];
+        fprintf(f, "%s_liczba=%llu\n", NAZWY_ETAPOW[e],
+            (unsigned long long)__atomic_load_n(&hist->liczba, __ATOMIC_RELAXED));
+        fprintf(f, "%s_p50_ms=%.3f\n", NAZWY_ETAPOW[e], histogram_percentyl(hist, 50.0) / 1e6);
+        fprintf(f, "%s_p90_ms=%.3f\n", NAZWY_ETAPOW[e], histogram_percentyl(hist, 90.0) / 1e6);
+        fprintf(f, "%s_p99_ms=%.3f\n", NAZWY_ETAPOW[e], histogram_percentyl(hist, 99.0) / 1e6);
+        fprintf(f, "%s_max_ms=%.3f\n", NAZWY_ETAPOW[e],
+            __atomic_load_n(&hist->max_ns, __ATOMIC_RELAXED) / 1e6);
+    }
+
+    for (int i = 0; i < LICZBA_KLADEK; i++) {
+        double zajete_s = (double)kladki[i].przejscia * CZAS_PRZECHODZENIA_KLADKA / 1000.0;
+        fprintf(f, "kladka%d_przejscia=%llu\n", i + 1, (unsigned long long)kladki[i].przejscia);
+        fprintf(f, "kladka%d_wykorzystanie=%.4f\n", i + 1,
+            czas_dnia_s > 0.0 ? zajete_s / (KLADKI[i].pojemnosc * czas_dnia_s) : 0.0);
+    }
+
+    double cpu_razem = 0.0;
+    long rss_max = 0, rss_razem = 0;
+    for (int i = 0; i < liczba_rol; i++) {
+        fprintf(f, "cpu_%s_s=%.3f\n", nazwy_rol[i], role[i].cpu_s);
+        fprintf(f, "rss_%s_kb=%ld\n", nazwy_rol[i], role[i].rss_kb);
+        cpu_razem += role[i].cpu_s;
+        if (role[i].rss_kb > rss_max) rss_max = role[i].rss_kb;
+        rss_razem += role[i].rss_kb;
+    }
+    double cpu_zwiedzajacych = __atomic_load_n(&z->cpu_us, __ATOMIC_RELAXED) / 1e6;
+    long rss_zwiedzajacego = (long)__atomic_load_n(&z->max_rss_kb, __ATOMIC_RELAXED);
+    fprintf(f, "cpu_zwiedzajacy_s=%.3f\n", cpu_zwiedzajacych);
+    fprintf(f, "rss_zwiedzajacy_kb=%ld\n", rss_zwiedzajacego);
+    fprintf(f, "cpu_razem_s=%.3f\n", cpu_razem + cpu_zwiedzajacych);
+    fprintf(f, "rss_max_kb=%ld\n", rss_zwiedzajacego > rss_max ? rss_zwiedzajacego : rss_max);
+    /// Szczytowe RSS stałych ról plus najcięższego zwiedzającego - strony wspólne liczone w każdym
+    fprintf(f, "rss_razem_kb=%ld\n", rss_razem + rss_zwiedzajacego);
+
+    fclose(f);
+    loguj_wiadomoscf("Wyniki pomiaru zapisane do %s", sciezka);
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,286 @@
+#ifndef ZEGAR_H
+#define ZEGAR_H
+
+#include "common.h"
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+/// Hierarchiczne koło czasowe procesu - dowolnie wiele terminów zamiast jednego alarm()
+///
+/// - ZEGAR_POZIOMY poziomów po ZEGAR_SLOTY slotów, tyknięcie ZEGAR_TYK_NS (250 us);
+///   poziom 0 to najbliższe 64 tyknięcia, każdy wyższy 64x dłuższe, razem ~70 minut
+///   (dalsze terminy przycinane do końca koła)
+/// - uzbrojenie i rozbrojenie O(1): timer to węzeł listy dwukierunkowej w slocie,
+///   przy przejściu przez granicę poziomu slot wyższego poziomu rozkłada się niżej
+/// - jeden wątek zegara na proces śpi na futeksie do najbliższego tyknięcia z pracą
+///   (termin na poziomie 0 albo kaskada niepustego slotu); wcześniejszy termin go budzi
+/// - akcję wykonuje wątek zegara pod mutexem koła: ma być krótka - zapalić flagę,
+///   obudzić futex (zegar_budz_futex), przerwać wątek sygnałem (zegar_przerwij_watek).
+///   Nie uzbraja timerów i nie loguje. Po zegar_rozbroj() akcja na pewno się nie wykona.
+/// - wątek zegara blokuje wszystkie sygnały - kill() do procesu trafia do wątków ról
+///
+/// Koło jest dla procesów, w których czeka naraz wiele terminów. Role z jednym terminem
+/// (bilet i kolejka zwiedzającego, zbieranie grupy) zostają przy alarm()/setitimer -
+/// wątek zegara na proces kosztowałby więcej niż jeden timer jądra.
+///
+/// Stan koła jest statyczny w tym nagłówku (jak slad.h) - stan procesu.
+/// zegar_uruchom() po ostatnim fork() procesu; wątek kończy się z procesem,
+/// zegar_zatrzymaj() zatrzymuje go wcześniej (sprzątanie roli).
+
+#define ZEGAR_TYK_NS 250000ULL  /// Rozdzielczość terminów
+#define ZEGAR_BITY 6
+#define ZEGAR_SLOTY (1 << ZEGAR_BITY)
+#define ZEGAR_MASKA (ZEGAR_SLOTY - 1)
+#define ZEGAR_POZIOMY 4
+#define ZEGAR_ZASIEG ((1ULL << (ZEGAR_BITY * ZEGAR_POZIOMY)) - 1)  /// W tyknięciach
+#define ZEGAR_NIGDY UINT64_MAX
+#define ZEGAR_STOS (64 * 1024)  /// Wątek zegara tylko przekłada listy - mały stos
+
+typedef struct ZegarTimer {
+    struct ZegarTimer* nastepny;
+    struct ZegarTimer* poprzedni;
+    uint64_t termin;            /// Tyknięcie koła
+    void (*akcja)(void* arg);
+    void* arg;
+    int uzbrojony;
+} ZegarTimer;
+
+typedef struct {
+    pthread_mutex_t mutex;
+    ZegarTimer sloty[ZEGAR_POZIOMY][ZEGAR_SLOTY];  /// Wartowniki list
+    uint64_t start_ns;          /// Tyknięcie 0
+    uint64_t teraz;             /// Ostatnie przetworzone tyknięcie
+    uint64_t plan;              /// Do którego tyknięcia śpi wątek zegara
+    int uzbrojone;
+    uint32_t zmiana;            /// Futex wątku zegara
+    int dziala;
+    pthread_t watek;
+} ZegarKolo;
+
+static ZegarKolo zegar;
+
+static inline long zegar_futex(uint32_t* adres, int operacja, uint32_t wartosc, const struct timespec* czas) {
+    return syscall(SYS_futex, adres, operacja, wartosc, czas, NULL, 0);
+}
+
+static inline uint64_t zegar_tyk_teraz(void) {
+    return (czas_monotoniczny_ns() - zegar.start_ns) / ZEGAR_TYK_NS;
+}
+
+static inline void zegar_wypnij(ZegarTimer* t) {
+    t->poprzedni->nastepny = t->nastepny;
+    t->nastepny->poprzedni = t->poprzedni;
+    t->nastepny = t->poprzedni = NULL;
+}
+
+/// Wepnij timer w slot wg odległości od zegar.teraz - wymaga termin >= teraz i mutexu
+static inline void zegar_wepnij(ZegarTimer* t) {
+    uint64_t odleglosc = t->termin - zegar.teraz;
+    if (odleglosc > ZEGAR_ZASIEG) {
+        t->termin = zegar.teraz + ZEGAR_ZASIEG;
+        odleglosc = ZEGAR_ZASIEG;
+    }
+    int poziom = 0;
+    while (poziom < ZEGAR_POZIOMY - 1 && odleglosc >= (1ULL << (ZEGAR_BITY * (poziom + 1)))) poziom++;
+
+    ZegarTimer* glowa = &zegar.sloty[poziom][(t->termin >> (ZEGAR_BITY * poziom)) & ZEGAR_MASKA];
+    t->nastepny = glowa;
+    t->poprzedni = glowa->poprzedni;
+    glowa->poprzedni->nastepny = t;
+    glowa->poprzedni = t;
+}
+
+/// Rozłóż slot poziomu (na granicy jego okresu) na niższe poziomy
+static inline void zegar_kaskada(int poziom) {
+    ZegarTimer* glowa = &zegar.sloty[poziom][(zegar.teraz >> (ZEGAR_BITY * poziom)) & ZEGAR_MASKA];
+    while (glowa->nastepny != glowa) {
+        ZegarTimer* t = glowa->nastepny;
+        zegar_wypnij(t);
+        zegar_wepnij(t);
+    }
+}
+
+/// Najbliższe tyknięcie wymagające pracy - pod mutexem
+/// Slot poziomu l wymaga pracy na początku swojego okresu (kaskada), slot poziomu 0 w terminie.
+/// Wszystkie timery slotu mają ten sam okres (odległość < 64 okresów poziomu), więc wystarczy
+/// pierwszy - 4 x 64 porównania, niezależnie od liczby timerów.
+static inline uint64_t zegar_nastepny_tyk(void) {
+    if (zegar.uzbrojone == 0) return ZEGAR_NIGDY;
+    uint64_t najblizszy = ZEGAR_NIGDY;
+    for (int p = 0; p < ZEGAR_POZIOMY; p++) {
+        int przesuniecie = ZEGAR_BITY * p;
+        for (int s = 0; s < ZEGAR_SLOTY; s++) {
+            ZegarTimer* glowa = &zegar.sloty[p][s];
+            if (glowa->nastepny == glowa) continue;
+            uint64_t tyk = (glowa->nastepny->termin >> przesuniecie) << przesuniecie;
+            if (tyk < najblizszy) najblizszy = tyk;
+        }
+    }
+    return najblizszy;
+}
+
+/// Przesuń koło do tyknięcia cel i wykonaj akcje zapadłych terminów - pod mutexem
+/// Tyknięcia bez pracy przeskakujemy - długi sen wątku nie kosztuje pętli po każdym tyknięciu
+static inline void zegar_przetworz_do(uint64_t cel) {
+    while (zegar.teraz < cel) {
+        uint64_t nastepny = zegar_nastepny_tyk();
+        if (nastepny > cel) {
+            zegar.teraz = cel;
+            return;
+        }
+        zegar.teraz = nastepny;
+
+        int poziom = 0;
+        while (poziom < ZEGAR_POZIOMY - 1 &&
+            (zegar.teraz & ((1ULL << (ZEGAR_BITY * (poziom + 1))) - 1)) == 0) {
+            poziom++;
+        }
+        for (; poziom > 0; poziom--) zegar_kaskada(poziom);
+
+        ZegarTimer* glowa = &zegar.sloty[0][zegar.teraz & ZEGAR_MASKA];
+        while (glowa->nastepny != glowa) {
+            ZegarTimer* t = glowa->nastepny;
+            zegar_wypnij(t);
+            t->uzbrojony = 0;
+            zegar.uzbrojone--;
+            t->akcja(t->arg);
+        }
+    }
+}
+
+static void* zegar_watek(void* arg) {
+    (void)arg;
+    pthread_mutex_lock(&zegar.mutex);
+    while (zegar.dziala) {
+        zegar_przetworz_do(zegar_tyk_teraz());
+        zegar.plan = zegar_nastepny_tyk();
+        uint32_t zmiana = zegar.zmiana;
+        uint64_t pobudka_ns = zegar.plan == ZEGAR_NIGDY ? 0 : zegar.start_ns + zegar.plan * ZEGAR_TYK_NS;
+        pthread_mutex_unlock(&zegar.mutex);
+
+        if (pobudka_ns == 0) {
+            zegar_futex(&zegar.zmiana, FUTEX_WAIT_PRIVATE, zmiana, NULL);
+        }
+        else {
+            uint64_t teraz_ns = czas_monotoniczny_ns();
+            if (pobudka_ns > teraz_ns) {
+                uint64_t za_ns = pobudka_ns - teraz_ns;
+                struct timespec czas = { (time_t)(za_ns / 1000000000ULL), (long)(za_ns % 1000000000ULL) };
+                zegar_futex(&zegar.zmiana, FUTEX_WAIT_PRIVATE, zmiana, &czas);
+            }
+        }
+        pthread_mutex_lock(&zegar.mutex);
+    }
+    pthread_mutex_unlock(&zegar.mutex);
+    return NULL;
+}
+
+/// Wystartuj wątek zegara - 0 OK, -1 błąd (errno)
+static inline int zegar_uruchom(void) {
+    pthread_mutex_init(&zegar.mutex, NULL);
+    for (int p = 0; p < ZEGAR_POZIOMY; p++) {
+        for (int s = 0; s < ZEGAR_SLOTY; s++) {
+            zegar.sloty[p][s].nastepny = zegar.sloty[p][s].poprzedni = &zegar.sloty[p][s];
+        }
+    }
+    zegar.start_ns = czas_monotoniczny_ns();
+    zegar.teraz = 0;
+    zegar.plan = ZEGAR_NIGDY;
+    zegar.uzbrojone = 0;
+    zegar.dziala = 1;
+
+    /// Wątek dziedziczy maskę - blokujemy wszystko na czas pthread_create
+    sigset_t wszystkie, stara;
+    sigfillset(&wszystkie);
+    pthread_sigmask(SIG_BLOCK, &wszystkie, &stara);
+    pthread_attr_t atrybuty;
+    pthread_attr_init(&atrybuty);
+    pthread_attr_setstacksize(&atrybuty, ZEGAR_STOS);
+    int blad = pthread_create(&zegar.watek, &atrybuty, zegar_watek, NULL);
+    pthread_attr_destroy(&atrybuty);
+    pthread_sigmask(SIG_SETMASK, &stara, NULL);
+    if (blad != 0) {
+        zegar.dziala = 0;
+        errno = blad;
+        return -1;
+    }
+    return 0;
+}
+
+static inline void zegar_zatrzymaj(void) {
+    if (!zegar.dziala) return;
+    pthread_mutex_lock(&zegar.mutex);
+    zegar.dziala = 0;
+    zegar.zmiana++;
+    pthread_mutex_unlock(&zegar.mutex);
+    zegar_futex(&zegar.zmiana, FUTEX_WAKE_PRIVATE, 1, NULL);
+    pthread_join(zegar.watek, NULL);
+}
+
+static inline void zegar_rozbroj(ZegarTimer* t) {
+    pthread_mutex_lock(&zegar.mutex);
+    if (t->uzbrojony) {
+        zegar_wypnij(t);
+        t->uzbrojony = 0;
+        zegar.uzbrojone--;
+    }
+    pthread_mutex_unlock(&zegar.mutex);
+}
+
+/// Uzbrój (lub przestaw) timer na za_ns od teraz - akcja(arg) w wątku zegara
+static inline void zegar_uzbroj(ZegarTimer* t, uint64_t za_ns, void (*akcja)(void*), void* arg) {
+    pthread_mutex_lock(&zegar.mutex);
+    if (t->uzbrojony) {
+        zegar_wypnij(t);
+        zegar.uzbrojone--;
+    }
+    if (zegar.uzbrojone == 0) {
+        uint64_t tyk = zegar_tyk_teraz();
+        if (tyk > zegar.teraz) zegar.teraz = tyk;  /// Puste koło - dogoń czas bez przekładania
+    }
+
+    uint64_t termin = (czas_monotoniczny_ns() - zegar.start_ns + za_ns + ZEGAR_TYK_NS - 1) / ZEGAR_TYK_NS;
+    if (termin <= zegar.teraz) termin = zegar.teraz + 1;  /// Slot bieżącego tyknięcia już przetworzony
+    t->termin = termin;
+    t->akcja = akcja;
+    t->arg = arg;
+    t->uzbrojony = 1;
+    zegar.uzbrojone++;
+    zegar_wepnij(t);
+
+    int obudz = t->termin < zegar.plan;
+    if (obudz) {
+        zegar.plan = t->termin;
+        zegar.zmiana++;
+    }
+    pthread_mutex_unlock(&zegar.mutex);
+    if (obudz) zegar_futex(&zegar.zmiana, FUTEX_WAKE_PRIVATE, 1, NULL);
+}
+
+/// Akcja: zapal słowo i obudź czekających na nim (zegar_czekaj)
+static inline void zegar_budz_futex(void* arg) {
+    uint32_t* slowo = (uint32_t*)arg;
+    __atomic_store_n(slowo, 1, __ATOMIC_RELEASE);
+    zegar_futex(slowo, FUTEX_WAKE_PRIVATE, INT_MAX, NULL);
+}
+
+/// Czekaj aż słowo przestanie być 0 (termin z zegar_budz_futex albo inny wątek)
+static inline void zegar_czekaj(uint32_t* slowo) {
+    while (__atomic_load_n(slowo, __ATOMIC_ACQUIRE) == 0) {
+        zegar_futex(slowo, FUTEX_WAIT_PRIVATE, 0, NULL);
+    }
+}
+
+/// Przerwanie wątku zablokowanego w msgrcv/sigsuspend - sygnał skierowany do tego wątku
+/// (handler ustawia flagę roli, wywołanie kończy się EINTR)
+typedef struct {
+    pthread_t watek;
+    int sygnal;
+} ZegarPrzerwanie;
+
+static inline void zegar_przerwij_watek(void* arg) {
+    ZegarPrzerwanie* p = (ZegarPrzerwanie*)arg;
+    pthread_kill(p->watek, p->sygnal);
+}
+
+#endif
@@ -1,71 +1,54 @@
 ﻿#include "common.h"
 #include "common_helpers.h"
-
-int globalny_semid_log = -1;
+#include "histogramy.h"
+#include "metryki.h"
+#include "slad.h"
+#include "pary.h"
+#include "pierscien.h"
+#include "zegar.h"
+#include "loguj.h"
 
 /// Maszyna stanów zwiedzającego - kontrolowana sygnałami
-volatile sig_atomic_t odwolano = 0;       /// SIGUSR1 - odwołano (odrzucony przez kasjera/przewodnika)
-volatile sig_atomic_t w_grupie = 0;       /// SIGRTMIN+0 - zebrali mnie do grupy
-volatile sig_atomic_t na_kladce = 0;      /// SIGRTMIN+1 - idę przez kładkę
-volatile sig_atomic_t zwiedzam = 0;       /// SIGRTMIN+2 - zwiedzam trasę
-volatile sig_atomic_t moze_wyjsc = 0;     /// SIGUSR2 - przeszedłem kładkę przy wyjściu
-volatile sig_atomic_t alarm_otrzymany = 0;  /// SIGALRM - timeout
-volatile sig_atomic_t sigterm_otrzymany = 0; /// SIGTERM - shutdown
-
-void obsluga_sigusr1(int sig) { (void)sig; odwolano = 1; }
-void obsluga_sigrtmin0(int sig) { (void)sig; w_grupie = 1; }
-void obsluga_sigrtmin1(int sig) { (void)sig; na_kladce = 1; }
-void obsluga_sigrtmin2(int sig) { (void)sig; zwiedzam = 1; }
-void obsluga_sigusr2(int sig) { (void)sig; moze_wyjsc = 1; }
-void obsluga_alarm(int sig) { (void)sig; alarm_otrzymany = 1; }
-void obsluga_sigterm(int sig) { (void)sig; sigterm_otrzymany = 1; }
-
-void loguj_wiadomosc(const char* wiadomosc) {
-    int sem_zdobyty = 0;
-    char ts[64], buf[512];
-
-    if (globalny_semid_log != -1) {
-        struct sembuf op = { 0, -1, 0 };
-        if (bezpieczny_semop(globalny_semid_log, &op, 1) == 0) {
-            sem_zdobyty = 1;
-        }
-    }
-
-    time_t teraz = time(NULL);
-    strftime(ts, sizeof(ts), "%Y-%m-%d %H:%M:%S", localtime(&teraz));
-    snprintf(buf, sizeof(buf), "[%s] [PID:%d] [ZWIEDZAJACY] %s\n", ts, getpid(), wiadomosc);
-
-    int fd = open("jaskinia_common.log", O_WRONLY | O_CREAT | O_APPEND, 0644);
-    if (fd != -1) {
-        bezpieczny_zapis_wszystko(fd, buf, strlen(buf));
-        close(fd);
-    }
-
-    fd = open("jaskinia_zwiedzajacy.log", O_WRONLY | O_CREAT | O_APPEND, 0644);
-    if (fd != -1) {
-        bezpieczny_zapis_wszystko(fd, buf, strlen(buf));
-        close(fd);
-    }
-
-    if (sem_zdobyty) {
-        struct sembuf op = { 0, 1, 0 };
-        bezpieczny_semop(globalny_semid_log, &op, 1);
-    }
+static volatile sig_atomic_t odwolano = 0;       /// SIGUSR1 - odwołano (odrzucony przez kasjera/przewodnika)
+static volatile sig_atomic_t w_grupie = 0;       /// SIGRTMIN+0 - zebrali mnie do grupy
+static volatile sig_atomic_t na_kladce = 0;      /// SIGRTMIN+1 - idę przez kładkę
+static volatile sig_atomic_t zwiedzam = 0;       /// SIGRTMIN+2 - zwiedzam trasę
+static volatile sig_atomic_t moze_wyjsc = 0;     /// SIGUSR2 - przeszedłem kładkę przy wyjściu
+static volatile sig_atomic_t alarm_otrzymany = 0;  /// SIGALRM - timeout
+static volatile sig_atomic_t sigterm_otrzymany = 0; /// SIGTERM - shutdown
+
+static void obsluga_sigusr1(int sig) { (void)sig; odwolano = 1; }
+static void obsluga_sigrtmin0(int sig) { (void)sig; w_grupie = 1; }
+static void obsluga_sigrtmin1(int sig) { (void)sig; na_kladce = 1; }
+static void obsluga_sigrtmin2(int sig) { (void)sig; zwiedzam = 1; }
+static void obsluga_sigusr2(int sig) { (void)sig; moze_wyjsc = 1; }
+static void obsluga_alarm(int sig) { (void)sig; alarm_otrzymany = 1; }
+static void obsluga_sigterm(int sig) { (void)sig; sigterm_otrzymany = 1; loguj_oproznij(); }  /// Ogon logu zapisany nawet gdy potem przyjdzie SIGKILL
+
+/// Przy wyjściu dopisz zużycie CPU i pamięci do metryk - zwiedzający nie są dziećmi
+/// strażnika, więc ich getrusage zbieramy tutaj (atexit)
+static void zapisz_zuzycie_zasobow(void) {
+    struct rusage r;
+    if (!globalne_metryki || getrusage(RUSAGE_SELF, &r) != 0) return;
+    uint64_t cpu_us = (uint64_t)(r.ru_utime.tv_sec + r.ru_stime.tv_sec) * 1000000ULL +
+        (uint64_t)(r.ru_utime.tv_usec + r.ru_stime.tv_usec);
+    METRYKI_DODAJ(zwiedzajacy.cpu_us, cpu_us);
+    METRYKI_MAX(zwiedzajacy.max_rss_kb, (uint64_t)r.ru_maxrss);
 }
 
-void loguj_wiadomoscf(const char* format, ...) {
-    char wiadomosc[512];
-    va_list args;
-    va_start(args, format);
-    vsnprintf(wiadomosc, sizeof(wiadomosc), format, args);
-    va_end(args);
-    loguj_wiadomosc(wiadomosc);
+/// Rejestr par - przy wyjściu kasujemy swój bit obecności (kasjer i przewodnik to widzą)
+static ShmPary* shm_pary = NULL;
+static int id_pary = BRAK_PARY;
+static int bit_pary = 0;  /// PARA_OPIEKUN lub PARA_DZIECKO
+
+static void opusc_pare(void) {
+    para_opusc(shm_pary, id_pary, bit_pary);
 }
 
-int main(int argc, char* argv[]) {
-    /// Argumenty: wiek powtorna poprz_trasa pid_opiekuna czy_opiekun
-    if (argc != 6) {
-        fprintf(stderr, "Uzycie: %s <wiek> <powtorna> <poprz_trasa> <pid_opiekuna> <czy_opiekun>\n", argv[0]);
+int main_zwiedzajacy(int argc, char* argv[]) {
+    /// Argumenty: wiek powtorna poprz_trasa pid_opiekuna czy_opiekun id_pary
+    if (argc != 7) {
+        fprintf(stderr, "Uzycie: %s <wiek> <powtorna> <poprz_trasa> <pid_opiekuna> <czy_opiekun> <id_pary>\n", argv[0]);
         return 1;
     }
 
@@ -74,9 +57,10 @@ int main(int argc, char* argv[]) {
     /// Walidacja wszystkich argumentów
     if (bezpieczny_strtol(argv[1], &wiek, MIN_WIEK, MAX_WIEK) != 0 ||
         bezpieczny_strtol(argv[2], &powtorna, 0, 1) != 0 ||
-        bezpieczny_strtol(argv[3], &poprz_trasa, 1, 2) != 0 ||
+        bezpieczny_strtol(argv[3], &poprz_trasa, 1, LICZBA_TRAS) != 0 ||
         bezpieczny_strtol(argv[4], &pid_opiekuna, 0, INT_MAX) != 0 ||
-        bezpieczny_strtol(argv[5], &czy_opiekun, 0, 1) != 0) {
+        bezpieczny_strtol(argv[5], &czy_opiekun, 0, 1) != 0 ||
+        bezpieczny_strtol(argv[6], &id_pary, BRAK_PARY, MAX_PAR - 1) != 0) {
         fprintf(stderr, "ERROR: Nieprawidlowe argumenty\n");
         return 1;
     }
@@ -91,20 +75,47 @@ int main(int argc, char* argv[]) {
     signal(SIGTERM, obsluga_sigterm);
     signal(SIGINT, SIG_IGN);
 
-    INIT_SEMAFOR_LOG();
+    profil_blokad_inicjalizuj();
+    loguj_inicjalizuj(ROLA_ZWIEDZAJACY);
+    slad_inicjalizuj("ZWIEDZAJACY");
 
     pid_t moj_pid = getpid();
+    uint64_t czas_startu_ns = czas_monotoniczny_ns();
+    uint64_t czas_etapu_ns = 0;  /// Kiedy weszliśmy w bieżący etap (0 = nieznane)
+    const char* spawn_env = getenv("JASKINIA_SPAWN_NS");  /// Chwila fork() w generatorze
+    uint64_t czas_spawnu_ns = spawn_env ? strtoull(spawn_env, NULL, 10) : 0;
+
+    /// Histogramy są opcjonalne - bez nich zwiedzający działa normalnie
+    ShmHistogramy* shm_hist = NULL;
+    if (podlacz_shm_helper(KLUCZ_SHM_HISTOGRAMY, (void**)&shm_hist) == -1) {
+        loguj_ostrzezenie("WARN: Brak histogramow etapow - pomiary wylaczone");
+        shm_hist = NULL;
+    }
+    if (czas_spawnu_ns > 0 && czas_spawnu_ns <= czas_startu_ns) {
+        histogram_zapisz(shm_hist, ETAP_SPAWN, czas_startu_ns - czas_spawnu_ns);
+    }
+    globalne_metryki = podlacz_metryki();  /// Też opcjonalne
+    atexit(zapisz_zuzycie_zasobow);
+
+    if (id_pary != BRAK_PARY) {
+        bit_pary = czy_opiekun ? PARA_OPIEKUN : PARA_DZIECKO;
+        if (podlacz_shm_helper(KLUCZ_SHM_PARY, (void**)&shm_pary) == -1) {
+            loguj_ostrzezenie("WARN: Brak rejestru par - para %d bez wpisu", id_pary);
+            shm_pary = NULL;
+        }
+        atexit(opusc_pare);
+    }
 
-    loguj_wiadomoscf("START: wiek=%d powtorna=%d poprz=%d opiekun=%d czy_opiekun=%d",
+    loguj_zdarzenie(DZ_ZW_START,
         wiek, powtorna, poprz_trasa, pid_opiekuna, czy_opiekun);
 
-    /// Sprawdź czy opiekun faktycznie istnieje (może się zdążył skończyć)
-    if (pid_opiekuna > 0 && !czy_proces_zyje(pid_opiekuna)) {
-        loguj_wiadomoscf("WARN: Opiekun PID=%d nie istnieje podczas startu", pid_opiekuna);
+    /// Sprawdź czy opiekun faktycznie istnieje (może się zdążył skończyć) - bit obecności z rejestru par
+    if (pid_opiekuna > 0 && !para_obecny(shm_pary, id_pary, PARA_OPIEKUN)) {
+        loguj_ostrzezenie("WARN: Opiekun PID=%d nie istnieje podczas startu", pid_opiekuna);
     }
 
     /// KROK 1: Idę do kasjera po bilet
-    loguj_wiadomosc("STATE: Ide do kasjera");
+    loguj_zdarzenie(DZ_ZW_DO_KASJERA);
 
     int msgid_kasjer = podlacz_msg_helper(KLUCZ_MSG_KASJER);
     if (msgid_kasjer == -1) {
@@ -112,6 +123,18 @@ int main(int argc, char* argv[]) {
         return 0;
     }
 
+    ShmJaskinia* shm_j = NULL;  /// Stan otwarcia - bramka powrotu tego samego dnia
+    if (podlacz_shm_helper(KLUCZ_SHM_JASKINIA, (void**)&shm_j) == -1) {
+        loguj_wiadomosc("SHUTDOWN: Nie mozna podlaczyc KLUCZ_SHM_JASKINIA");
+        return 0;
+    }
+    ShmPierscienie* shm_pierscienie = NULL;  /// Kolejki do przewodników - podłączane przy pierwszej wizycie
+
+    /// Ziarno własne procesu - po fork() bez exec rand() generatora byłby wspólny. PID mnożony
+    /// (Knuth), nie XOR - bez JASKINIA_SEED ziarno_losowania ma już time ^ getpid() i XOR by go znosił
+    unsigned int ziarno = ziarno_losowania(2 + LICZBA_TRAS) + (unsigned int)moj_pid * 2654435761u;
+
+powrot:;
     /// Wypełnij prośbę o bilet
     WiadomoscKasjer zadanie;
     zadanie.mtype = powtorna ? TYP_MSG_POWTORNA : TYP_MSG_ZADANIE;  /// Powtórne mają priorytet!
@@ -121,18 +144,21 @@ int main(int argc, char* argv[]) {
     zadanie.poprzednia_trasa = poprz_trasa;
     zadanie.pid_opiekuna = pid_opiekuna;
     zadanie.czy_opiekun = czy_opiekun;
+    zadanie.id_pary = id_pary;
 
-    if (msgsnd(msgid_kasjer, &zadanie, sizeof(WiadomoscKasjer) - sizeof(long), 0) == -1) {
+    czas_etapu_ns = czas_monotoniczny_ns();
+    if (wyslij_msg(msgid_kasjer, &zadanie, sizeof(WiadomoscKasjer) - sizeof(long), 0) == -1) {
         if (errno == EIDRM) {
             loguj_wiadomosc("SHUTDOWN: Kolejka kasjera usunieta");
             return 0;
         }
-        loguj_wiadomoscf("ERROR: msgsnd kasjer: %s", strerror(errno));
+        loguj_blad("ERROR: msgsnd kasjer: %s", strerror(errno));
         return 0;
     }
+    METRYKI_DODAJ(zwiedzajacy.kolejka_kasjer, 1);
 
     /// KROK 2: Czekam na odpowiedź kasjera (max TIMEOUT_ODPOWIEDZ_BILET sekund)
-    loguj_wiadomosc("STATE: Czekam na bilet");
+    loguj_zdarzenie(DZ_ZW_CZEKAM_NA_BILET);
 
     WiadomoscOdpowiedz odpowiedz;
     int otrzymano = 0;
@@ -141,24 +167,27 @@ int main(int argc, char* argv[]) {
     alarm(TIMEOUT_ODPOWIEDZ_BILET);
 
     /// msgrcv z mtype=moj_pid - dostanę tylko swoją odpowiedź
-    ssize_t wynik = msgrcv(msgid_kasjer, &odpowiedz, sizeof(WiadomoscOdpowiedz) - sizeof(long),
-        moj_pid, 0);
+    ssize_t wynik = czekaj_msg(msgid_kasjer, &odpowiedz, sizeof(WiadomoscOdpowiedz) - sizeof(long),
+        moj_pid);
 
     alarm(0);
 
     if (wynik != -1) {
         otrzymano = 1;
+        histogram_zapisz_od(shm_hist, ETAP_BILET, czas_etapu_ns);
+        SLAD_KONIEC(SLAD_BILET, czas_etapu_ns, 0);
     }
     else if (errno == EINTR) {
         if (alarm_otrzymany) {
-            loguj_wiadomoscf("TIMEOUT: Brak odpowiedzi od kasjera (%ds)", TIMEOUT_ODPOWIEDZ_BILET);
+            METRYKI_DODAJ(zwiedzajacy.timeouty, 1);
+            loguj_zdarzenie(DZ_ZW_TIMEOUT_BILETU, TIMEOUT_ODPOWIEDZ_BILET);
             return 0;
         }
         if (sigterm_otrzymany) {
             loguj_wiadomosc("SHUTDOWN: SIGTERM podczas oczekiwania na bilet");
             return 0;
         }
-        loguj_wiadomosc("WARN: msgrcv przerwany sygnalem, koncze");
+        loguj_ostrzezenie("WARN: msgrcv przerwany sygnalem, koncze");
         return 0;
     }
     else if (errno == EIDRM) {
@@ -166,54 +195,59 @@ int main(int argc, char* argv[]) {
         return 0;
     }
     else {
-        loguj_wiadomoscf("ERROR: msgrcv odpowiedz: %s", strerror(errno));
+        loguj_blad("ERROR: msgrcv odpowiedz: %s", strerror(errno));
         return 0;
     }
 
     if (!otrzymano) {
-        loguj_wiadomosc("ERROR: Nie udalo sie otrzymac biletu");
+        loguj_blad("ERROR: Nie udalo sie otrzymac biletu");
         return 0;
     }
 
     /// Sprawdź decyzję kasjera
     if (odpowiedz.decyzja == DECYZJA_ODRZUCONY) {
-        loguj_wiadomosc("REJECT: Odrzucony przez kasjera");
+        METRYKI_DODAJ(zwiedzajacy.odrzuceni, 1);
+        loguj_zdarzenie(DZ_ZW_ODRZUCONY);
         return 0;
     }
 
     int trasa = odpowiedz.przydzielona_trasa;
-    if (trasa < 1 || trasa > 2) {
-        loguj_wiadomoscf("ERROR: Nieprawidlowa przydzielona trasa: %d", trasa);
+    if (trasa < 1 || trasa > LICZBA_TRAS) {
+        loguj_blad("ERROR: Nieprawidlowa przydzielona trasa: %d", trasa);
         return 0;
     }
 
-    loguj_wiadomoscf("TICKET: Przydzielono trase %d", trasa);
+    loguj_zdarzenie(DZ_ZW_BILET, trasa);
 
     /// KROK 3: Dołączam do kolejki przewodnika
-    loguj_wiadomosc("STATE: Dolaczam do kolejki przewodnika");
+    loguj_zdarzenie(DZ_ZW_DO_KOLEJKI);
 
-    int msgid_przewodnik = podlacz_msg_helper(trasa == 1 ? KLUCZ_MSG_PRZEWODNIK1 : KLUCZ_MSG_PRZEWODNIK2);
-    if (msgid_przewodnik == -1) {
+    if (!shm_pierscienie && podlacz_shm_helper(KLUCZ_SHM_PIERSCIENIE, (void**)&shm_pierscienie) == -1) {
         loguj_wiadomosc("SHUTDOWN: Nie mozna podlaczyc kolejki przewodnika");
         return 0;
     }
 
     WiadomoscPrzewodnik wiadomosc_przew;
-    wiadomosc_przew.mtype = TYP_MSG_ZWIEDZAJACY;
+    wiadomosc_przew.mtype = powtorna ? TYP_MSG_ZWIEDZAJACY_POWTORNY : TYP_MSG_ZWIEDZAJACY;  /// Pas priorytetowy
     wiadomosc_przew.pid_zwiedzajacego = moj_pid;
     wiadomosc_przew.wiek = wiek;
-
-    if (msgsnd(msgid_przewodnik, &wiadomosc_przew, sizeof(WiadomoscPrzewodnik) - sizeof(long), 0) == -1) {
-        if (errno == EIDRM) {
-            loguj_wiadomosc("SHUTDOWN: Kolejka przewodnika usunieta");
+    wiadomosc_przew.id_pary = id_pary;
+    wiadomosc_przew.czas_dolaczenia_ns = czas_monotoniczny_ns();
+
+    /// Pierścień trasy w shared memory (pierscien.h) - bez wywołania systemowego, gdy przewodnik nie śpi.
+    /// Pełny pierścień - czekamy na miejsce jak msgsnd na pełnej kolejce, najwyżej MAX_CZAS_W_KOLEJCE
+    int proby_wstawienia = 0;
+    while (kolejka_wstaw(&shm_pierscienie->trasy[trasa - 1], &wiadomosc_przew) == -1) {
+        if (sigterm_otrzymany || ++proby_wstawienia > MAX_CZAS_W_KOLEJCE * 1000 / INTERWAL_POLLING) {
+            loguj_blad("ERROR: Kolejka przewodnika %d pelna", trasa);
             return 0;
         }
-        loguj_wiadomoscf("ERROR: msgsnd przewodnik: %s", strerror(errno));
-        return 0;
+        sen_us(INTERWAL_POLLING * 1000);
     }
+    METRYKI_DODAJ(zwiedzajacy.kolejka_przewodnik[trasa - 1], 1);
 
     /// KROK 4: Czekam na sygnały od przewodnika - MASZYNA STANÓW
-    loguj_wiadomosc("STATE: W kolejce czekam na grupe");
+    loguj_zdarzenie(DZ_ZW_W_KOLEJCE);
 
     /// Ustawiamy alarm na MAX_CZAS_W_KOLEJCE - jeśli za długo w kolejce, kończymy
     alarm_otrzymany = 0;
@@ -234,12 +268,13 @@ int main(int argc, char* argv[]) {
 
     /// STAN 1: Czekam aż przewodnik zbierze grupę
     while (!odwolano && !w_grupie && !moze_wyjsc && !sigterm_otrzymany && !alarm_otrzymany) {
-        sigsuspend(&stara_maska);  /// Sleep z atomowym odblokowaniem sygnałów
+        czekaj_na_sygnal(&stara_maska);  /// Sleep z atomowym odblokowaniem sygnałów
     }
 
     if (alarm_otrzymany) {
         sigprocmask(SIG_SETMASK, &stara_maska, NULL);
-        loguj_wiadomoscf("TIMEOUT: Za dlugo w kolejce (%ds), koncze", MAX_CZAS_W_KOLEJCE);
+        METRYKI_DODAJ(zwiedzajacy.timeouty, 1);
+        loguj_zdarzenie(DZ_ZW_TIMEOUT_KOLEJKI, MAX_CZAS_W_KOLEJCE);
         return 0;
     }
 
@@ -248,86 +283,120 @@ int main(int argc, char* argv[]) {
 
     if (sigterm_otrzymany) {
         sigprocmask(SIG_SETMASK, &stara_maska, NULL);
-        loguj_wiadomosc("SHUTDOWN: SIGTERM przed rozpoczeciem wycieczki");
+        loguj_zdarzenie(DZ_ZW_SHUTDOWN_PRZED);
         return 0;
     }
 
     if (odwolano) {
         sigprocmask(SIG_SETMASK, &stara_maska, NULL);
-        loguj_wiadomosc("CANCEL: Przed rozpoczeciem wycieczki");
+        METRYKI_DODAJ(zwiedzajacy.anulowani, 1);
+        loguj_zdarzenie(DZ_ZW_ANULOWANY_PRZED);
         return 0;
     }
 
+    /// Od tej chwili znaczniki etapów - kolejkę i zbieranie mierzy przewodnik
+    czas_etapu_ns = 0;
     if (w_grupie) {
-        loguj_wiadomosc("STATE: Zebrano do grupy");
+        SLAD_KONIEC(SLAD_KOLEJKA, wiadomosc_przew.czas_dolaczenia_ns, trasa);
+        czas_etapu_ns = czas_monotoniczny_ns();
+        loguj_zdarzenie(DZ_ZW_ZEBRANO);
     }
 
     /// STAN 2: Czekam aż przewodnik powie "idźcie przez kładkę"
     while (!odwolano && !na_kladce && !moze_wyjsc && !sigterm_otrzymany) {
-        sigsuspend(&stara_maska);
+        czekaj_na_sygnal(&stara_maska);
     }
 
     if (sigterm_otrzymany) {
         sigprocmask(SIG_SETMASK, &stara_maska, NULL);
-        loguj_wiadomosc("SHUTDOWN: SIGTERM po zebraniu grupy");
+        loguj_zdarzenie(DZ_ZW_SHUTDOWN_W_GRUPIE);
         return 0;
     }
 
     if (odwolano) {
         sigprocmask(SIG_SETMASK, &stara_maska, NULL);
-        loguj_wiadomosc("CANCEL: Po zebraniu grupy");
+        METRYKI_DODAJ(zwiedzajacy.anulowani, 1);
+        loguj_zdarzenie(DZ_ZW_ANULOWANY_W_GRUPIE);
         return 0;
     }
 
     if (na_kladce) {
-        loguj_wiadomosc("STATE: Przechodze kladke (wejscie)");
+        SLAD_KONIEC(SLAD_CZEKANIE_KLADKA, czas_etapu_ns, trasa);
+        czas_etapu_ns = histogram_zapisz_od(shm_hist, ETAP_KLADKA, czas_etapu_ns);
+        loguj_zdarzenie(DZ_ZW_KLADKA_WEJSCIE);
     }
 
     /// STAN 3: Czekam aż przewodnik powie "zaczynamy zwiedzanie"
     while (!odwolano && !zwiedzam && !moze_wyjsc && !sigterm_otrzymany) {
-        sigsuspend(&stara_maska);
+        czekaj_na_sygnal(&stara_maska);
     }
 
     if (sigterm_otrzymany) {
         sigprocmask(SIG_SETMASK, &stara_maska, NULL);
-        loguj_wiadomosc("SHUTDOWN: SIGTERM podczas przechodzenia kladki");
+        loguj_zdarzenie(DZ_ZW_SHUTDOWN_NA_KLADCE);
         return 0;
     }
 
     if (odwolano) {
         sigprocmask(SIG_SETMASK, &stara_maska, NULL);
-        loguj_wiadomosc("CANCEL: Podczas przechodzenia kladki");
+        METRYKI_DODAJ(zwiedzajacy.anulowani, 1);
+        loguj_zdarzenie(DZ_ZW_ANULOWANY_NA_KLADCE);
         return 0;
     }
 
     if (zwiedzam) {
-        loguj_wiadomoscf("STATE: Zwiedzam trase %d", trasa);
+        SLAD_KONIEC(SLAD_PRZEJSCIE, na_kladce ? czas_etapu_ns : 0, trasa);
+        czas_etapu_ns = histogram_zapisz_od(shm_hist, ETAP_PRZEJSCIE, na_kladce ? czas_etapu_ns : 0);
+        histogram_zapisz_od(shm_hist, ETAP_START_WYCIECZKI, wiadomosc_przew.czas_dolaczenia_ns);
+        loguj_zdarzenie(DZ_ZW_ZWIEDZAM, trasa);
     }
 
     /// STAN 4: Zwiedzam - czekam aż przewodnik powie "możecie wyjść" (SIGUSR2)
     while (!odwolano && !moze_wyjsc && !sigterm_otrzymany) {
-        sigsuspend(&stara_maska);
+        czekaj_na_sygnal(&stara_maska);
     }
 
     if (sigterm_otrzymany) {
         sigprocmask(SIG_SETMASK, &stara_maska, NULL);
-        loguj_wiadomosc("SHUTDOWN: SIGTERM podczas zwiedzania");
+        loguj_zdarzenie(DZ_ZW_SHUTDOWN_NA_TRASIE);
         return 0;
     }
 
     if (odwolano) {
         sigprocmask(SIG_SETMASK, &stara_maska, NULL);
-        loguj_wiadomosc("CANCEL: Awaryjnie podczas zwiedzania");
+        METRYKI_DODAJ(zwiedzajacy.anulowani, 1);
+        loguj_zdarzenie(DZ_ZW_ANULOWANY_NA_TRASIE);
         return 0;
     }
 
     /// STAN 5: WYJŚCIE - przeszedłem kładkę wyjściową
     if (moze_wyjsc) {
-        loguj_wiadomosc("STATE: Przechodze kladke (wyjscie)");
-        sleep(1);  /// Krótka przerwa
-        loguj_wiadomosc("COMPLETE: Opuscilem jaskinie");
+        SLAD_KONIEC(SLAD_ZWIEDZANIE, zwiedzam ? czas_etapu_ns : 0, trasa);
+        czas_etapu_ns = histogram_zapisz_od(shm_hist, ETAP_ZWIEDZANIE, zwiedzam ? czas_etapu_ns : 0);
+        loguj_zdarzenie(DZ_ZW_KLADKA_WYJSCIE);
+        sen_s(1);  /// Krótka przerwa
+        histogram_zapisz_od(shm_hist, ETAP_WYJSCIE, czas_etapu_ns);
+        SLAD_KONIEC(SLAD_WYJSCIE, czas_etapu_ns, trasa);
+        histogram_zapisz_od(shm_hist, ETAP_CALOSC, czas_startu_ns);
+        METRYKI_DODAJ(zwiedzajacy.zakonczyli, 1);
+        loguj_zdarzenie(DZ_ZW_KONIEC);
     }
 
     sigprocmask(SIG_SETMASK, &stara_maska, NULL);
+
+    /// Powrót tego samego dnia na inną trasę (50% zniżki, kolejka TYP_MSG_POWTORNA) - ten sam
+    /// proces, podłączenia IPC i wpis w rejestrze generatora. Raz na dzień i tylko póki jaskinia
+    /// otwarta; pary nie wracają - opiekun z dzieckiem wychodzą razem
+    if (moze_wyjsc && !powtorna && id_pary == BRAK_PARY && !sigterm_otrzymany &&
+        jaskinia_otwarta(shm_j) && (int)(rand_r(&ziarno) % 100) < SZANSA_POWTORNA) {
+        powtorna = 1;
+        poprz_trasa = trasa;
+        odwolano = w_grupie = na_kladce = zwiedzam = 0;
+        moze_wyjsc = alarm_otrzymany = 0;
+        czas_startu_ns = czas_monotoniczny_ns();
+        loguj_zdarzenie(DZ_ZW_POWROT, poprz_trasa);
+        loguj_zdarzenie(DZ_ZW_START, wiek, powtorna, poprz_trasa, pid_opiekuna, czy_opiekun);
+        goto powrot;
+    }
     return 0;
 }
\ No newline at end of file